@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "BlobPool.h"
+
+using namespace mqtt;
+
+// Test equal contents share one handle and one copy
+TEST(BlobPoolTests, Acquire_DeduplicatesContent) {
+    // Arrange
+    BlobPool pool;
+
+    // Act
+    uint32_t first = pool.acquire("online");
+    uint32_t second = pool.acquire(std::string("onl") + "ine");
+    uint32_t other = pool.acquire("offline");
+
+    // Assert
+    EXPECT_EQ(first, second);
+    EXPECT_NE(first, other);
+    EXPECT_EQ("online", pool.get(first));
+    EXPECT_EQ(2u, pool.size());
+    EXPECT_EQ(std::string("online").size() + std::string("offline").size(), pool.contentBytes());
+}
+
+// Test content is freed with its last reference and the slot reused
+TEST(BlobPoolTests, Release_FreesWithLastReference) {
+    // Arrange
+    BlobPool pool;
+    uint32_t handle = pool.acquire("online");
+    pool.retain(handle);
+
+    // Act
+    pool.release(handle);
+    size_t size_after_first = pool.size();
+    pool.release(handle);
+    uint32_t reused = pool.acquire("offline");
+
+    // Assert
+    EXPECT_EQ(1u, size_after_first);
+    EXPECT_EQ(handle, reused);
+    EXPECT_EQ("offline", pool.get(reused));
+    EXPECT_EQ(1u, pool.size());
+}
+
+// Test handles stay valid while the pool grows
+TEST(BlobPoolTests, Get_StableAcrossGrowth) {
+    // Arrange
+    BlobPool pool;
+    uint32_t handle = pool.acquire("a payload long enough to live on the heap");
+
+    // Act
+    for (int i = 0; i < 10000; i++) {
+        pool.acquire("value_" + std::to_string(i));
+    }
+
+    // Assert
+    EXPECT_EQ("a payload long enough to live on the heap", pool.get(handle));
+    EXPECT_EQ(handle, pool.acquire("a payload long enough to live on the heap"));
+    EXPECT_GT(pool.memoryBytes(), pool.contentBytes());
+}
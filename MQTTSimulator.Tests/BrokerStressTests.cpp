@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "Broker.h"
+#include "Device.h"
+#include <algorithm>
+
+using namespace mqtt;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Longest time a single call to fn took over iterations
+    template <typename Fn>
+    std::chrono::microseconds maxCallLatency(int iterations, Fn fn) {
+        std::chrono::microseconds worst(0);
+        for (int i = 0; i < iterations; i++) {
+            auto start = Clock::now();
+            fn(i);
+            worst = std::max(worst, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start));
+        }
+        return worst;
+    }
+
+}
+
+class BrokerStressTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // Single dispatcher so the slow consumer stalls all delivery
+        broker = std::make_shared<Broker>("stress_broker", 1);
+        slow_device = std::make_shared<Device>("slow_device", broker, std::chrono::milliseconds(10));
+        slow_device->addMessageHandler([this](const Message&) {
+            handler_calls++;
+            std::this_thread::sleep_for(SLOW_HANDLER_DELAY);
+            });
+        slow_device->subscribe("slow/#");
+    }
+
+    void waitForHandler() {
+        auto deadline = Clock::now() + std::chrono::seconds(2);
+        while (handler_calls == 0 && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_GT(handler_calls.load(), 0);
+    }
+
+    static constexpr std::chrono::milliseconds SLOW_HANDLER_DELAY{ 50 };
+    static constexpr std::chrono::milliseconds LATENCY_BUDGET{ 25 };
+
+    std::atomic<int> handler_calls{ 0 };
+    std::shared_ptr<Broker> broker;
+    std::shared_ptr<Device> slow_device;
+};
+
+// Test publisher latency
+TEST_F(BrokerStressTest, Publish_SlowConsumer_LatencyStaysFlat) {
+    // Arrange
+    broker->publish(Message("slow/first", "stall"));
+    waitForHandler();
+
+    // Act
+    auto worst = maxCallLatency(500, [this](int i) {
+        broker->publish(Message("slow/" + std::to_string(i), "payload"));
+        });
+
+    // Assert
+    EXPECT_LT(worst, LATENCY_BUDGET);
+}
+
+// Test subscription changes during delivery
+TEST_F(BrokerStressTest, Subscribe_DuringSlowDelivery_DoesNotWait) {
+    // Arrange
+    auto other = std::make_shared<Device>("other_device", broker, std::chrono::milliseconds(10));
+    broker->publish(Message("slow/first", "stall"));
+    waitForHandler();
+
+    // Act
+    auto worst = maxCallLatency(50, [&other](int i) {
+        other->subscribe("fast/" + std::to_string(i));
+        other->unsubscribe("fast/" + std::to_string(i));
+        });
+
+    // Assert
+    EXPECT_LT(worst, LATENCY_BUDGET);
+}
+
+// Test a device publishing while its own handler is slow
+TEST_F(BrokerStressTest, DevicePublish_DuringOwnSlowHandler_DoesNotWait) {
+    // Arrange
+    broker->publish(Message("slow/first", "stall"));
+    waitForHandler();
+
+    // Act
+    auto worst = maxCallLatency(100, [this](int) {
+        slow_device->publish("telemetry/slow_device", "{}");
+        });
+
+    // Assert
+    EXPECT_LT(worst, LATENCY_BUDGET);
+}
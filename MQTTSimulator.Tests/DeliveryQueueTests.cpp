@@ -0,0 +1,291 @@
+#include "pch.h"
+#include "DeliveryQueue.h"
+#include "Broker.h"
+#include "Device.h"
+#include <future>
+#include <thread>
+
+using namespace mqtt;
+
+namespace {
+
+    Message makeMessage(const std::string& payload) {
+        return Message("telemetry/device_1", payload);
+    }
+
+    std::vector<std::string> drainPayloads(DeliveryQueue& queue) {
+        std::vector<std::string> payloads;
+        while (auto message = queue.pop()) {
+            payloads.push_back(message->getPayload());
+        }
+        return payloads;
+    }
+
+}
+
+// Test only the push that finds the queue idle schedules a drain
+TEST(DeliveryQueueTests, Push_Idle_SchedulesOneDrain) {
+    // Arrange
+    DeliveryQueue queue(4, OverflowPolicy::DropOldest);
+    bool schedule = false;
+    bool second_schedule = true;
+
+    // Act
+    auto admission = queue.push(makeMessage("a"), schedule);
+    queue.push(makeMessage("b"), second_schedule);
+    auto payloads = drainPayloads(queue);
+    bool after_drain = false;
+    queue.push(makeMessage("c"), after_drain);
+
+    // Assert
+    EXPECT_EQ(DeliveryQueue::Admission::Accepted, admission);
+    EXPECT_TRUE(schedule);
+    EXPECT_FALSE(second_schedule);
+    EXPECT_EQ((std::vector<std::string>{ "a", "b" }), payloads);
+    EXPECT_TRUE(after_drain);
+}
+
+// Test a batch that leaves messages behind keeps the drain claimed
+TEST(DeliveryQueueTests, EndBatch_WithMessagesLeft_KeepsDraining) {
+    // Arrange
+    DeliveryQueue queue(4, OverflowPolicy::DropOldest);
+    bool schedule = false;
+    queue.push(makeMessage("1"), schedule);
+    queue.push(makeMessage("2"), schedule);
+
+    // Act
+    queue.pop();
+    bool more = queue.endBatch();
+    queue.push(makeMessage("3"), schedule);
+    auto payloads = drainPayloads(queue);
+
+    // Assert
+    EXPECT_TRUE(more);
+    EXPECT_FALSE(schedule);
+    EXPECT_EQ((std::vector<std::string>{ "2", "3" }), payloads);
+    EXPECT_FALSE(queue.endBatch());
+}
+
+// Test drop-oldest keeps the newest messages
+TEST(DeliveryQueueTests, DropOldest_KeepsNewest) {
+    // Arrange
+    DeliveryQueue queue(2, OverflowPolicy::DropOldest);
+    bool schedule = false;
+
+    // Act
+    queue.push(makeMessage("1"), schedule);
+    queue.push(makeMessage("2"), schedule);
+    auto admission = queue.push(makeMessage("3"), schedule);
+
+    // Assert
+    EXPECT_EQ(DeliveryQueue::Admission::DroppedOldest, admission);
+    EXPECT_EQ((std::vector<std::string>{ "2", "3" }), drainPayloads(queue));
+    EXPECT_EQ(1u, queue.getStats().dropped);
+    EXPECT_EQ(2u, queue.getStats().high_water);
+}
+
+// Test drop-newest keeps what was already queued
+TEST(DeliveryQueueTests, DropNewest_DiscardsIncoming) {
+    // Arrange
+    DeliveryQueue queue(2, OverflowPolicy::DropNewest);
+    bool schedule = false;
+
+    // Act
+    queue.push(makeMessage("1"), schedule);
+    queue.push(makeMessage("2"), schedule);
+    auto admission = queue.push(makeMessage("3"), schedule);
+
+    // Assert
+    EXPECT_EQ(DeliveryQueue::Admission::DroppedNewest, admission);
+    EXPECT_EQ((std::vector<std::string>{ "1", "2" }), drainPayloads(queue));
+    EXPECT_EQ(1u, queue.getStats().dropped);
+}
+
+// Test disconnect fires once and then refuses everything until reconfigured
+TEST(DeliveryQueueTests, Disconnect_RefusesUntilConfigured) {
+    // Arrange
+    DeliveryQueue queue(1, OverflowPolicy::Disconnect);
+    bool schedule = false;
+    queue.push(makeMessage("1"), schedule);
+
+    // Act
+    auto overflow = queue.push(makeMessage("2"), schedule);
+    auto after = queue.push(makeMessage("3"), schedule);
+    drainPayloads(queue);
+    auto idle_after = queue.push(makeMessage("4"), schedule);
+    queue.configure(1, OverflowPolicy::Disconnect);
+    auto reconfigured = queue.push(makeMessage("5"), schedule);
+
+    // Assert
+    EXPECT_EQ(DeliveryQueue::Admission::Disconnected, overflow);
+    EXPECT_EQ(DeliveryQueue::Admission::DroppedNewest, after);
+    EXPECT_EQ(DeliveryQueue::Admission::DroppedNewest, idle_after);
+    EXPECT_EQ(DeliveryQueue::Admission::Accepted, reconfigured);
+    EXPECT_TRUE(schedule);
+    EXPECT_EQ(3u, queue.getStats().dropped);
+}
+
+// Test block holds the pushing thread until the drain makes room
+TEST(DeliveryQueueTests, Block_WaitsForRoom) {
+    // Arrange
+    DeliveryQueue queue(1, OverflowPolicy::Block);
+    bool schedule = false;
+    queue.push(makeMessage("1"), schedule);
+
+    // Act
+    auto blocked = std::async(std::launch::async, [&queue] {
+        bool other_schedule = false;
+        return queue.push(makeMessage("2"), other_schedule);
+        });
+    bool finished_early = blocked.wait_for(std::chrono::milliseconds(50)) == std::future_status::ready;
+    auto drained = std::async(std::launch::async, [&queue] {
+        return queue.pop().has_value();
+        });
+    ASSERT_TRUE(drained.get());
+    auto admission = blocked.get();
+
+    // Assert
+    EXPECT_FALSE(finished_early);
+    EXPECT_EQ(DeliveryQueue::Admission::Waited, admission);
+    EXPECT_EQ(std::vector<std::string>{ "2" }, drainPayloads(queue));
+    EXPECT_EQ(1u, queue.getStats().blocked);
+    EXPECT_EQ(0u, queue.getStats().dropped);
+}
+
+// Test a handler never blocks on its own subscriber's queue
+TEST(DeliveryQueueTests, Block_FromDrainer_Drops) {
+    // Arrange
+    DeliveryQueue queue(1, OverflowPolicy::Block);
+    bool schedule = false;
+    queue.push(makeMessage("1"), schedule);
+    queue.pop();
+    queue.push(makeMessage("2"), schedule);
+
+    // Act
+    auto admission = queue.push(makeMessage("3"), schedule);
+
+    // Assert
+    EXPECT_EQ(DeliveryQueue::Admission::DroppedNewest, admission);
+    EXPECT_EQ(0u, queue.getStats().blocked);
+}
+
+// Test waiting for idle returns once the drain ends
+TEST(DeliveryQueueTests, WaitIdle_ReturnsWhenDrained) {
+    // Arrange
+    DeliveryQueue queue(4, OverflowPolicy::Block);
+    bool schedule = false;
+    queue.push(makeMessage("1"), schedule);
+
+    // Act
+    bool idle_while_queued = queue.waitIdle(std::chrono::milliseconds(10));
+    auto drain = std::async(std::launch::async, [&queue] { return drainPayloads(queue); });
+    bool idle = queue.waitIdle(std::chrono::seconds(5));
+
+    // Assert
+    EXPECT_FALSE(idle_while_queued);
+    EXPECT_TRUE(idle);
+    EXPECT_EQ(std::vector<std::string>{ "1" }, drain.get());
+}
+
+// Test policy names round-trip through the parser
+TEST(DeliveryQueueTests, PolicyNames_RoundTrip) {
+    for (auto policy : { OverflowPolicy::DropOldest, OverflowPolicy::DropNewest,
+        OverflowPolicy::Block, OverflowPolicy::Disconnect }) {
+        OverflowPolicy parsed = OverflowPolicy::DropOldest;
+        EXPECT_TRUE(parseOverflowPolicy(overflowPolicyName(policy), parsed));
+        EXPECT_EQ(policy, parsed);
+    }
+    OverflowPolicy parsed;
+    EXPECT_FALSE(parseOverflowPolicy("drop-everything", parsed));
+}
+
+// Test a stalled subscriber overflowing with disconnect loses its subscriptions
+TEST(DeliveryQueueTests, Broker_SlowSubscriber_Disconnected) {
+    // Arrange
+    auto broker = std::make_shared<Broker>("test_broker", 1);
+    auto slow = std::make_shared<Device>("slow", broker, std::chrono::milliseconds(0));
+    slow->setDeliveryQueue(2, OverflowPolicy::Disconnect);
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<bool> first{ true };
+    slow->addMessageHandler([&](const Message&) {
+        if (first.exchange(false)) {
+            entered.set_value();
+            released.wait();
+        }
+        });
+    slow->subscribe("telemetry/#");
+
+    // Act
+    broker->publish(Message("telemetry/stuck", "0"));
+    entered.get_future().wait();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    const MetricsRegistry& metrics = broker->getMetrics();
+    for (int i = 0; metrics.value("mqttsim_subscriber_disconnects_total") == 0 &&
+        std::chrono::steady_clock::now() < deadline; i++) {
+        broker->publish(Message("telemetry/device_" + std::to_string(i % 64), std::to_string(i)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    release.set_value();
+
+    // Assert
+    auto stats = slow->getDeliveryStats();
+    EXPECT_TRUE(stats.disconnected);
+    EXPECT_GE(stats.dropped, 1u);
+    EXPECT_LE(stats.high_water, 2u);
+    EXPECT_TRUE(slow->getSubscribedTopics().empty());
+    EXPECT_EQ(1.0, metrics.value("mqttsim_subscriber_disconnects_total"));
+    EXPECT_GE(metrics.value("mqttsim_subscriber_dropped_total"), 1.0);
+    broker.reset(); // Joins the delivery workers before the handler's captures go away
+}
+
+// Test a stalled subscriber drops on a single dispatch thread without holding up others
+TEST(DeliveryQueueTests, Broker_OneDispatcher_SlowSubscriberDrops) {
+    // Arrange: a second delivery worker serves the fast subscriber while the slow one is stuck
+    auto broker = std::make_shared<Broker>("test_broker", 1, 2);
+    auto slow = std::make_shared<Device>("slow", broker, std::chrono::milliseconds(0));
+    auto fast = std::make_shared<Device>("fast", broker, std::chrono::milliseconds(0));
+    slow->setDeliveryQueue(4, OverflowPolicy::DropOldest);
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<bool> first{ true };
+    std::atomic<int> slow_handled{ 0 };
+    std::atomic<int> fast_handled{ 0 };
+    slow->addMessageHandler([&](const Message&) {
+        if (first.exchange(false)) {
+            entered.set_value();
+            released.wait();
+        }
+        slow_handled++;
+        });
+    fast->addMessageHandler([&](const Message&) { fast_handled++; });
+    slow->subscribe("telemetry/#");
+    fast->subscribe("telemetry/#");
+
+    // Act
+    const int count = 100;
+    broker->publish(Message("telemetry/device_1", "0"));
+    entered.get_future().wait();
+    for (int i = 1; i < count; i++) {
+        broker->publish(Message("telemetry/device_1", std::to_string(i)));
+    }
+    bool fast_done = fast->waitForDeliveries(std::chrono::seconds(5));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (fast_handled < count && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto stalled_stats = slow->getDeliveryStats();
+    release.set_value();
+    slow->waitForDeliveries(std::chrono::seconds(5));
+
+    // Assert
+    EXPECT_TRUE(fast_done);
+    EXPECT_EQ(count, fast_handled.load());
+    EXPECT_EQ(static_cast<uint64_t>(count - 1 - 4), stalled_stats.dropped);
+    EXPECT_EQ(4u, stalled_stats.depth);
+    EXPECT_EQ(1 + 4, slow_handled.load());
+    EXPECT_EQ(count - 1.0 - 4, broker->getMetrics().value("mqttsim_subscriber_dropped_total"));
+    broker.reset();
+}
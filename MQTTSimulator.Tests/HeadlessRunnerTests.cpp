@@ -0,0 +1,179 @@
+#include "pch.h"
+#include "HeadlessRunner.h"
+#include <sstream>
+
+using namespace mqtt;
+
+// Test option parsing
+TEST(HeadlessRunnerTests, Parse_ReadsAllOptions) {
+    // Arrange
+    const char* argv[] = { "MQTTSimulator", "--headless", "--duration", "2.5", "--messages", "5000",
+        "--devices", "20", "--interval", "50", "--publishers", "2", "--dispatch-threads", "3",
+        "--metrics-file", "metrics.json", "--metrics-format", "json" };
+    HeadlessOptions options;
+    std::string error;
+
+    // Act
+    bool parsed = options.parse(static_cast<int>(std::size(argv)), argv, error);
+
+    // Assert
+    ASSERT_TRUE(parsed) << error;
+    EXPECT_TRUE(options.enabled);
+    EXPECT_EQ(2500, options.duration.count());
+    EXPECT_EQ(5000u, options.message_limit);
+    EXPECT_EQ(20u, options.device_count);
+    EXPECT_EQ(50, options.telemetry_interval.count());
+    EXPECT_EQ(2u, options.publisher_threads);
+    EXPECT_EQ(3u, options.dispatch_threads);
+    EXPECT_EQ("metrics.json", options.metrics_file);
+    EXPECT_EQ(MetricsFormat::Json, options.metrics_format);
+}
+
+// Test defaults and errors
+TEST(HeadlessRunnerTests, Parse_RejectsBadInputAndDefaultsDuration) {
+    // Arrange
+    const char* headless_only[] = { "MQTTSimulator", "--headless" };
+    const char* unknown[] = { "MQTTSimulator", "--fast" };
+    const char* negative[] = { "MQTTSimulator", "--devices", "-3" };
+    const char* missing[] = { "MQTTSimulator", "--messages" };
+    const char* bad_format[] = { "MQTTSimulator", "--metrics-format", "xml" };
+    HeadlessOptions options;
+    std::string error;
+
+    // Act & Assert
+    ASSERT_TRUE(options.parse(2, headless_only, error));
+    EXPECT_EQ(constants::HEADLESS_DEFAULT_DURATION_S * 1000, options.duration.count());
+
+    EXPECT_FALSE(HeadlessOptions().parse(2, unknown, error));
+    EXPECT_NE(std::string::npos, error.find("--fast"));
+    EXPECT_FALSE(HeadlessOptions().parse(3, negative, error));
+    EXPECT_FALSE(HeadlessOptions().parse(2, missing, error));
+    EXPECT_FALSE(HeadlessOptions().parse(3, bad_format, error));
+}
+
+// Test options the graphical simulator would ignore need --headless
+TEST(HeadlessRunnerTests, Parse_HeadlessOnlyOptionWithoutHeadless_Rejected) {
+    // Arrange
+    const char* listen[] = { "MQTTSimulator", "--listen", "1883" };
+    const char* overflow[] = { "MQTTSimulator", "--snapshot", "start.bin", "--overflow", "block" };
+    const char* snapshot[] = { "MQTTSimulator", "--snapshot", "start.bin" };
+    std::string error;
+
+    // Act & Assert
+    EXPECT_FALSE(HeadlessOptions().parse(3, listen, error));
+    EXPECT_EQ("--listen requires --headless", error);
+    EXPECT_FALSE(HeadlessOptions().parse(5, overflow, error));
+    EXPECT_EQ("--overflow requires --headless", error);
+    HeadlessOptions options;
+    EXPECT_TRUE(options.parse(3, snapshot, error)) << error;
+    EXPECT_FALSE(options.enabled);
+}
+
+// Test load generator options
+TEST(HeadlessRunnerTests, Parse_LoadTarget) {
+    // Arrange
+    const char* argv[] = { "MQTTSimulator", "--load", "[::1]:1883", "--load-threads", "4", "--qos", "2" };
+    const char* no_port[] = { "MQTTSimulator", "--load", "localhost" };
+    const char* bad_qos[] = { "MQTTSimulator", "--load", "localhost:1883", "--qos", "3" };
+    HeadlessOptions options;
+    std::string error;
+
+    // Act
+    bool parsed = options.parse(static_cast<int>(std::size(argv)), argv, error);
+
+    // Assert
+    ASSERT_TRUE(parsed) << error;
+    EXPECT_TRUE(options.enabled);
+    EXPECT_EQ("::1", options.load_host);
+    EXPECT_EQ(1883, options.load_port);
+    EXPECT_EQ(4u, options.load_threads);
+    EXPECT_EQ(QoS::EXACTLY_ONCE, options.load_qos);
+    EXPECT_FALSE(HeadlessOptions().parse(3, no_port, error));
+    EXPECT_FALSE(HeadlessOptions().parse(5, bad_qos, error));
+}
+
+// Test the subscriber queue options
+TEST(HeadlessRunnerTests, Parse_OverflowPolicy) {
+    // Arrange
+    const char* argv[] = { "MQTTSimulator", "--headless", "--queue-capacity", "16", "--overflow", "drop-newest" };
+    const char* bad_policy[] = { "MQTTSimulator", "--overflow", "drop-all" };
+    const char* zero_capacity[] = { "MQTTSimulator", "--queue-capacity", "0" };
+    HeadlessOptions options;
+    std::string error;
+
+    // Act
+    bool parsed = options.parse(static_cast<int>(std::size(argv)), argv, error);
+
+    // Assert
+    ASSERT_TRUE(parsed) << error;
+    EXPECT_EQ(16u, options.queue_capacity);
+    EXPECT_EQ(OverflowPolicy::DropNewest, options.overflow_policy);
+    EXPECT_EQ(OverflowPolicy::DropOldest, HeadlessOptions().overflow_policy);
+    EXPECT_FALSE(HeadlessOptions().parse(3, bad_policy, error));
+    EXPECT_FALSE(HeadlessOptions().parse(3, zero_capacity, error));
+}
+
+// Test the persistence directory option
+TEST(HeadlessRunnerTests, Parse_DataDir) {
+    // Arrange
+    const char* argv[] = { "MQTTSimulator", "--headless", "--data-dir", "/var/lib/mqttsim" };
+    const char* empty_dir[] = { "MQTTSimulator", "--data-dir", "" };
+    HeadlessOptions options;
+    std::string error;
+
+    // Act
+    bool parsed = options.parse(static_cast<int>(std::size(argv)), argv, error);
+
+    // Assert
+    ASSERT_TRUE(parsed) << error;
+    EXPECT_EQ("/var/lib/mqttsim", options.data_dir);
+    EXPECT_TRUE(HeadlessOptions().data_dir.empty());
+    EXPECT_FALSE(HeadlessOptions().parse(3, empty_dir, error));
+}
+
+// Test a short load run
+TEST(HeadlessRunnerTests, Run_MessageLimit_DeliversAndReports) {
+    // Arrange
+    HeadlessOptions options;
+    options.enabled = true;
+    options.message_limit = 2000;
+    options.duration = std::chrono::seconds(20);
+    options.device_count = 4;
+    options.telemetry_interval = std::chrono::milliseconds(0);
+    options.publisher_threads = 1;
+    options.dispatch_threads = 2;
+    HeadlessRunner runner(options);
+
+    // Act
+    HeadlessReport report = runner.run();
+
+    // Assert
+    EXPECT_GE(report.delivered, 2000u);
+    EXPECT_GE(report.published, report.delivered);
+    EXPECT_LT(report.elapsed.count(), 20.0);
+    EXPECT_GT(report.throughput, 0.0);
+    EXPECT_LE(report.latency_p50_us, report.latency_p99_us);
+    EXPECT_LE(report.latency_p99_us, report.latency_max_us);
+
+    std::ostringstream out;
+    HeadlessRunner::printReport(options, report, out);
+    EXPECT_NE(std::string::npos, out.str().find("Delivered:"));
+}
+
+// Test the snapshot options
+TEST(HeadlessRunnerTests, Parse_Snapshot) {
+    // Arrange
+    const char* argv[] = { "MQTTSimulator", "--headless", "--snapshot", "start.bin", "--save-snapshot", "end.bin" };
+    const char* empty_path[] = { "MQTTSimulator", "--snapshot", "" };
+    HeadlessOptions options;
+    std::string error;
+
+    // Act
+    bool parsed = options.parse(static_cast<int>(std::size(argv)), argv, error);
+
+    // Assert
+    ASSERT_TRUE(parsed) << error;
+    EXPECT_EQ("start.bin", options.snapshot_file);
+    EXPECT_EQ("end.bin", options.save_snapshot_file);
+    EXPECT_FALSE(HeadlessOptions().parse(3, empty_path, error));
+}
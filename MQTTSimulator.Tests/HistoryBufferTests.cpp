@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "HistoryBuffer.h"
+#include <atomic>
+#include <thread>
+
+using namespace mqtt;
+
+// Test overwrite
+TEST(HistoryBufferTests, PushBeyondCapacity_DropsOldest) {
+    // Arrange
+    HistoryBuffer<int> buffer(3);
+
+    // Act
+    for (int i = 1; i <= 5; i++) {
+        buffer.push_back(i);
+    }
+
+    // Assert
+    ASSERT_EQ(3u, buffer.size());
+    EXPECT_EQ((std::vector<int>{ 3, 4, 5 }), buffer.snapshot());
+    ASSERT_TRUE(buffer.latest().has_value());
+    EXPECT_EQ(5, *buffer.latest());
+    EXPECT_EQ(5u, buffer.version());
+}
+
+// Test resizing
+TEST(HistoryBufferTests, SetCapacity_KeepsNewestInOrder) {
+    // Arrange
+    HistoryBuffer<int> buffer(4);
+    for (int i = 1; i <= 6; i++) {
+        buffer.push_back(i);
+    }
+
+    // Act
+    buffer.setCapacity(2);
+    buffer.push_back(7);
+
+    // Assert
+    EXPECT_EQ((std::vector<int>{ 6, 7 }), buffer.snapshot());
+
+    buffer.setCapacity(5);
+    buffer.push_back(8);
+    EXPECT_EQ((std::vector<int>{ 6, 7, 8 }), buffer.snapshot());
+    EXPECT_EQ(5u, buffer.capacity());
+}
+
+// Test empty buffer
+TEST(HistoryBufferTests, Empty_HasNoLatestOrSnapshot) {
+    // Arrange
+    HistoryBuffer<int> buffer(3);
+    HistoryBuffer<int> disabled(0);
+
+    // Act
+    disabled.push_back(1);
+
+    // Assert
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_FALSE(buffer.latest().has_value());
+    EXPECT_TRUE(disabled.snapshot().empty());
+}
+
+// Test readers racing a writer
+TEST(HistoryBufferTests, ConcurrentSnapshots_AreContiguousAndOrdered) {
+    // Arrange
+    HistoryBuffer<int> buffer(64);
+    std::atomic<bool> done{ false };
+    std::atomic<int> inconsistent{ 0 };
+
+    std::thread writer([&] {
+        for (int i = 0; i < 200000; i++) {
+            buffer.push_back(i);
+            if (i % 50000 == 0) {
+                buffer.setCapacity(i % 100000 == 0 ? 32 : 64);
+            }
+        }
+        done = true;
+        });
+
+    // Act
+    while (!done) {
+        auto values = buffer.snapshot();
+        if (values.size() > 64) {
+            inconsistent++;
+        }
+        for (size_t i = 1; i < values.size(); i++) {
+            if (values[i] != values[i - 1] + 1) {
+                inconsistent++;
+                break;
+            }
+        }
+    }
+    writer.join();
+
+    // Assert
+    EXPECT_EQ(0, inconsistent.load());
+    auto values = buffer.snapshot();
+    ASSERT_FALSE(values.empty());
+    EXPECT_EQ(199999, values.back());
+}
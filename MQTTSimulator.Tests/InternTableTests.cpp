@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "InternTable.h"
+#include "Message.h"
+#include "Broker.h"
+#include "Device.h"
+#include <thread>
+
+using namespace mqtt;
+
+// Test equal strings share a handle and lookups give the string back
+TEST(InternTableTests, Intern_EqualStrings_ShareHandle) {
+    // Arrange
+    InternTable table;
+
+    // Act
+    InternTable::Handle first = table.intern("telemetry/sensor_temp");
+    InternTable::Handle again = table.intern(std::string("telemetry/") + "sensor_temp");
+    InternTable::Handle other = table.intern("telemetry/gateway");
+
+    // Assert
+    EXPECT_EQ(first, again);
+    EXPECT_NE(first, other);
+    EXPECT_EQ("telemetry/sensor_temp", table.lookup(first));
+    EXPECT_EQ(InternTable::EMPTY, table.intern(""));
+    EXPECT_EQ("", table.lookup(InternTable::EMPTY));
+    EXPECT_EQ(first, table.find("telemetry/sensor_temp"));
+    EXPECT_FALSE(table.find("telemetry/unknown").has_value());
+    EXPECT_EQ(3u, table.size());
+}
+
+// Test threads interning the same strings in different orders agree on every handle
+TEST(InternTableTests, Intern_ConcurrentThreads_AgreeOnHandles) {
+    // Arrange
+    InternTable table;
+    const int string_count = 5000;
+    const int thread_count = 8;
+    std::vector<std::vector<InternTable::Handle>> handles(thread_count,
+        std::vector<InternTable::Handle>(string_count));
+
+    // Act
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&table, &handles, t] {
+            for (int n = 0; n < string_count; n++) {
+                int i = (t % 2 == 0) ? n : string_count - 1 - n;
+                handles[t][i] = table.intern("device_" + std::to_string(i));
+            }
+            });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Assert
+    EXPECT_EQ(static_cast<size_t>(string_count) + 1, table.size());
+    for (int t = 1; t < thread_count; t++) {
+        EXPECT_EQ(handles[0], handles[t]);
+    }
+    for (int i = 0; i < string_count; i++) {
+        EXPECT_EQ("device_" + std::to_string(i), table.lookup(handles[0][i]));
+    }
+    EXPECT_GT(table.memoryUsage(), 0u);
+}
+
+// Test messages keep their topic, sender and target as handles into the global tables
+TEST(InternTableTests, Message_CarriesHandles) {
+    // Arrange: as a subscription to the topic would
+    InternTable::Handle topic = InternTable::topics().intern("fleet/valve/status");
+    Message message("fleet/valve/status", "open");
+    message.setSenderId("valve");
+
+    // Act
+    Message delivery = message;
+    delivery.setTargetHandle(InternTable::clients().intern("monitor"));
+
+    // Assert
+    EXPECT_EQ(topic, message.getTopicHandle());
+    EXPECT_EQ(message.getTopicHandle(), delivery.getTopicHandle());
+    EXPECT_EQ("valve", delivery.getSenderId());
+    EXPECT_EQ("monitor", delivery.getTargetId());
+    EXPECT_EQ("", message.getTargetId());
+}
+
+// Test a topic nobody interned stays a string and does not grow the table
+TEST(InternTableTests, Message_UninternedTopic_KeepsString) {
+    // Arrange
+    size_t before = InternTable::topics().size();
+
+    // Act
+    Message message("req/4f1c2a9e-unique", "ping");
+    Message copy = message;
+    copy.setTopic("req/5d0b7e31-unique");
+
+    // Assert
+    EXPECT_EQ(InternTable::EMPTY, message.getTopicHandle());
+    EXPECT_EQ("req/4f1c2a9e-unique", message.getTopic());
+    EXPECT_EQ("req/5d0b7e31-unique", copy.getTopic());
+    EXPECT_EQ(before, InternTable::topics().size());
+    EXPECT_FALSE(InternTable::topics().find("req/4f1c2a9e-unique").has_value());
+}
+
+// Test a topic without a handle still reaches wildcard subscribers without being interned
+TEST(InternTableTests, Broker_UninternedTopic_Delivered) {
+    // Arrange
+    auto broker = std::make_shared<Broker>("test_broker", 4);
+    auto monitor = std::make_shared<Device>("monitor", broker, std::chrono::milliseconds(0));
+    std::atomic<int> received{ 0 };
+    monitor->addMessageHandler([&received](const Message& message) {
+        if (message.getTopic() == "req/9a7e11c0-unique") {
+            received++;
+        }
+        });
+    monitor->subscribe("req/#");
+    size_t before = InternTable::topics().size();
+
+    // Act
+    broker->publish(Message("req/9a7e11c0-unique", "ping"));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (received == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Assert
+    EXPECT_EQ(1, received.load());
+    EXPECT_EQ(before, InternTable::topics().size());
+    broker.reset();
+}
+
+// Test a transient device's id, exact filter and publishes add nothing to either table
+TEST(InternTableTests, TransientDevice_NotInterned) {
+    // Arrange
+    auto broker = std::make_shared<Broker>("test_broker", 4);
+    size_t topics_before = InternTable::topics().size();
+    size_t clients_before = InternTable::clients().size();
+    auto client = std::make_shared<Device>("client-3b81e6d2", broker, std::chrono::milliseconds(0), true);
+    std::atomic<int> received{ 0 };
+    client->addMessageHandler([&received](const Message& message) {
+        if (message.getSenderId() == "client-3b81e6d2") {
+            received++;
+        }
+        });
+    client->subscribe("reply/3b81e6d2");
+
+    // Act
+    client->publish("reply/3b81e6d2", "pong");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (received == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Assert
+    EXPECT_EQ(1, received.load());
+    EXPECT_EQ(InternTable::EMPTY, client->getHandle());
+    EXPECT_EQ(topics_before, InternTable::topics().size());
+    EXPECT_EQ(clients_before, InternTable::clients().size());
+    broker.reset();
+}
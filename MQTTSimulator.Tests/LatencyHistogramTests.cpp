@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "LatencyHistogram.h"
+#include <cmath>
+
+using namespace mqtt;
+
+// Test bucket mapping
+TEST(LatencyHistogramTests, BucketIndex_BoundsContainValue) {
+    // Arrange
+    const uint64_t values[] = { 0, 1, 31, 32, 33, 63, 64, 1000, 123456, 987654321, uint64_t(1) << 40 };
+
+    // Act & Assert
+    for (uint64_t value : values) {
+        size_t index = LatencyHistogram::bucketIndex(value);
+        EXPECT_LE(LatencyHistogram::bucketLowerBound(index), value);
+        EXPECT_GE(LatencyHistogram::bucketUpperBound(index), value);
+    }
+    for (size_t i = 1; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        EXPECT_EQ(LatencyHistogram::bucketUpperBound(i - 1) + 1, LatencyHistogram::bucketLowerBound(i));
+    }
+}
+
+// Test percentile accuracy
+TEST(LatencyHistogramTests, Percentile_UniformValues_WithinThreePercent) {
+    // Arrange
+    LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 100000; value++) {
+        histogram.record(value * 10);
+    }
+
+    // Act
+    double p50 = static_cast<double>(histogram.percentile(0.50));
+    double p99 = static_cast<double>(histogram.percentile(0.99));
+    double p999 = static_cast<double>(histogram.percentile(0.999));
+
+    // Assert
+    EXPECT_EQ(100000u, histogram.count());
+    EXPECT_EQ(1000000u, histogram.max());
+    EXPECT_LT(std::abs(p50 - 500000.0) / 500000.0, 0.03);
+    EXPECT_LT(std::abs(p99 - 990000.0) / 990000.0, 0.03);
+    EXPECT_LT(std::abs(p999 - 999000.0) / 999000.0, 0.03);
+}
+
+// Test reset
+TEST(LatencyHistogramTests, Reset_ClearsSamples) {
+    // Arrange
+    LatencyHistogram histogram;
+    histogram.record(5000);
+
+    // Act
+    histogram.reset();
+
+    // Assert
+    EXPECT_EQ(0u, histogram.count());
+    EXPECT_EQ(0u, histogram.max());
+    EXPECT_EQ(0u, histogram.percentile(0.99));
+}
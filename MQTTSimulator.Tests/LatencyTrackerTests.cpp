@@ -0,0 +1,201 @@
+#include "pch.h"
+#include "LatencyTracker.h"
+#include "Broker.h"
+#include "Device.h"
+#include <algorithm>
+
+using namespace mqtt;
+
+class LatencyTrackerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        broker = std::make_shared<Broker>("latency_broker", 1);
+        subscriber = std::make_shared<Device>("subscriber", broker, std::chrono::milliseconds(0));
+        subscriber->addMessageHandler([this](const Message&) { deliveries++; });
+    }
+
+    void waitForDeliveries(int expected) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (deliveries < expected && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_EQ(expected, deliveries.load());
+    }
+
+    std::atomic<int> deliveries{ 0 };
+    std::shared_ptr<Broker> broker;
+    std::shared_ptr<Device> subscriber;
+};
+
+// Test stage durations
+TEST(LatencyTrackerTests, Record_TracedMessage_SplitsStages) {
+    // Arrange
+    LatencyTracker tracker;
+    auto start = std::chrono::steady_clock::now();
+    Message message("sensors/temp", "21.5", QoS::AT_LEAST_ONCE);
+    message.markTrace(TracePoint::Publish, start);
+    message.markTrace(TracePoint::Enqueue, start + std::chrono::microseconds(10));
+    message.markTrace(TracePoint::Dispatch, start + std::chrono::microseconds(110));
+
+    // Act
+    tracker.record(message, start + std::chrono::microseconds(1110));
+    tracker.record(Message("sensors/temp", "untraced"), start);
+
+    // Assert
+    auto overall = tracker.overall();
+    EXPECT_EQ(1u, overall.stage(LatencyStage::EndToEnd).count);
+    EXPECT_NEAR(10.0, overall.stage(LatencyStage::EnqueueWait).p50_us, 0.5);
+    EXPECT_NEAR(100.0, overall.stage(LatencyStage::Queueing).p50_us, 3.0);
+    EXPECT_NEAR(1000.0, overall.stage(LatencyStage::Delivery).p50_us, 30.0);
+    EXPECT_NEAR(1110.0, overall.stage(LatencyStage::EndToEnd).max_us, 0.5);
+
+    auto qos = tracker.byQoS();
+    ASSERT_EQ(3u, qos.size());
+    EXPECT_EQ(0u, qos[0].stage(LatencyStage::EndToEnd).count);
+    EXPECT_EQ(1u, qos[1].stage(LatencyStage::EndToEnd).count);
+}
+
+// Test topic cap
+TEST(LatencyTrackerTests, ByTopic_BeyondCap_FoldsIntoOther) {
+    // Arrange
+    LatencyTracker tracker(2);
+    auto now = std::chrono::steady_clock::now();
+    const char* topics[] = { "a", "b", "c", "d", "a" };
+
+    // Act
+    for (const char* topic : topics) {
+        Message message(topic, "x");
+        message.markTrace(TracePoint::Publish, now);
+        tracker.record(message, now + std::chrono::microseconds(50));
+    }
+
+    // Assert
+    auto rows = tracker.byTopic(10);
+    ASSERT_EQ(3u, rows.size());
+    EXPECT_EQ("a", rows[0].label);
+    EXPECT_EQ(2u, rows[0].stage(LatencyStage::EndToEnd).count);
+    EXPECT_EQ(1u, tracker.byTopic(1).size());
+
+    uint64_t other = 0;
+    for (const auto& row : rows) {
+        if (row.label == "(other)") {
+            other = row.stage(LatencyStage::EndToEnd).count;
+        }
+    }
+    EXPECT_EQ(2u, other);
+}
+
+// Test interned and plain topics get their own rows under one cap
+TEST(LatencyTrackerTests, ByTopic_InternedAndPlain_ShareCap) {
+    // Arrange
+    LatencyTracker tracker(2);
+    auto now = std::chrono::steady_clock::now();
+    InternTable::topics().intern("latency/interned");
+    Message interned("latency/interned", "x");
+    Message plain("latency/plain", "x");
+    Message beyond("latency/beyond", "x");
+    ASSERT_NE(InternTable::EMPTY, interned.getTopicHandle());
+
+    // Act
+    for (Message* message : { &interned, &interned, &plain, &beyond }) {
+        message->markTrace(TracePoint::Publish, now);
+        tracker.record(*message, now + std::chrono::microseconds(50));
+    }
+
+    // Assert
+    auto rows = tracker.byTopic(10);
+    ASSERT_EQ(3u, rows.size());
+    EXPECT_EQ("latency/interned", rows[0].label);
+    EXPECT_EQ(2u, rows[0].stage(LatencyStage::EndToEnd).count);
+    std::vector<std::string> labels{ rows[1].label, rows[2].label };
+    std::sort(labels.begin(), labels.end());
+    EXPECT_EQ((std::vector<std::string>{ "(other)", "latency/plain" }), labels);
+}
+
+// Test reset while other threads record
+TEST(LatencyTrackerTests, Reset_DuringRecord_KeepsTopicRows) {
+    // Arrange
+    LatencyTracker tracker(16);
+    std::atomic<bool> running{ true };
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&tracker, &running, t] {
+            auto now = std::chrono::steady_clock::now();
+            for (int i = 0; running; i++) {
+                Message message("topic/" + std::to_string((t + i) % 8), "x");
+                message.markTrace(TracePoint::Publish, now);
+                tracker.record(message, now + std::chrono::microseconds(5));
+            }
+            });
+    }
+
+    // Act
+    for (int i = 0; i < 200; i++) {
+        tracker.reset();
+        tracker.byTopic(16);
+    }
+    running = false;
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    tracker.reset();
+
+    // Assert
+    EXPECT_EQ(0u, tracker.overall().stage(LatencyStage::EndToEnd).count);
+    EXPECT_TRUE(tracker.byTopic(16).empty());
+
+    auto now = std::chrono::steady_clock::now();
+    Message message("topic/0", "x");
+    message.markTrace(TracePoint::Publish, now);
+    tracker.record(message, now + std::chrono::microseconds(5));
+    ASSERT_EQ(1u, tracker.byTopic(16).size());
+    EXPECT_EQ(1u, tracker.byTopic(16)[0].stage(LatencyStage::EndToEnd).count);
+}
+
+// Test broker integration
+TEST_F(LatencyTrackerTest, Publish_Delivered_RecordsPerTopicAndQoS) {
+    // Arrange
+    subscriber->subscribe("sensors/#");
+
+    // Act
+    broker->publish(Message("sensors/temp", "21.5", QoS::AT_MOST_ONCE));
+    broker->publish(Message("sensors/temp", "21.6", QoS::EXACTLY_ONCE));
+    broker->publish(Message("sensors/humidity", "40", QoS::EXACTLY_ONCE));
+    waitForDeliveries(3);
+
+    // Assert
+    auto tracker = broker->getLatencyTracker();
+    auto overall = tracker->overall();
+    EXPECT_EQ(3u, overall.stage(LatencyStage::EndToEnd).count);
+    EXPECT_EQ(3u, overall.stage(LatencyStage::Queueing).count);
+    EXPECT_GE(overall.stage(LatencyStage::EndToEnd).max_us, overall.stage(LatencyStage::Delivery).max_us);
+
+    auto qos = tracker->byQoS();
+    EXPECT_EQ(1u, qos[0].stage(LatencyStage::EndToEnd).count);
+    EXPECT_EQ(2u, qos[2].stage(LatencyStage::EndToEnd).count);
+
+    auto topics = tracker->byTopic(10);
+    ASSERT_EQ(2u, topics.size());
+    EXPECT_EQ("sensors/temp", topics[0].label);
+    EXPECT_EQ(2u, topics[0].stage(LatencyStage::EndToEnd).count);
+}
+
+// Test retained replay
+TEST_F(LatencyTrackerTest, Subscribe_RetainedReplay_NotRecorded) {
+    // Arrange
+    auto publisher = std::make_shared<Device>("publisher", broker, std::chrono::milliseconds(0));
+    publisher->subscribe("status/#");
+    broker->publish(Message("status/door", "open", QoS::AT_MOST_ONCE, true));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (broker->getLatencyTracker()->overall().stage(LatencyStage::EndToEnd).count == 0 &&
+        std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Act
+    subscriber->subscribe("status/#");
+    waitForDeliveries(1);
+
+    // Assert
+    EXPECT_EQ(1u, broker->getLatencyTracker()->overall().stage(LatencyStage::EndToEnd).count);
+}
@@ -0,0 +1,212 @@
+#include "pch.h"
+#include "LoadGenerator.h"
+#include "TcpListener.h"
+#include "WireCodec.h"
+#include <sstream>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mqtt;
+
+namespace {
+
+    /**
+     * @brief Broker stand-in for one connection that refuses every PUBLISH
+     */
+    class RefusingBroker {
+    public:
+        RefusingBroker() {
+            listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(address);
+            ::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), length);
+            ::listen(listen_fd, 1);
+            ::getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &length);
+            port = ntohs(address.sin_port);
+            thread = std::thread([this] { serve(); });
+        }
+
+        ~RefusingBroker() {
+            ::shutdown(listen_fd, SHUT_RDWR); // Wakes an accept still waiting
+            thread.join();
+            ::close(listen_fd);
+        }
+
+        uint16_t port = 0;
+
+    private:
+        void serve() {
+            int fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+            std::string inbound;
+            char chunk[4096];
+            ssize_t received;
+            while ((received = ::recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+                inbound.append(chunk, static_cast<size_t>(received));
+                wire::PacketType type = wire::PacketType::Connect;
+                uint8_t flags = 0;
+                size_t size = 0;
+                while (wire::peekPacket(inbound, type, flags, size) == wire::DecodeStatus::Ok && inbound.size() >= size) {
+                    char reply[64];
+                    size_t reply_size = 0;
+                    wire::PublishView publish;
+                    if (type == wire::PacketType::Connect) {
+                        reply_size = wire::encodeConnack(wire::ConnackView(), reply, sizeof(reply));
+                    }
+                    else if (type == wire::PacketType::Publish &&
+                        wire::decodePublish(std::string_view(inbound).substr(0, size), publish) == wire::DecodeStatus::Ok) {
+                        reply_size = wire::encodeAck(wire::PacketType::Puback, publish.packet_id,
+                            wire::ReasonCode::QuotaExceeded, reply, sizeof(reply));
+                    }
+                    ::send(fd, reply, reply_size, MSG_NOSIGNAL);
+                    inbound.erase(0, size);
+                }
+            }
+            ::close(fd);
+        }
+
+        int listen_fd = -1;
+        std::thread thread;
+    };
+
+}
+
+class LoadGeneratorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // The in-process broker behind a listener stands in for a real one
+        broker = std::make_shared<Broker>("stand_in_broker", 2);
+        listener = std::make_unique<TcpListener>(broker);
+        std::string error;
+        ASSERT_TRUE(listener->start("127.0.0.1", 0, error)) << error;
+
+        options.enabled = true;
+        options.load_host = "127.0.0.1";
+        options.load_port = listener->getPort();
+        options.device_count = 50;
+        options.load_threads = 2;
+        options.telemetry_interval = std::chrono::milliseconds(10);
+        options.duration = std::chrono::milliseconds(500);
+    }
+
+    void TearDown() override {
+        listener.reset();
+    }
+
+    std::shared_ptr<Broker> broker;
+    std::unique_ptr<TcpListener> listener;
+    HeadlessOptions options;
+};
+
+// Test paced QoS 1 telemetry from many connections
+TEST_F(LoadGeneratorTest, Run_QoS1_ConnectsPublishesAndMeasuresAcks) {
+    // Arrange
+    std::atomic<uint64_t> received{ 0 };
+    auto sink = std::make_shared<Device>("sink", broker, std::chrono::milliseconds(0));
+    sink->addMessageHandler([&received](const Message&) { received++; });
+    sink->subscribe("telemetry/#");
+    LoadGenerator generator(options);
+
+    // Act
+    LoadReport report = generator.run();
+
+    // Assert
+    EXPECT_EQ(50u, report.connected);
+    EXPECT_EQ(0u, report.connect_failures);
+    EXPECT_EQ(0u, report.disconnects);
+    EXPECT_GT(report.published, 500u);
+    EXPECT_GT(report.acknowledged, 0u);
+    EXPECT_LE(report.acknowledged, report.published);
+    EXPECT_GT(report.publish_rate, 0.0);
+    EXPECT_GT(report.ack_latency_p50_us, 0);
+    EXPECT_LE(report.ack_latency_p50_us, report.ack_latency_p99_us);
+    EXPECT_GE(received.load(), report.acknowledged);
+    EXPECT_EQ(50u, listener->getStats().connections_accepted);
+
+    std::ostringstream out;
+    LoadGenerator::printReport(options, report, out);
+    EXPECT_NE(std::string::npos, out.str().find("Ack latency:"));
+}
+
+// Test the QoS 2 four-way handshake in closed-loop mode
+TEST_F(LoadGeneratorTest, Run_QoS2_BackToBack_CompletesHandshakes) {
+    // Arrange
+    options.device_count = 4;
+    options.telemetry_interval = std::chrono::milliseconds(0);
+    options.load_qos = QoS::EXACTLY_ONCE;
+    options.message_limit = 2000;
+    options.duration = std::chrono::seconds(20);
+    LoadGenerator generator(options);
+
+    // Act
+    LoadReport report = generator.run();
+
+    // Assert
+    EXPECT_GE(report.acknowledged, 2000u);
+    EXPECT_LT(report.elapsed.count(), 20.0);
+    EXPECT_EQ(0u, listener->getStats().protocol_errors);
+}
+
+// Test QoS 0 publishes count as acknowledged once sent
+TEST_F(LoadGeneratorTest, Run_QoS0_NeedsNoAcks) {
+    // Arrange
+    options.load_qos = QoS::AT_MOST_ONCE;
+    options.device_count = 10;
+    LoadGenerator generator(options);
+
+    // Act
+    LoadReport report = generator.run();
+
+    // Assert
+    EXPECT_GT(report.published, 0u);
+    EXPECT_EQ(report.published, report.acknowledged);
+    EXPECT_EQ(0, report.ack_latency_max_us);
+}
+
+// Test error PUBACKs are counted as refused, not acknowledged, and left out of the latency
+TEST_F(LoadGeneratorTest, Run_RefusedAcks_CountedSeparately) {
+    // Arrange
+    RefusingBroker refusing;
+    options.load_port = refusing.port;
+    options.device_count = 1;
+    options.telemetry_interval = std::chrono::milliseconds(0);
+    options.message_limit = 500;
+    options.duration = std::chrono::seconds(20);
+    LoadGenerator generator(options);
+
+    // Act
+    LoadReport report = generator.run();
+
+    // Assert
+    EXPECT_EQ(1u, report.connected);
+    EXPECT_GE(report.refused, 500u);
+    EXPECT_EQ(0u, report.acknowledged);
+    EXPECT_EQ(0, report.ack_latency_max_us);
+    EXPECT_LT(report.elapsed.count(), 20.0);
+}
+
+// Test an unreachable broker ends the run early
+TEST_F(LoadGeneratorTest, Run_NothingListening_ReportsFailures) {
+    // Arrange
+    listener->stop();
+    options.duration = std::chrono::seconds(20);
+    LoadGenerator generator(options);
+
+    // Act
+    LoadReport report = generator.run();
+
+    // Assert
+    EXPECT_EQ(0u, report.connected);
+    EXPECT_EQ(50u, report.connect_failures);
+    EXPECT_LT(report.elapsed.count(), 20.0);
+}
+
+#endif
@@ -41,4 +41,40 @@ TEST_F(MessageTest, Setters_ValidInput_ChangesProperties) {
 
     // Assert
     EXPECT_EQ(newTopic, message.getTopic());
-}
\ No newline at end of file
+}
+
+// Test shared content
+TEST_F(MessageTest, Copy_SharesPayloadStorage) {
+    // Arrange
+    Message original("retained/state", std::string(1024 * 1024, 'x'), QoS::AT_LEAST_ONCE, true);
+
+    // Act
+    Message delivery = original;
+    delivery.setTargetId("device_1");
+    delivery.setQoS(QoS::AT_MOST_ONCE);
+
+    // Assert
+    EXPECT_EQ(original.getPayload().data(), delivery.getPayload().data());
+    EXPECT_EQ(original.getTopic().data(), delivery.getTopic().data());
+    EXPECT_TRUE(original.getTargetId().empty());
+    EXPECT_EQ(QoS::AT_LEAST_ONCE, original.getQoS());
+}
+
+// Test copy on write
+TEST_F(MessageTest, SetterOnCopy_LeavesOriginalUnchanged) {
+    // Arrange
+    Message original("sensors/temp", "21.5");
+    original.addUserProperty("unit", "C");
+    Message copy = original;
+
+    // Act
+    copy.setPayload("22.0");
+    copy.addUserProperty("unit", "F");
+
+    // Assert
+    EXPECT_EQ("21.5", original.getPayload());
+    EXPECT_EQ("C", original.getUserProperties().at("unit"));
+    EXPECT_EQ("22.0", copy.getPayload());
+    EXPECT_EQ("F", copy.getUserProperties().at("unit"));
+    EXPECT_EQ(original.getTimestamp(), copy.getTimestamp());
+}
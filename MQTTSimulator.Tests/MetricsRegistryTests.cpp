@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "MetricsRegistry.h"
+#include "Broker.h"
+#include "Device.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace mqtt;
+
+// Test sharded counting
+TEST(MetricsRegistryTests, Counter_ConcurrentAdds_SumAcrossShards) {
+    // Arrange
+    MetricsRegistry registry;
+    ShardedCounter& counter = registry.counter("test_total", "Test counter");
+    const int threads = 8;
+    const int adds = 10000;
+
+    // Act
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&counter] {
+            for (int i = 0; i < adds; i++) {
+                counter.add();
+            }
+            });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Assert
+    EXPECT_EQ(static_cast<uint64_t>(threads * adds), counter.value());
+    EXPECT_EQ(threads * adds, registry.value("test_total"));
+    EXPECT_EQ(0, registry.value("missing_total"));
+}
+
+// Test dump formats
+TEST(MetricsRegistryTests, Format_PrometheusAndJson_ListEveryMetric) {
+    // Arrange
+    MetricsRegistry registry;
+    registry.counter("requests_total", "Requests").add(3);
+    registry.gauge("queue_depth", "Queued items", [] { return 7.0; });
+    registry.duration("match_seconds", "Match time").record(std::chrono::milliseconds(250));
+
+    // Act
+    std::string prometheus = registry.format(MetricsFormat::Prometheus);
+    std::string json = registry.format(MetricsFormat::Json);
+
+    // Assert
+    EXPECT_NE(std::string::npos, prometheus.find("# TYPE requests_total counter\nrequests_total 3\n"));
+    EXPECT_NE(std::string::npos, prometheus.find("# TYPE queue_depth gauge\nqueue_depth 7\n"));
+    EXPECT_NE(std::string::npos, prometheus.find("match_seconds_sum 0.25\nmatch_seconds_count 1\n"));
+    EXPECT_NE(std::string::npos, json.find("{\"name\": \"queue_depth\", \"type\": \"gauge\", \"help\": \"Queued items\", \"value\": 7}"));
+    EXPECT_NE(std::string::npos, json.find("\"value\": 0.25, \"count\": 1}"));
+}
+
+// Test file dump
+TEST(MetricsRegistryTests, WriteFile_ReplacesContents) {
+    // Arrange
+    MetricsRegistry registry;
+    ShardedCounter& counter = registry.counter("writes_total", "Writes");
+    const std::string path = "metrics_registry_test.prom";
+
+    // Act
+    counter.add();
+    ASSERT_TRUE(registry.writeFile(path, MetricsFormat::Prometheus));
+    counter.add();
+    ASSERT_TRUE(registry.writeFile(path, MetricsFormat::Prometheus));
+
+    // Assert
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    file.close();
+    std::remove(path.c_str());
+    EXPECT_EQ(registry.format(MetricsFormat::Prometheus), contents.str());
+    EXPECT_NE(std::string::npos, contents.str().find("writes_total 2\n"));
+}
+
+// Test broker instrumentation
+TEST(MetricsRegistryTests, Broker_Publish_CountsDeliveriesAndDrops) {
+    // Arrange
+    auto broker = std::make_shared<Broker>("metrics_broker", 1);
+    auto first = std::make_shared<Device>("first", broker, std::chrono::milliseconds(0));
+    auto second = std::make_shared<Device>("second", broker, std::chrono::milliseconds(0));
+    first->subscribe("sensors/#");
+    second->subscribe("sensors/+/temp");
+    const auto& metrics = broker->getMetrics();
+
+    // Act
+    broker->publish(Message("sensors/room1/temp", "21"));
+    broker->publish(Message("sensors/room1/humidity", "40"));
+    broker->publish(Message("nobody/listens", "x"));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (metrics.value("mqttsim_deliveries_total") + metrics.value("mqttsim_dropped_total") < 4 &&
+        std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Assert
+    EXPECT_EQ(3, metrics.value("mqttsim_publishes_total"));
+    EXPECT_EQ(3, metrics.value("mqttsim_deliveries_total"));
+    EXPECT_EQ(1, metrics.value("mqttsim_dropped_total"));
+    EXPECT_EQ(0, metrics.value("mqttsim_ingress_queue_depth"));
+
+    bool timed_matches = false;
+    for (const auto& sample : metrics.collect()) {
+        if (sample.name == "mqttsim_match_seconds") {
+            timed_matches = sample.count == 3;
+        }
+    }
+    EXPECT_TRUE(timed_matches);
+}
@@ -0,0 +1,78 @@
+#include "pch.h"
+#include "MpscQueue.h"
+
+using namespace mqtt;
+
+// Test ordering
+TEST(MpscQueueTests, SingleProducer_PopsInFifoOrder) {
+    // Arrange
+    MpscQueue<int> queue(8);
+
+    // Act
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(queue.tryPush(i));
+    }
+
+    // Assert
+    int value = -1;
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE(queue.tryPop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(queue.tryPop(value));
+    EXPECT_TRUE(queue.empty());
+}
+
+// Test capacity
+TEST(MpscQueueTests, TryPush_FullRing_ReturnsFalse) {
+    // Arrange
+    MpscQueue<int> queue(4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.tryPush(i));
+    }
+
+    // Act & Assert
+    EXPECT_FALSE(queue.tryPush(4));
+
+    int value = 0;
+    ASSERT_TRUE(queue.tryPop(value));
+    EXPECT_TRUE(queue.tryPush(4));
+    EXPECT_EQ(4u, queue.sizeApprox());
+}
+
+// Test concurrent producers
+TEST(MpscQueueTests, ConcurrentProducers_DeliverEveryItemOnce) {
+    // Arrange
+    const int producers = 4;
+    const int per_producer = 20000;
+    MpscQueue<int> queue(256);
+    std::vector<int> seen(producers * per_producer, 0);
+
+    // Act
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p, per_producer]() {
+            for (int i = 0; i < per_producer; i++) {
+                queue.push(p * per_producer + i);
+            }
+            });
+    }
+
+    int received = 0;
+    int value = 0;
+    while (received < producers * per_producer) {
+        if (queue.tryPop(value)) {
+            seen[value]++;
+            received++;
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Assert
+    for (int count : seen) {
+        ASSERT_EQ(1, count);
+    }
+    EXPECT_EQ(static_cast<uint64_t>(producers * per_producer), queue.getStats().pushes);
+}
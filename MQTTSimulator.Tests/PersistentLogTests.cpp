@@ -0,0 +1,365 @@
+#include "pch.h"
+#include "PersistentLog.h"
+#include "Broker.h"
+#include "Device.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace mqtt;
+
+class PersistentLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        const auto* test = ::testing::UnitTest::GetInstance()->current_test_info();
+        std::string name = std::string("mqttsim_log_") + test->name() + "_" +
+            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        directory = (std::filesystem::temp_directory_path() / name).string();
+        std::filesystem::remove_all(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    std::vector<std::filesystem::path> files() const {
+        std::vector<std::filesystem::path> found;
+        for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+            found.push_back(entry.path());
+        }
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+
+    // Reopen the log into fresh state
+    PersistentLog::Stats reopen(RetainedStore& retained, std::set<PersistentLog::Subscription>& subscriptions,
+        size_t segment_bytes = constants::LOG_SEGMENT_BYTES) {
+        PersistentLog log(directory, segment_bytes);
+        std::string error;
+        EXPECT_TRUE(log.open(retained, subscriptions, error)) << error;
+        return log.getStats();
+    }
+
+    std::string directory;
+};
+
+// Test retained messages and subscriptions come back after reopening
+TEST_F(PersistentLogTest, Open_ReplaysRetainedAndSubscriptions) {
+    // Arrange
+    {
+        RetainedStore retained;
+        std::set<PersistentLog::Subscription> subscriptions;
+        PersistentLog log(directory);
+        std::string error;
+        ASSERT_TRUE(log.open(retained, subscriptions, error)) << error;
+
+        Message status("fleet/valve/status", "open", QoS::AT_LEAST_ONCE, true);
+        status.setSenderId("valve");
+        status.addUserProperty("site", "north");
+        log.appendRetained(status);
+        log.appendRetained(Message("fleet/pump/status", "on", QoS::AT_MOST_ONCE, true));
+        log.appendRetained(Message("fleet/pump/status", "", QoS::AT_MOST_ONCE, true));
+        log.appendSubscribe("valve", "command/valve");
+        log.appendSubscribe("valve", "command/all");
+        log.appendUnsubscribe("valve", "command/all");
+    }
+
+    // Act
+    RetainedStore retained;
+    std::set<PersistentLog::Subscription> subscriptions;
+    PersistentLog::Stats stats = reopen(retained, subscriptions);
+
+    // Assert
+    EXPECT_EQ(6u, stats.recovered);
+    EXPECT_EQ(0u, stats.torn_bytes);
+    EXPECT_EQ(1u, retained.size());
+    auto status = retained.find("fleet/valve/status");
+    ASSERT_TRUE(status.has_value());
+    EXPECT_EQ("open", status->getPayload());
+    EXPECT_EQ(QoS::AT_LEAST_ONCE, status->getQoS());
+    EXPECT_EQ("valve", status->getSenderId());
+    EXPECT_EQ("north", status->getUserProperties().at("site"));
+    EXPECT_EQ((std::set<PersistentLog::Subscription>{ { "valve", "command/valve" } }), subscriptions);
+}
+
+// Test a record torn by a crash is cut off and appending resumes after the last good one
+TEST_F(PersistentLogTest, Open_CutsTornTail) {
+    // Arrange
+    {
+        RetainedStore retained;
+        std::set<PersistentLog::Subscription> subscriptions;
+        PersistentLog log(directory);
+        std::string error;
+        ASSERT_TRUE(log.open(retained, subscriptions, error)) << error;
+        log.appendRetained(Message("a", "1", QoS::AT_MOST_ONCE, true));
+        log.appendRetained(Message("b", "2", QoS::AT_MOST_ONCE, true));
+    }
+    auto segment = files().back();
+    std::filesystem::resize_file(segment, std::filesystem::file_size(segment) - 3);
+
+    // Act
+    RetainedStore retained;
+    std::set<PersistentLog::Subscription> subscriptions;
+    PersistentLog::Stats torn;
+    {
+        PersistentLog log(directory);
+        std::string error;
+        ASSERT_TRUE(log.open(retained, subscriptions, error)) << error;
+        torn = log.getStats();
+        log.appendRetained(Message("c", "3", QoS::AT_MOST_ONCE, true));
+    }
+    RetainedStore reopened;
+    PersistentLog::Stats stats = reopen(reopened, subscriptions);
+
+    // Assert
+    EXPECT_EQ(1u, torn.recovered);
+    EXPECT_GT(torn.torn_bytes, 0u);
+    EXPECT_EQ(2u, stats.recovered);
+    EXPECT_TRUE(reopened.find("a").has_value());
+    EXPECT_FALSE(reopened.find("b").has_value());
+    EXPECT_TRUE(reopened.find("c").has_value());
+}
+
+// Test a corrupted byte fails the checksum instead of replaying garbage
+TEST_F(PersistentLogTest, Open_RejectsCorruptRecord) {
+    // Arrange
+    {
+        RetainedStore retained;
+        std::set<PersistentLog::Subscription> subscriptions;
+        PersistentLog log(directory);
+        std::string error;
+        ASSERT_TRUE(log.open(retained, subscriptions, error)) << error;
+        log.appendRetained(Message("a", "first", QoS::AT_MOST_ONCE, true));
+        log.appendRetained(Message("b", "second", QoS::AT_MOST_ONCE, true));
+    }
+    auto segment = files().back();
+    {
+        std::fstream file(segment, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-2, std::ios::end);
+        file.put('X');
+    }
+
+    // Act
+    RetainedStore retained;
+    std::set<PersistentLog::Subscription> subscriptions;
+    PersistentLog::Stats stats = reopen(retained, subscriptions);
+
+    // Assert
+    EXPECT_EQ(1u, stats.recovered);
+    EXPECT_EQ("first", retained.find("a")->getPayload());
+    EXPECT_FALSE(retained.find("b").has_value());
+}
+
+// Test a small segment size spreads records over several files that replay in order
+TEST_F(PersistentLogTest, Append_RollsSegments) {
+    // Arrange
+    const size_t segment_bytes = 256;
+    {
+        RetainedStore retained;
+        std::set<PersistentLog::Subscription> subscriptions;
+        PersistentLog log(directory, segment_bytes);
+        std::string error;
+        ASSERT_TRUE(log.open(retained, subscriptions, error)) << error;
+
+        // Act
+        for (int i = 0; i < 100; i++) {
+            log.appendRetained(Message("sensor/" + std::to_string(i % 10), std::to_string(i), QoS::AT_MOST_ONCE, true));
+        }
+    }
+    RetainedStore retained;
+    std::set<PersistentLog::Subscription> subscriptions;
+    PersistentLog::Stats stats = reopen(retained, subscriptions, segment_bytes);
+
+    // Assert
+    EXPECT_GT(stats.segments, 1u);
+    EXPECT_EQ(files().size(), stats.segments);
+    EXPECT_EQ(100u, stats.recovered);
+    EXPECT_EQ(10u, retained.size());
+    EXPECT_EQ("99", retained.find("sensor/9")->getPayload());
+}
+
+// Test compaction leaves one segment holding only the live state
+TEST_F(PersistentLogTest, Compact_KeepsOnlyLiveState) {
+    // Arrange
+    RetainedStore retained;
+    std::set<PersistentLog::Subscription> subscriptions;
+    PersistentLog log(directory, 512);
+    std::string error;
+    ASSERT_TRUE(log.open(retained, subscriptions, error)) << error;
+    for (int i = 0; i < 200; i++) {
+        Message message("$SYS/broker/uptime", std::to_string(i), QoS::AT_MOST_ONCE, true);
+        retained.store(message);
+        log.appendRetained(message);
+    }
+    subscriptions.insert({ "monitor", "$SYS/#" });
+    log.appendSubscribe("monitor", "$SYS/#");
+    uint64_t before = log.getStats().bytes;
+
+    // Act
+    ASSERT_TRUE(log.compact(retained, subscriptions));
+    log.appendRetained(Message("$SYS/broker/version", "5.0", QoS::AT_MOST_ONCE, true));
+    PersistentLog::Stats compacted = log.getStats();
+    RetainedStore reopened;
+    std::set<PersistentLog::Subscription> restored;
+    PersistentLog::Stats stats = reopen(reopened, restored);
+
+    // Assert
+    EXPECT_EQ(1u, compacted.compactions);
+    EXPECT_EQ(1u, compacted.segments);
+    EXPECT_LT(compacted.bytes, before / 10);
+    EXPECT_EQ(3u, stats.recovered);
+    EXPECT_EQ("199", reopened.find("$SYS/broker/uptime")->getPayload());
+    EXPECT_TRUE(reopened.find("$SYS/broker/version").has_value());
+    EXPECT_EQ(subscriptions, restored);
+}
+
+// Test records appended while a compaction is written win over what it holds
+TEST_F(PersistentLogTest, Compaction_AppendsMeanwhile_ReplayAfterIt) {
+    // Arrange
+    RetainedStore retained;
+    std::set<PersistentLog::Subscription> subscriptions;
+    PersistentLog log(directory);
+    std::string error;
+    ASSERT_TRUE(log.open(retained, subscriptions, error)) << error;
+    for (const char* topic : { "fleet/a", "fleet/b", "fleet/c" }) {
+        Message message(topic, "old", QoS::AT_MOST_ONCE, true);
+        retained.store(message);
+        log.appendRetained(message);
+    }
+    subscriptions.insert({ "monitor", "fleet/#" });
+    log.appendSubscribe("monitor", "fleet/#");
+
+    // Act: the compaction holds the state as of its start
+    auto compaction = log.beginCompaction();
+    ASSERT_NE(nullptr, compaction);
+    Message changed("fleet/a", "new", QoS::AT_MOST_ONCE, true);
+    retained.store(changed);
+    log.appendRetained(changed);
+    retained.erase("fleet/b");
+    log.appendRetained(Message("fleet/b", "", QoS::AT_MOST_ONCE, true));
+    subscriptions.clear();
+    log.appendUnsubscribe("monitor", "fleet/#");
+    for (const char* topic : { "fleet/a", "fleet/b", "fleet/c" }) {
+        compaction->addRetained(Message(topic, "old", QoS::AT_MOST_ONCE, true));
+    }
+    compaction->addSubscription({ "monitor", "fleet/#" });
+    ASSERT_TRUE(compaction->commit());
+    log.finishCompaction(*compaction);
+    PersistentLog::Stats compacted = log.getStats();
+    RetainedStore reopened;
+    std::set<PersistentLog::Subscription> restored;
+    reopen(reopened, restored);
+
+    // Assert
+    EXPECT_EQ(1u, compacted.compactions);
+    EXPECT_EQ(2u, compacted.segments);
+    EXPECT_EQ(2u, files().size());
+    EXPECT_EQ("new", reopened.find("fleet/a")->getPayload());
+    EXPECT_FALSE(reopened.find("fleet/b").has_value());
+    EXPECT_EQ("old", reopened.find("fleet/c")->getPayload());
+    EXPECT_TRUE(restored.empty());
+}
+
+// Test a compaction interrupted before it finished is discarded
+TEST_F(PersistentLogTest, Open_DiscardsUnfinishedCompaction) {
+    // Arrange
+    {
+        RetainedStore retained;
+        std::set<PersistentLog::Subscription> subscriptions;
+        PersistentLog log(directory);
+        std::string error;
+        ASSERT_TRUE(log.open(retained, subscriptions, error)) << error;
+        log.appendRetained(Message("a", "1", QoS::AT_MOST_ONCE, true));
+    }
+    std::ofstream(std::filesystem::path(directory) / "00000000000000000002.log.tmp") << "partial";
+
+    // Act
+    RetainedStore retained;
+    std::set<PersistentLog::Subscription> subscriptions;
+    PersistentLog::Stats stats = reopen(retained, subscriptions);
+
+    // Assert
+    EXPECT_EQ(1u, stats.recovered);
+    EXPECT_EQ(1u, files().size());
+}
+
+// Test a restarted broker keeps retained messages and gives devices back their subscriptions
+TEST_F(PersistentLogTest, Broker_RestoresAfterRestart) {
+    // Arrange
+    {
+        auto broker = std::make_shared<Broker>("test_broker", 1);
+        std::string error;
+        ASSERT_TRUE(broker->enablePersistence(directory, error)) << error;
+        auto device = std::make_shared<Device>("valve", broker, std::chrono::milliseconds(0));
+        device->subscribe("command/valve");
+        device->publish("fleet/valve/status", "open", QoS::AT_LEAST_ONCE, true);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (broker->getMetrics().value("mqttsim_retained_messages") < 1 &&
+            std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Act
+    auto broker = std::make_shared<Broker>("test_broker", 1);
+    std::string error;
+    ASSERT_TRUE(broker->enablePersistence(directory, error)) << error;
+    auto device = std::make_shared<Device>("valve", broker, std::chrono::milliseconds(0));
+    device->restoreSubscriptions();
+    auto monitor = std::make_shared<Device>("monitor", broker, std::chrono::milliseconds(0));
+    std::vector<std::string> replayed;
+    monitor->addMessageHandler([&replayed](const Message& message) {
+        replayed.push_back(message.getPayload());
+        });
+    monitor->subscribe("fleet/#");
+    monitor->waitForDeliveries(std::chrono::seconds(5));
+
+    // Assert
+    EXPECT_EQ(std::vector<std::string>{ "command/valve" }, device->getSubscribedTopics());
+    EXPECT_EQ(std::vector<std::string>{ "open" }, replayed);
+    EXPECT_EQ(2u, broker->getLogStats().recovered);
+}
+
+// Test an explicit compaction while publishes carry on keeps every topic's latest message
+TEST_F(PersistentLogTest, Broker_CompactWhilePublishing_KeepsLatest) {
+    // Arrange
+    const int topics = 600;
+    const int rounds = 5;
+    {
+        auto broker = std::make_shared<Broker>("test_broker", 1);
+        std::string error;
+        ASSERT_TRUE(broker->enablePersistence(directory, error)) << error;
+        auto device = std::make_shared<Device>("sensor", broker, std::chrono::milliseconds(0));
+        for (int i = 0; i < topics; i++) {
+            device->publish("fleet/" + std::to_string(i), "0", QoS::AT_MOST_ONCE, true);
+        }
+
+        // Act
+        std::thread publisher([&] {
+            for (int round = 1; round <= rounds; round++) {
+                for (int i = 0; i < topics; i++) {
+                    device->publish("fleet/" + std::to_string(i), std::to_string(round), QoS::AT_MOST_ONCE, true);
+                }
+            }
+            });
+        bool compacted = broker->compactLog();
+        publisher.join();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (broker->getLogStats().appended < static_cast<uint64_t>(topics * (rounds + 1)) &&
+            std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        EXPECT_TRUE(compacted);
+        EXPECT_EQ(1u, broker->getLogStats().compactions);
+    }
+    RetainedStore reopened;
+    std::set<PersistentLog::Subscription> restored;
+    reopen(reopened, restored);
+
+    // Assert
+    EXPECT_EQ(static_cast<size_t>(topics), reopened.size());
+    for (int i = 0; i < topics; i++) {
+        EXPECT_EQ(std::to_string(rounds), reopened.find("fleet/" + std::to_string(i))->getPayload());
+    }
+}
@@ -0,0 +1,184 @@
+#include "pch.h"
+#include "QoSSession.h"
+#include "Constants.h"
+#include <set>
+
+using namespace mqtt;
+
+namespace {
+
+    using Clock = QoSSession::Clock;
+
+    Message makeMessage(QoS qos, const std::string& payload = "reading") {
+        return Message("telemetry/device_1", payload, qos);
+    }
+
+}
+
+// Test the window limits in-flight deliveries
+TEST(QoSSessionTests, Send_StopsAtWindow) {
+    // Arrange
+    QoSSession session;
+    session.reset(3, 0);
+    auto now = Clock::now();
+    std::set<uint16_t> ids;
+
+    // Act
+    for (int i = 0; i < 3; i++) {
+        ids.insert(session.send(makeMessage(QoS::AT_LEAST_ONCE), now));
+    }
+
+    // Assert
+    EXPECT_EQ(3u, ids.size());
+    EXPECT_EQ(0u, ids.count(0));
+    EXPECT_EQ(3u, session.inFlight());
+    EXPECT_FALSE(session.canSend());
+    EXPECT_EQ(0, session.send(makeMessage(QoS::AT_LEAST_ONCE), now));
+}
+
+// Test PUBACK frees a slot for a queued delivery
+TEST(QoSSessionTests, Acknowledge_FreesSlotForQueued) {
+    // Arrange
+    QoSSession session;
+    session.reset(1, 0);
+    auto now = Clock::now();
+    uint16_t first = session.send(makeMessage(QoS::AT_LEAST_ONCE, "first"), now);
+    ASSERT_TRUE(session.enqueue(makeMessage(QoS::AT_LEAST_ONCE, "second")));
+    const Message* queued = nullptr;
+    EXPECT_EQ(0, session.sendQueued(now, queued));
+
+    // Act
+    bool acknowledged = session.acknowledge(first);
+    uint16_t second = session.sendQueued(now, queued);
+
+    // Assert
+    EXPECT_TRUE(acknowledged);
+    EXPECT_FALSE(session.acknowledge(first));
+    ASSERT_NE(0, second);
+    EXPECT_NE(first, second);
+    ASSERT_NE(nullptr, queued);
+    EXPECT_EQ("second", queued->getPayload());
+    EXPECT_EQ(0u, session.queued());
+}
+
+// Test the QoS 2 sequence PUBREC, PUBREL, PUBCOMP
+TEST(QoSSessionTests, ExactlyOnce_RequiresPubrecThenPubcomp) {
+    // Arrange
+    QoSSession session;
+    session.reset(4, 0);
+    auto now = Clock::now();
+    uint16_t id = session.send(makeMessage(QoS::EXACTLY_ONCE), now);
+
+    // Act & Assert
+    EXPECT_FALSE(session.acknowledge(id));
+    EXPECT_FALSE(session.complete(id));
+    EXPECT_TRUE(session.received(id, now));
+    EXPECT_TRUE(session.received(id, now)); // Repeated PUBREC
+    EXPECT_TRUE(session.complete(id));
+    EXPECT_EQ(0u, session.inFlight());
+    EXPECT_FALSE(session.received(id, now));
+}
+
+// Test a refused QoS 2 delivery frees its slot
+TEST(QoSSessionTests, Refused_EndsExchange) {
+    // Arrange
+    QoSSession session;
+    session.reset(1, 0);
+    uint16_t id = session.send(makeMessage(QoS::EXACTLY_ONCE), Clock::now());
+
+    // Act
+    bool refused = session.refused(id);
+
+    // Assert
+    EXPECT_TRUE(refused);
+    EXPECT_TRUE(session.canSend());
+}
+
+// Test acknowledgements for stale ids are rejected after slot reuse
+TEST(QoSSessionTests, PacketIds_NotReusedWhileInFlight) {
+    // Arrange
+    QoSSession session;
+    session.reset(2, 0);
+    auto now = Clock::now();
+    uint16_t stale = session.send(makeMessage(QoS::AT_LEAST_ONCE), now);
+    session.acknowledge(stale);
+
+    // Act: cycle the slots many times, past the 16-bit id space
+    std::set<uint16_t> live;
+    for (int i = 0; i < 100000; i++) {
+        uint16_t a = session.send(makeMessage(QoS::AT_LEAST_ONCE), now);
+        uint16_t b = session.send(makeMessage(QoS::AT_LEAST_ONCE), now);
+        ASSERT_NE(0, a);
+        ASSERT_NE(0, b);
+        ASSERT_NE(a, b);
+        ASSERT_TRUE(session.acknowledge(a));
+        ASSERT_TRUE(session.acknowledge(b));
+        live.insert(a);
+    }
+
+    // Assert
+    EXPECT_GT(live.size(), 1000u);
+    EXPECT_FALSE(session.acknowledge(stale));
+}
+
+// Test the retry timer resends old deliveries once per interval
+TEST(QoSSessionTests, ForEachExpired_VisitsOnlyOldDeliveries) {
+    // Arrange
+    QoSSession session;
+    session.reset(4, 0);
+    auto start = Clock::now();
+    uint16_t publish_id = session.send(makeMessage(QoS::AT_LEAST_ONCE), start);
+    uint16_t release_id = session.send(makeMessage(QoS::EXACTLY_ONCE), start);
+    session.received(release_id, start);
+    session.send(makeMessage(QoS::AT_LEAST_ONCE), start + std::chrono::seconds(4));
+    std::vector<std::pair<uint16_t, bool>> visited;
+    auto collect = [&visited](uint16_t id, const Message&, bool awaiting_pubcomp) {
+        visited.emplace_back(id, awaiting_pubcomp);
+    };
+
+    // Act
+    size_t first = session.forEachExpired(start + std::chrono::seconds(5), std::chrono::seconds(5), collect);
+    size_t again = session.forEachExpired(start + std::chrono::seconds(6), std::chrono::seconds(5), collect);
+
+    // Assert
+    EXPECT_EQ(2u, first);
+    EXPECT_EQ(0u, again);
+    ASSERT_EQ(2u, visited.size());
+    EXPECT_NE(visited.end(), std::find(visited.begin(), visited.end(), std::make_pair(publish_id, false)));
+    EXPECT_NE(visited.end(), std::find(visited.begin(), visited.end(), std::make_pair(release_id, true)));
+    EXPECT_EQ(2u, session.getRetries());
+}
+
+// Test incoming QoS 2 duplicates and the receive window
+TEST(QoSSessionTests, BeginReceive_DetectsDuplicatesAndOverflow) {
+    // Arrange
+    QoSSession session;
+    session.reset(1, 2);
+
+    // Act & Assert
+    EXPECT_EQ(QoSSession::ReceiveResult::New, session.beginReceive(10));
+    EXPECT_EQ(QoSSession::ReceiveResult::Duplicate, session.beginReceive(10));
+    EXPECT_EQ(QoSSession::ReceiveResult::New, session.beginReceive(11));
+    EXPECT_EQ(QoSSession::ReceiveResult::Exceeded, session.beginReceive(12));
+    EXPECT_TRUE(session.release(10));
+    EXPECT_FALSE(session.release(10));
+    EXPECT_EQ(QoSSession::ReceiveResult::New, session.beginReceive(12));
+}
+
+// Test the pending queue is bounded
+TEST(QoSSessionTests, Enqueue_StopsAtLimit) {
+    // Arrange
+    QoSSession session;
+    session.reset(1, 0);
+    Message message = makeMessage(QoS::AT_LEAST_ONCE);
+
+    // Act
+    size_t accepted = 0;
+    for (size_t i = 0; i < constants::QOS_MAX_PENDING + 10; i++) {
+        accepted += session.enqueue(message) ? 1 : 0;
+    }
+
+    // Assert
+    EXPECT_EQ(constants::QOS_MAX_PENDING, accepted);
+    EXPECT_FALSE(session.canSend());
+}
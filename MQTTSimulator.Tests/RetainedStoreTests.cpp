@@ -0,0 +1,273 @@
+#include "pch.h"
+#include "RetainedStore.h"
+#include "Broker.h"
+#include "Device.h"
+#include <algorithm>
+#include <set>
+#include <thread>
+
+using namespace mqtt;
+
+class RetainedStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (const char* topic : { "sport", "sport/tennis", "sport/tennis/player1", "sport/tennis/player2",
+            "sport/golf", "/finance", "finance", "$SYS/uptime", "home/kitchen/temp", "home/hall/temp",
+            "home/kitchen/light" }) {
+            store.store(Message(topic, std::string("state of ") + topic, QoS::AT_MOST_ONCE, true));
+            topics.push_back(topic);
+        }
+    }
+
+    std::set<std::string> collectAll(const std::string& filter, size_t chunk) {
+        std::set<std::string> found;
+        std::string cursor;
+        std::vector<Message> out;
+        size_t added = 0;
+        do {
+            out.clear();
+            added = store.collect(filter, cursor, chunk, out);
+            for (const auto& message : out) {
+                EXPECT_TRUE(found.insert(message.getTopic()).second) << message.getTopic();
+            }
+        } while (added == chunk);
+        return found;
+    }
+
+    std::set<std::string> expected(const std::string& filter) {
+        std::set<std::string> matching;
+        for (const auto& topic : topics) {
+            if (Broker::topicMatches(filter, topic)) {
+                matching.insert(topic);
+            }
+        }
+        return matching;
+    }
+
+    RetainedStore store;
+    std::vector<std::string> topics;
+};
+
+// Test storing, replacing and finding by topic
+TEST_F(RetainedStoreTest, Store_ReplacesPerTopic) {
+    // Act
+    store.store(Message("sport/golf", "closed", QoS::AT_MOST_ONCE, true));
+
+    // Assert
+    EXPECT_EQ(topics.size(), store.size());
+    ASSERT_TRUE(store.find("sport/golf").has_value());
+    EXPECT_EQ("closed", store.find("sport/golf")->getPayload());
+    EXPECT_FALSE(store.find("sport/chess").has_value());
+    EXPECT_FALSE(store.find("home/kitchen").has_value());
+}
+
+// Test an empty payload clears the topic but keeps its children
+TEST_F(RetainedStoreTest, Store_EmptyPayload_Clears) {
+    // Act
+    store.store(Message("sport/tennis", "", QoS::AT_MOST_ONCE, true));
+    bool erased_again = store.erase("sport/tennis");
+
+    // Assert
+    EXPECT_FALSE(erased_again);
+    EXPECT_EQ(topics.size() - 1, store.size());
+    EXPECT_FALSE(store.find("sport/tennis").has_value());
+    EXPECT_TRUE(store.find("sport/tennis/player1").has_value());
+}
+
+// Test wildcard filters return exactly what topicMatches accepts
+TEST_F(RetainedStoreTest, Collect_MatchesTopicMatches) {
+    for (const char* filter : { "#", "+", "sport/#", "sport/+", "sport/+/player1", "+/+", "/+", "+/tennis/#",
+        "home/+/temp", "$SYS/#", "finance", "sport/tennis/player3", "+/kitchen/+" }) {
+        // Act
+        std::set<std::string> found = collectAll(filter, 100);
+
+        // Assert
+        EXPECT_EQ(expected(filter), found) << filter;
+    }
+}
+
+// Test a chunked walk returns every match once, whatever the chunk size
+TEST_F(RetainedStoreTest, Collect_ChunksResumeAfterCursor) {
+    for (size_t chunk : { 1, 2, 3, 7 }) {
+        // Act
+        std::set<std::string> found = collectAll("#", chunk);
+
+        // Assert
+        EXPECT_EQ(expected("#"), found) << chunk;
+    }
+}
+
+// Test changes between chunks: topics after the cursor are still returned
+TEST_F(RetainedStoreTest, Collect_SeesTopicsAddedAfterCursor) {
+    // Arrange
+    std::string cursor;
+    std::vector<Message> out;
+    store.collect("sport/#", cursor, 2, out);
+    ASSERT_EQ(2u, out.size());
+
+    // Act
+    store.store(Message("sport/zorbing", "open", QoS::AT_MOST_ONCE, true));
+    store.erase(out.back().getTopic());
+    out.clear();
+    while (store.collect("sport/#", cursor, 2, out) == 2) {
+    }
+
+    // Assert
+    std::vector<std::string> rest;
+    for (const auto& message : out) {
+        rest.push_back(message.getTopic());
+    }
+    EXPECT_NE(rest.end(), std::find(rest.begin(), rest.end(), "sport/zorbing"));
+    EXPECT_EQ(4u, rest.size());
+}
+
+// Test properties and timestamps survive the compact encoding
+TEST_F(RetainedStoreTest, Find_RestoresProperties) {
+    // Arrange
+    Message message("home/hall/temp", "21.5", QoS::EXACTLY_ONCE, true);
+    message.setSenderId("thermostat");
+    message.setMessageExpiryInterval(300);
+    message.setContentType("text/plain");
+    message.setResponseTopic("home/hall/temp/ack");
+    message.setCorrelationData({ 0x00, 0x7F, 0xFF });
+    message.addUserProperty("unit", "celsius");
+    message.addUserProperty("room", "hall");
+
+    // Act
+    store.store(message);
+    auto found = store.find("home/hall/temp");
+
+    // Assert
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ("21.5", found->getPayload());
+    EXPECT_EQ(QoS::EXACTLY_ONCE, found->getQoS());
+    EXPECT_TRUE(found->isRetained());
+    EXPECT_EQ("thermostat", found->getSenderId());
+    EXPECT_EQ(300u, found->getMessageExpiryInterval());
+    EXPECT_EQ("text/plain", found->getContentType());
+    EXPECT_EQ("home/hall/temp/ack", found->getResponseTopic());
+    EXPECT_EQ(message.getCorrelationData(), found->getCorrelationData());
+    EXPECT_EQ(message.getUserProperties(), found->getUserProperties());
+    EXPECT_EQ(std::chrono::duration_cast<std::chrono::microseconds>(message.getTimestamp().time_since_epoch()),
+        std::chrono::duration_cast<std::chrono::microseconds>(found->getTimestamp().time_since_epoch()));
+}
+
+// Test replaying a topic again shares the body built the first time until it changes
+TEST_F(RetainedStoreTest, Collect_ReplaysShareBody) {
+    // Arrange
+    std::string cursor;
+    std::vector<Message> first;
+    store.collect("home/hall/temp", cursor, 10, first);
+
+    // Act
+    cursor.clear();
+    std::vector<Message> second;
+    store.collect("home/hall/temp", cursor, 10, second);
+    store.store(Message("home/hall/temp", "19.0", QoS::AT_MOST_ONCE, true));
+    cursor.clear();
+    std::vector<Message> changed;
+    store.collect("home/hall/temp", cursor, 10, changed);
+
+    // Assert
+    ASSERT_EQ(1u, first.size());
+    ASSERT_EQ(1u, second.size());
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ(&first[0].getPayload(), &second[0].getPayload());
+    EXPECT_EQ("19.0", changed[0].getPayload());
+    EXPECT_EQ(1u, store.memoryUsage().cached);
+}
+
+// Test repeated level names and payloads are stored once
+TEST(RetainedStoreMemoryTests, MemoryUsage_SharesLevelsAndPayloads) {
+    // Arrange
+    RetainedStore store;
+
+    // Act
+    for (int i = 0; i < 1000; i++) {
+        store.store(Message("fleet/device_" + std::to_string(i) + "/status", "online", QoS::AT_MOST_ONCE, true));
+    }
+    RetainedStore::MemoryUsage usage = store.memoryUsage();
+
+    // Assert
+    EXPECT_EQ(1000u, usage.topics);
+    EXPECT_EQ(2002u, usage.nodes);
+    EXPECT_EQ(1002u, usage.levels);
+    EXPECT_EQ(1u, usage.payloads);
+    EXPECT_EQ(std::string("online").size(), usage.payload_bytes);
+    EXPECT_EQ(0u, usage.properties);
+    EXPECT_EQ(usage.node_bytes + usage.pool_bytes + usage.cache_bytes, usage.total_bytes);
+}
+
+// Test the replay cache stays within its bound
+TEST(RetainedStoreMemoryTests, ReplayCache_Bounded) {
+    // Arrange
+    RetainedStore store;
+    size_t topics = mqtt::constants::RETAINED_REPLAY_CACHE_SIZE + 100;
+    for (size_t i = 0; i < topics; i++) {
+        store.store(Message("fleet/device_" + std::to_string(i), "online", QoS::AT_MOST_ONCE, true));
+    }
+
+    // Act
+    std::string cursor;
+    std::vector<Message> out;
+    size_t replayed = store.collect("fleet/#", cursor, topics, out);
+    RetainedStore::MemoryUsage usage = store.memoryUsage();
+
+    // Assert
+    EXPECT_EQ(topics, replayed);
+    EXPECT_EQ(mqtt::constants::RETAINED_REPLAY_CACHE_SIZE, usage.cached);
+}
+
+// Test erasing every topic returns the pools to empty
+TEST(RetainedStoreMemoryTests, Erase_ReleasesPooledValues) {
+    // Arrange
+    RetainedStore store;
+    for (int i = 0; i < 100; i++) {
+        Message message("fleet/device_" + std::to_string(i) + "/status", "online", QoS::AT_MOST_ONCE, true);
+        message.addUserProperty("batch", std::to_string(i % 3));
+        store.store(message);
+    }
+
+    // Act
+    for (int i = 0; i < 100; i++) {
+        store.erase("fleet/device_" + std::to_string(i) + "/status");
+    }
+    RetainedStore::MemoryUsage usage = store.memoryUsage();
+
+    // Assert
+    EXPECT_TRUE(store.empty());
+    EXPECT_EQ(1u, usage.nodes);
+    EXPECT_EQ(0u, usage.levels);
+    EXPECT_EQ(0u, usage.payloads);
+    EXPECT_EQ(0u, usage.properties);
+}
+
+// Test the broker replays retained messages through the store in chunks
+TEST(RetainedStoreBrokerTests, Subscribe_ReplaysAcrossChunks) {
+    // Arrange
+    auto broker = std::make_shared<Broker>("test_broker", 1);
+    auto publisher = std::make_shared<Device>("publisher", broker, std::chrono::milliseconds(0));
+    const size_t count = constants::BROKER_RETAINED_REPLAY_CHUNK * 3 + 5;
+    for (size_t i = 0; i < count; i++) {
+        publisher->publish("fleet/device_" + std::to_string(i) + "/status", "online", QoS::AT_LEAST_ONCE, true);
+    }
+    publisher->publish("other/status", "online", QoS::AT_LEAST_ONCE, true);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (broker->getMetrics().value("mqttsim_retained_messages") < count + 1 &&
+        std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto subscriber = std::make_shared<Device>("subscriber", broker, std::chrono::milliseconds(0));
+    std::set<std::string> replayed;
+    subscriber->addMessageHandler([&replayed](const Message& message) {
+        replayed.insert(message.getTopic());
+        });
+
+    // Act
+    subscriber->subscribe("fleet/+/status");
+    subscriber->waitForDeliveries(std::chrono::seconds(5));
+
+    // Assert
+    EXPECT_EQ(count, replayed.size());
+    EXPECT_EQ(0u, replayed.count("other/status"));
+}
@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "Scheduler.h"
+#include <atomic>
+#include <thread>
+
+using namespace mqtt;
+using namespace std::chrono;
+
+namespace {
+
+    template <typename Predicate>
+    bool waitFor(Predicate predicate, milliseconds timeout = milliseconds(2000)) {
+        auto deadline = steady_clock::now() + timeout;
+        while (!predicate()) {
+            if (steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+        return true;
+    }
+
+}
+
+// Test one-shot timers
+TEST(SchedulerTests, Schedule_RunsOnceAfterDelay) {
+    // Arrange
+    Scheduler scheduler(2);
+    std::atomic<int> runs{ 0 };
+    std::atomic<int64_t> fired_after_ms{ -1 };
+    auto start = steady_clock::now();
+
+    // Act
+    auto handle = scheduler.schedule(milliseconds(30), [&] {
+        fired_after_ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+        runs++;
+        });
+
+    // Assert
+    ASSERT_TRUE(waitFor([&] { return runs.load() == 1; }));
+    EXPECT_GE(fired_after_ms.load(), 30);
+    std::this_thread::sleep_for(milliseconds(50));
+    EXPECT_EQ(1, runs.load());
+    EXPECT_FALSE(handle.active());
+}
+
+// Test delays longer than the innermost wheel
+TEST(SchedulerTests, Schedule_LongDelayCascadesAndFiresOnTime) {
+    // Arrange
+    Scheduler scheduler(1);
+    std::atomic<int64_t> fired_after_ms{ -1 };
+    auto start = steady_clock::now();
+
+    // Act
+    scheduler.schedule(milliseconds(600), [&] {
+        fired_after_ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+        });
+
+    // Assert
+    ASSERT_TRUE(waitFor([&] { return fired_after_ms.load() >= 0; }));
+    EXPECT_GE(fired_after_ms.load(), 600);
+    EXPECT_LT(fired_after_ms.load(), 700);
+}
+
+// Test posted tasks run on a worker without waiting for a tick
+TEST(SchedulerTests, Post_RunsOnWorkerWithoutDelay) {
+    // Arrange
+    Scheduler scheduler(1, milliseconds(50));
+    std::atomic<bool> ran{ false };
+    std::thread::id runner;
+    auto start = steady_clock::now();
+
+    // Act
+    auto handle = scheduler.post([&] {
+        runner = std::this_thread::get_id();
+        ran = true;
+        });
+
+    // Assert
+    ASSERT_TRUE(waitFor([&] { return ran.load(); }));
+    EXPECT_LT(duration_cast<milliseconds>(steady_clock::now() - start).count(), 50);
+    EXPECT_NE(std::this_thread::get_id(), runner);
+    EXPECT_TRUE(waitFor([&] { return !handle.active(); }));
+}
+
+// Test repeating timers
+TEST(SchedulerTests, ScheduleRepeating_UsesReturnedDelayUntilNegative) {
+    // Arrange
+    Scheduler scheduler(1);
+    std::atomic<int> runs{ 0 };
+
+    // Act
+    auto handle = scheduler.scheduleRepeating(milliseconds(1), [&] {
+        return ++runs < 5 ? milliseconds(2) : milliseconds(-1);
+        });
+
+    // Assert
+    ASSERT_TRUE(waitFor([&] { return !handle.active(); }));
+    EXPECT_EQ(5, runs.load());
+}
+
+// Test cancellation
+TEST(SchedulerTests, Cancel_WaitsForRunningCallbackAndStopsTimer) {
+    // Arrange
+    Scheduler scheduler(1);
+    std::atomic<bool> in_callback{ false };
+    std::atomic<int> runs{ 0 };
+    auto handle = scheduler.scheduleRepeating(milliseconds(1), [&] {
+        in_callback = true;
+        std::this_thread::sleep_for(milliseconds(50));
+        runs++;
+        in_callback = false;
+        return milliseconds(1);
+        });
+    ASSERT_TRUE(waitFor([&] { return in_callback.load(); }));
+
+    // Act
+    handle.cancel();
+
+    // Assert
+    EXPECT_FALSE(in_callback.load());
+    int runs_at_cancel = runs.load();
+    std::this_thread::sleep_for(milliseconds(30));
+    EXPECT_EQ(runs_at_cancel, runs.load());
+    EXPECT_FALSE(handle.active());
+}
+
+// Test many timers on a small pool
+TEST(SchedulerTests, ManyTimers_AllFireWithBoundedThreads) {
+    // Arrange
+    constexpr int TIMER_COUNT = 20000;
+    Scheduler scheduler(2);
+    std::atomic<int> runs{ 0 };
+
+    // Act
+    std::vector<Scheduler::Handle> handles;
+    handles.reserve(TIMER_COUNT);
+    for (int i = 0; i < TIMER_COUNT; i++) {
+        handles.push_back(scheduler.schedule(milliseconds(1 + i % 400), [&] { runs++; }));
+    }
+
+    // Assert
+    ASSERT_TRUE(waitFor([&] { return runs.load() == TIMER_COUNT; }, milliseconds(5000)));
+    EXPECT_EQ(2u, scheduler.getWorkerCount());
+    EXPECT_EQ(0u, scheduler.getStats().pending);
+}
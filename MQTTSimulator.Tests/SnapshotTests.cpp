@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "Snapshot.h"
+#include "Broker.h"
+#include "Device.h"
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace mqtt;
+
+class SnapshotTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        const auto* test = ::testing::UnitTest::GetInstance()->current_test_info();
+        std::string name = std::string("mqttsim_snapshot_") + test->name() + "_" +
+            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".bin";
+        path = (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(path);
+    }
+
+    // Wait until the broker has stored count retained messages
+    static void waitForRetained(const Broker& broker, double count) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (broker.getMetrics().value("mqttsim_retained_messages") < count &&
+            std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::string path;
+};
+
+// Test devices, their configuration and retained messages come back from a snapshot
+TEST_F(SnapshotTest, Restore_RecreatesDevicesAndRetained) {
+    // Arrange
+    {
+        auto broker = std::make_shared<Broker>("test_broker", 1);
+        auto valve = std::make_shared<Device>("valve", broker, std::chrono::milliseconds(0));
+        valve->setDeliveryQueue(16, OverflowPolicy::DropNewest);
+        valve->setHistoryCapacity(5);
+        valve->subscribe("command/valve");
+        valve->subscribe("command/all");
+        auto sensor = std::make_shared<Device>("sensor", broker, std::chrono::milliseconds(60000));
+        Message status("command/valve", "open", QoS::AT_LEAST_ONCE, true);
+        status.setSenderId("gateway");
+        status.addUserProperty("site", "north");
+        broker->publish(status);
+        waitForRetained(*broker, 1);
+        std::string error;
+        ASSERT_TRUE(Snapshot::write(path, *broker, { valve, sensor }, error)) << error;
+    }
+
+    // Act
+    Snapshot snapshot;
+    std::string error;
+    ASSERT_TRUE(snapshot.open(path, error)) << error;
+    auto broker = std::make_shared<Broker>("test_broker", 1);
+    auto devices = snapshot.restore(broker);
+    auto monitor = std::make_shared<Device>("monitor", broker, std::chrono::milliseconds(0));
+    std::vector<Message> replayed;
+    monitor->addMessageHandler([&replayed](const Message& message) {
+        replayed.push_back(message);
+        });
+    monitor->subscribe("command/#");
+    monitor->waitForDeliveries(std::chrono::seconds(5));
+
+    // Assert
+    EXPECT_EQ(2u, snapshot.getDeviceCount());
+    EXPECT_EQ(1u, snapshot.getRetainedCount());
+    ASSERT_EQ(2u, devices.size());
+    EXPECT_EQ("valve", devices[0]->getId());
+    EXPECT_EQ((std::vector<std::string>{ "command/valve", "command/all" }), devices[0]->getSubscribedTopics());
+    EXPECT_EQ(16u, devices[0]->getDeliveryCapacity());
+    EXPECT_EQ(OverflowPolicy::DropNewest, devices[0]->getOverflowPolicy());
+    EXPECT_EQ(5u, devices[0]->getHistoryCapacity());
+    EXPECT_FALSE(devices[0]->getLastMessage().has_value());
+    EXPECT_EQ(60000, devices[1]->getTelemetryInterval().count());
+    EXPECT_TRUE(devices[1]->getSubscribedTopics().empty());
+
+    ASSERT_EQ(1u, replayed.size());
+    EXPECT_EQ("open", replayed[0].getPayload());
+    EXPECT_EQ(QoS::AT_LEAST_ONCE, replayed[0].getQoS());
+    EXPECT_EQ("gateway", replayed[0].getSenderId());
+    EXPECT_EQ("north", replayed[0].getUserProperties().at("site"));
+}
+
+// Test a missing, foreign or truncated file is refused
+TEST_F(SnapshotTest, Open_RejectsBadFiles) {
+    // Arrange
+    auto broker = std::make_shared<Broker>("test_broker", 1);
+    std::vector<std::shared_ptr<Device>> devices;
+    for (int i = 0; i < 10; i++) {
+        devices.push_back(std::make_shared<Device>("device_" + std::to_string(i), broker, std::chrono::milliseconds(0)));
+        devices.back()->subscribe("command/all");
+    }
+    Snapshot snapshot;
+    std::string error;
+
+    // Act & Assert
+    EXPECT_FALSE(snapshot.open(path, error));
+
+    std::ofstream(path, std::ios::binary) << "not a snapshot, just some text that is long enough for a header";
+    EXPECT_FALSE(snapshot.open(path, error));
+    EXPECT_NE(std::string::npos, error.find("not a snapshot"));
+
+    ASSERT_TRUE(Snapshot::write(path, *broker, devices, error)) << error;
+    ASSERT_TRUE(snapshot.open(path, error)) << error;
+    EXPECT_EQ(10u, snapshot.getDeviceCount());
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+    EXPECT_FALSE(snapshot.open(path, error));
+    EXPECT_NE(std::string::npos, error.find("truncated"));
+    EXPECT_EQ(0u, snapshot.getDeviceCount());
+}
@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "SubscriptionTrie.h"
+#include "Broker.h"
+#include "Device.h"
+#include <algorithm>
+
+using namespace mqtt;
+
+class SubscriptionTrieTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        broker = std::make_shared<Broker>("test_broker");
+        first = std::make_shared<Device>("first", broker, std::chrono::milliseconds(10));
+        second = std::make_shared<Device>("second", broker, std::chrono::milliseconds(10));
+    }
+
+    std::shared_ptr<Broker> broker;
+    std::shared_ptr<Device> first;
+    std::shared_ptr<Device> second;
+    SubscriptionTrie trie;
+};
+
+// Test exact filters
+TEST_F(SubscriptionTrieTest, Match_ExactFilter_ReturnsOnlySubscriber) {
+    // Arrange
+    trie.insert("sensors/room1/temp", first);
+    trie.insert("sensors/room2/temp", second);
+
+    // Act
+    auto matches = trie.match("sensors/room1/temp");
+
+    // Assert
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(first, matches[0]);
+    EXPECT_TRUE(trie.match("sensors/room1").empty());
+    EXPECT_TRUE(trie.match("sensors/room1/temp/extra").empty());
+}
+
+// Test wildcard filters
+TEST_F(SubscriptionTrieTest, Match_Wildcards_FollowLevelRules) {
+    // Arrange
+    trie.insert("sensors/+/temp", first);
+    trie.insert("sensors/#", second);
+
+    // Act & Assert
+    EXPECT_EQ(2u, trie.match("sensors/room1/temp").size());
+    EXPECT_EQ(1u, trie.match("sensors/room1/humidity").size());
+    EXPECT_EQ(1u, trie.match("sensors").size());
+    EXPECT_TRUE(trie.match("actuators/valve").empty());
+}
+
+// Test overlapping filters
+TEST_F(SubscriptionTrieTest, Match_OverlappingFilters_ReturnsDeviceOnce) {
+    // Arrange
+    trie.insert("command/all", first);
+    trie.insert("command/+", first);
+    trie.insert("#", first);
+
+    // Act
+    auto matches = trie.match("command/all");
+
+    // Assert
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(3u, trie.size());
+}
+
+// Test system topics
+TEST_F(SubscriptionTrieTest, Match_SystemTopic_IgnoresRootWildcards) {
+    // Arrange
+    trie.insert("#", first);
+    trie.insert("$SYS/#", second);
+
+    // Act
+    auto matches = trie.match("$SYS/broker/load");
+
+    // Assert
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(second, matches[0]);
+}
+
+// Test removal
+TEST_F(SubscriptionTrieTest, Remove_Subscriber_StopsMatching) {
+    // Arrange
+    trie.insert("sensors/+/temp", first);
+    trie.insert("sensors/+/temp", second);
+
+    // Act
+    trie.remove("sensors/+/temp", first);
+
+    // Assert
+    auto matches = trie.match("sensors/room1/temp");
+    ASSERT_EQ(1u, matches.size());
+    EXPECT_EQ(second, matches[0]);
+
+    trie.remove("sensors/+/temp", second);
+    EXPECT_TRUE(trie.empty());
+    EXPECT_TRUE(trie.match("sensors/room1/temp").empty());
+}
+
+// Test a filter shared by enough devices to be indexed keeps duplicates out and removes in place
+TEST_F(SubscriptionTrieTest, Insert_ManySubscribers_IndexesOneFilter) {
+    // Arrange
+    std::vector<std::shared_ptr<Device>> devices;
+    for (int i = 0; i < 100; i++) {
+        devices.push_back(std::make_shared<Device>("device_" + std::to_string(i), broker, std::chrono::milliseconds(0)));
+        trie.insert("command/all", devices.back());
+    }
+
+    // Act
+    for (const auto& device : devices) {
+        trie.insert("command/all", device);
+    }
+    for (int i = 0; i < 100; i += 2) {
+        trie.remove("command/all", devices[i]);
+    }
+    devices[1].reset();
+    trie.insert("command/all", first);
+
+    // Assert
+    auto matches = trie.match("command/all");
+    EXPECT_EQ(50u, matches.size());
+    EXPECT_NE(matches.end(), std::find(matches.begin(), matches.end(), first));
+    EXPECT_EQ(matches.end(), std::find(matches.begin(), matches.end(), devices[2]));
+}
+
+// Test exact filters are found by topic handle alongside wildcard filters
+TEST_F(SubscriptionTrieTest, Match_ByHandle_FindsExactAndWildcardFilters) {
+    // Arrange
+    trie.insert("command/first", first);
+    trie.insert("command/+", second);
+    InternTable::Handle topic = InternTable::topics().intern("command/first");
+
+    // Act
+    auto by_handle = trie.match(topic);
+    auto by_string = trie.match("command/first");
+    trie.remove("command/first", first);
+    auto after_remove = trie.match(topic);
+
+    // Assert
+    EXPECT_EQ(2u, by_handle.size());
+    EXPECT_EQ(2u, by_string.size());
+    ASSERT_EQ(1u, after_remove.size());
+    EXPECT_EQ(second, after_remove[0]);
+    EXPECT_EQ(1u, trie.size());
+}
+
+// Test broker filter matching
+TEST(TopicMatchTests, TopicMatches_Wildcards_FollowLevelRules) {
+    EXPECT_TRUE(Broker::topicMatches("a/b/c", "a/b/c"));
+    EXPECT_TRUE(Broker::topicMatches("a/+/c", "a/b/c"));
+    EXPECT_TRUE(Broker::topicMatches("a/#", "a/b/c"));
+    EXPECT_TRUE(Broker::topicMatches("a/#", "a"));
+    EXPECT_TRUE(Broker::topicMatches("#", "a/b"));
+    EXPECT_TRUE(Broker::topicMatches("+/+", "a/b"));
+
+    EXPECT_FALSE(Broker::topicMatches("a/+", "a/b/c"));
+    EXPECT_FALSE(Broker::topicMatches("a/+/c", "a/b/d"));
+    EXPECT_FALSE(Broker::topicMatches("a/b", "a"));
+    EXPECT_FALSE(Broker::topicMatches("#", "$SYS/load"));
+}
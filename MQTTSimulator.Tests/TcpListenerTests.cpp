@@ -0,0 +1,550 @@
+#include "pch.h"
+#include "TcpListener.h"
+#include "Device.h"
+#include "WireCodec.h"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mqtt;
+using namespace mqtt::wire;
+
+namespace {
+
+    /**
+     * @brief Blocking MQTT client socket for driving the listener
+     */
+    class TestClient {
+    public:
+        explicit TestClient(uint16_t port) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            timeval timeout{ 2, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+            connected = ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        }
+
+        ~TestClient() {
+            close();
+        }
+
+        void close() {
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        void send(std::string_view bytes) {
+            ::send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+        }
+
+        void sendConnect(const ConnectView& connect) {
+            char buffer[512];
+            send(std::string_view(buffer, encodeConnect(connect, buffer, sizeof(buffer))));
+        }
+
+        void sendSubscribe(uint16_t packet_id, std::string_view filter, QoS maximum_qos = QoS::AT_MOST_ONCE,
+            uint8_t flags = 0) {
+            char buffer[256];
+            size_t size = encodeSubscribe(packet_id, &filter, 1, maximum_qos, buffer, sizeof(buffer));
+            buffer[size - 1] |= static_cast<char>(flags); // Options byte follows the only filter
+            send(std::string_view(buffer, size));
+        }
+
+        void sendAck(PacketType type, uint16_t packet_id) {
+            char buffer[8];
+            send(std::string_view(buffer, encodeAck(type, packet_id, ReasonCode::Success, buffer, sizeof(buffer))));
+        }
+
+        // Next whole packet, empty on timeout or close
+        std::string readPacket() {
+            while (true) {
+                PacketType type = PacketType::Connect;
+                uint8_t flags = 0;
+                size_t size = 0;
+                if (peekPacket(inbound, type, flags, size) == DecodeStatus::Ok && inbound.size() >= size) {
+                    std::string packet = inbound.substr(0, size);
+                    inbound.erase(0, size);
+                    return packet;
+                }
+                char chunk[4096];
+                ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    return std::string();
+                }
+                inbound.append(chunk, static_cast<size_t>(received));
+            }
+        }
+
+        // CONNECT and wait for CONNACK
+        bool handshake(std::string_view client_id, ConnackView& connack) {
+            ConnectView connect;
+            connect.client_id = client_id;
+            sendConnect(connect);
+            connack_packet = readPacket();
+            return decodeConnack(connack_packet, connack) == DecodeStatus::Ok &&
+                connack.reason == ReasonCode::Success;
+        }
+
+        bool handshake(std::string_view client_id) {
+            ConnackView connack;
+            return handshake(client_id, connack);
+        }
+
+        int fd = -1;
+        bool connected = false;
+        std::string inbound;
+        std::string connack_packet; // Backs the views of the last CONNACK
+    };
+
+    PacketType typeOf(const std::string& packet) {
+        return static_cast<PacketType>(static_cast<uint8_t>(packet[0]) >> 4);
+    }
+
+    std::string encode(const Message& message, uint16_t packet_id = 0) {
+        std::string buffer(publishSize(message), '\0');
+        buffer.resize(encodePublish(message, buffer.data(), buffer.size(), packet_id));
+        return buffer;
+    }
+
+    template <typename Predicate>
+    bool waitFor(Predicate predicate) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (!predicate()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+}
+
+class TcpListenerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        broker = std::make_shared<Broker>("tcp_broker", 2);
+        listener = std::make_unique<TcpListener>(broker);
+        std::string error;
+        ASSERT_TRUE(listener->start("127.0.0.1", 0, error)) << error;
+    }
+
+    void TearDown() override {
+        listener.reset();
+    }
+
+    // In-process device recording what it receives
+    std::shared_ptr<Device> makeObserver(const std::string& filter) {
+        auto device = std::make_shared<Device>("observer", broker, std::chrono::milliseconds(0));
+        device->addMessageHandler([this](const Message& message) {
+            std::lock_guard<std::mutex> lock(received_mutex);
+            received.push_back(message);
+            });
+        device->subscribe(filter);
+        return device;
+    }
+
+    size_t receivedCount() {
+        std::lock_guard<std::mutex> lock(received_mutex);
+        return received.size();
+    }
+
+    std::shared_ptr<Broker> broker;
+    std::unique_ptr<TcpListener> listener;
+    std::mutex received_mutex;
+    std::vector<Message> received;
+};
+
+// Test CONNECT without a client id
+TEST_F(TcpListenerTest, Connect_EmptyClientId_AssignsOne) {
+    // Arrange
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.connected);
+
+    // Act
+    ConnackView connack;
+    bool accepted = client.handshake("", connack);
+
+    // Assert
+    ASSERT_TRUE(accepted);
+    EXPECT_FALSE(connack.assigned_client_id.empty());
+    EXPECT_GT(connack.maximum_packet_size, 0u);
+    EXPECT_EQ(1u, listener->getStats().connections_accepted);
+}
+
+// Test an assigned client id is handed out again once its connection closes
+TEST_F(TcpListenerTest, Connect_EmptyClientId_ReusesClosedId) {
+    // Arrange
+    TestClient first(listener->getPort());
+    ConnackView first_connack;
+    ASSERT_TRUE(first.handshake("", first_connack));
+    std::string first_id(first_connack.assigned_client_id);
+    first.close();
+    ASSERT_TRUE(waitFor([this] { return listener->getStats().active_connections == 0; }));
+
+    // Act
+    TestClient second(listener->getPort());
+    ConnackView second_connack;
+    ASSERT_TRUE(second.handshake("", second_connack));
+
+    // Assert
+    EXPECT_EQ(first_id, second_connack.assigned_client_id);
+}
+
+// Test delivery of in-process publishes to a network subscriber
+TEST_F(TcpListenerTest, Subscribe_ReceivesBrokerPublishes) {
+    // Arrange
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.handshake("subscriber"));
+    client.sendSubscribe(1, "telemetry/+");
+    std::string suback_packet = client.readPacket();
+    SubackView suback;
+    ASSERT_EQ(DecodeStatus::Ok, decodeSuback(suback_packet, suback));
+    ASSERT_EQ(1u, suback.reason_codes.size());
+    EXPECT_EQ(0, suback.reason_codes[0]);
+
+    // Act
+    broker->publish(Message("telemetry/device_1", "{\"t\":21}", QoS::AT_LEAST_ONCE));
+    std::string packet = client.readPacket();
+
+    // Assert
+    PublishView publish;
+    ASSERT_EQ(DecodeStatus::Ok, decodePublish(packet, publish));
+    EXPECT_EQ("telemetry/device_1", publish.topic);
+    EXPECT_EQ("{\"t\":21}", publish.payload);
+    EXPECT_EQ(QoS::AT_MOST_ONCE, publish.qos);
+}
+
+// Test a filter listed twice in one SUBSCRIBE is removed by a single UNSUBSCRIBE
+TEST_F(TcpListenerTest, Unsubscribe_DuplicateFilter_RemovedOnce) {
+    // Arrange
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.handshake("duplicate"));
+    char buffer[256];
+    std::string_view filters[] = { "alarms/a", "alarms/a" };
+    client.send(std::string_view(buffer, encodeSubscribe(1, filters, 2, QoS::AT_MOST_ONCE, buffer, sizeof(buffer))));
+    SubackView suback;
+    ASSERT_EQ(DecodeStatus::Ok, decodeSuback(client.readPacket(), suback));
+    ASSERT_EQ(2u, suback.reason_codes.size());
+
+    // Act
+    SubackView first;
+    SubackView second;
+    client.send(std::string_view(buffer, encodeUnsubscribe(2, filters, 1, buffer, sizeof(buffer))));
+    std::string first_packet = client.readPacket();
+    client.send(std::string_view(buffer, encodeUnsubscribe(3, filters, 1, buffer, sizeof(buffer))));
+    std::string second_packet = client.readPacket();
+
+    // Assert
+    ASSERT_EQ(DecodeStatus::Ok, decodeSuback(first_packet, first));
+    ASSERT_EQ(DecodeStatus::Ok, decodeSuback(second_packet, second));
+    EXPECT_EQ(PacketType::Unsuback, first.type);
+    EXPECT_EQ(static_cast<char>(ReasonCode::Success), first.reason_codes[0]);
+    EXPECT_EQ(static_cast<char>(ReasonCode::NoSubscriptionExisted), second.reason_codes[0]);
+    timeval short_timeout{ 0, 200000 };
+    setsockopt(client.fd, SOL_SOCKET, SO_RCVTIMEO, &short_timeout, sizeof(short_timeout));
+    broker->publish(Message("alarms/a", "late"));
+    EXPECT_TRUE(client.readPacket().empty());
+    EXPECT_EQ(1u, listener->getStats().active_connections);
+}
+
+// Test No Local keeps a client's own publishes from coming back to it
+TEST_F(TcpListenerTest, SubscribeNoLocal_SkipsOwnPublishes) {
+    // Arrange
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.handshake("chatter"));
+    client.sendSubscribe(1, "chat/#", QoS::AT_MOST_ONCE, SUBSCRIBE_NO_LOCAL);
+    ASSERT_EQ(PacketType::Suback, typeOf(client.readPacket()));
+
+    // Act
+    client.send(encode(Message("chat/room", "mine")));
+    broker->publish(Message("chat/room", "theirs"));
+    std::string packet = client.readPacket();
+    timeval short_timeout{ 0, 200000 };
+    setsockopt(client.fd, SOL_SOCKET, SO_RCVTIMEO, &short_timeout, sizeof(short_timeout));
+    std::string extra = client.readPacket();
+
+    // Assert
+    PublishView publish;
+    ASSERT_EQ(DecodeStatus::Ok, decodePublish(packet, publish));
+    EXPECT_EQ("theirs", publish.payload);
+    EXPECT_TRUE(extra.empty());
+}
+
+// Test Retain Handling picks which SUBSCRIBEs replay and RETAIN only stays on live deliveries with Retain As Published
+TEST_F(TcpListenerTest, SubscribeRetainOptions_ControlReplayAndFlag) {
+    // Arrange
+    broker->restoreRetained(Message("state/valve", "open", QoS::AT_MOST_ONCE, true));
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.handshake("retainer"));
+    timeval short_timeout{ 0, 200000 };
+    setsockopt(client.fd, SOL_SOCKET, SO_RCVTIMEO, &short_timeout, sizeof(short_timeout));
+
+    // Act
+    client.sendSubscribe(1, "state/#", QoS::AT_MOST_ONCE, 2 << SUBSCRIBE_RETAIN_HANDLING_SHIFT);
+    std::string never_suback = client.readPacket();
+    std::string never_replay = client.readPacket();
+    client.sendSubscribe(2, "state/#", QoS::AT_MOST_ONCE, 1 << SUBSCRIBE_RETAIN_HANDLING_SHIFT);
+    std::string existing_suback = client.readPacket();
+    std::string existing_replay = client.readPacket();
+    client.sendSubscribe(3, "state/#");
+    std::string always_suback = client.readPacket();
+    std::string always_replay = client.readPacket();
+    broker->publish(Message("state/valve", "closed", QoS::AT_MOST_ONCE, true));
+    std::string live = client.readPacket();
+    client.sendSubscribe(4, "state/#", QoS::AT_MOST_ONCE,
+        SUBSCRIBE_RETAIN_AS_PUBLISHED | (2 << SUBSCRIBE_RETAIN_HANDLING_SHIFT));
+    std::string published_suback = client.readPacket();
+    broker->publish(Message("state/valve", "open", QoS::AT_MOST_ONCE, true));
+    std::string live_published = client.readPacket();
+
+    // Assert
+    EXPECT_EQ(PacketType::Suback, typeOf(never_suback));
+    EXPECT_TRUE(never_replay.empty());
+    EXPECT_EQ(PacketType::Suback, typeOf(existing_suback));
+    EXPECT_TRUE(existing_replay.empty());
+    EXPECT_EQ(PacketType::Suback, typeOf(always_suback));
+    PublishView replay;
+    ASSERT_EQ(DecodeStatus::Ok, decodePublish(always_replay, replay));
+    EXPECT_EQ("open", replay.payload);
+    EXPECT_TRUE(replay.retained);
+    PublishView cleared;
+    ASSERT_EQ(DecodeStatus::Ok, decodePublish(live, cleared));
+    EXPECT_EQ("closed", cleared.payload);
+    EXPECT_FALSE(cleared.retained);
+    EXPECT_EQ(PacketType::Suback, typeOf(published_suback));
+    PublishView kept;
+    ASSERT_EQ(DecodeStatus::Ok, decodePublish(live_published, kept));
+    EXPECT_TRUE(kept.retained);
+}
+
+// Test a network QoS 1 publish reaching an in-process subscriber
+TEST_F(TcpListenerTest, PublishQoS1_AcknowledgedAndRouted) {
+    // Arrange
+    auto observer = makeObserver("command/#");
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.handshake("publisher"));
+
+    // Act
+    client.send(encode(Message("command/device_1", "reboot", QoS::AT_LEAST_ONCE), 9));
+    std::string packet = client.readPacket();
+
+    // Assert
+    AckView ack;
+    ASSERT_EQ(DecodeStatus::Ok, decodeAck(packet, ack));
+    EXPECT_EQ(PacketType::Puback, ack.type);
+    EXPECT_EQ(9, ack.packet_id);
+    ASSERT_TRUE(waitFor([this] { return receivedCount() == 1; }));
+    std::lock_guard<std::mutex> lock(received_mutex);
+    EXPECT_EQ("reboot", received[0].getPayload());
+    EXPECT_EQ("publisher", received[0].getSenderId());
+}
+
+// Test keep-alive pings
+TEST_F(TcpListenerTest, Pingreq_GetsPingresp) {
+    // Arrange
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.handshake("pinger"));
+    char ping[2];
+
+    // Act
+    client.send(std::string_view(ping, encodePing(PacketType::Pingreq, ping, sizeof(ping))));
+    std::string packet = client.readPacket();
+
+    // Assert
+    ASSERT_EQ(2u, packet.size());
+    EXPECT_EQ(PacketType::Pingresp, typeOf(packet));
+}
+
+// Test malformed input after CONNECT
+TEST_F(TcpListenerTest, MalformedPacket_DisconnectsWithReason) {
+    // Arrange
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.handshake("broken"));
+
+    // Act: PUBLISH with a topic length running past the packet
+    client.send(std::string("\x30\x03\x00\x09\x61", 5));
+    std::string packet = client.readPacket();
+
+    // Assert
+    DisconnectView disconnect;
+    ASSERT_EQ(DecodeStatus::Ok, decodeDisconnect(packet, disconnect));
+    EXPECT_EQ(ReasonCode::MalformedPacket, disconnect.reason);
+    EXPECT_TRUE(client.readPacket().empty());
+    EXPECT_EQ(1u, listener->getStats().protocol_errors);
+}
+
+// Test MQTT 3.1.1 clients are refused in their own protocol
+TEST_F(TcpListenerTest, Connect_OlderProtocol_Refused) {
+    // Arrange
+    TestClient client(listener->getPort());
+    const char connect[] = { 0x10, 0x0D, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, 0x00, 0x3C, 0x00, 0x01, 'c' };
+
+    // Act
+    client.send(std::string_view(connect, sizeof(connect)));
+    std::string packet = client.readPacket();
+
+    // Assert
+    EXPECT_EQ(std::string("\x20\x02\x00\x01", 4), packet);
+    EXPECT_TRUE(client.readPacket().empty());
+}
+
+// Test the will message after an abrupt close
+TEST_F(TcpListenerTest, AbruptClose_PublishesWill) {
+    // Arrange
+    auto observer = makeObserver("status/#");
+    TestClient client(listener->getPort());
+    ConnectView connect;
+    connect.client_id = "fragile";
+    connect.has_will = true;
+    connect.will_topic = "status/fragile";
+    connect.will_payload = "offline";
+    client.sendConnect(connect);
+    ASSERT_FALSE(client.readPacket().empty());
+
+    // Act
+    client.close();
+
+    // Assert
+    ASSERT_TRUE(waitFor([this] { return receivedCount() == 1; }));
+    std::lock_guard<std::mutex> lock(received_mutex);
+    EXPECT_EQ("status/fragile", received[0].getTopic());
+    EXPECT_EQ("offline", received[0].getPayload());
+}
+
+// Test a normal DISCONNECT discards the will
+TEST_F(TcpListenerTest, NormalDisconnect_DiscardsWill) {
+    // Arrange
+    auto observer = makeObserver("status/#");
+    TestClient client(listener->getPort());
+    ConnectView connect;
+    connect.client_id = "polite";
+    connect.has_will = true;
+    connect.will_topic = "status/polite";
+    connect.will_payload = "offline";
+    client.sendConnect(connect);
+    ASSERT_FALSE(client.readPacket().empty());
+    char disconnect[8];
+
+    // Act
+    client.send(std::string_view(disconnect, encodeDisconnect(ReasonCode::Success, disconnect, sizeof(disconnect))));
+    client.close();
+
+    // Assert
+    ASSERT_TRUE(waitFor([this] { return listener->getStats().active_connections == 0; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(0u, receivedCount());
+}
+
+// Test QoS 1 deliveries respect the client's Receive Maximum
+TEST_F(TcpListenerTest, SubscribeQoS1_WindowHeldUntilPuback) {
+    // Arrange
+    TestClient client(listener->getPort());
+    ConnectView connect;
+    connect.client_id = "slow-acker";
+    connect.receive_maximum = 2;
+    client.sendConnect(connect);
+    ASSERT_EQ(PacketType::Connack, typeOf(client.readPacket()));
+    client.sendSubscribe(1, "alarms/#", QoS::AT_LEAST_ONCE);
+    std::string suback_packet = client.readPacket();
+    SubackView suback;
+    ASSERT_EQ(DecodeStatus::Ok, decodeSuback(suback_packet, suback));
+    EXPECT_EQ(static_cast<char>(ReasonCode::GrantedQoS1), suback.reason_codes[0]);
+
+    // Act
+    for (int i = 0; i < 3; i++) {
+        broker->publish(Message("alarms/zone1", std::to_string(i), QoS::AT_LEAST_ONCE));
+    }
+    std::vector<uint16_t> ids;
+    for (int i = 0; i < 2; i++) {
+        std::string packet = client.readPacket();
+        PublishView publish;
+        ASSERT_EQ(DecodeStatus::Ok, decodePublish(packet, publish));
+        EXPECT_EQ(QoS::AT_LEAST_ONCE, publish.qos);
+        ids.push_back(publish.packet_id);
+    }
+    timeval short_timeout{ 0, 200000 };
+    setsockopt(client.fd, SOL_SOCKET, SO_RCVTIMEO, &short_timeout, sizeof(short_timeout));
+    bool third_before_ack = !client.readPacket().empty();
+    client.sendAck(PacketType::Puback, ids[0]);
+    std::string third = client.readPacket();
+
+    // Assert
+    EXPECT_NE(ids[0], ids[1]);
+    EXPECT_FALSE(third_before_ack);
+    PublishView publish;
+    ASSERT_EQ(DecodeStatus::Ok, decodePublish(third, publish));
+    EXPECT_EQ("2", publish.payload);
+    EXPECT_NE(ids[1], publish.packet_id);
+}
+
+// Test a retransmitted QoS 2 PUBLISH is delivered once
+TEST_F(TcpListenerTest, PublishQoS2_DuplicateDeliveredOnce) {
+    // Arrange
+    auto observer = makeObserver("command/#");
+    TestClient client(listener->getPort());
+    ASSERT_TRUE(client.handshake("exactly-once"));
+    std::string packet = encode(Message("command/valve", "open", QoS::EXACTLY_ONCE), 5);
+
+    // Act
+    client.send(packet);
+    std::string first = client.readPacket();
+    client.send(packet);
+    std::string second = client.readPacket();
+    client.sendAck(PacketType::Pubrel, 5);
+    std::string complete = client.readPacket();
+    client.sendAck(PacketType::Pubrel, 5);
+    std::string unknown = client.readPacket();
+
+    // Assert
+    AckView ack;
+    ASSERT_EQ(DecodeStatus::Ok, decodeAck(first, ack));
+    EXPECT_EQ(PacketType::Pubrec, ack.type);
+    ASSERT_EQ(DecodeStatus::Ok, decodeAck(second, ack));
+    EXPECT_EQ(PacketType::Pubrec, ack.type);
+    ASSERT_EQ(DecodeStatus::Ok, decodeAck(complete, ack));
+    EXPECT_EQ(PacketType::Pubcomp, ack.type);
+    EXPECT_EQ(ReasonCode::Success, ack.reason);
+    ASSERT_EQ(DecodeStatus::Ok, decodeAck(unknown, ack));
+    EXPECT_EQ(ReasonCode::PacketIdentifierNotFound, ack.reason);
+    ASSERT_TRUE(waitFor([this] { return receivedCount() >= 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(1u, receivedCount());
+}
+
+// Test many clients served by the single loop thread
+TEST_F(TcpListenerTest, ManyClients_AllReceiveFanOut) {
+    // Arrange
+    constexpr size_t CLIENTS = 300;
+    std::vector<std::unique_ptr<TestClient>> clients;
+    for (size_t i = 0; i < CLIENTS; i++) {
+        clients.push_back(std::make_unique<TestClient>(listener->getPort()));
+        ASSERT_TRUE(clients.back()->handshake("client-" + std::to_string(i)));
+        clients.back()->sendSubscribe(1, "broadcast/all");
+    }
+    for (auto& client : clients) {
+        ASSERT_EQ(PacketType::Suback, typeOf(client->readPacket()));
+    }
+
+    // Act
+    broker->publish(Message("broadcast/all", "hello"));
+
+    // Assert
+    for (auto& client : clients) {
+        std::string packet = client->readPacket();
+        PublishView publish;
+        ASSERT_EQ(DecodeStatus::Ok, decodePublish(packet, publish));
+        EXPECT_EQ("hello", publish.payload);
+    }
+    EXPECT_EQ(CLIENTS, listener->getStats().active_connections);
+}
+
+#endif
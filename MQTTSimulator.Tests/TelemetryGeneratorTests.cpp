@@ -0,0 +1,66 @@
+#include "pch.h"
+#include "TelemetryGenerator.h"
+#include "Constants.h"
+#include <regex>
+#include <string>
+
+using namespace mqtt;
+
+namespace {
+
+    double fieldValue(const std::string& payload, const std::string& key) {
+        size_t pos = payload.find("\"" + key + "\":");
+        return std::stod(payload.substr(pos + key.size() + 3));
+    }
+
+}
+
+// Test payload layout
+TEST(TelemetryGeneratorTests, Next_FormatsJsonWithFixedPrecision) {
+    // Arrange
+    TelemetryGenerator generator(42);
+    std::chrono::system_clock::time_point now(std::chrono::system_clock::duration(1234567));
+
+    // Act
+    std::string payload(generator.next(now));
+
+    // Assert
+    std::regex layout(R"(\{"temperature":\d+\.\d,"humidity":\d+\.\d,"pressure":\d+\.\d,"battery":\d\.\d\d,"timestamp":"1234567"\})");
+    EXPECT_TRUE(std::regex_match(payload, layout)) << payload;
+}
+
+// Test value ranges
+TEST(TelemetryGeneratorTests, Next_ReadingsStayInSensorRanges) {
+    // Arrange
+    TelemetryGenerator generator(7);
+
+    for (int i = 0; i < 1000; i++) {
+        // Act
+        std::string payload(generator.next());
+
+        // Assert
+        double temperature = fieldValue(payload, "temperature");
+        double battery = fieldValue(payload, "battery");
+        ASSERT_GE(temperature, constants::TEMPERATURE_MIN);
+        ASSERT_LE(temperature, constants::TEMPERATURE_MAX);
+        ASSERT_GE(battery, constants::BATTERY_MIN);
+        ASSERT_LE(battery, constants::BATTERY_MAX);
+    }
+}
+
+// Test seeding
+TEST(TelemetryGeneratorTests, SameSeed_ProducesSameSequence) {
+    // Arrange
+    TelemetryGenerator first(99);
+    TelemetryGenerator second(99);
+    std::chrono::system_clock::time_point now{};
+
+    // Act & Assert
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(first.next(now), second.next(now));
+        int jitter = first.uniformInt(100, 500);
+        EXPECT_EQ(jitter, second.uniformInt(100, 500));
+        EXPECT_GE(jitter, 100);
+        EXPECT_LE(jitter, 500);
+    }
+}
@@ -0,0 +1,428 @@
+#include "pch.h"
+#include "WireCodec.h"
+#include <random>
+
+using namespace mqtt;
+using namespace mqtt::wire;
+
+namespace {
+
+    std::string encode(const Message& message, uint16_t packet_id = 0) {
+        std::string buffer(publishSize(message), '\0');
+        size_t written = encodePublish(message, buffer.data(), buffer.size(), packet_id);
+        buffer.resize(written);
+        return buffer;
+    }
+
+    // Views must stay inside the decoded packet
+    bool within(std::string_view view, std::string_view packet) {
+        return view.empty() || (view.data() >= packet.data() &&
+            view.data() + view.size() <= packet.data() + packet.size());
+    }
+
+}
+
+// Test variable byte integers at every length boundary
+TEST(WireCodecTests, VariableInt_RoundTripsBoundaries) {
+    // Arrange
+    const uint32_t values[] = { 0, 127, 128, 16383, 16384, 2097151, 2097152, MAX_VARIABLE_INT };
+    const size_t sizes[] = { 1, 1, 2, 2, 3, 3, 4, 4 };
+    char buffer[MAX_VARIABLE_INT_SIZE];
+
+    for (size_t i = 0; i < std::size(values); i++) {
+        // Act
+        size_t written = encodeVariableInt(values[i], buffer);
+        uint32_t decoded = 0;
+        size_t length = 0;
+        DecodeStatus status = decodeVariableInt(std::string_view(buffer, written), decoded, length);
+
+        // Assert
+        EXPECT_EQ(sizes[i], written);
+        EXPECT_EQ(sizes[i], variableIntSize(values[i]));
+        EXPECT_EQ(DecodeStatus::Ok, status);
+        EXPECT_EQ(values[i], decoded);
+        EXPECT_EQ(written, length);
+    }
+    EXPECT_EQ(0u, encodeVariableInt(MAX_VARIABLE_INT + 1, buffer));
+}
+
+// Test variable byte integer errors
+TEST(WireCodecTests, VariableInt_RejectsOverlongAndTruncated) {
+    // Arrange
+    uint32_t value = 0;
+    size_t length = 0;
+
+    // Act & Assert
+    EXPECT_EQ(DecodeStatus::Malformed, decodeVariableInt(std::string_view("\xFF\xFF\xFF\xFF\x01", 5), value, length));
+    EXPECT_EQ(DecodeStatus::Malformed, decodeVariableInt(std::string_view("\x80\x00", 2), value, length));
+    EXPECT_EQ(DecodeStatus::Incomplete, decodeVariableInt(std::string_view("\x80\x80", 2), value, length));
+    EXPECT_EQ(DecodeStatus::Incomplete, decodeVariableInt(std::string_view(), value, length));
+}
+
+// Test the exact PUBLISH layout against the specification
+TEST(WireCodecTests, EncodePublish_MatchesSpecificationLayout) {
+    // Arrange
+    Message message("a/b", "hi", QoS::AT_LEAST_ONCE, true);
+    message.setTopicAlias(5);
+
+    // Act
+    std::string packet = encode(message, 0x1234);
+
+    // Assert
+    const char expected[] = {
+        0x33, 0x0D,                   // PUBLISH, QoS 1, retain; remaining length 13
+        0x00, 0x03, 'a', '/', 'b',    // Topic name
+        0x12, 0x34,                   // Packet identifier
+        0x03, 0x23, 0x00, 0x05,       // Properties: topic alias 5
+        'h', 'i'                      // Payload
+    };
+    EXPECT_EQ(std::string(expected, sizeof(expected)), packet);
+}
+
+// Test a full property round trip
+TEST(WireCodecTests, DecodePublish_RoundTripsAllProperties) {
+    // Arrange
+    Message message("site/b3/temp", "{\"t\":21.5}", QoS::EXACTLY_ONCE, false);
+    message.setMessageExpiryInterval(3600);
+    message.setTopicAlias(7);
+    message.setContentType("application/json");
+    message.setResponseTopic("site/b3/reply");
+    message.setCorrelationData({ 0x00, 0xFF, 0x10 });
+    message.addUserProperty("unit", "celsius");
+    message.addUserProperty("sensor", "t1");
+    std::string packet = encode(message, 42);
+
+    // Act
+    PublishView view;
+    DecodeStatus status = decodePublish(packet, view);
+    Message decoded = toMessage(view);
+
+    // Assert
+    ASSERT_EQ(DecodeStatus::Ok, status);
+    EXPECT_EQ(packet.size(), view.packet_size);
+    EXPECT_EQ(42, view.packet_id);
+    EXPECT_EQ(2u, view.user_property_count);
+    EXPECT_EQ(message.getTopic(), decoded.getTopic());
+    EXPECT_EQ(message.getPayload(), decoded.getPayload());
+    EXPECT_EQ(QoS::EXACTLY_ONCE, decoded.getQoS());
+    EXPECT_FALSE(decoded.isRetained());
+    EXPECT_EQ(3600u, decoded.getMessageExpiryInterval());
+    EXPECT_EQ(7, decoded.getTopicAlias());
+    EXPECT_EQ("application/json", decoded.getContentType());
+    EXPECT_EQ("site/b3/reply", decoded.getResponseTopic());
+    EXPECT_EQ(message.getCorrelationData(), decoded.getCorrelationData());
+    EXPECT_EQ(message.getUserProperties(), decoded.getUserProperties());
+}
+
+// Test stream framing
+TEST(WireCodecTests, DecodePublish_FramesBackToBackPackets) {
+    // Arrange
+    std::string stream = encode(Message("first", "1")) + encode(Message("second", "22"));
+
+    // Act
+    PublishView first;
+    PublishView second;
+    DecodeStatus first_status = decodePublish(stream, first);
+    DecodeStatus second_status = decodePublish(std::string_view(stream).substr(first.packet_size), second);
+
+    // Assert
+    ASSERT_EQ(DecodeStatus::Ok, first_status);
+    ASSERT_EQ(DecodeStatus::Ok, second_status);
+    EXPECT_EQ("first", first.topic);
+    EXPECT_EQ("1", first.payload);
+    EXPECT_EQ("second", second.topic);
+    EXPECT_EQ(stream.size(), first.packet_size + second.packet_size);
+    for (size_t cut = 0; cut < first.packet_size; cut++) {
+        EXPECT_EQ(DecodeStatus::Incomplete, decodePublish(std::string_view(stream.data(), cut), first));
+    }
+}
+
+// Test encoder preconditions
+TEST(WireCodecTests, EncodePublish_RejectsUnencodableMessages) {
+    // Arrange
+    Message qos1("a", "x", QoS::AT_LEAST_ONCE);
+    Message no_topic("", "x");
+    Message long_topic(std::string(70000, 'a'), "x");
+    char buffer[64];
+
+    // Act & Assert
+    EXPECT_EQ(0u, encodePublish(qos1, buffer, sizeof(buffer)));
+    EXPECT_NE(0u, encodePublish(qos1, buffer, sizeof(buffer), 1));
+    EXPECT_EQ(0u, encodePublish(qos1, buffer, 3, 1));
+    EXPECT_EQ(0u, encodePublish(no_topic, buffer, sizeof(buffer)));
+    EXPECT_EQ(0u, publishSize(long_topic));
+}
+
+// Test protocol violations
+TEST(WireCodecTests, DecodePublish_RejectsProtocolViolations) {
+    // Arrange
+    auto decode = [](std::initializer_list<int> bytes) {
+        std::string packet;
+        for (int byte : bytes) {
+            packet += static_cast<char>(byte);
+        }
+        PublishView view;
+        return decodePublish(packet, view);
+    };
+
+    // Act & Assert
+    EXPECT_EQ(DecodeStatus::Ok, decode({ 0x30, 0x05, 0x00, 0x01, 'a', 0x00, 'x' }));
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x36, 0x05, 0x00, 0x01, 'a', 0x00, 'x' }));          // QoS 3
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x38, 0x05, 0x00, 0x01, 'a', 0x00, 'x' }));          // DUP on QoS 0
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x30, 0x05, 0x00, 0x01, '#', 0x00, 'x' }));          // Wildcard topic
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x30, 0x05, 0x00, 0x01, 0x00, 0x00, 'x' }));         // U+0000 in topic
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x30, 0x05, 0x00, 0x01, 0xC0, 0x00, 'x' }));         // Invalid UTF-8
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x30, 0x03, 0x00, 0x00, 0x00 }));                    // No topic or alias
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x32, 0x06, 0x00, 0x01, 'a', 0x00, 0x00, 0x00 }));   // Packet id 0
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x30, 0x08, 0x00, 0x01, 'a', 0x04, 0x01, 0x01, 0x01, 0x01 })); // Duplicate property
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x30, 0x05, 0x00, 0x01, 'a', 0x01, 0x7F }));         // Unknown property
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x30, 0x05, 0x00, 0x01, 'a', 0x05, 0x01 }));         // Properties overrun
+    EXPECT_EQ(DecodeStatus::Malformed, decode({ 0x40, 0x02, 0x00, 0x01 }));                          // PUBACK, not PUBLISH
+}
+
+// Test random messages survive a round trip
+TEST(WireCodecTests, Fuzz_RandomMessagesRoundTrip) {
+    // Arrange
+    std::mt19937 random(1234);
+    auto text = [&random](size_t max_length) {
+        std::uniform_int_distribution<int> length(0, static_cast<int>(max_length));
+        std::uniform_int_distribution<int> character('0', 'z');
+        std::string result(static_cast<size_t>(length(random)), ' ');
+        for (auto& c : result) {
+            c = static_cast<char>(character(random));
+            c = c == '+' || c == '#' ? '_' : c;
+        }
+        return result;
+    };
+
+    for (int i = 0; i < 2000; i++) {
+        Message message("t/" + text(40), text(random() % 8 == 0 ? 20000 : 200),
+            static_cast<QoS>(random() % 3), random() % 2 == 0);
+        message.setMessageExpiryInterval(static_cast<uint32_t>(random() % 4));
+        message.setTopicAlias(static_cast<uint16_t>(random() % 3));
+        message.setContentType(text(10));
+        message.setCorrelationData(std::vector<uint8_t>(random() % 5, 0xAB));
+        for (int p = static_cast<int>(random() % 4); p > 0; p--) {
+            message.addUserProperty(text(8), text(8));
+        }
+        uint16_t packet_id = static_cast<uint16_t>(1 + random() % 65535);
+
+        // Act
+        std::string packet = encode(message, packet_id);
+        PublishView view;
+        DecodeStatus status = decodePublish(packet, view);
+        Message decoded = toMessage(view);
+
+        // Assert
+        ASSERT_EQ(DecodeStatus::Ok, status);
+        ASSERT_EQ(packet.size(), view.packet_size);
+        EXPECT_EQ(message.getTopic(), decoded.getTopic());
+        EXPECT_EQ(message.getPayload(), decoded.getPayload());
+        EXPECT_EQ(message.getQoS(), decoded.getQoS());
+        EXPECT_EQ(message.isRetained(), decoded.isRetained());
+        EXPECT_EQ(message.getMessageExpiryInterval(), decoded.getMessageExpiryInterval());
+        EXPECT_EQ(message.getTopicAlias(), decoded.getTopicAlias());
+        EXPECT_EQ(message.getCorrelationData(), decoded.getCorrelationData());
+        EXPECT_EQ(message.getUserProperties(), decoded.getUserProperties());
+    }
+}
+
+// Test corrupted input never escapes the buffer
+TEST(WireCodecTests, Fuzz_CorruptedPacketsStayInBounds) {
+    // Arrange
+    std::mt19937 random(99);
+    Message message("site/b3/floor7/temp", "{\"temperature\":21.5}", QoS::AT_LEAST_ONCE, true);
+    message.setContentType("application/json");
+    message.setResponseTopic("reply/here");
+    message.addUserProperty("unit", "celsius");
+    const std::string original = encode(message, 9);
+    size_t decoded_ok = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        std::string packet = original;
+        for (int flips = 1 + static_cast<int>(random() % 4); flips > 0; flips--) {
+            packet[random() % packet.size()] = static_cast<char>(random());
+        }
+        if (random() % 4 == 0) {
+            packet.resize(random() % packet.size());
+        }
+
+        // Act
+        PublishView view;
+        DecodeStatus status = decodePublish(packet, view);
+
+        // Assert
+        if (status == DecodeStatus::Ok) {
+            decoded_ok++;
+            std::string_view input(packet);
+            ASSERT_LE(view.packet_size, packet.size());
+            std::string_view frame = input.substr(0, view.packet_size);
+            EXPECT_TRUE(within(view.topic, frame));
+            EXPECT_TRUE(within(view.payload, frame));
+            EXPECT_TRUE(within(view.properties, frame));
+            EXPECT_TRUE(within(view.content_type, frame));
+            EXPECT_TRUE(within(view.response_topic, frame));
+            size_t cursor = 0;
+            std::string_view key;
+            std::string_view value;
+            size_t user_properties = 0;
+            while (view.nextUserProperty(cursor, key, value)) {
+                EXPECT_TRUE(within(key, frame));
+                EXPECT_TRUE(within(value, frame));
+                user_properties++;
+            }
+            EXPECT_EQ(view.user_property_count, user_properties);
+        }
+    }
+    EXPECT_GT(decoded_ok, 0u);
+}
+
+// Test CONNECT round trip with will, credentials and properties
+TEST(WireCodecTests, Connect_RoundTripsAllFields) {
+    // Arrange
+    ConnectView connect;
+    connect.clean_start = false;
+    connect.keep_alive = 30;
+    connect.session_expiry_interval = 3600;
+    connect.receive_maximum = 20;
+    connect.maximum_packet_size = 4096;
+    connect.client_id = "sensor-1";
+    connect.has_will = true;
+    connect.will_qos = QoS::AT_LEAST_ONCE;
+    connect.will_retained = true;
+    connect.will_topic = "status/sensor-1";
+    connect.will_payload = "offline";
+    connect.username = "user";
+    connect.password = "secret";
+    char buffer[256];
+
+    // Act
+    size_t written = encodeConnect(connect, buffer, sizeof(buffer));
+    ConnectView decoded;
+    DecodeStatus status = decodeConnect(std::string_view(buffer, written), decoded);
+
+    // Assert
+    ASSERT_EQ(DecodeStatus::Ok, status);
+    EXPECT_EQ(written, decoded.packet_size);
+    EXPECT_EQ(5, decoded.protocol_version);
+    EXPECT_FALSE(decoded.clean_start);
+    EXPECT_EQ(30, decoded.keep_alive);
+    EXPECT_EQ(3600u, decoded.session_expiry_interval);
+    EXPECT_EQ(20, decoded.receive_maximum);
+    EXPECT_EQ(4096u, decoded.maximum_packet_size);
+    EXPECT_EQ("sensor-1", decoded.client_id);
+    EXPECT_TRUE(decoded.has_will);
+    EXPECT_EQ(QoS::AT_LEAST_ONCE, decoded.will_qos);
+    EXPECT_TRUE(decoded.will_retained);
+    EXPECT_EQ("status/sensor-1", decoded.will_topic);
+    EXPECT_EQ("offline", decoded.will_payload);
+    EXPECT_EQ("user", decoded.username);
+    EXPECT_EQ("secret", decoded.password);
+}
+
+// Test CONNECT from an MQTT 3.1.1 client reports its version
+TEST(WireCodecTests, Connect_ReportsOlderProtocolVersion) {
+    // Arrange
+    const char packet[] = { 0x10, 0x0D, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, 0x00, 0x3C, 0x00, 0x01, 'c' };
+    ConnectView decoded;
+
+    // Act
+    DecodeStatus status = decodeConnect(std::string_view(packet, sizeof(packet)), decoded);
+
+    // Assert
+    EXPECT_EQ(DecodeStatus::Ok, status);
+    EXPECT_EQ(4, decoded.protocol_version);
+}
+
+// Test CONNACK, acknowledgement and DISCONNECT round trips
+TEST(WireCodecTests, ControlPackets_RoundTrip) {
+    // Arrange
+    ConnackView connack;
+    connack.reason = ReasonCode::Success;
+    connack.receive_maximum = 100;
+    connack.maximum_packet_size = 65536;
+    connack.assigned_client_id = "mqttsim-1";
+    char buffer[128];
+
+    // Act
+    size_t connack_size = encodeConnack(connack, buffer, sizeof(buffer));
+    ConnackView decoded_connack;
+    DecodeStatus connack_status = decodeConnack(std::string_view(buffer, connack_size), decoded_connack);
+
+    // Assert
+    ASSERT_EQ(DecodeStatus::Ok, connack_status);
+    EXPECT_EQ(100, decoded_connack.receive_maximum);
+    EXPECT_EQ(65536u, decoded_connack.maximum_packet_size);
+    EXPECT_EQ("mqttsim-1", decoded_connack.assigned_client_id);
+
+    // Act
+    size_t ack_size = encodeAck(PacketType::Pubrec, 7, ReasonCode::Success, buffer, sizeof(buffer));
+    AckView ack;
+    DecodeStatus ack_status = decodeAck(std::string_view(buffer, ack_size), ack);
+
+    // Assert
+    EXPECT_EQ(4u, ack_size);
+    ASSERT_EQ(DecodeStatus::Ok, ack_status);
+    EXPECT_EQ(PacketType::Pubrec, ack.type);
+    EXPECT_EQ(7, ack.packet_id);
+
+    // Act
+    size_t disconnect_size = encodeDisconnect(ReasonCode::KeepAliveTimeout, buffer, sizeof(buffer));
+    DisconnectView disconnect;
+    DecodeStatus disconnect_status = decodeDisconnect(std::string_view(buffer, disconnect_size), disconnect);
+
+    // Assert
+    ASSERT_EQ(DecodeStatus::Ok, disconnect_status);
+    EXPECT_EQ(ReasonCode::KeepAliveTimeout, disconnect.reason);
+}
+
+// Test SUBSCRIBE and SUBACK round trips
+TEST(WireCodecTests, Subscribe_RoundTripsFilters) {
+    // Arrange
+    const std::string_view filters[] = { "telemetry/#", "command/+/set" };
+    const ReasonCode reasons[] = { ReasonCode::Success, ReasonCode::TopicFilterInvalid };
+    char buffer[128];
+
+    // Act
+    size_t written = encodeSubscribe(3, filters, std::size(filters), QoS::AT_LEAST_ONCE, buffer, sizeof(buffer));
+    SubscribeView subscribe;
+    DecodeStatus status = decodeSubscribe(std::string_view(buffer, written), subscribe);
+
+    // Assert
+    ASSERT_EQ(DecodeStatus::Ok, status);
+    EXPECT_EQ(3, subscribe.packet_id);
+    EXPECT_EQ(2u, subscribe.filter_count);
+    size_t cursor = 0;
+    std::string_view filter;
+    uint8_t options = 0;
+    for (const auto& expected : filters) {
+        ASSERT_TRUE(subscribe.nextFilter(cursor, filter, options));
+        EXPECT_EQ(expected, filter);
+        EXPECT_EQ(1, options & 0x03);
+    }
+    EXPECT_FALSE(subscribe.nextFilter(cursor, filter, options));
+
+    // Act
+    written = encodeSuback(PacketType::Suback, 3, reasons, std::size(reasons), buffer, sizeof(buffer));
+    SubackView suback;
+    status = decodeSuback(std::string_view(buffer, written), suback);
+
+    // Assert
+    ASSERT_EQ(DecodeStatus::Ok, status);
+    EXPECT_EQ(3, suback.packet_id);
+    ASSERT_EQ(2u, suback.reason_codes.size());
+    EXPECT_EQ(static_cast<char>(ReasonCode::TopicFilterInvalid), suback.reason_codes[1]);
+}
+
+// Test topic filter syntax checks
+TEST(WireCodecTests, ValidTopicFilter_ChecksWildcardPlacement) {
+    // Act & Assert
+    EXPECT_TRUE(validTopicFilter("#"));
+    EXPECT_TRUE(validTopicFilter("a/+/c"));
+    EXPECT_TRUE(validTopicFilter("+/+"));
+    EXPECT_TRUE(validTopicFilter("a/#"));
+    EXPECT_FALSE(validTopicFilter(""));
+    EXPECT_FALSE(validTopicFilter("a/#/c"));
+    EXPECT_FALSE(validTopicFilter("a#"));
+    EXPECT_FALSE(validTopicFilter("a/b+"));
+}
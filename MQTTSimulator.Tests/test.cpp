@@ -2,6 +2,8 @@
 #include "Message.h"
 #include "Broker.h"
 #include "Device.h"
+#include <algorithm>
+#include <map>
 
 using namespace mqtt;
 
@@ -32,6 +34,58 @@ TEST(BrokerTests, GetIdReturnsCorrectId) {
 	EXPECT_EQ("test_broker", broker->getId());
 }
 
+TEST(BrokerTests, PublishWakesDispatcherAndDeliversBurst) {
+	// Arrange
+	auto broker = std::make_shared<Broker>("test_broker");
+	auto device = std::make_shared<Device>("test_device", broker, std::chrono::milliseconds(10));
+	std::atomic<int> received{ 0 };
+	device->addMessageHandler([&received](const Message&) { received++; });
+	device->subscribe("burst/+");
+
+	// Act
+	for (int i = 0; i < 1000; i++) {
+		broker->publish(Message("burst/" + std::to_string(i % 10), "payload"));
+	}
+
+	// Assert
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (received < 1000 && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_EQ(1000, received.load());
+}
+
+TEST(BrokerTests, ShardedDispatchPreservesPerTopicOrder) {
+	// Arrange
+	auto broker = std::make_shared<Broker>("test_broker", 4);
+	auto device = std::make_shared<Device>("test_device", broker, std::chrono::milliseconds(10));
+	std::map<std::string, std::vector<int>> sequences;
+	std::atomic<int> received{ 0 };
+	device->addMessageHandler([&sequences, &received](const Message& msg) {
+		sequences[msg.getTopic()].push_back(std::stoi(msg.getPayload()));
+		received++;
+		});
+	device->setDeliveryQueue(2000, OverflowPolicy::DropNewest);
+	device->subscribe("ordered/#");
+
+	// Act
+	for (int i = 0; i < 2000; i++) {
+		broker->publish(Message("ordered/" + std::to_string(i % 8), std::to_string(i)));
+	}
+
+	// Assert
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (received < 2000 && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_EQ(2000, received.load());
+	EXPECT_EQ(4u, broker->getDispatchThreadCount());
+	EXPECT_EQ(8u, sequences.size());
+	for (const auto& topic : sequences) {
+		EXPECT_TRUE(std::is_sorted(topic.second.begin(), topic.second.end())) << topic.first;
+	}
+}
+
 // Device Tests
 TEST(DeviceTests, GetIdReturnsCorrectId) {
 	// Arrange
@@ -40,4 +94,53 @@ TEST(DeviceTests, GetIdReturnsCorrectId) {
 
 	// Act & Assert
 	EXPECT_EQ("test_device", device->getId());
-}
\ No newline at end of file
+}
+
+TEST(DeviceTests, TelemetryDisabledWithNonPositiveInterval) {
+	// Arrange
+	auto broker = std::make_shared<Broker>("test_broker");
+	auto device = std::make_shared<Device>("quiet_device", broker, std::chrono::milliseconds(0));
+
+	// Act
+	std::this_thread::sleep_for(std::chrono::milliseconds(600));
+
+	// Assert
+	EXPECT_FALSE(device->getLastMessage().has_value());
+}
+
+TEST(DeviceTests, SetTelemetryIntervalStartsStoppedTelemetry) {
+	// Arrange
+	auto broker = std::make_shared<Broker>("test_broker");
+	auto device = std::make_shared<Device>("late_device", broker, std::chrono::milliseconds(0));
+
+	// Act
+	device->setTelemetryInterval(std::chrono::milliseconds(1));
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (!device->getLastMessage() && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	// Assert
+	auto message = device->getLastMessage();
+	ASSERT_TRUE(message.has_value());
+	EXPECT_EQ("telemetry/late_device", message->getTopic());
+}
+
+TEST(DeviceTests, SetTelemetryIntervalAppliesImmediately) {
+	// Arrange
+	auto broker = std::make_shared<Broker>("test_broker");
+	auto device = std::make_shared<Device>("busy_device", broker, std::chrono::milliseconds(1));
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (!device->getLastMessage() && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	// Act
+	device->setTelemetryInterval(std::chrono::minutes(1));
+	size_t sent = device->getMessageHistory().size();
+	std::this_thread::sleep_for(std::chrono::milliseconds(700));
+
+	// Assert
+	ASSERT_GT(sent, 0u);
+	EXPECT_EQ(sent, device->getMessageHistory().size());
+}
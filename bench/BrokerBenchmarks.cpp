@@ -0,0 +1,404 @@
+#include "Broker.h"
+#include "Device.h"
+#include "RetainedStore.h"
+#include "PersistentLog.h"
+#include "Snapshot.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace mqtt;
+
+/**
+ * @brief Sustained publish-to-delivery throughput through one broker
+ *
+ * Publishes a burst of messages and waits until the subscriber has received
+ * all of them, so the reported items/s is end-to-end delivery rate.
+ */
+static void BM_BrokerSustainedThroughput(benchmark::State& state) {
+    const int64_t burst = state.range(0);
+    auto broker = std::make_shared<Broker>("bench_broker");
+    auto sink = std::make_shared<Device>("bench_sink", broker, std::chrono::milliseconds(0));
+
+    std::atomic<int64_t> delivered{ 0 };
+    sink->addMessageHandler([&delivered](const Message&) {
+        delivered.fetch_add(1, std::memory_order_relaxed);
+        });
+    sink->subscribe("bench/#");
+
+    Message message("bench/throughput", "{\"temperature\":21.5}");
+    int64_t expected = 0;
+    for (auto _ : state) {
+        for (int64_t i = 0; i < burst; i++) {
+            broker->publish(message);
+        }
+        expected += burst;
+        while (delivered.load(std::memory_order_relaxed) < expected) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(expected);
+}
+BENCHMARK(BM_BrokerSustainedThroughput)->Arg(1000)->Arg(10000)->UseRealTime();
+
+/**
+ * @brief Publish cost with many concurrent publishers
+ *
+ * Measures only the publisher side; the contention counters show how often
+ * publishers lost an ingress slot claim to each other or found it full.
+ */
+static void BM_BrokerConcurrentPublish(benchmark::State& state) {
+    static std::shared_ptr<Broker> broker;
+    if (state.thread_index() == 0) {
+        broker = std::make_shared<Broker>("bench_broker");
+    }
+
+    Message message("bench/publish/" + std::to_string(state.thread_index()), "{\"humidity\":45.0}");
+    for (auto _ : state) {
+        broker->publish(message);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        auto stats = broker->getIngressStats();
+        state.counters["contended"] = static_cast<double>(stats.contended_publishes);
+        state.counters["full_waits"] = static_cast<double>(stats.full_waits);
+        state.counters["wakeups"] = static_cast<double>(stats.dispatcher_wakeups);
+        broker.reset();
+    }
+}
+BENCHMARK(BM_BrokerConcurrentPublish)->ThreadRange(1, 16)->UseRealTime();
+
+/**
+ * @brief Delivery throughput as dispatch shards are added
+ *
+ * Messages are spread over many topics, each with its own subscriber, so
+ * shards do not serialize on a single device.
+ */
+static void BM_BrokerShardedDispatch(benchmark::State& state) {
+    const size_t dispatch_threads = static_cast<size_t>(state.range(0));
+    const int topic_count = 64;
+    const int64_t burst = 20000;
+    auto broker = std::make_shared<Broker>("bench_broker", dispatch_threads);
+
+    std::atomic<int64_t> delivered{ 0 };
+    std::vector<std::shared_ptr<Device>> sinks;
+    std::vector<Message> messages;
+    for (int i = 0; i < topic_count; i++) {
+        auto sink = std::make_shared<Device>("bench_sink_" + std::to_string(i), broker,
+            std::chrono::milliseconds(0));
+        sink->addMessageHandler([&delivered](const Message&) {
+            delivered.fetch_add(1, std::memory_order_relaxed);
+            });
+        sink->subscribe("bench/shard/" + std::to_string(i));
+        sinks.push_back(sink);
+        messages.emplace_back("bench/shard/" + std::to_string(i), "{\"pressure\":1004.2}");
+    }
+
+    int64_t expected = 0;
+    for (auto _ : state) {
+        for (int64_t i = 0; i < burst; i++) {
+            broker->publish(messages[i % topic_count]);
+        }
+        expected += burst;
+        while (delivered.load(std::memory_order_relaxed) < expected) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(expected);
+}
+BENCHMARK(BM_BrokerShardedDispatch)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+
+/**
+ * @brief Publish-to-receive latency of a single message on an idle broker
+ *
+ * Each iteration publishes one message and waits for its delivery, so the
+ * iteration time includes waking the dispatcher. Percentiles are reported
+ * as counters in microseconds.
+ */
+static void BM_BrokerPublishLatency(benchmark::State& state) {
+    auto broker = std::make_shared<Broker>("bench_broker", 1);
+    auto sink = std::make_shared<Device>("bench_sink", broker, std::chrono::milliseconds(0));
+    sink->setHistoryCapacity(0);
+
+    std::atomic<int64_t> delivered{ 0 };
+    sink->addMessageHandler([&delivered](const Message&) {
+        delivered.fetch_add(1, std::memory_order_release);
+        });
+    sink->subscribe("bench/latency");
+
+    Message message("bench/latency", "{\"temperature\":21.5}");
+    std::vector<double> samples;
+    int64_t expected = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        broker->publish(message);
+        expected++;
+        while (delivered.load(std::memory_order_acquire) < expected) {
+            std::this_thread::yield();
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::sort(samples.begin(), samples.end());
+    if (!samples.empty()) {
+        state.counters["p50_us"] = samples[samples.size() / 2];
+        state.counters["p99_us"] = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    }
+}
+BENCHMARK(BM_BrokerPublishLatency)->UseRealTime();
+
+/**
+ * @brief Delivery cost as the number of subscribers to one topic grows
+ *
+ * Items are individual deliveries, so a flat items/s means fan-out scales
+ * linearly with subscriber count.
+ */
+static void BM_BrokerFanOut(benchmark::State& state) {
+    const int subscriber_count = static_cast<int>(state.range(0));
+    auto broker = std::make_shared<Broker>("bench_broker", 1);
+
+    std::atomic<int64_t> delivered{ 0 };
+    std::vector<std::shared_ptr<Device>> sinks;
+    for (int i = 0; i < subscriber_count; i++) {
+        auto sink = std::make_shared<Device>("bench_sink_" + std::to_string(i), broker,
+            std::chrono::milliseconds(0));
+        sink->setHistoryCapacity(0);
+        sink->addMessageHandler([&delivered](const Message&) {
+            delivered.fetch_add(1, std::memory_order_relaxed);
+            });
+        sink->subscribe("bench/fanout/+");
+        sinks.push_back(sink);
+    }
+
+    Message message("bench/fanout/all", "{\"command\":\"sync\"}");
+    const int64_t burst = std::max<int64_t>(1, 16384 / subscriber_count);
+    int64_t expected = 0;
+    for (auto _ : state) {
+        for (int64_t i = 0; i < burst; i++) {
+            broker->publish(message);
+        }
+        expected += burst * subscriber_count;
+        while (delivered.load(std::memory_order_relaxed) < expected) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(expected);
+}
+BENCHMARK(BM_BrokerFanOut)->RangeMultiplier(4)->Range(1, 1024)->UseRealTime();
+
+/**
+ * @brief Cost of Broker::subscribe replaying retained messages
+ *
+ * The broker holds range(0) retained messages, a tenth of which match the
+ * new subscription; each iteration subscribes and unsubscribes once.
+ */
+static void BM_BrokerRetainedReplay(benchmark::State& state) {
+    const int retained_count = static_cast<int>(state.range(0));
+    auto broker = std::make_shared<Broker>("bench_broker", 1);
+    auto publisher = std::make_shared<Device>("bench_publisher", broker, std::chrono::milliseconds(0));
+    for (int i = 0; i < retained_count; i++) {
+        std::string zone = (i % 10 == 0) ? "zone0" : "zone" + std::to_string(1 + i % 9);
+        publisher->publish("site/" + zone + "/sensor" + std::to_string(i) + "/state", "{\"online\":true}",
+            QoS::AT_LEAST_ONCE, true);
+    }
+    while (broker->getIngressStats().queue_depth > 0) {
+        std::this_thread::yield();
+    }
+
+    auto subscriber = std::make_shared<Device>("bench_subscriber", broker, std::chrono::milliseconds(0));
+    subscriber->setHistoryCapacity(0);
+    std::atomic<int64_t> replayed{ 0 };
+    subscriber->addMessageHandler([&replayed](const Message&) {
+        replayed.fetch_add(1, std::memory_order_relaxed);
+        });
+
+    for (auto _ : state) {
+        subscriber->subscribe("site/zone0/#");
+        subscriber->unsubscribe("site/zone0/#");
+    }
+    state.SetItemsProcessed(replayed.load());
+    state.counters["replayed_per_subscribe"] = benchmark::Counter(
+        static_cast<double>(replayed.load()) / std::max<int64_t>(1, state.iterations()));
+}
+BENCHMARK(BM_BrokerRetainedReplay)->RangeMultiplier(10)->Range(10, 100000);
+
+/**
+ * @brief Retained lookup for a narrow wildcard filter as the store grows
+ *
+ * One sensor of range(0) matches "site/+/sensor7/state", so a flat time
+ * means the walk skips the branches that cannot match.
+ */
+static void BM_RetainedStoreNarrowFilter(benchmark::State& state) {
+    const int retained_count = static_cast<int>(state.range(0));
+    RetainedStore store;
+    for (int i = 0; i < retained_count; i++) {
+        std::string zone = "zone" + std::to_string(i % 10);
+        store.store(Message("site/" + zone + "/sensor" + std::to_string(i) + "/state", "{\"online\":true}",
+            QoS::AT_LEAST_ONCE, true));
+    }
+
+    std::vector<Message> out;
+    for (auto _ : state) {
+        out.clear();
+        std::string cursor;
+        store.collect("site/+/sensor7/state", cursor, mqtt::constants::BROKER_RETAINED_REPLAY_CHUNK, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.counters["matches"] = benchmark::Counter(static_cast<double>(out.size()));
+}
+BENCHMARK(BM_RetainedStoreNarrowFilter)->RangeMultiplier(10)->Range(10, 1000000);
+
+/**
+ * @brief Cost of retaining range(0) sensor states, in time and memory
+ *
+ * Every topic shares its "site", zone and "state" levels and one of two
+ * payloads, so bytes_per_topic shows what a topic costs on its own.
+ */
+static void BM_RetainedStoreFootprint(benchmark::State& state) {
+    const int retained_count = static_cast<int>(state.range(0));
+    RetainedStore::MemoryUsage usage;
+    for (auto _ : state) {
+        RetainedStore store;
+        for (int i = 0; i < retained_count; i++) {
+            std::string zone = "zone" + std::to_string(i % 10);
+            store.store(Message("site/" + zone + "/sensor" + std::to_string(i) + "/state",
+                i % 2 == 0 ? "{\"online\":true}" : "{\"online\":false}", QoS::AT_LEAST_ONCE, true));
+        }
+        usage = store.memoryUsage();
+    }
+    state.SetItemsProcessed(state.iterations() * retained_count);
+    state.counters["bytes_per_topic"] = benchmark::Counter(
+        static_cast<double>(usage.total_bytes) / std::max(1, retained_count));
+    state.counters["unique_payloads"] = benchmark::Counter(static_cast<double>(usage.payloads));
+}
+BENCHMARK(BM_RetainedStoreFootprint)->RangeMultiplier(100)->Range(100, 1000000)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Restart cost: replaying a log of range(0) retained messages
+ *
+ * The log is written once, compacted the way a long-running broker's
+ * would be, and then reopened into an empty store each iteration.
+ */
+static void BM_PersistentLogRecovery(benchmark::State& state) {
+    const int retained_count = static_cast<int>(state.range(0));
+    std::string directory = (std::filesystem::temp_directory_path() / "mqttsim_bench_log").string();
+    std::filesystem::remove_all(directory);
+    {
+        RetainedStore retained;
+        std::set<PersistentLog::Subscription> subscriptions;
+        PersistentLog log(directory);
+        std::string error;
+        if (!log.open(retained, subscriptions, error)) {
+            state.SkipWithError(error.c_str());
+            return;
+        }
+        for (int i = 0; i < retained_count; i++) {
+            std::string zone = "zone" + std::to_string(i % 10);
+            Message message("site/" + zone + "/sensor" + std::to_string(i) + "/state",
+                i % 2 == 0 ? "{\"online\":true}" : "{\"online\":false}", QoS::AT_LEAST_ONCE, true);
+            retained.store(message);
+        }
+        log.compact(retained, subscriptions);
+    }
+
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        RetainedStore retained;
+        std::set<PersistentLog::Subscription> subscriptions;
+        PersistentLog log(directory);
+        std::string error;
+        log.open(retained, subscriptions, error);
+        bytes = log.getStats().bytes;
+        benchmark::DoNotOptimize(retained.size());
+    }
+    state.SetItemsProcessed(state.iterations() * retained_count);
+    state.counters["log_bytes"] = benchmark::Counter(static_cast<double>(bytes));
+    std::filesystem::remove_all(directory);
+}
+BENCHMARK(BM_PersistentLogRecovery)->RangeMultiplier(100)->Range(100, 1000000)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Retained publishes per second with and without the log
+ *
+ * range(0) is 1 when persistence is enabled. Every publish replaces the
+ * retained message of one of 1000 topics, so compaction runs periodically.
+ */
+static void BM_BrokerRetainedPublishPersisted(benchmark::State& state) {
+    std::string directory = (std::filesystem::temp_directory_path() / "mqttsim_bench_broker_log").string();
+    std::filesystem::remove_all(directory);
+    auto broker = std::make_shared<Broker>("bench_broker", 1);
+    std::string error;
+    if (state.range(0) == 1 && !broker->enablePersistence(directory, error)) {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+    auto publisher = std::make_shared<Device>("bench_publisher", broker, std::chrono::milliseconds(0));
+    publisher->setHistoryCapacity(0);
+
+    int64_t published = 0;
+    for (auto _ : state) {
+        publisher->publish("site/sensor" + std::to_string(published % 1000) + "/state",
+            "{\"online\":true}", QoS::AT_LEAST_ONCE, true);
+        published++;
+    }
+    while (broker->getIngressStats().queue_depth > 0) {
+        std::this_thread::yield();
+    }
+    state.SetItemsProcessed(published);
+    state.counters["log_bytes"] = benchmark::Counter(static_cast<double>(broker->getLogStats().bytes));
+    broker.reset();
+    std::filesystem::remove_all(directory);
+}
+BENCHMARK(BM_BrokerRetainedPublishPersisted)->Arg(0)->Arg(1)->UseRealTime();
+
+/**
+ * @brief Startup cost: bringing up range(0) subscribed devices from a snapshot
+ *
+ * Each device has a telemetry timer and two command subscriptions, one
+ * of them shared by all; every tenth has a retained status. Each
+ * iteration maps the file and restores it onto a fresh broker.
+ */
+static void BM_SnapshotRestore(benchmark::State& state) {
+    const int device_count = static_cast<int>(state.range(0));
+    std::string path = (std::filesystem::temp_directory_path() / "mqttsim_bench_snapshot.bin").string();
+    {
+        auto broker = std::make_shared<Broker>("bench_broker", 1);
+        std::vector<std::shared_ptr<Device>> devices;
+        for (int i = 0; i < device_count; i++) {
+            std::string id = "device_" + std::to_string(i);
+            devices.push_back(std::make_shared<Device>(id, broker, std::chrono::milliseconds(60000)));
+            devices.back()->subscribe("command/" + id);
+            devices.back()->subscribe("command/all");
+            if (i % 10 == 0) {
+                broker->restoreRetained(Message("status/" + id, "online", QoS::AT_LEAST_ONCE, true));
+            }
+        }
+        std::string error;
+        if (!Snapshot::write(path, *broker, devices, error)) {
+            state.SkipWithError(error.c_str());
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        auto broker = std::make_shared<Broker>("bench_broker", 1);
+        Snapshot snapshot;
+        std::string error;
+        snapshot.open(path, error);
+        auto devices = snapshot.restore(broker);
+        benchmark::DoNotOptimize(devices.size());
+        state.PauseTiming();
+        devices.clear();
+        broker.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * device_count);
+    state.counters["file_bytes"] = benchmark::Counter(static_cast<double>(std::filesystem::file_size(path)));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_SnapshotRestore)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
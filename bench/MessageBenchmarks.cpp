@@ -0,0 +1,75 @@
+#include "Message.h"
+#include <benchmark/benchmark.h>
+#include <string>
+
+using namespace mqtt;
+
+namespace {
+
+    Message makeMessage(size_t payload_size, int user_properties) {
+        Message message("site/b3/floor7/room15/temperature", std::string(payload_size, 'x'), QoS::AT_LEAST_ONCE);
+        message.setSenderId("sensor_temp");
+        for (int i = 0; i < user_properties; i++) {
+            message.addUserProperty("key" + std::to_string(i), "value" + std::to_string(i));
+        }
+        return message;
+    }
+
+}
+
+/**
+ * @brief Copying a message, which shares its body
+ */
+static void BM_MessageCopy(benchmark::State& state) {
+    Message message = makeMessage(static_cast<size_t>(state.range(0)), 4);
+    for (auto _ : state) {
+        Message copy = message;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MessageCopy)->Arg(64)->Arg(4096);
+
+/**
+ * @brief Per-subscriber delivery copy: copy plus target handle, as the broker does
+ */
+static void BM_MessageDeliveryCopy(benchmark::State& state) {
+    Message message = makeMessage(static_cast<size_t>(state.range(0)), 4);
+    const InternTable::Handle target = InternTable::clients().intern("gateway");
+    for (auto _ : state) {
+        Message copy = message;
+        copy.setTargetHandle(target);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MessageDeliveryCopy)->Arg(64)->Arg(4096);
+
+/**
+ * @brief Copy followed by a payload edit, which clones the shared body
+ */
+static void BM_MessageCopyOnWrite(benchmark::State& state) {
+    Message message = makeMessage(static_cast<size_t>(state.range(0)), 4);
+    const std::string payload(static_cast<size_t>(state.range(0)), 'y');
+    for (auto _ : state) {
+        Message copy = message;
+        copy.setPayload(payload);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MessageCopyOnWrite)->Arg(64)->Arg(4096);
+
+/**
+ * @brief Building a fresh message, for comparison with copying
+ */
+static void BM_MessageConstruct(benchmark::State& state) {
+    const std::string payload(static_cast<size_t>(state.range(0)), 'x');
+    for (auto _ : state) {
+        Message message("site/b3/floor7/room15/temperature", payload, QoS::AT_LEAST_ONCE);
+        benchmark::DoNotOptimize(message);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MessageConstruct)->Arg(64)->Arg(4096);
@@ -0,0 +1,198 @@
+#include "QoSSession.h"
+#include "TcpListener.h"
+#include "WireCodec.h"
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace mqtt;
+
+/**
+ * @brief Session bookkeeping and encoding for one delivery and its acknowledgements
+ *
+ * QoS 0 only encodes the PUBLISH; QoS 1 adds a slot and a PUBACK; QoS 2 a
+ * slot, PUBREC, PUBREL and PUBCOMP.
+ */
+static void BM_QoSSessionExchange(benchmark::State& state) {
+    QoS qos = static_cast<QoS>(state.range(0));
+    Message message("telemetry/device_42", std::string(64, 'x'), qos);
+    QoSSession session;
+    session.reset(constants::QOS_MAX_SEND_WINDOW, constants::QOS_RECEIVE_MAXIMUM);
+    std::vector<char> buffer(wire::publishSize(message) + 16);
+    auto now = QoSSession::Clock::now();
+    for (auto _ : state) {
+        uint16_t packet_id = qos == QoS::AT_MOST_ONCE ? 0 : session.send(message, now);
+        size_t written = wire::encodePublish(message, buffer.data(), buffer.size(), packet_id);
+        benchmark::DoNotOptimize(written);
+        if (qos == QoS::AT_LEAST_ONCE) {
+            session.acknowledge(packet_id);
+        }
+        else if (qos == QoS::EXACTLY_ONCE) {
+            session.received(packet_id, now);
+            written = wire::encodeAck(wire::PacketType::Pubrel, packet_id, wire::ReasonCode::Success,
+                buffer.data(), buffer.size());
+            benchmark::DoNotOptimize(written);
+            session.complete(packet_id);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QoSSessionExchange)->ArgName("qos")->Arg(0)->Arg(1)->Arg(2);
+
+#ifdef __linux__
+
+namespace {
+
+    // Blocking loopback client that acknowledges everything it receives
+    class AckingClient {
+    public:
+        explicit AckingClient(uint16_t port) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+            ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        }
+
+        ~AckingClient() {
+            ::close(fd);
+        }
+
+        void send(const char* data, size_t size) {
+            ::send(fd, data, size, MSG_NOSIGNAL);
+        }
+
+        // Handle packets until count PUBLISHes have completed their flow
+        bool receive(size_t count) {
+            completed = 0;
+            return pump([this, count] { return completed >= count; });
+        }
+
+        bool waitForSuback() {
+            return pump([this] { return subscribed; });
+        }
+
+    private:
+        template <typename Done>
+        bool pump(Done done) {
+            while (true) {
+                handleBuffered();
+                if (done()) {
+                    return true;
+                }
+                char chunk[65536];
+                ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    return false;
+                }
+                inbound.append(chunk, static_cast<size_t>(received));
+            }
+        }
+
+        void handleBuffered() {
+            std::string acks;
+            size_t offset = 0;
+            while (true) {
+                wire::PacketType type = wire::PacketType::Connect;
+                uint8_t flags = 0;
+                size_t size = 0;
+                std::string_view input(inbound.data() + offset, inbound.size() - offset);
+                if (wire::peekPacket(input, type, flags, size) != wire::DecodeStatus::Ok || input.size() < size) {
+                    break;
+                }
+                std::string_view packet = input.substr(0, size);
+                offset += size;
+                char ack[8];
+                if (type == wire::PacketType::Publish) {
+                    wire::PublishView publish;
+                    wire::decodePublish(packet, publish);
+                    if (publish.qos == QoS::AT_MOST_ONCE) {
+                        completed++;
+                        continue;
+                    }
+                    auto reply = publish.qos == QoS::AT_LEAST_ONCE ? wire::PacketType::Puback : wire::PacketType::Pubrec;
+                    acks.append(ack, wire::encodeAck(reply, publish.packet_id, wire::ReasonCode::Success, ack, sizeof(ack)));
+                    completed += publish.qos == QoS::AT_LEAST_ONCE ? 1 : 0;
+                }
+                else if (type == wire::PacketType::Pubrel) {
+                    wire::AckView release;
+                    wire::decodeAck(packet, release);
+                    acks.append(ack, wire::encodeAck(wire::PacketType::Pubcomp, release.packet_id,
+                        wire::ReasonCode::Success, ack, sizeof(ack)));
+                    completed++;
+                }
+                else if (type == wire::PacketType::Suback) {
+                    subscribed = true;
+                }
+            }
+            inbound.erase(0, offset);
+            if (!acks.empty()) {
+                send(acks.data(), acks.size());
+            }
+        }
+
+    public:
+        int fd = -1;
+        std::string inbound;
+        size_t completed = 0;
+        bool subscribed = false;
+    };
+
+}
+
+/**
+ * @brief Broker-to-client delivery over loopback TCP at each QoS
+ *
+ * A batch of publishes fans out to one network subscriber that answers
+ * every PUBLISH and PUBREL, so QoS 1 and 2 pay for their round trips and
+ * the Receive Maximum window.
+ */
+static void BM_TcpDeliveryQoS(benchmark::State& state) {
+    constexpr size_t BATCH = 1000;
+    QoS qos = static_cast<QoS>(state.range(0));
+    auto broker = std::make_shared<Broker>("bench_broker", 1);
+    TcpListener listener(broker);
+    std::string error;
+    if (!listener.start("127.0.0.1", 0, error)) {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+
+    AckingClient client(listener.getPort());
+    char buffer[256];
+    wire::ConnectView connect;
+    connect.client_id = "bench";
+    client.send(buffer, wire::encodeConnect(connect, buffer, sizeof(buffer)));
+    std::string_view filter = "bench/#";
+    client.send(buffer, wire::encodeSubscribe(1, &filter, 1, qos, buffer, sizeof(buffer)));
+    if (!client.waitForSuback()) {
+        state.SkipWithError("No SUBACK");
+        return;
+    }
+
+    Message message("bench/device_1", std::string(64, 'x'), qos);
+    for (auto _ : state) {
+        for (size_t i = 0; i < BATCH; i++) {
+            broker->publish(message);
+        }
+        if (!client.receive(BATCH)) {
+            state.SkipWithError("Connection closed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+BENCHMARK(BM_TcpDeliveryQoS)->ArgName("qos")->Arg(0)->Arg(1)->Arg(2)->UseRealTime();
+
+#endif
@@ -0,0 +1,74 @@
+#include "TelemetryGenerator.h"
+#include "Constants.h"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace mqtt;
+
+namespace {
+
+    // Device::generateRandomTelemetry as it was before TelemetryGenerator
+    std::string legacyTelemetry() {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+
+        std::uniform_real_distribution<> temp(constants::TEMPERATURE_MIN, constants::TEMPERATURE_MAX);
+        std::uniform_real_distribution<> humidity(constants::HUMIDITY_MIN, constants::HUMIDITY_MAX);
+        std::uniform_real_distribution<> pressure(constants::PRESSURE_MIN, constants::PRESSURE_MAX);
+        std::uniform_real_distribution<> battery(constants::BATTERY_MIN, constants::BATTERY_MAX);
+
+        std::stringstream ss;
+        ss << "{"
+            << "\"temperature\":" << std::fixed << std::setprecision(1) << temp(gen) << ","
+            << "\"humidity\":" << std::fixed << std::setprecision(1) << humidity(gen) << ","
+            << "\"pressure\":" << std::fixed << std::setprecision(1) << pressure(gen) << ","
+            << "\"battery\":" << std::fixed << std::setprecision(2) << battery(gen) << ","
+            << "\"timestamp\":\"" << std::chrono::system_clock::now().time_since_epoch().count() << "\""
+            << "}";
+
+        return ss.str();
+    }
+
+}
+
+/**
+ * @brief Payloads/s of the original stringstream + mt19937 generator
+ */
+static void BM_TelemetryLegacy(benchmark::State& state) {
+    for (auto _ : state) {
+        std::string payload = legacyTelemetry();
+        benchmark::DoNotOptimize(payload.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelemetryLegacy);
+
+/**
+ * @brief Payloads/s of TelemetryGenerator, formatting into its own buffer
+ */
+static void BM_TelemetryGenerator(benchmark::State& state) {
+    TelemetryGenerator generator(12345);
+    for (auto _ : state) {
+        auto payload = generator.next();
+        benchmark::DoNotOptimize(payload.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelemetryGenerator);
+
+/**
+ * @brief Payloads/s including the copy into a message payload string
+ */
+static void BM_TelemetryGeneratorToString(benchmark::State& state) {
+    TelemetryGenerator generator(12345);
+    for (auto _ : state) {
+        std::string payload(generator.next());
+        benchmark::DoNotOptimize(payload.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelemetryGeneratorToString);
@@ -0,0 +1,144 @@
+#include "Broker.h"
+#include "Device.h"
+#include "SubscriptionTrie.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace mqtt;
+
+namespace {
+
+    /**
+     * @brief Filters a building-automation deployment typically carries
+     *
+     * Mostly exact per-device topics, plus per-floor and per-kind wildcards,
+     * dashboards on "#" and a few $SYS monitors.
+     */
+    std::vector<std::string> realisticFilters(size_t count) {
+        std::vector<std::string> filters;
+        filters.reserve(count);
+        for (size_t i = 0; filters.size() < count; i++) {
+            std::string building = "b" + std::to_string(i % 8);
+            std::string floor = "floor" + std::to_string(i % 12);
+            std::string room = "room" + std::to_string(i % 40);
+            switch (i % 10) {
+            case 0:
+                filters.push_back("site/" + building + "/" + floor + "/#");
+                break;
+            case 1:
+                filters.push_back("site/+/" + floor + "/+/temperature");
+                break;
+            case 2:
+                filters.push_back("command/device_" + std::to_string(i));
+                break;
+            case 3:
+                filters.push_back(i % 100 == 3 ? "#" : "$SYS/broker/" + std::to_string(i % 5) + "/#");
+                break;
+            default:
+                filters.push_back("site/" + building + "/" + floor + "/" + room + "/humidity");
+                break;
+            }
+        }
+        return filters;
+    }
+
+    std::vector<std::string> realisticTopics() {
+        return {
+            "site/b3/floor7/room15/temperature",
+            "site/b1/floor2/room22/humidity",
+            "site/b5/floor11/room3/co2",
+            "command/device_42",
+            "command/all",
+            "$SYS/broker/2/load",
+            "telemetry/sensor_temp",
+            "site/b0/floor0/room0/humidity",
+        };
+    }
+
+}
+
+/**
+ * @brief Broker::topicMatches over a whole filter set, as a linear scan would
+ */
+static void BM_TopicMatchesLinearScan(benchmark::State& state) {
+    auto filters = realisticFilters(static_cast<size_t>(state.range(0)));
+    auto topics = realisticTopics();
+
+    size_t matches = 0;
+    size_t next = 0;
+    for (auto _ : state) {
+        const std::string& topic = topics[next++ % topics.size()];
+        for (const auto& filter : filters) {
+            matches += Broker::topicMatches(filter, topic);
+        }
+    }
+    benchmark::DoNotOptimize(matches);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(filters.size()));
+    state.counters["topics_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_TopicMatchesLinearScan)->RangeMultiplier(10)->Range(10, 10000);
+
+/**
+ * @brief SubscriptionTrie lookup over the same filter set
+ */
+static void BM_SubscriptionTrieMatch(benchmark::State& state) {
+    auto filters = realisticFilters(static_cast<size_t>(state.range(0)));
+    auto topics = realisticTopics();
+
+    auto broker = std::make_shared<Broker>("bench_broker", 1);
+    std::vector<std::shared_ptr<Device>> subscribers;
+    SubscriptionTrie trie;
+    for (size_t i = 0; i < filters.size(); i++) {
+        // Share devices between filters, like clients with several subscriptions
+        if (i % 4 == 0) {
+            subscribers.push_back(std::make_shared<Device>("bench_device_" + std::to_string(i), broker,
+                std::chrono::milliseconds(0)));
+        }
+        trie.insert(filters[i], subscribers.back());
+    }
+
+    size_t matches = 0;
+    size_t next = 0;
+    for (auto _ : state) {
+        matches += trie.match(topics[next++ % topics.size()]).size();
+    }
+    benchmark::DoNotOptimize(matches);
+    state.counters["topics_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SubscriptionTrieMatch)->RangeMultiplier(10)->Range(10, 10000);
+
+/**
+ * @brief SubscriptionTrie lookup by interned topic handle, as the broker does
+ */
+static void BM_SubscriptionTrieMatchByHandle(benchmark::State& state) {
+    auto filters = realisticFilters(static_cast<size_t>(state.range(0)));
+    std::vector<InternTable::Handle> topics;
+    for (const auto& topic : realisticTopics()) {
+        topics.push_back(InternTable::topics().intern(topic));
+    }
+
+    auto broker = std::make_shared<Broker>("bench_broker", 1);
+    std::vector<std::shared_ptr<Device>> subscribers;
+    SubscriptionTrie trie;
+    for (size_t i = 0; i < filters.size(); i++) {
+        if (i % 4 == 0) {
+            subscribers.push_back(std::make_shared<Device>("bench_device_" + std::to_string(i), broker,
+                std::chrono::milliseconds(0)));
+        }
+        trie.insert(filters[i], subscribers.back());
+    }
+
+    size_t matches = 0;
+    size_t next = 0;
+    for (auto _ : state) {
+        matches += trie.match(topics[next++ % topics.size()]).size();
+    }
+    benchmark::DoNotOptimize(matches);
+    state.counters["topics_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SubscriptionTrieMatchByHandle)->RangeMultiplier(10)->Range(10, 10000);
@@ -0,0 +1,73 @@
+#include "WireCodec.h"
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+using namespace mqtt;
+
+namespace {
+
+    Message makeMessage(size_t payload_size) {
+        Message message("site/b3/floor7/room15/temperature", std::string(payload_size, 'x'), QoS::AT_LEAST_ONCE);
+        message.setContentType("application/json");
+        message.setMessageExpiryInterval(60);
+        message.addUserProperty("unit", "celsius");
+        message.addUserProperty("sensor", "t1");
+        return message;
+    }
+
+}
+
+/**
+ * @brief Serializing a PUBLISH into a reused buffer
+ */
+static void BM_WireEncodePublish(benchmark::State& state) {
+    Message message = makeMessage(static_cast<size_t>(state.range(0)));
+    std::vector<char> buffer(wire::publishSize(message));
+    uint16_t packet_id = 1;
+    for (auto _ : state) {
+        size_t written = wire::encodePublish(message, buffer.data(), buffer.size(), packet_id);
+        benchmark::DoNotOptimize(written);
+        packet_id = static_cast<uint16_t>(packet_id % 65535 + 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(buffer.size()));
+}
+BENCHMARK(BM_WireEncodePublish)->Arg(64)->Arg(4096);
+
+/**
+ * @brief Parsing a PUBLISH into views over the input
+ */
+static void BM_WireDecodePublish(benchmark::State& state) {
+    Message message = makeMessage(static_cast<size_t>(state.range(0)));
+    std::vector<char> buffer(wire::publishSize(message));
+    wire::encodePublish(message, buffer.data(), buffer.size(), 1);
+    std::string_view input(buffer.data(), buffer.size());
+    for (auto _ : state) {
+        wire::PublishView view;
+        auto status = wire::decodePublish(input, view);
+        benchmark::DoNotOptimize(status);
+        benchmark::DoNotOptimize(view);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(buffer.size()));
+}
+BENCHMARK(BM_WireDecodePublish)->Arg(64)->Arg(4096);
+
+/**
+ * @brief Decoding back into a Message, which copies topic, payload and properties
+ */
+static void BM_WireDecodeToMessage(benchmark::State& state) {
+    Message message = makeMessage(static_cast<size_t>(state.range(0)));
+    std::vector<char> buffer(wire::publishSize(message));
+    wire::encodePublish(message, buffer.data(), buffer.size(), 1);
+    std::string_view input(buffer.data(), buffer.size());
+    for (auto _ : state) {
+        wire::PublishView view;
+        wire::decodePublish(input, view);
+        Message decoded = wire::toMessage(view);
+        benchmark::DoNotOptimize(decoded);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WireDecodeToMessage)->Arg(64)->Arg(4096);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Reference-counted, content-addressed byte strings
+     *
+     * Equal contents share one copy behind a 32-bit handle, so a value
+     * stored a million times costs one string plus a counter. A handle
+     * stays valid until its last reference is released, after which the
+     * slot is reused.
+     *
+     * Not thread-safe; the owner serializes access.
+     */
+    class BlobPool {
+    public:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        BlobPool() = default;
+        BlobPool(const BlobPool&) = delete;
+        BlobPool& operator=(const BlobPool&) = delete;
+
+        // Handle for these bytes, adding a reference
+        uint32_t acquire(std::string_view bytes);
+
+        // Another reference to an existing handle
+        void retain(uint32_t handle);
+
+        // Drop a reference; the bytes are freed with the last one
+        void release(uint32_t handle);
+
+        std::string_view get(uint32_t handle) const {
+            return slots[handle].bytes;
+        }
+
+        // Distinct contents currently held
+        size_t size() const;
+
+        // Bytes of content held, each distinct value counted once
+        size_t contentBytes() const;
+
+        // Estimated heap use: slots, string storage and the content index
+        size_t memoryBytes() const;
+
+    private:
+        struct Slot {
+            std::string bytes;
+            uint32_t references = 0;
+        };
+
+        // A deque never moves its elements, so index keys can view slot strings
+        std::deque<Slot> slots;
+        std::vector<uint32_t> free_slots;
+        std::unordered_map<std::string_view, uint32_t> index;
+        size_t content_bytes = 0;
+        size_t string_heap_bytes = 0;
+    };
+
+} // namespace mqtt
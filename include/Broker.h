@@ -2,14 +2,24 @@
 
 #include "Message.h"
 #include "Constants.h"
+#include "SubscriptionTrie.h"
+#include "RetainedStore.h"
+#include "PersistentLog.h"
+#include "MpscQueue.h"
+#include "HistoryBuffer.h"
+#include "LatencyTracker.h"
+#include "MetricsRegistry.h"
+#include "Scheduler.h"
 #include <string>
-#include <map>
 #include <vector>
-#include <queue>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
 #include <thread>
 #include <atomic>
+#include <functional>
 #include <memory>
+#include <set>
 
 namespace mqtt {
 
@@ -21,10 +31,27 @@ namespace mqtt {
      */
     class Broker {
     public:
+        /**
+         * @brief Publish path counters
+         */
+        struct IngressStats {
+            uint64_t published = 0;           // Messages accepted by publish()
+            uint64_t contended_publishes = 0; // Ingress slot claims lost to another publisher
+            uint64_t full_waits = 0;          // Times a publisher found the ingress ring full
+            uint64_t dispatcher_wakeups = 0;  // Times a publisher had to wake a dispatcher
+            size_t queue_depth = 0;           // Messages waiting for dispatch
+        };
+
         /**
          * @brief Construct a new Broker object
+         *
+         * @param id Broker identifier
+         * @param dispatch_threads Number of dispatch shards, 0 for one per hardware thread
+         * @param delivery_threads Workers running subscriber handlers, 0 for one per hardware thread
          */
-        explicit Broker(const std::string& id);
+        explicit Broker(const std::string& id,
+            size_t dispatch_threads = mqtt::constants::BROKER_DEFAULT_DISPATCH_THREADS,
+            size_t delivery_threads = mqtt::constants::BROKER_DEFAULT_DELIVERY_THREADS);
 
         /**
          * @brief Destroy the Broker object
@@ -38,33 +65,139 @@ namespace mqtt {
         Broker& operator=(Broker&&) = delete;
 
         // Manage subscirptions 
-        void subscribe(const std::string& topic, std::shared_ptr<Device> device);
+        void subscribe(const std::string& topic, std::shared_ptr<Device> device, bool replay_retained = true);
         void unsubscribe(const std::string& topic, std::shared_ptr<Device> device);
 
-        // Handle messages
+        // Deliver the retained messages matching a filter, as a new subscription does
+        void replayRetained(const std::string& topic, const std::shared_ptr<Device>& device);
+
+        // Handle messages (lock-free unless the ingress ring is full)
         void publish(const Message& message);
 
         // Accessors
-        const std::vector<Message>& getMessageHistory() const;
+        std::vector<Message> getMessageHistory() const;
+        uint64_t getMessageHistoryVersion() const;
         const std::string& getId() const;
+        IngressStats getIngressStats() const;
+        size_t getDispatchThreadCount() const;
+        RetainedStore::MemoryUsage getRetainedMemoryUsage() const;
+
+        // Delivery latency, recorded by subscribing devices
+        std::shared_ptr<LatencyTracker> getLatencyTracker() const;
+
+        // Hot-path counters and gauges
+        const MetricsRegistry& getMetrics() const;
+
+        // Configuration
+        void setHistoryCapacity(size_t capacity);
+
+        /**
+         * @brief Keep retained messages and subscriptions in a log under directory
+         *
+         * Replays whatever the log already holds, so call it before anything
+         * is published or subscribed. Subscriptions are kept per client id
+         * and taken up again by Device::restoreSubscriptions.
+         *
+         * @return False with a description in error if the log cannot be opened
+         */
+        bool enablePersistence(const std::string& directory, std::string& error);
+
+        // Filters the log holds for a client; empty without persistence
+        std::vector<std::string> getPersistedSubscriptions(const std::string& client_id) const;
+
+        // Rewrite the log to the live state now on the calling thread, after any compaction already running
+        bool compactLog();
+
+        // Zero without persistence
+        PersistentLog::Stats getLogStats() const;
+
+        // Visit every retained message under the broker lock
+        void forEachRetained(const std::function<void(const Message&)>& visit) const;
+
+        // Store (and log) a retained message without dispatching it to subscribers
+        void restoreRetained(const Message& message);
+
+        /**
+         * @brief Check a topic against a subscription filter
+         *
+         * Supports single-level (+) and multi-level (#) wildcards.
+         */
+        static bool topicMatches(const std::string& subscription, const std::string& topic);
 
     private:
-        void processMessages();
+        /**
+         * @brief One dispatch worker and the ingress ring it drains
+         *
+         * Every topic maps to exactly one shard by its interned handle, or by
+         * a hash of the string for a topic without one, which keeps per-topic
+         * delivery order while different topics fan out in parallel.
+         */
+        struct DispatchShard {
+            explicit DispatchShard(size_t capacity);
+
+            MpscQueue<Message> message_queue;
+            std::mutex wake_mutex;
+            std::condition_variable message_condition;
+            std::atomic<bool> dispatcher_idle;
+            std::atomic<uint64_t> dispatcher_wakeups;
+            std::thread processing_thread;
+        };
+
+        DispatchShard& shardFor(const Message& message);
+        void processMessages(DispatchShard& shard);
         void distributeMessage(const Message& message);
-        bool topicMatches(const std::string& subscription, const std::string& topic);
+        void deliverTo(const std::shared_ptr<Device>& device, const Message& message);
+
+        // Run a device's queued handlers on a delivery worker, a batch at a time
+        void scheduleDrain(const std::shared_ptr<Device>& device);
+
+        // Called under mutex after each append; starts compacting a log that has grown enough
+        void afterLogAppend();
+
+        // Fill a compaction from the live state a chunk at a time, then commit it
+        // without the broker lock; clears compacting when done
+        bool writeCompaction(std::unique_ptr<PersistentLog::Compaction> compaction);
 
     private:
         std::string broker_id;
-        std::map<std::string, std::vector<std::weak_ptr<Device>>> topic_subscriptions;
-        std::map<std::string, Message> retained_messages;
-        std::queue<Message> message_queue;
-        std::mutex mutex;
-        std::thread processing_thread;
+
+        // Registered before anything that updates them
+        MetricsRegistry metrics;
+        ShardedCounter& publishes_metric;
+        ShardedCounter& deliveries_metric;
+        ShardedCounter& drops_metric;
+        ShardedCounter& subscriber_drops_metric;
+        ShardedCounter& subscriber_blocks_metric;
+        ShardedCounter& subscriber_disconnects_metric;
+        DurationCounter& match_time_metric;
+        DurationCounter& lock_wait_metric;
+
+        SubscriptionTrie subscriptions;
+        std::shared_mutex subscription_mutex;
+
+        // Guards retained messages and persistence
+        RetainedStore retained_messages;
+        std::unique_ptr<PersistentLog> persistent_log;
+        std::set<PersistentLog::Subscription> persisted_subscriptions;
+        bool compacting = false;
+        std::condition_variable compaction_done;
+        mutable std::mutex mutex;
+
+        // Runs the compactions started by afterLogAppend, off the dispatch threads
+        std::thread compaction_thread;
+
+        // Dispatch workers
+        std::vector<std::unique_ptr<DispatchShard>> shards;
         std::atomic<bool> running;
 
+        // Drain tasks for subscriber queues, so handlers never run on a dispatcher
+        std::unique_ptr<Scheduler> delivery_workers;
+
         // For visualization
-        std::vector<Message> message_history;
-        const size_t MAX_HISTORY_SIZE = mqtt::constants::BROKER_MESSAGE_HISTORY_SIZE;
+        HistoryBuffer<Message> message_history;
+
+        // Shared with devices so they can record after the broker is gone
+        std::shared_ptr<LatencyTracker> latency_tracker;
     };
 
 } // namespace mqtt
\ No newline at end of file
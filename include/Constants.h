@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <chrono>
 
 namespace mqtt {
@@ -20,21 +21,192 @@ namespace mqtt {
         // Message history settings
         //-------------------------------------------------------------------------
 
-        // Maximum number of messages to keep in broker history
+        // Default number of messages to keep in broker history
         constexpr size_t BROKER_MESSAGE_HISTORY_SIZE = 100;
 
-        // Maximum number of messages to keep in device history
+        // Default number of messages to keep in device history
         constexpr size_t DEVICE_MESSAGE_HISTORY_SIZE = 50;
 
         // Maximum number of messages to display in visualization
         constexpr size_t MAX_DISPLAYED_MESSAGES = 20;
 
         //-------------------------------------------------------------------------
-        // Thread timing constants
+        // Broker settings
+        //-------------------------------------------------------------------------
+
+        // Slots in the broker's publish rings, split across dispatch shards
+        constexpr size_t BROKER_INGRESS_QUEUE_CAPACITY = 16384;
+
+        // Smallest publish ring a single dispatch shard gets
+        constexpr size_t BROKER_MIN_SHARD_QUEUE_CAPACITY = 1024;
+
+        // Dispatch threads per broker (0 = one per hardware thread)
+        constexpr size_t BROKER_DEFAULT_DISPATCH_THREADS = 0;
+
+        // Subscribers of one filter checked by a plain scan before they get a position index
+        constexpr size_t SUBSCRIBER_SCAN_LIMIT = 8;
+
+        // Lock shards of each string intern table
+        constexpr size_t INTERN_TABLE_SHARDS = 64;
+
+        // Recent intern results each thread remembers, across all tables
+        constexpr size_t INTERN_THREAD_CACHE_SIZE = 1024;
+
+        // Retained messages replayed to a new subscriber per hold of the broker lock
+        constexpr size_t BROKER_RETAINED_REPLAY_CHUNK = 256;
+
+        // Retained messages a store keeps built for replay, so repeated replays share their bodies
+        constexpr size_t RETAINED_REPLAY_CACHE_SIZE = 4096;
+
+        //-------------------------------------------------------------------------
+        // Delivery queue settings
+        //-------------------------------------------------------------------------
+
+        // Deliveries a device may have waiting for its handlers before its overflow policy applies
+        constexpr size_t DEVICE_DELIVERY_QUEUE_CAPACITY = 1024;
+
+        // Longest a dispatcher waits for room under the block policy before dropping
+        constexpr int DEVICE_BLOCK_TIMEOUT_MS = 1000;
+
+        // Deliveries one drain task handles before yielding its worker to other devices
+        constexpr size_t DEVICE_DRAIN_BATCH = 64;
+
+        // Workers running subscriber handlers per broker (0 = one per hardware thread)
+        constexpr size_t BROKER_DEFAULT_DELIVERY_THREADS = 0;
+
+        //-------------------------------------------------------------------------
+        // Persistence settings
+        //-------------------------------------------------------------------------
+
+        // Size at which the log starts a new segment file
+        constexpr size_t LOG_SEGMENT_BYTES = 64 * 1024 * 1024;
+
+        // Log size below which compaction never runs
+        constexpr size_t LOG_COMPACT_MIN_BYTES = 16 * 1024 * 1024;
+
+        // Compact once the log is this many times the size of the live state it last held
+        constexpr size_t LOG_COMPACT_RATIO = 3;
+
+        // File written by the "Save Snapshot" button
+        constexpr char SNAPSHOT_DEFAULT_FILE[] = "mqttsim_snapshot.bin";
+
+        //-------------------------------------------------------------------------
+        // Metrics settings
+        //-------------------------------------------------------------------------
+
+        // Per-thread shards in each metrics counter
+        constexpr size_t METRICS_COUNTER_SHARDS = 16;
+
+        // File written by the "Dump Metrics" button
+        constexpr char METRICS_DEFAULT_FILE[] = "mqttsim_metrics.prom";
+
+        // How often a headless run rewrites its metrics file
+        constexpr int METRICS_DUMP_INTERVAL_MS = 1000;
+
+        // How often the overview panel re-reads the metrics; gauges may take broker locks
+        constexpr int METRICS_PANEL_REFRESH_MS = 1000;
+
+        //-------------------------------------------------------------------------
+        // TCP listener settings
+        //-------------------------------------------------------------------------
+
+        // Address the listener binds to unless told otherwise
+        constexpr char LISTENER_DEFAULT_ADDRESS[] = "127.0.0.1";
+
+        // Connections the kernel queues before they are accepted
+        constexpr int LISTENER_BACKLOG = 4096;
+
+        // Socket events handled per epoll_wait call
+        constexpr int LISTENER_MAX_EVENTS = 256;
+
+        // Bytes read from a socket per call
+        constexpr size_t LISTENER_READ_CHUNK = 16384;
+
+        // Largest packet accepted from a client, advertised in CONNACK
+        constexpr size_t LISTENER_MAX_PACKET_SIZE = 1024 * 1024;
+
+        // Unsent bytes queued for a client before further deliveries to it are dropped
+        constexpr size_t LISTENER_MAX_OUTBOUND_BYTES = 8 * 1024 * 1024;
+
+        // How often keep-alive and CONNECT deadlines are checked
+        constexpr int LISTENER_SWEEP_INTERVAL_MS = 500;
+
+        // Time a new connection has to send CONNECT
+        constexpr int LISTENER_CONNECT_TIMEOUT_MS = 10000;
+
+        //-------------------------------------------------------------------------
+        // QoS flow settings
         //-------------------------------------------------------------------------
 
-        // Interval between message processing cycles in broker
-        constexpr int MESSAGE_PROCESSING_INTERVAL_MS = 10;
+        // Unacknowledged QoS 1/2 deliveries per session, further capped by the client's Receive Maximum
+        constexpr uint16_t QOS_MAX_SEND_WINDOW = 64;
+
+        // Incoming QoS 1/2 PUBLISHes a client may have unacknowledged, advertised in CONNACK
+        constexpr uint16_t QOS_RECEIVE_MAXIMUM = 64;
+
+        // QoS 1/2 deliveries queued per session while its window is full
+        constexpr size_t QOS_MAX_PENDING = 1024;
+
+        // Unacknowledged PUBLISH or PUBREL age before it is sent again
+        constexpr int QOS_RETRY_INTERVAL_MS = 5000;
+
+        //-------------------------------------------------------------------------
+        // Load generator settings
+        //-------------------------------------------------------------------------
+
+        // epoll threads sharing the virtual devices' connections
+        constexpr size_t LOADGEN_DEFAULT_THREADS = 2;
+
+        // Virtual device client ids are this prefix plus a number
+        constexpr char LOADGEN_CLIENT_ID_PREFIX[] = "loadgen-";
+
+        // Keep-alive requested in CONNECT; a PINGREQ goes out after half of it idle
+        constexpr uint16_t LOADGEN_KEEP_ALIVE_S = 60;
+
+        // Unacknowledged publishes per connection, further capped by the broker's Receive Maximum
+        constexpr size_t LOADGEN_MAX_IN_FLIGHT = 32;
+
+        // Unsent bytes per connection before back-to-back publishing pauses
+        constexpr size_t LOADGEN_MAX_OUTBOUND_BYTES = 64 * 1024;
+
+        // Time a connection has to reach CONNACK
+        constexpr int LOADGEN_CONNECT_TIMEOUT_MS = 10000;
+
+        //-------------------------------------------------------------------------
+        // Scheduler settings
+        //-------------------------------------------------------------------------
+
+        // Timer wheel resolution
+        constexpr int SCHEDULER_TICK_MS = 1;
+
+        // Timer callback threads (0 = one per hardware thread)
+        constexpr size_t SCHEDULER_DEFAULT_WORKER_THREADS = 0;
+
+        //-------------------------------------------------------------------------
+        // Headless run settings
+        //-------------------------------------------------------------------------
+
+        // Run length when neither a duration nor a message count is given
+        constexpr int HEADLESS_DEFAULT_DURATION_S = 10;
+
+        // Simulated devices in a headless run
+        constexpr size_t HEADLESS_DEFAULT_DEVICES = 100;
+
+        // Threads publishing back-to-back on top of device telemetry
+        constexpr size_t HEADLESS_DEFAULT_PUBLISHERS = 0;
+
+        // Latency samples kept for percentile reporting
+        constexpr size_t HEADLESS_LATENCY_SAMPLES = 100000;
+
+        // Topics given their own latency histograms before folding into "(other)"
+        constexpr size_t LATENCY_MAX_TRACKED_TOPICS = 128;
+
+        // Topic rows shown in the latency panel
+        constexpr size_t LATENCY_PANEL_TOPIC_ROWS = 10;
+
+        //-------------------------------------------------------------------------
+        // Thread timing constants
+        //-------------------------------------------------------------------------
 
         // Random variation range for telemetry timing
         constexpr int TELEMETRY_RANDOM_MIN_MS = 100;
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Message.h"
+#include "Constants.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace mqtt {
+
+    /**
+     * @brief What a subscriber's full delivery queue does with the next message
+     */
+    enum class OverflowPolicy {
+        DropOldest, // Discard the oldest queued message to make room
+        DropNewest, // Discard the incoming message
+        Block,      // Hold up the delivering dispatcher, and so its whole shard, until there is room, then drop
+        Disconnect  // Discard the message and cut the subscriber off
+    };
+
+    // Command-line name of a policy, e.g. "drop-oldest"
+    const char* overflowPolicyName(OverflowPolicy policy);
+
+    // False if name is not one of the command-line names
+    bool parseOverflowPolicy(const std::string& name, OverflowPolicy& policy);
+
+    /**
+     * @brief Bounded queue of deliveries waiting for one subscriber's handlers
+     *
+     * Dispatchers only enqueue; the policy applies there, so a slow
+     * subscriber never runs its handlers on a dispatch thread. The push
+     * that finds the queue idle tells its caller to schedule a drain task,
+     * which pops batches on a delivery worker until the queue is empty.
+     * At most one drain runs at a time, so handlers never run concurrently.
+     *
+     * Block waits at most DEVICE_BLOCK_TIMEOUT_MS and then drops, so a
+     * handler publishing into a stalled shard cannot deadlock the broker.
+     * It is not backpressure on publishers: every other topic of the
+     * dispatcher's shard waits too, up to that timeout per message.
+     */
+    class DeliveryQueue {
+    public:
+        enum class Admission {
+            Accepted,      // Queued for the drain task
+            Waited,        // Accepted after blocking for room
+            DroppedOldest, // Accepted in place of the oldest queued message
+            DroppedNewest, // Discarded
+            Disconnected   // Discarded; the subscriber must now be disconnected
+        };
+
+        /**
+         * @brief Overflow counters and queue depth
+         */
+        struct Stats {
+            uint64_t dropped = 0;      // Messages discarded by any policy
+            uint64_t blocked = 0;      // Deliveries accepted after waiting for room
+            size_t depth = 0;          // Messages waiting now
+            size_t high_water = 0;     // Deepest the queue has been
+            bool disconnected = false; // Disconnect policy has fired
+        };
+
+        /**
+         * @brief Construct an empty queue
+         *
+         * @param capacity Messages that may wait, at least 1
+         */
+        explicit DeliveryQueue(size_t capacity = mqtt::constants::DEVICE_DELIVERY_QUEUE_CAPACITY,
+            OverflowPolicy policy = OverflowPolicy::DropOldest);
+
+        DeliveryQueue(const DeliveryQueue&) = delete;
+        DeliveryQueue& operator=(const DeliveryQueue&) = delete;
+
+        /**
+         * @brief Offer a delivery
+         *
+         * @param schedule Set when the queue was idle: the caller must now
+         *        schedule a drain task, which calls pop() and endBatch()
+         */
+        Admission push(const Message& message, bool& schedule);
+
+        /**
+         * @brief Take the next queued message, as the drain task
+         *
+         * @return Nothing once the queue is empty, which ends draining
+         */
+        std::optional<Message> pop();
+
+        /**
+         * @brief Hand back the worker after a batch of pop() calls
+         *
+         * @return True if messages remain; the caller still owns draining
+         *         and must schedule another drain task
+         */
+        bool endBatch();
+
+        // Wait until nothing is queued and no drain task is pending or running
+        bool waitIdle(std::chrono::milliseconds timeout);
+
+        // Change the bound and policy and clear a disconnect; queued messages are kept
+        void configure(size_t capacity, OverflowPolicy policy);
+
+        Stats getStats() const;
+        size_t getCapacity() const;
+        OverflowPolicy getPolicy() const;
+
+    private:
+        mutable std::mutex mutex;
+        std::condition_variable space_condition; // Room freed or draining ended
+        std::deque<Message> queue;
+        size_t capacity;
+        OverflowPolicy policy;
+
+        bool draining = false;   // A drain task is scheduled or running
+        std::thread::id drainer; // Thread running the current batch
+        size_t waiters = 0;      // Threads blocked in push() or waitIdle()
+
+        Stats stats;
+    };
+
+} // namespace mqtt
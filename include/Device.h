@@ -2,20 +2,24 @@
 
 #include "Message.h"
 #include "Constants.h"
+#include "HistoryBuffer.h"
+#include "DeliveryQueue.h"
+#include "Scheduler.h"
+#include "TelemetryGenerator.h"
 #include <string>
 #include <vector>
-#include <queue>
 #include <mutex>
-#include <thread>
 #include <atomic>
 #include <chrono>
 #include <memory>
 #include <functional>
+#include <optional>
 
 namespace mqtt {
 
-    // Forward declaration
+    // Forward declarations
     class Broker;
+    class LatencyTracker;
 
     /**
      * @brief MQTT Client Device class
@@ -24,10 +28,15 @@ namespace mqtt {
     public:
         /**
          * @brief Construct Device object
+         *
+         * @param interval Base telemetry interval, 0 or less disables telemetry
+         * @param transient Leave the id and exact filters out of the process-wide
+         *        intern tables, for devices that come and go with network clients
          */
         Device(const std::string& id,
             std::shared_ptr<Broker> broker,
-            std::chrono::milliseconds interval = std::chrono::milliseconds(mqtt::constants::GATEWAY_INTERVAL_MS));
+            std::chrono::milliseconds interval = std::chrono::milliseconds(mqtt::constants::GATEWAY_INTERVAL_MS),
+            bool transient = false);
 
         /**
          * @brief Destroy Device object
@@ -40,46 +49,104 @@ namespace mqtt {
         Device(Device&&) = delete;
         Device& operator=(Device&&) = delete;
 
-        // MQTT operations
-        void subscribe(const std::string& topic);
+        // MQTT operations; replay_retained false skips the retained messages the filter matches
+        void subscribe(const std::string& topic, bool replay_retained = true);
         void unsubscribe(const std::string& topic);
+
+        // Subscribe again to what the broker's persistence log holds for this id
+        void restoreSubscriptions();
         void publish(const std::string& topic,
             const std::string& payload,
             QoS qos = QoS::AT_MOST_ONCE,
             bool retained = false);
-        void receiveMessage(const Message& message);
+
+        // Same, for a topic from InternTable::topics(); the payload is copied once, into the message
+        void publish(InternTable::Handle topic,
+            std::string_view payload,
+            QoS qos = QoS::AT_MOST_ONCE,
+            bool retained = false);
+
+        /**
+         * @brief Queue a message for this device's handlers
+         *
+         * Applies the overflow policy when the queue is full; never runs
+         * the handlers on the calling thread.
+         *
+         * @param schedule Set when the caller must schedule drainDeliveries()
+         */
+        DeliveryQueue::Admission receiveMessage(const Message& message, bool& schedule);
+
+        /**
+         * @brief Run the handlers for up to DEVICE_DRAIN_BATCH queued messages
+         *
+         * @return True if messages remain and another drain must be scheduled
+         */
+        bool drainDeliveries();
+
+        // Wait until every queued delivery has been handled
+        bool waitForDeliveries(std::chrono::milliseconds timeout);
 
         // Message handling
         void addMessageHandler(std::function<void(const Message&)> handler);
 
         // Accessors
         const std::string& getId() const;
-        const std::vector<Message>& getMessageHistory() const;
-        const std::vector<std::string>& getSubscribedTopics() const;
+        InternTable::Handle getHandle() const; // The id in InternTable::clients(); EMPTY for a transient id not in it
+        std::vector<Message> getMessageHistory() const;
+        std::optional<Message> getLastMessage() const;
+        std::vector<std::string> getSubscribedTopics() const;
+        DeliveryQueue::Stats getDeliveryStats() const;
+        std::chrono::milliseconds getTelemetryInterval() const;
+        size_t getHistoryCapacity() const;
+        size_t getDeliveryCapacity() const;
+        OverflowPolicy getOverflowPolicy() const;
 
-        // Configuration
+        // Configuration (0 or less stops telemetry)
         void setTelemetryInterval(std::chrono::milliseconds interval);
+        void setHistoryCapacity(size_t capacity);
+
+        // Bound on waiting deliveries and what happens beyond it; also re-enables a disconnected device
+        void setDeliveryQueue(size_t capacity, OverflowPolicy policy);
 
     private:
-        void generateTelemetry();
-        std::string generateRandomTelemetry();
+        void send(Message& message);
+        void handleMessage(Message& message);
+
+        // Drop every subscription after the disconnect overflow policy fired
+        void disconnect();
+
+        // All three run under telemetry_mutex except the publish in generateTelemetry
+        void startTelemetry();
+        std::chrono::milliseconds generateTelemetry(uint64_t generation);
+        std::chrono::milliseconds nextTelemetryDelay();
 
     private:
         std::string device_id;
+        bool transient;
+        InternTable::Handle handle;
         std::weak_ptr<Broker> broker;
         std::vector<std::string> subscribed_topics;
-        std::queue<Message> received_messages;
-        std::mutex mutex;
-        std::vector<std::function<void(const Message&)>> message_handlers;
+        mutable std::mutex mutex;
+
+        // Handlers are replaced as a whole so deliveries can run them unlocked
+        using HandlerList = std::vector<std::function<void(const Message&)>>;
+        std::shared_ptr<const HandlerList> message_handlers;
+
+        // Deliveries waiting for a drain task to run the handlers
+        DeliveryQueue delivery_queue;
 
-        // For telemetry simulation
-        std::thread telemetry_thread;
-        std::atomic<bool> running;
-        std::chrono::milliseconds telemetry_interval;
+        // For telemetry simulation, run on the shared scheduler; telemetry_mutex
+        // guards the timer, the generation and the generator
+        Scheduler::Handle telemetry_timer;
+        std::mutex telemetry_mutex;
+        uint64_t telemetry_generation = 0; // Bumped to retire the current timer
+        std::atomic<std::chrono::milliseconds> telemetry_interval;
+        InternTable::Handle telemetry_topic = InternTable::EMPTY; // Interned once telemetry first starts
+        TelemetryGenerator telemetry_generator;
 
         // For visualization
-        std::vector<Message> message_history;
-        const size_t MAX_HISTORY_SIZE = mqtt::constants::DEVICE_MESSAGE_HISTORY_SIZE;
+        HistoryBuffer<Message> message_history;
+        std::shared_ptr<LatencyTracker> latency_tracker;
     };
 
 } // namespace mqtt
\ No newline at end of file
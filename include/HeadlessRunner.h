@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Broker.h"
+#include "Device.h"
+#include "Constants.h"
+#include "TcpListener.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Settings for a simulation run without GLFW/ImGui
+     */
+    struct HeadlessOptions {
+        bool enabled = false;                   // --headless
+        std::chrono::milliseconds duration{ 0 }; // --duration <seconds>, 0 = no limit
+        uint64_t message_limit = 0;             // --messages <count>, 0 = no limit
+        size_t device_count = mqtt::constants::HEADLESS_DEFAULT_DEVICES;    // --devices <count>
+        std::chrono::milliseconds telemetry_interval{ mqtt::constants::DEFAULT_TELEMETRY_INTERVAL_MS }; // --interval <ms>
+        size_t publisher_threads = mqtt::constants::HEADLESS_DEFAULT_PUBLISHERS; // --publishers <count>
+        size_t dispatch_threads = mqtt::constants::BROKER_DEFAULT_DISPATCH_THREADS; // --dispatch-threads <count>
+        std::string metrics_file;               // --metrics-file <path>, empty = no dump
+        MetricsFormat metrics_format = MetricsFormat::Prometheus; // --metrics-format prometheus|json
+        uint16_t listen_port = 0;               // --listen <port>, 0 = no TCP listener
+        std::string listen_address = mqtt::constants::LISTENER_DEFAULT_ADDRESS; // --listen-address <ip>
+        std::string load_host;                  // --load <host:port>, empty = in-process run
+        uint16_t load_port = 0;
+        size_t load_threads = mqtt::constants::LOADGEN_DEFAULT_THREADS; // --load-threads <count>
+        QoS load_qos = QoS::AT_LEAST_ONCE;      // --qos <0|1|2>
+        size_t queue_capacity = mqtt::constants::DEVICE_DELIVERY_QUEUE_CAPACITY; // --queue-capacity <count>
+        OverflowPolicy overflow_policy = OverflowPolicy::DropOldest; // --overflow <policy>
+        std::string data_dir;                   // --data-dir <path>, empty = nothing persisted
+        std::string snapshot_file;              // --snapshot <path>, devices and retained state to start from
+        std::string save_snapshot_file;         // --save-snapshot <path>, written when a headless run ends
+        bool show_help = false;                 // --help
+
+        /**
+         * @brief Read options from the command line
+         *
+         * Unknown arguments are an error, and so is any option but --snapshot
+         * without --headless or --load, since the graphical simulator would
+         * ignore it. A headless run without a duration or message limit gets
+         * the default duration.
+         *
+         * @return False with a description in error if parsing failed
+         */
+        bool parse(int argc, const char* const* argv, std::string& error);
+
+        // Command-line usage text
+        static const char* usage();
+    };
+
+    /**
+     * @brief Results of a headless run
+     */
+    struct HeadlessReport {
+        size_t devices = 0;      // Simulated devices, excluding the sink
+        std::chrono::duration<double> elapsed{ 0 };
+        uint64_t published = 0;  // Messages accepted by the broker
+        uint64_t delivered = 0;  // Telemetry messages received by the sink
+        double throughput = 0;   // Delivered messages per second
+
+        // Publish-to-receive latency from the message trace, in microseconds
+        int64_t latency_p50_us = 0;
+        int64_t latency_p99_us = 0;
+        int64_t latency_max_us = 0;
+
+        // Subscriber queue overflows
+        uint64_t overflow_dropped = 0;
+        uint64_t overflow_blocked = 0;
+        uint64_t overflow_disconnects = 0;
+
+        // MQTT clients served over TCP, when listening
+        TcpListener::Stats network;
+
+        // Persistence log, with a data directory
+        PersistentLog::Stats log;
+
+        // Time to restore the devices from --snapshot, and whether --save-snapshot was written
+        std::chrono::microseconds snapshot_load_time{ 0 };
+        bool snapshot_saved = false;
+    };
+
+    /**
+     * @brief Runs a broker and simulated devices for a fixed duration or
+     *        message count and measures delivery throughput and latency
+     *
+     * Devices publish telemetry on their normal schedule; optional
+     * publisher threads additionally publish back-to-back on the devices'
+     * behalf to load the broker. A sink device subscribed to all telemetry
+     * measures what is delivered. With a listen port, MQTT clients can
+     * connect over TCP and join in.
+     */
+    class HeadlessRunner {
+    public:
+        explicit HeadlessRunner(const HeadlessOptions& options);
+        ~HeadlessRunner();
+
+        HeadlessRunner(const HeadlessRunner&) = delete;
+        HeadlessRunner& operator=(const HeadlessRunner&) = delete;
+
+        HeadlessReport run();
+
+        static void printReport(const HeadlessOptions& options, const HeadlessReport& report, std::ostream& out);
+
+        // Broker metrics, for dumps during and after a run
+        const MetricsRegistry& getMetrics() const;
+
+    private:
+        void recordDelivery(const Message& message);
+        void dumpMetrics() const;
+        bool limitReached(std::chrono::steady_clock::time_point start) const;
+        void publishLoop(size_t publisher_index);
+
+    private:
+        HeadlessOptions options;
+        std::shared_ptr<Broker> broker;
+        std::vector<std::shared_ptr<Device>> devices;
+        std::shared_ptr<Device> sink;
+        std::unique_ptr<TcpListener> listener;
+        std::atomic<bool> stopping{ false };
+        std::chrono::microseconds snapshot_load_time{ 0 };
+
+        // Latency samples, kept to a bounded uniform reservoir
+        std::atomic<uint64_t> delivered{ 0 };
+        std::mutex sample_mutex;
+        std::vector<int64_t> latency_samples;
+        int64_t latency_max_us = 0;
+        std::mt19937_64 sample_generator;
+    };
+
+} // namespace mqtt
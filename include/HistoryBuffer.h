@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Fixed-capacity circular history of values
+     *
+     * Appending to a full buffer overwrites the oldest element in place,
+     * in O(1) and without allocating. Writers serialize on an internal
+     * mutex. Each slot has a lock of its own, held by a writer only to
+     * swap one element in and by a reader only to copy one out, so a
+     * reader taking a snapshot holds up a writer for at most one element
+     * copy. Every slot records the write count it was filled at, which
+     * lets a reader drop any element overwritten while it copied.
+     */
+    template <typename T>
+    class HistoryBuffer {
+    public:
+        explicit HistoryBuffer(size_t capacity)
+            : storage(std::make_unique<Storage>(capacity)) {
+        }
+
+        HistoryBuffer(const HistoryBuffer&) = delete;
+        HistoryBuffer& operator=(const HistoryBuffer&) = delete;
+
+        /**
+         * @brief Append an element, dropping the oldest one when full
+         */
+        void push_back(T value) {
+            std::lock_guard<std::mutex> lock(writer_mutex);
+            Storage& current = *storage; // Only replaced under writer_mutex
+            if (current.capacity == 0) {
+                return;
+            }
+            uint64_t head = current.head.load(std::memory_order_relaxed);
+            Slot& slot = current.slots[head % current.capacity];
+            {
+                std::lock_guard<std::mutex> slot_lock(slot.mutex);
+                std::swap(slot.value, value);
+                slot.sequence = head;
+            }
+            current.head.store(head + 1, std::memory_order_release);
+            version_counter.fetch_add(1, std::memory_order_release);
+            // The overwritten element is destroyed here, outside the slot lock
+        }
+
+        /**
+         * @brief Change the capacity, keeping the newest elements
+         */
+        void setCapacity(size_t capacity) {
+            std::lock_guard<std::mutex> lock(writer_mutex);
+            auto resized = std::make_unique<Storage>(capacity);
+            auto kept = collect(*storage);
+            size_t skip = kept.size() > capacity ? kept.size() - capacity : 0;
+            for (size_t i = skip; i < kept.size(); i++) {
+                resized->slots[i - skip].value = std::move(kept[i]);
+                resized->slots[i - skip].sequence = i - skip;
+            }
+            resized->head.store(kept.size() - skip, std::memory_order_relaxed);
+            {
+                std::unique_lock<std::shared_mutex> swap_lock(storage_mutex);
+                storage.swap(resized);
+            }
+            version_counter.fetch_add(1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Consistent copy of the history, oldest element first
+         *
+         * Elements overwritten during the copy are left out, so the result
+         * is always a contiguous run of the history.
+         */
+        std::vector<T> snapshot() const {
+            std::shared_lock<std::shared_mutex> lock(storage_mutex);
+            return collect(*storage);
+        }
+
+        /**
+         * @brief Most recently appended element, if any
+         */
+        std::optional<T> latest() const {
+            std::shared_lock<std::shared_mutex> lock(storage_mutex);
+            const Storage& current = *storage;
+            uint64_t head = current.head.load(std::memory_order_acquire);
+            if (head == 0 || current.capacity == 0) {
+                return std::nullopt;
+            }
+
+            // A newer element may have replaced it meanwhile, which is as good
+            Slot& slot = current.slots[(head - 1) % current.capacity];
+            std::lock_guard<std::mutex> slot_lock(slot.mutex);
+            return std::optional<T>(slot.value);
+        }
+
+        size_t size() const {
+            std::shared_lock<std::shared_mutex> lock(storage_mutex);
+            return static_cast<size_t>(std::min<uint64_t>(
+                storage->head.load(std::memory_order_acquire), storage->capacity));
+        }
+
+        size_t capacity() const {
+            std::shared_lock<std::shared_mutex> lock(storage_mutex);
+            return storage->capacity;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        /**
+         * @brief Changes whenever the contents change
+         *
+         * Lets readers skip taking a new snapshot when nothing was written.
+         */
+        uint64_t version() const {
+            return version_counter.load(std::memory_order_acquire);
+        }
+
+    private:
+        struct Slot {
+            std::mutex mutex;
+            uint64_t sequence = 0; // Write count this slot was filled at
+            T value{};
+        };
+
+        struct Storage {
+            explicit Storage(size_t capacity)
+                : slots(std::make_unique<Slot[]>(capacity)),
+                capacity(capacity) {
+            }
+
+            std::unique_ptr<Slot[]> slots;
+            size_t capacity;
+            std::atomic<uint64_t> head{ 0 }; // Elements written
+        };
+
+        static std::vector<T> collect(const Storage& current) {
+            std::vector<T> elements;
+            const uint64_t capacity = current.capacity;
+            if (capacity == 0) {
+                return elements;
+            }
+            uint64_t end = current.head.load(std::memory_order_acquire);
+            uint64_t begin = end > capacity ? end - capacity : 0;
+            elements.reserve(static_cast<size_t>(end - begin));
+            for (uint64_t i = begin; i < end; i++) {
+                Slot& slot = current.slots[i % capacity];
+                std::lock_guard<std::mutex> slot_lock(slot.mutex);
+
+                // Overwritten since head was read, like everything before it; keep the run after it
+                if (slot.sequence != i) {
+                    elements.clear();
+                    continue;
+                }
+                elements.push_back(slot.value);
+            }
+            return elements;
+        }
+
+    private:
+        std::unique_ptr<Storage> storage;
+        mutable std::shared_mutex storage_mutex; // Held shared by readers, exclusively to replace storage
+        std::atomic<uint64_t> version_counter{ 0 };
+        std::mutex writer_mutex;
+    };
+
+} // namespace mqtt
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Constants.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace mqtt {
+
+    /**
+     * @brief Process-wide table giving each distinct string a 32-bit handle
+     *
+     * Messages carry handles for their topic, sender and target instead of
+     * strings, so copying a message copies integers and comparing topics or
+     * client ids is an integer compare.
+     *
+     * Handles are dense and start at 1; EMPTY stands for the empty string.
+     * Lookups take no lock: strings sit in chunks that double in size and
+     * never move, so a handle's string stays at the same address for the
+     * life of the process. Interning a string the table already holds is
+     * usually answered by a small per-thread cache of recent results;
+     * otherwise it takes a shared lock on one of several shards, and only
+     * new strings take it exclusively.
+     *
+     * Strings are never released. The table suits the bounded sets of
+     * topics and client ids of a simulation, not arbitrary data, so only
+     * simulated devices add to it: their ids, their exact subscription
+     * filters and, once telemetry runs, their telemetry topics. Messages
+     * only look topics and senders up, and network clients' devices are
+     * transient, so nothing a client sends is ever added.
+     */
+    class InternTable {
+    public:
+        using Handle = uint32_t;
+
+        static constexpr Handle EMPTY = 0;
+
+        InternTable();
+        ~InternTable();
+
+        InternTable(const InternTable&) = delete;
+        InternTable& operator=(const InternTable&) = delete;
+
+        /**
+         * @brief Get the handle of a string, adding it if it is new
+         *
+         * @throws std::length_error Once every 32-bit handle is taken
+         */
+        Handle intern(std::string_view value);
+
+        // Handle of a string already interned, without adding it
+        std::optional<Handle> find(std::string_view value) const;
+
+        // The string behind a handle this table returned
+        const std::string& lookup(Handle handle) const;
+
+        // Distinct strings, including the empty one
+        size_t size() const;
+
+        // Estimated heap use of the strings and their index
+        size_t memoryUsage() const;
+
+        // Tables for topics and for client ids; never destroyed, so messages may outlive static teardown
+        static InternTable& topics();
+        static InternTable& clients();
+
+    private:
+        struct Shard {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<std::string_view, Handle> index; // Views into the chunks
+        };
+
+        // Chunk k holds 1024 << k strings
+        static constexpr unsigned FIRST_CHUNK_BITS = 10;
+        static constexpr size_t CHUNK_COUNT = 33 - FIRST_CHUNK_BITS;
+
+        std::string& slot(Handle handle);
+
+        // Handle of value from the calling thread's cache, or from the shard and then cached
+        std::optional<Handle> findShared(std::string_view value, size_t hash) const;
+
+    private:
+        const uint64_t table_id; // Tags cache entries, so a later table at the same address misses
+        mutable std::array<Shard, mqtt::constants::INTERN_TABLE_SHARDS> shards;
+        std::array<std::atomic<std::string*>, CHUNK_COUNT> chunks;
+        std::atomic<uint64_t> next_handle{ 1 };
+        std::atomic<size_t> heap_bytes{ 0 }; // Characters stored outside std::string's inline buffer
+    };
+
+} // namespace mqtt
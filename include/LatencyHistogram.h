@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mqtt {
+
+    /**
+     * @brief Fixed-size log-linear latency histogram (HDR style)
+     *
+     * Values up to 32 ns are counted exactly; above that every power-of-two
+     * range is split into 16 equal buckets, so any reported percentile is
+     * within about 3% of the true value. Recording is a single relaxed
+     * atomic increment and may run concurrently with reads.
+     */
+    class LatencyHistogram {
+    public:
+        static constexpr size_t SUB_BUCKET_COUNT = 32;
+        static constexpr size_t BUCKET_COUNT = 656; // Covers values below 2^44 ns (~4.9 hours)
+
+        LatencyHistogram() = default;
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+        void record(uint64_t value_ns);
+
+        uint64_t count() const;
+        uint64_t max() const;
+
+        /**
+         * @brief Value at or below which the given fraction of samples fall
+         *
+         * @param fraction Between 0 and 1, e.g. 0.999 for p99.9
+         * @return Midpoint of the matching bucket in nanoseconds, 0 when empty
+         */
+        uint64_t percentile(double fraction) const;
+
+        void reset();
+
+        // Bucket mapping, exposed for tests
+        static size_t bucketIndex(uint64_t value_ns);
+        static uint64_t bucketLowerBound(size_t index);
+        static uint64_t bucketUpperBound(size_t index);
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+        std::atomic<uint64_t> total{ 0 };
+        std::atomic<uint64_t> max_value{ 0 };
+    };
+
+} // namespace mqtt
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "Message.h"
+#include "Constants.h"
+#include <array>
+#include <chrono>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Intervals between trace points that latency is tracked for
+     */
+    enum class LatencyStage {
+        EnqueueWait, // Publish -> Enqueue: waiting for ring space
+        Queueing,    // Enqueue -> Dispatch: waiting behind earlier messages
+        Delivery,    // Dispatch -> Receive: matching and earlier subscribers
+        EndToEnd     // Publish -> Receive
+    };
+
+    constexpr size_t LATENCY_STAGE_COUNT = 4;
+
+    /**
+     * @brief Percentiles of one histogram, in microseconds
+     */
+    struct LatencySummary {
+        uint64_t count = 0;
+        double p50_us = 0;
+        double p99_us = 0;
+        double p999_us = 0;
+        double max_us = 0;
+    };
+
+    /**
+     * @brief Aggregates delivery trace timestamps into latency histograms
+     *
+     * Keeps one set of stage histograms overall, one per QoS level and one
+     * per topic. Topic rows are keyed by interned handle, so recording a
+     * device topic hashes four bytes rather than the string; a topic that
+     * was not interned, such as one a network client published, is keyed
+     * by its string. Topic tracking is capped across both; deliveries on
+     * topics seen after the cap are folded into a shared "(other)" row.
+     */
+    class LatencyTracker {
+    public:
+        /**
+         * @brief Summaries for one overall, QoS or topic row
+         */
+        struct Row {
+            std::string label;
+            std::array<LatencySummary, LATENCY_STAGE_COUNT> stages;
+
+            const LatencySummary& stage(LatencyStage latency_stage) const;
+        };
+
+        explicit LatencyTracker(size_t max_topics = mqtt::constants::LATENCY_MAX_TRACKED_TOPICS);
+
+        LatencyTracker(const LatencyTracker&) = delete;
+        LatencyTracker& operator=(const LatencyTracker&) = delete;
+
+        /**
+         * @brief Record a delivery; messages without a publish trace are ignored
+         */
+        void record(const Message& message, std::chrono::steady_clock::time_point received);
+
+        Row overall() const;
+        std::vector<Row> byQoS() const;
+
+        // Topic rows with the most deliveries first
+        std::vector<Row> byTopic(size_t limit) const;
+
+        // Clear every histogram; tracked topics keep their rows, so the topic cap still applies
+        void reset();
+
+        static const char* stageName(LatencyStage stage);
+
+    private:
+        struct StageHistograms {
+            std::array<LatencyHistogram, LATENCY_STAGE_COUNT> stages;
+
+            void record(const std::array<int64_t, LATENCY_STAGE_COUNT>& durations_ns);
+            Row summarize(const std::string& label) const;
+            void reset();
+        };
+
+        StageHistograms& topicHistograms(const Message& message);
+
+        // Row for a key of either map, or other_topics once the cap is reached
+        template <typename Map>
+        StageHistograms& findOrAdd(Map& rows, const typename Map::key_type& key);
+
+    private:
+        const size_t max_topics;
+        StageHistograms total;
+        std::array<StageHistograms, 3> qos_levels;
+
+        mutable std::shared_mutex topic_mutex;
+        std::unordered_map<InternTable::Handle, std::unique_ptr<StageHistograms>> interned_topics;
+        std::unordered_map<std::string, std::unique_ptr<StageHistograms>> named_topics;
+        StageHistograms other_topics;
+    };
+
+} // namespace mqtt
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "HeadlessRunner.h"
+#include "LatencyHistogram.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Results of a load generator run
+     */
+    struct LoadReport {
+        std::chrono::duration<double> elapsed{ 0 };
+        uint64_t connected = 0;          // Devices that received a successful CONNACK
+        uint64_t connect_failures = 0;   // Refused, unreachable or timed out
+        uint64_t disconnects = 0;        // Connections lost after CONNACK
+        uint64_t published = 0;          // PUBLISH packets queued for sending
+        uint64_t acknowledged = 0;       // QoS 1/2 publishes completed; equals published for QoS 0
+        uint64_t refused = 0;            // QoS 1/2 publishes the broker answered with an error reason
+        double publish_rate = 0;         // Published messages per second
+
+        // PUBLISH to successful PUBACK (QoS 1) or PUBCOMP (QoS 2), in microseconds
+        int64_t ack_latency_p50_us = 0;
+        int64_t ack_latency_p99_us = 0;
+        int64_t ack_latency_max_us = 0;
+    };
+
+    /**
+     * @brief Drives an external MQTT 5.0 broker with simulated devices
+     *
+     * Each virtual device has its own TCP connection and publishes
+     * TelemetryGenerator payloads to telemetry/<client id> every telemetry
+     * interval, or back-to-back within its in-flight window when the
+     * interval is 0. The connections are spread over a few threads, each
+     * running a non-blocking epoll loop.
+     *
+     * Requires Linux; run() throws elsewhere.
+     */
+    class LoadGenerator {
+    public:
+        explicit LoadGenerator(const HeadlessOptions& options);
+        ~LoadGenerator();
+
+        LoadGenerator(const LoadGenerator&) = delete;
+        LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+        /**
+         * @brief Connect, publish until the duration or message limit, disconnect
+         *
+         * @throws std::runtime_error if the target host cannot be resolved
+         */
+        LoadReport run();
+
+        static void printReport(const HeadlessOptions& options, const LoadReport& report, std::ostream& out);
+
+    private:
+        class Worker;
+
+        /**
+         * @brief Totals updated by every worker
+         */
+        struct Counters {
+            std::atomic<uint64_t> connected{ 0 };
+            std::atomic<uint64_t> connect_failures{ 0 };
+            std::atomic<uint64_t> disconnects{ 0 };
+            std::atomic<uint64_t> published{ 0 };
+            std::atomic<uint64_t> acknowledged{ 0 };
+            std::atomic<uint64_t> refused{ 0 };
+            LatencyHistogram ack_latency;
+        };
+
+        bool limitReached(std::chrono::steady_clock::time_point start) const;
+
+    private:
+        HeadlessOptions options;
+        Counters counters;
+        std::atomic<bool> stopping{ false };
+    };
+
+} // namespace mqtt
@@ -1,16 +1,42 @@
 #pragma once
 
 #include "QoS.h"
+#include "InternTable.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <array>
 #include <chrono>
 #include <cstdint>
+#include <memory>
 
 namespace mqtt {
 
+    /**
+     * @brief Points on a message's way through the broker, in order
+     */
+    enum class TracePoint {
+        Publish,   // Broker::publish called
+        Enqueue,   // Accepted into a dispatch ring
+        Dispatch,  // Taken off the ring by a dispatcher
+        Receive    // Handed to a subscriber
+    };
+
     /**
      * @brief MQTT Message class implementing MQTT 5.0 message format
+     *
+     * Topic, payload and properties live in a reference-counted body shared
+     * by every copy of the message; only the per-delivery envelope (target,
+     * QoS and retain flag) is copied. Setters on shared content clone the
+     * body first, so copies never observe each other's changes.
+     *
+     * The target is kept as an InternTable handle, and so are the topic and
+     * sender when the tables already hold them, as they do for simulated
+     * devices' ids, topics and filters. Messages never add a topic or sender
+     * to those tables: one that is not there stays a string in the body, so
+     * arbitrary topics and client ids, such as those of network clients,
+     * cannot grow the process-wide tables.
      */
     class Message {
     public:
@@ -27,7 +53,7 @@ namespace mqtt {
         void setTopic(const std::string& topic);
 
         const std::string& getPayload() const;
-        void setPayload(const std::string& payload);
+        void setPayload(std::string_view payload);
 
         QoS getQoS() const;
         void setQoS(QoS qos);
@@ -41,7 +67,24 @@ namespace mqtt {
         const std::string& getTargetId() const;
         void setTargetId(const std::string& target_id);
 
+        // Interned forms: topics from InternTable::topics(), ids from InternTable::clients();
+        // the topic and sender handles are EMPTY for strings that were not interned
+        InternTable::Handle getTopicHandle() const;
+        void setTopicHandle(InternTable::Handle topic);
+        InternTable::Handle getSenderHandle() const;
+        void setSenderHandle(InternTable::Handle sender);
+        InternTable::Handle getTargetHandle() const;
+        void setTargetHandle(InternTable::Handle target);
+
         std::chrono::system_clock::time_point getTimestamp() const;
+        void setTimestamp(std::chrono::system_clock::time_point timestamp);
+
+        // Monotonic trace timestamps, carried per delivery
+        void markTrace(TracePoint point,
+            std::chrono::steady_clock::time_point when = std::chrono::steady_clock::now());
+        std::chrono::steady_clock::time_point getTrace(TracePoint point) const;
+        bool hasTrace() const;
+        void clearTrace();
 
         // MQTT 5.0 specific properties
         void addUserProperty(const std::string& key, const std::string& value);
@@ -62,22 +105,53 @@ namespace mqtt {
         void setCorrelationData(const std::vector<uint8_t>& correlation_data);
         const std::vector<uint8_t>& getCorrelationData() const;
 
+        /**
+         * @brief Sender and MQTT 5.0 properties packed into one byte string
+         *
+         * For stores that keep messages outside Message objects. The topic
+         * alias is per connection and not included.
+         */
+        bool hasProperties() const;
+        void appendProperties(std::string& out) const;
+
+        // Restore properties from appendProperties output; false if malformed
+        bool readProperties(std::string_view blob);
+
+    private:
+        /**
+         * @brief Publish-time content, immutable once shared
+         */
+        struct Body {
+            InternTable::Handle topic = InternTable::EMPTY;
+            std::string topic_name; // Only for a topic without a handle
+            std::string payload;
+            InternTable::Handle sender = InternTable::EMPTY;
+            std::string sender_name; // Only for a sender without a handle
+            std::chrono::system_clock::time_point timestamp;
+
+            // MQTT 5.0 specific properties
+            std::map<std::string, std::string> user_properties;
+            uint32_t message_expiry_interval = 0;
+            uint16_t topic_alias = 0;
+            std::string content_type;
+            std::string response_topic;
+            std::vector<uint8_t> correlation_data;
+        };
+
+        Body& mutableBody();
+
+        // Use the topic's handle if it has one, otherwise keep the string
+        static void assignTopic(Body& content, const std::string& topic);
+        static void assignSender(Body& content, std::string_view sender);
+
     private:
-        std::string topic;
-        std::string payload;
+        std::shared_ptr<Body> body;
+
+        // Per-delivery envelope
         QoS qos;
         bool retained;
-        std::string sender_id;
-        std::string target_id; 
-        std::chrono::system_clock::time_point timestamp;
-
-        // MQTT 5.0 specific properties
-        std::map<std::string, std::string> user_properties;
-        uint32_t message_expiry_interval;
-        uint16_t topic_alias;
-        std::string content_type;
-        std::string response_topic;
-        std::vector<uint8_t> correlation_data;
+        InternTable::Handle target = InternTable::EMPTY;
+        std::array<std::chrono::steady_clock::time_point, 4> trace{};
     };
 
 } // namespace mqtt
\ No newline at end of file
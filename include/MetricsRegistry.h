@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Constants.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Monotonic counter split across cache-line-sized shards
+     *
+     * Each thread increments its own shard with a relaxed add, so hot paths
+     * on different threads never share a cache line. Reads sum all shards.
+     */
+    class ShardedCounter {
+    public:
+        ShardedCounter() = default;
+        ShardedCounter(const ShardedCounter&) = delete;
+        ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+        void add(uint64_t amount = 1) {
+            shards[shardIndex()].value.fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        uint64_t value() const;
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> value{ 0 };
+        };
+
+        // Threads are assigned shards round-robin on first use
+        static size_t shardIndex();
+
+        std::array<Shard, mqtt::constants::METRICS_COUNTER_SHARDS> shards;
+    };
+
+    /**
+     * @brief Accumulated time spent in an operation and how often it ran
+     */
+    class DurationCounter {
+    public:
+        void record(std::chrono::nanoseconds elapsed) {
+            count_counter.add();
+            total_ns.add(static_cast<uint64_t>(elapsed.count()));
+        }
+
+        uint64_t count() const { return count_counter.value(); }
+        uint64_t totalNanoseconds() const { return total_ns.value(); }
+
+    private:
+        ShardedCounter count_counter;
+        ShardedCounter total_ns;
+    };
+
+    /**
+     * @brief Output formats for a metrics dump
+     */
+    enum class MetricsFormat {
+        Prometheus, // Text exposition format, e.g. for node_exporter's textfile collector
+        Json
+    };
+
+    /**
+     * @brief Named counters, gauges and duration metrics
+     *
+     * Metrics are registered once, typically at construction of the owning
+     * component, and the returned references are updated directly on hot
+     * paths without going through the registry. Gauges are read from a
+     * callback when the registry is sampled.
+     */
+    class MetricsRegistry {
+    public:
+        enum class Type { Counter, Gauge, Duration };
+
+        /**
+         * @brief One metric's value at sampling time
+         *
+         * Durations report their total in seconds as value and the number
+         * of timed operations as count.
+         */
+        struct Sample {
+            std::string name;
+            std::string help;
+            Type type = Type::Counter;
+            double value = 0;
+            uint64_t count = 0;
+        };
+
+        MetricsRegistry() = default;
+        MetricsRegistry(const MetricsRegistry&) = delete;
+        MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+        // Registration; references stay valid for the registry's lifetime
+        ShardedCounter& counter(const std::string& name, const std::string& help);
+        DurationCounter& duration(const std::string& name, const std::string& help);
+        void gauge(const std::string& name, const std::string& help, std::function<double()> read);
+
+        // Current value of every metric, in registration order
+        std::vector<Sample> collect() const;
+
+        // Value of a single metric by name, 0 if it is not registered
+        double value(const std::string& name) const;
+
+        std::string format(MetricsFormat output_format) const;
+
+        /**
+         * @brief Write a dump to a file, replacing it atomically
+         *
+         * The dump is written to a temporary file next to path and renamed
+         * over it, so a collector never reads a partial file.
+         *
+         * @return False if the file could not be written
+         */
+        bool writeFile(const std::string& path, MetricsFormat output_format) const;
+
+    private:
+        struct Entry {
+            std::string name;
+            std::string help;
+            Type type;
+            std::unique_ptr<ShardedCounter> counter;
+            std::unique_ptr<DurationCounter> duration;
+            std::function<double()> read;
+        };
+
+        Sample sample(const Entry& entry) const;
+
+    private:
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<Entry>> entries;
+    };
+
+} // namespace mqtt
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace mqtt {
+
+    /**
+     * @brief Bounded lock-free multi-producer/single-consumer ring
+     *
+     * Producers claim a slot with a single compare-and-swap on the enqueue
+     * position and publish it through a per-slot sequence number, so they
+     * never wait for each other or for the consumer unless the ring is full.
+     * Only one thread may call tryPop().
+     */
+    template <typename T>
+    class MpscQueue {
+    public:
+        /**
+         * @brief Producer-side counters, read without synchronization
+         */
+        struct Stats {
+            uint64_t pushes = 0;           // Slots claimed by producers
+            uint64_t contended_pushes = 0; // Slot claims lost to another producer
+            uint64_t full_waits = 0;       // Times a producer found the ring full
+        };
+
+        /**
+         * @brief Construct a new MpscQueue
+         *
+         * @param capacity Number of slots, rounded up to a power of two
+         */
+        explicit MpscQueue(size_t capacity)
+            : mask(roundUpToPowerOfTwo(capacity) - 1),
+            slots(new Slot[mask + 1]) {
+            for (size_t i = 0; i <= mask; i++) {
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        /**
+         * @brief Enqueue without waiting
+         *
+         * @return False if the ring is full
+         */
+        bool tryPush(T value) {
+            return tryPushFrom(value, [](T&) {});
+        }
+
+        /**
+         * @brief Enqueue, yielding while the ring is full
+         */
+        void push(T value) {
+            push(std::move(value), [](T&) {});
+        }
+
+        /**
+         * @brief Enqueue, letting the caller touch the item once it has a slot
+         *
+         * @param stamp Called on the stored item after the slot is claimed and
+         *              before the consumer can see it
+         */
+        template <typename Stamp>
+        void push(T value, Stamp&& stamp) {
+            while (!tryPushFrom(value, stamp)) {
+                full_waits.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::yield();
+            }
+        }
+
+        /**
+         * @brief Dequeue the oldest item (consumer thread only)
+         *
+         * @return False if no published item is available
+         */
+        bool tryPop(T& out) {
+            size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            Slot& slot = slots[pos & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+                return false;
+            }
+            out = std::move(slot.value);
+            slot.sequence.store(pos + mask + 1, std::memory_order_release);
+            dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Approximate when called concurrently with producers
+        bool empty() const {
+            size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            return slots[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+        }
+
+        size_t sizeApprox() const {
+            size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+            size_t head = dequeue_pos.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+        size_t capacity() const {
+            return mask + 1;
+        }
+
+        Stats getStats() const {
+            Stats stats;
+            stats.pushes = enqueue_pos.load(std::memory_order_relaxed);
+            stats.contended_pushes = contended_pushes.load(std::memory_order_relaxed);
+            stats.full_waits = full_waits.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+    private:
+        // Moves from value only when a slot was claimed
+        template <typename Stamp>
+        bool tryPushFrom(T& value, Stamp&& stamp) {
+            size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            Slot* slot;
+            while (true) {
+                slot = &slots[pos & mask];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                    contended_pushes.fetch_add(1, std::memory_order_relaxed);
+                }
+                else if (diff < 0) {
+                    return false;
+                }
+                else {
+                    // Another producer claimed this slot first
+                    contended_pushes.fetch_add(1, std::memory_order_relaxed);
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            slot->value = std::move(value);
+            stamp(slot->value);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        struct Slot {
+            std::atomic<size_t> sequence{ 0 };
+            T value{};
+        };
+
+        static size_t roundUpToPowerOfTwo(size_t value) {
+            size_t result = 2;
+            while (result < value) {
+                result <<= 1;
+            }
+            return result;
+        }
+
+    private:
+        const size_t mask;
+        std::unique_ptr<Slot[]> slots;
+
+        // Producer and consumer positions live on separate cache lines
+        alignas(64) std::atomic<size_t> enqueue_pos{ 0 };
+        alignas(64) std::atomic<size_t> dequeue_pos{ 0 };
+
+        alignas(64) std::atomic<uint64_t> contended_pushes{ 0 };
+        std::atomic<uint64_t> full_waits{ 0 };
+    };
+
+} // namespace mqtt
@@ -55,6 +55,22 @@ public:
         std::chrono::milliseconds(mqtt::constants::DEFAULT_TELEMETRY_INTERVAL_MS)
     );
 
+    /**
+     * @brief Write the devices and retained messages to a snapshot file
+     *
+     * @return False with a description in error if it could not be written
+     */
+    bool saveSnapshot(const std::string& path, std::string& error) const;
+
+    /**
+     * @brief Add the devices and retained messages of a snapshot file
+     *
+     * Restored devices get the same command handler as addDevice.
+     *
+     * @return False with a description in error if the file is unusable
+     */
+    bool loadSnapshot(const std::string& path, std::string& error);
+
     /**
      * @brief Initialize the simulator
      *
@@ -72,6 +88,11 @@ public:
     void run();
 
 private:
+    /**
+     * @brief Track a device and print the commands it receives
+     */
+    void attachDevice(const std::shared_ptr<mqtt::Device>& device);
+
     /**
      * @brief Set up UI components
      *
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "Message.h"
+#include "RetainedStore.h"
+#include "Constants.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Append-only, checksummed log of retained messages and subscriptions
+     *
+     * Every change is appended as a record framed by its length and a
+     * CRC-32 to the newest of a series of numbered segment files. Opening
+     * the log maps each segment into memory and replays its records in
+     * order straight into a RetainedStore. Replay of a segment stops at
+     * the first record that fails its checksum: the torn tail left by a
+     * crash mid-write is cut off and appending continues after the last
+     * good record.
+     *
+     * Superseded records pile up, so once the log holds several times the
+     * live state, a compaction writes that state into a fresh segment and
+     * deletes the older ones. The new segment only takes its place once it
+     * is complete and synced, so a crash during compaction loses nothing.
+     * beginCompaction() moves appends on to a new segment so that the
+     * owner can write the compacted one from another thread meanwhile.
+     *
+     * Records reach the operating system as they are appended and survive
+     * a process crash; sync() also flushes them to disk.
+     *
+     * Requires Linux; open() fails elsewhere. Not thread-safe; the owner
+     * serializes access.
+     */
+    class PersistentLog {
+    public:
+        // Client id and topic filter
+        using Subscription = std::pair<std::string, std::string>;
+
+        /**
+         * @brief A compacted segment being written, see beginCompaction()
+         *
+         * Takes the place of every segment before the one appends moved on
+         * to, which replays after it. Records appended while it is written
+         * therefore win over whatever it holds, so it may be filled from a
+         * state that keeps changing as long as each entry is read after
+         * beginCompaction() returned.
+         *
+         * Touches no state of the log, so it may be filled and committed
+         * on any thread without the owner's lock. Destroying it without a
+         * commit discards the partial segment.
+         */
+        class Compaction {
+        public:
+            ~Compaction();
+
+            Compaction(const Compaction&) = delete;
+            Compaction& operator=(const Compaction&) = delete;
+
+            void addRetained(const Message& message);
+            void addSubscription(const Subscription& subscription);
+
+            /**
+             * @brief Sync the segment, put it in place and delete the ones it replaces
+             *
+             * @return False if it could not be written; the old segments are then kept
+             */
+            bool commit();
+
+        private:
+            friend class PersistentLog;
+            Compaction() = default;
+
+            void flush();
+
+            std::string directory;
+            std::string path;
+            std::string temporary;
+            std::vector<std::string> replaced; // Paths, oldest first
+            uint64_t replaced_bytes = 0;
+            uint64_t sequence = 0;
+            int fd = -1;
+            std::string buffer;
+            uint64_t written = 0;
+            bool ok = true;
+            bool committed = false;
+        };
+
+        struct Stats {
+            size_t segments = 0;
+            uint64_t bytes = 0;         // All segments together
+            uint64_t appended = 0;      // Records appended since open
+            uint64_t write_errors = 0;  // Appends the operating system refused
+            uint64_t compactions = 0;
+            uint64_t recovered = 0;     // Records replayed by open
+            uint64_t torn_bytes = 0;    // Cut off after a record that failed its checksum
+            std::chrono::microseconds recovery_time{ 0 };
+        };
+
+        explicit PersistentLog(const std::string& directory,
+            size_t segment_bytes = mqtt::constants::LOG_SEGMENT_BYTES);
+
+        // Syncs the newest segment
+        ~PersistentLog();
+
+        PersistentLog(const PersistentLog&) = delete;
+        PersistentLog& operator=(const PersistentLog&) = delete;
+
+        /**
+         * @brief Create the directory if needed, replay it and start appending
+         *
+         * @param retained Receives the logged retained messages
+         * @param subscriptions Receives the logged subscriptions
+         * @return False with a description in error if the directory is unusable
+         */
+        bool open(RetainedStore& retained, std::set<Subscription>& subscriptions, std::string& error);
+
+        // Each returns false if the record could not be written
+        bool appendRetained(const Message& message); // An empty payload records a clear
+        bool appendSubscribe(const std::string& client_id, const std::string& filter);
+        bool appendUnsubscribe(const std::string& client_id, const std::string& filter);
+
+        // True once the log has outgrown the live state it describes
+        bool needsCompaction() const;
+
+        /**
+         * @brief Replace every segment with one holding only the given state
+         *
+         * @return False if the new segment could not be written; the old
+         *         ones are then kept
+         */
+        bool compact(const RetainedStore& retained, const std::set<Subscription>& subscriptions);
+
+        /**
+         * @brief Start a compaction that the caller fills and commits
+         *
+         * Appends continue in a new segment from here on. Pass the
+         * committed compaction to finishCompaction().
+         *
+         * @return Null if the segments could not be switched
+         */
+        std::unique_ptr<Compaction> beginCompaction();
+
+        // Account for a compaction after commit(); does nothing if it failed
+        void finishCompaction(const Compaction& compaction);
+
+        void sync();
+
+        Stats getStats() const;
+        const std::string& getDirectory() const;
+
+    private:
+        enum class RecordType : uint8_t {
+            Retain = 1,
+            Clear = 2,
+            Subscribe = 3,
+            Unsubscribe = 4
+        };
+
+        std::string segmentPath(uint64_t sequence) const;
+
+        // Replays one segment and truncates it after its last good record
+        bool replaySegment(uint64_t sequence, RetainedStore& retained, std::set<Subscription>& subscriptions,
+            std::string& error);
+        bool applyRecord(std::string_view record, RetainedStore& retained, std::set<Subscription>& subscriptions);
+
+        bool openForAppend(uint64_t sequence, std::string& error);
+        void closeSegment();
+
+        // Frame a record into buffer: type, then fields written by the caller
+        static void beginRecord(std::string& buffer, RecordType type);
+        static void endRecord(std::string& buffer, size_t start);
+        static void encodeRetained(std::string& buffer, const Message& message);
+        static void encodeSubscription(std::string& buffer, RecordType type, const std::string& client_id,
+            const std::string& filter);
+
+        bool writeRecord();
+
+    private:
+        std::string directory;
+        size_t segment_bytes;
+
+        std::vector<uint64_t> segments; // Sequence numbers, oldest first
+        int fd = -1;                    // Newest segment, appended to
+        uint64_t segment_size = 0;      // Bytes in the newest segment
+        uint64_t total_bytes = 0;
+        uint64_t live_bytes = 0;        // Estimated bytes the live state takes in the log
+
+        std::string record;             // Encode buffer, reused
+        Stats stats;
+    };
+
+} // namespace mqtt
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Message.h"
+#include "QoS.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Packet identifiers and acknowledgement state of one MQTT session
+     *
+     * Outbound, each QoS 1/2 delivery takes one of a fixed number of
+     * in-flight slots (the client's Receive Maximum) until PUBACK or
+     * PUBCOMP; deliveries beyond that wait in a bounded queue. Packet ids
+     * encode their slot, so every acknowledgement is an O(1) lookup and
+     * memory depends only on the window, not on the message rate.
+     *
+     * Inbound, it remembers QoS 2 packet ids between PUBLISH and PUBREL so
+     * a retransmitted PUBLISH is not delivered twice.
+     *
+     * Not thread-safe; the owner serializes access.
+     */
+    class QoSSession {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        enum class ReceiveResult {
+            New,       // First time this packet id is seen: deliver it
+            Duplicate, // Already delivered, awaiting PUBREL: acknowledge only
+            Exceeded   // More unreleased packets than the advertised Receive Maximum
+        };
+
+        QoSSession();
+
+        /**
+         * @brief Drop all state and size the windows for a new connection
+         *
+         * @param send_window In-flight deliveries allowed, at least 1
+         * @param receive_window Unreleased incoming QoS 2 packets allowed
+         */
+        void reset(uint16_t send_window, uint16_t receive_window);
+
+        //---------------------------------------------------------------------
+        // Outbound: server to client
+        //---------------------------------------------------------------------
+
+        // A slot is free and nothing is queued ahead of a new delivery
+        bool canSend() const;
+
+        /**
+         * @brief Take a slot for a QoS 1 or 2 message
+         *
+         * @return Packet id to send it with, 0 if the window is full
+         */
+        uint16_t send(const Message& message, Clock::time_point now);
+
+        // Hold a delivery until a slot frees up; false when the queue is full
+        bool enqueue(const Message& message);
+
+        // Oldest queued delivery into a free slot; returns its packet id, 0 if none
+        uint16_t sendQueued(Clock::time_point now, const Message*& message);
+
+        // PUBACK for a QoS 1 delivery; false if the id is not awaiting one
+        bool acknowledge(uint16_t packet_id);
+
+        // PUBREC for a QoS 2 delivery, after which PUBREL is sent; false if unexpected
+        bool received(uint16_t packet_id, Clock::time_point now);
+
+        // PUBCOMP ending a QoS 2 delivery; false if the id is not awaiting one
+        bool complete(uint16_t packet_id);
+
+        // PUBREC with an error reason, which also ends a QoS 2 delivery
+        bool refused(uint16_t packet_id);
+
+        /**
+         * @brief Visit deliveries unacknowledged for longer than timeout
+         *
+         * fn(packet_id, message, awaiting_pubcomp) is called for each, and
+         * its timer restarts. The caller resends the PUBLISH with the DUP
+         * flag, or the PUBREL when awaiting_pubcomp is true.
+         *
+         * @return Number visited
+         */
+        template <typename Fn>
+        size_t forEachExpired(Clock::time_point now, std::chrono::milliseconds timeout, Fn&& fn);
+
+        size_t inFlight() const;
+        size_t queued() const;
+        uint64_t getRetries() const;
+
+        //---------------------------------------------------------------------
+        // Inbound: client to server
+        //---------------------------------------------------------------------
+
+        // A QoS 2 PUBLISH arrived with this packet id
+        ReceiveResult beginReceive(uint16_t packet_id);
+
+        // PUBREL arrived; false if the id was not awaiting one
+        bool release(uint16_t packet_id);
+
+    private:
+        enum class SlotState : uint8_t {
+            Free,
+            AwaitingPuback,
+            AwaitingPubrec,
+            AwaitingPubcomp
+        };
+
+        struct Slot {
+            Message message;
+            Clock::time_point sent;
+            uint16_t packet_id = 0;
+            SlotState state = SlotState::Free;
+        };
+
+        Slot* find(uint16_t packet_id, SlotState state);
+        uint16_t occupy(const Message& message, Clock::time_point now);
+        void releaseSlot(Slot& slot);
+
+    private:
+        std::vector<Slot> slots;
+        std::vector<uint16_t> free_slots;     // Stack of slot indices
+        std::vector<uint16_t> generations;    // Per slot, advanced on every reuse
+        std::deque<Message> pending;
+
+        std::vector<uint16_t> unreleased;     // Incoming QoS 2 ids awaiting PUBREL
+        uint16_t receive_window = 0;
+
+        uint64_t retries = 0;
+    };
+
+    template <typename Fn>
+    size_t QoSSession::forEachExpired(Clock::time_point now, std::chrono::milliseconds timeout, Fn&& fn) {
+        size_t visited = 0;
+        for (auto& slot : slots) {
+            if (slot.state != SlotState::Free && now - slot.sent >= timeout) {
+                slot.sent = now;
+                fn(slot.packet_id, static_cast<const Message&>(slot.message), slot.state == SlotState::AwaitingPubcomp);
+                visited++;
+            }
+        }
+        retries += visited;
+        return visited;
+    }
+
+} // namespace mqtt
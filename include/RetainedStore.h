@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Message.h"
+#include "BlobPool.h"
+#include "Constants.h"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Retained messages indexed by topic level
+     *
+     * Each node holds the retained message of the topic ending there, if
+     * any, and its child levels in sorted order. Looking up the messages
+     * matching a subscription filter walks only the branches the filter
+     * can match: a literal level follows one child, + visits every child
+     * and # takes the whole subtree.
+     *
+     * Lookups are resumable: collect() visits matches in a fixed order and
+     * picks up after the last topic it returned, so a caller can replay a
+     * large store a chunk at a time and release its lock between chunks.
+     *
+     * Messages are not kept as Message objects. Level names, payloads and
+     * properties go into content-addressed pools, so the "state" level of
+     * a million topics or a million identical "online" payloads are each
+     * stored once, and a node is a fixed-size record in one flat array.
+     * Topics are rebuilt from the path on the way out.
+     *
+     * Rebuilding copies the payload and parses the properties, so the
+     * messages collect() replays are also kept, up to
+     * RETAINED_REPLAY_CACHE_SIZE of them in a ring, and later replays of
+     * the same topic hand out copies sharing their body.
+     *
+     * Not thread-safe, const lookups included; the owner serializes access.
+     */
+    class RetainedStore {
+    public:
+        /**
+         * @brief Where the store's memory goes
+         */
+        struct MemoryUsage {
+            size_t topics = 0;          // Retained messages
+            size_t nodes = 0;           // Trie nodes, including inner levels
+            size_t levels = 0;          // Distinct level names
+            size_t payloads = 0;        // Distinct payloads
+            size_t payload_bytes = 0;   // Their content, each counted once
+            size_t properties = 0;      // Distinct property blobs
+            size_t cached = 0;          // Messages kept built for replay
+            size_t node_bytes = 0;      // Node array and child lists
+            size_t pool_bytes = 0;      // Level, payload and property pools
+            size_t cache_bytes = 0;     // Replay cache, estimated
+            size_t total_bytes = 0;     // Estimated heap use of the whole store
+        };
+
+        RetainedStore();
+        ~RetainedStore();
+
+        RetainedStore(const RetainedStore&) = delete;
+        RetainedStore& operator=(const RetainedStore&) = delete;
+
+        /**
+         * @brief Retain a message for its topic, replacing any earlier one
+         *
+         * An empty payload clears the topic instead, as MQTT specifies.
+         * Per-delivery state (target, trace) and topic aliases are not kept.
+         */
+        void store(const Message& message);
+
+        // Drop the retained message of a topic; false if there was none
+        bool erase(const std::string& topic);
+
+        std::optional<Message> find(const std::string& topic) const;
+
+        /**
+         * @brief Append up to limit messages matching a filter
+         *
+         * @param cursor Empty to start; updated to the last topic returned,
+         *        and passed back unchanged to continue after it
+         * @return Number appended; fewer than limit means the walk is done
+         */
+        size_t collect(const std::string& filter, std::string& cursor, size_t limit,
+            std::vector<Message>& out) const;
+
+        // As collect() with every topic matching, "$" topics included
+        size_t collectAll(std::string& cursor, size_t limit, std::vector<Message>& out) const;
+
+        // Visit every retained message, "$" topics included
+        void forEach(const std::function<void(const Message&)>& visit) const;
+
+        size_t size() const;
+        bool empty() const;
+        MemoryUsage memoryUsage() const;
+
+    private:
+        static constexpr uint32_t NONE = BlobPool::NONE;
+
+        struct Node {
+            std::vector<uint32_t> children; // Node indices, sorted by level name
+            int64_t timestamp_us = 0;       // Publish time, system clock
+            uint32_t level = NONE;          // Level name in the level pool
+            uint32_t payload = NONE;        // NONE when nothing is retained here
+            uint32_t properties = NONE;     // NONE when the message has none
+            mutable uint32_t replay = NONE; // Slot in the replay cache, if built
+            QoS qos = QoS::AT_MOST_ONCE;
+        };
+
+        struct CachedReplay {
+            uint32_t node = NONE;           // NONE once evicted or invalidated
+            Message message;
+        };
+
+        struct Walk {
+            const std::vector<std::string_view>& filter;
+            const std::vector<std::string_view>& cursor;
+            size_t limit;
+            std::vector<Message>& out;
+            std::string topic;              // Path of the current node
+            size_t added = 0;
+            bool cache = false;             // Keep the messages built for replay
+        };
+
+        static std::vector<std::string_view> splitLevels(std::string_view topic);
+
+        std::string_view levelName(uint32_t node) const;
+        std::vector<uint32_t>::const_iterator lowerBound(const Node& node, std::string_view level) const;
+        uint32_t findChild(uint32_t node, std::string_view level) const;
+        uint32_t addChild(uint32_t node, std::string_view level);
+        void clearMessage(Node& node);
+        bool eraseFrom(uint32_t node, const std::vector<std::string_view>& levels, size_t depth);
+        Message toMessage(uint32_t node, const std::string& topic, bool cache) const;
+
+        // All return false once the limit is reached
+        bool walkFilter(Walk& walk, uint32_t node, size_t depth, bool on_cursor) const;
+        bool walkSubtree(Walk& walk, uint32_t node, size_t depth, bool on_cursor, bool skip_system) const;
+        bool walkChild(Walk& walk, uint32_t child, size_t depth, bool on_cursor, bool subtree) const;
+        bool emit(Walk& walk, uint32_t node, bool on_cursor) const;
+        void visitSubtree(uint32_t node, std::string& topic, const std::function<void(const Message&)>& visit) const;
+
+    private:
+        std::vector<Node> nodes;            // nodes[0] is the root
+        std::vector<uint32_t> free_nodes;
+        size_t children_bytes = 0;
+        size_t message_count = 0;
+
+        BlobPool levels;
+        BlobPool payloads;
+        BlobPool properties;
+
+        // Ring of recently replayed messages; grows to RETAINED_REPLAY_CACHE_SIZE
+        mutable std::vector<CachedReplay> replay_cache;
+        mutable size_t replay_next = 0;
+    };
+
+} // namespace mqtt
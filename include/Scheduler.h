@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Constants.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Timer service backed by a hierarchical timing wheel
+     *
+     * A single ticker thread advances four wheels of 256 slots each. Timers
+     * due within 256 ticks sit in the innermost wheel; longer ones are
+     * parked in an outer wheel and cascade inwards as time passes, so
+     * scheduling and firing are O(1) regardless of how many timers exist.
+     * Due callbacks run on a fixed pool of worker threads.
+     */
+    class Scheduler {
+    public:
+        /**
+         * @brief Callback of a repeating timer
+         *
+         * @return Delay until the next run, negative to stop repeating
+         */
+        using RepeatingTask = std::function<std::chrono::milliseconds()>;
+
+        /**
+         * @brief Timer counters, read without synchronization
+         */
+        struct Stats {
+            uint64_t scheduled = 0;  // Timer arms, including re-arms of repeating timers
+            uint64_t fired = 0;      // Callbacks run
+            uint64_t late_ticks = 0; // Ticks processed behind the wall clock
+            size_t pending = 0;      // Timers waiting in the wheel
+        };
+
+    private:
+        struct Timer;
+
+    public:
+        /**
+         * @brief Cancellation handle for a scheduled timer
+         */
+        class Handle {
+        public:
+            Handle() = default;
+
+            /**
+             * @brief Stop the timer from running again
+             *
+             * Waits for a callback that is already running, unless called
+             * from within that callback.
+             */
+            void cancel();
+
+            // True until the timer is cancelled or has run for the last time
+            bool active() const;
+
+        private:
+            friend class Scheduler;
+            explicit Handle(std::shared_ptr<Timer> timer);
+
+            std::shared_ptr<Timer> timer;
+        };
+
+        /**
+         * @brief Construct a new Scheduler
+         *
+         * @param worker_threads Number of callback threads, 0 for one per hardware thread
+         * @param tick Wheel resolution
+         */
+        explicit Scheduler(size_t worker_threads = mqtt::constants::SCHEDULER_DEFAULT_WORKER_THREADS,
+            std::chrono::milliseconds tick = std::chrono::milliseconds(mqtt::constants::SCHEDULER_TICK_MS));
+
+        /**
+         * @brief Stop the ticker and workers; pending timers never run
+         */
+        ~Scheduler();
+
+        /**
+         * @brief Stop as the destructor does, but keep the scheduler usable
+         *
+         * Waits for running callbacks. Tasks they or others schedule
+         * afterwards are accepted and never run.
+         */
+        void stop();
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        // Run a task once after a delay
+        Handle schedule(std::chrono::milliseconds delay, std::function<void()> task);
+
+        // Run a task after a delay, then again after each delay it returns
+        Handle scheduleRepeating(std::chrono::milliseconds delay, RepeatingTask task);
+
+        // Run a task on a worker as soon as one is free, bypassing the wheel
+        Handle post(std::function<void()> task);
+
+        Stats getStats() const;
+        size_t getWorkerCount() const;
+
+        /**
+         * @brief Process-wide scheduler shared by all devices
+         */
+        static Scheduler& shared();
+
+    private:
+        static constexpr size_t WHEEL_BITS = 8;
+        static constexpr size_t WHEEL_SIZE = size_t(1) << WHEEL_BITS;
+        static constexpr size_t WHEEL_LEVELS = 4;
+
+        using Slot = std::vector<std::shared_ptr<Timer>>;
+
+        void arm(const std::shared_ptr<Timer>& timer, std::chrono::milliseconds delay);
+        void insert(const std::shared_ptr<Timer>& timer);
+        void cascade(size_t level);
+        void advanceTo(uint64_t target, std::vector<std::shared_ptr<Timer>>& due);
+        uint64_t elapsedTicks() const;
+
+        void runTicker();
+        void runWorker();
+        void runTimer(const std::shared_ptr<Timer>& timer);
+
+    private:
+        const std::chrono::milliseconds tick_length;
+        const std::chrono::steady_clock::time_point start_time;
+
+        // Timing wheels, guarded by wheel_mutex
+        std::array<std::array<Slot, WHEEL_SIZE>, WHEEL_LEVELS> wheels;
+        uint64_t current_tick = 0;
+        size_t pending_timers = 0;
+        mutable std::mutex wheel_mutex;
+        std::condition_variable wheel_condition;
+
+        // Timers ready to run
+        std::deque<std::shared_ptr<Timer>> ready_timers;
+        std::mutex ready_mutex;
+        std::condition_variable ready_condition;
+
+        std::atomic<bool> running;
+        std::thread ticker_thread;
+        std::vector<std::thread> worker_threads;
+
+        std::atomic<uint64_t> scheduled_count{ 0 };
+        std::atomic<uint64_t> fired_count{ 0 };
+        std::atomic<uint64_t> late_tick_count{ 0 };
+    };
+
+} // namespace mqtt
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Broker.h"
+#include "Device.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief Point-in-time image of a simulation in one binary file
+     *
+     * Holds every device with its configuration and subscriptions, and the
+     * broker's retained messages. The file is a header followed by tables
+     * of fixed-size records and one area of string bytes the records point
+     * into. It is written in host byte order and 8-byte aligned, so open()
+     * only maps it into memory and checks the tables' bounds: records are
+     * read in place and strings are views into the mapping, with nothing
+     * decoded per entry.
+     *
+     * Restoring still has to construct each Device and subscribe it, but
+     * skips everything a scenario did to reach that state.
+     *
+     * The file is meant for the machine that wrote it; one from a host of
+     * the other byte order is rejected. Maps the file on Linux and reads it
+     * into memory elsewhere.
+     */
+    class Snapshot {
+    public:
+        Snapshot() = default;
+
+        // Unmaps the file
+        ~Snapshot();
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        /**
+         * @brief Write the devices and the broker's retained messages to path
+         *
+         * The file is written beside path and renamed over it when complete.
+         *
+         * @return False with a description in error if it could not be written
+         */
+        static bool write(const std::string& path, const Broker& broker,
+            const std::vector<std::shared_ptr<Device>>& devices, std::string& error);
+
+        /**
+         * @brief Map a snapshot file and check its layout
+         *
+         * @return False with a description in error if the file is missing,
+         *         truncated or not a snapshot from this kind of host
+         */
+        bool open(const std::string& path, std::string& error);
+
+        /**
+         * @brief Recreate the snapshot's devices and retained messages on broker
+         *
+         * Devices subscribe before retained messages are restored, so the
+         * restore replays nothing to them. Retained messages are not
+         * dispatched either; they are only stored, and logged if the broker
+         * persists. Message handlers are left to the caller.
+         */
+        std::vector<std::shared_ptr<Device>> restore(const std::shared_ptr<Broker>& broker) const;
+
+        size_t getDeviceCount() const;
+        size_t getRetainedCount() const;
+        std::chrono::system_clock::time_point getCreated() const;
+
+    private:
+        // Where a string's bytes sit in the string area
+        struct StringRef {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;        // Reads back as BYTE_ORDER_MARK on the writing host only
+            int64_t created_us;
+            uint64_t device_count;
+            uint64_t device_offset;
+            uint64_t subscription_count;
+            uint64_t subscription_offset;
+            uint64_t retained_count;
+            uint64_t retained_offset;
+            uint64_t strings_offset;
+            uint64_t strings_size;
+        };
+
+        struct DeviceRecord {
+            StringRef id;
+            int64_t telemetry_interval_ms;
+            uint64_t queue_capacity;
+            uint64_t history_capacity;
+            uint32_t overflow_policy;
+            uint32_t reserved;
+            uint64_t first_subscription; // Index into the subscription table
+            uint64_t subscription_count;
+        };
+
+        struct RetainedRecord {
+            StringRef topic;
+            StringRef payload;
+            StringRef properties;       // Message::appendProperties output, empty if none
+            int64_t timestamp_us;
+            uint32_t qos;
+            uint32_t reserved;
+        };
+
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        std::string_view view(const StringRef& ref) const;
+        bool checkTable(uint64_t offset, uint64_t count, size_t record_size) const;
+        bool checkString(const StringRef& ref) const;
+        void close();
+
+        const Header& header() const;
+        const DeviceRecord* devices() const;
+        const StringRef* subscriptions() const;
+        const RetainedRecord* retained() const;
+
+    private:
+        const char* data = nullptr;
+        size_t size = 0;
+        bool mapped = false;
+
+        // Holds the file where it is read rather than mapped; uint64_t keeps records aligned
+        std::vector<uint64_t> buffer;
+    };
+
+} // namespace mqtt
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "InternTable.h"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+namespace mqtt {
+
+    // Forward declaration
+    class Device;
+
+    /**
+     * @brief Subscription index organized by topic level
+     *
+     * Every node owns its exact-match children, an optional single-level (+)
+     * child and the subscribers whose filter ends at that level, either
+     * exactly or with a multi-level (#) wildcard. Matching a topic only
+     * visits the branches that can match it, so the cost grows with topic
+     * depth rather than with the number of subscriptions.
+     *
+     * Filters without wildcards, such as one "command/<id>" per device,
+     * bypass the trie: those InternTable::topics() holds are keyed on their
+     * handle, so they cost no nodes and a topic's handle finds them with
+     * one integer lookup. The trie never interns a filter itself; any other
+     * exact filter, such as a network client's, is keyed on its string and
+     * costs a string lookup per publish while one exists. The trie is only
+     * walked when a wildcard filter exists.
+     */
+    class SubscriptionTrie {
+    public:
+        SubscriptionTrie();
+        ~SubscriptionTrie();
+
+        SubscriptionTrie(const SubscriptionTrie&) = delete;
+        SubscriptionTrie& operator=(const SubscriptionTrie&) = delete;
+
+        /**
+         * @brief Add a subscriber to a topic filter
+         *
+         * Subscribing the same device twice to a filter is a no-op.
+         */
+        void insert(const std::string& filter, const std::shared_ptr<Device>& device);
+
+        /**
+         * @brief Remove a subscriber from a topic filter
+         *
+         * Branches left without subscribers are pruned.
+         */
+        void remove(const std::string& filter, const std::shared_ptr<Device>& device);
+
+        /**
+         * @brief Find the live subscribers whose filter matches a topic
+         *
+         * @return Each matching device once, regardless of how many of its
+         *         filters matched
+         */
+        std::vector<std::shared_ptr<Device>> match(const std::string& topic) const;
+
+        // Same, for a topic from InternTable::topics()
+        std::vector<std::shared_ptr<Device>> match(InternTable::Handle topic) const;
+
+        // Number of filter/subscriber pairs
+        size_t size() const;
+        bool empty() const;
+
+    private:
+        struct Subscriber {
+            std::weak_ptr<Device> device;
+            const Device* address;  // Still known once the device is gone
+        };
+
+        /**
+         * @brief Subscribers of one filter, in no particular order
+         *
+         * Past a few entries a position index keeps duplicate checks and
+         * removals constant-time, so many thousands of devices can share a
+         * filter such as "command/all". Entries of destroyed devices are
+         * skipped by matching and swept out whenever the list doubles.
+         */
+        struct SubscriberList {
+            std::vector<Subscriber> entries;
+            std::unordered_map<const Device*, size_t> positions; // Empty until the list outgrows a scan
+            size_t sweep_at = 0;
+
+            bool empty() const;
+        };
+
+        struct Node {
+            std::unordered_map<std::string, std::unique_ptr<Node>> children;
+            std::unique_ptr<Node> single_level;
+            SubscriberList subscribers;
+            SubscriberList multi_level_subscribers;
+
+            bool isEmpty() const;
+        };
+
+        // Both return the change in the list's entry count
+        static std::ptrdiff_t addSubscriber(SubscriberList& list, const std::shared_ptr<Device>& device);
+        static size_t removeSubscriber(SubscriberList& list, const Device* device);
+        static size_t findSubscriber(const SubscriberList& list, const Device* device);
+        static size_t sweepExpired(SubscriberList& list);
+        static void collect(const SubscriberList& list,
+            std::vector<std::shared_ptr<Device>>& out);
+
+        bool removeFrom(Node& node, const std::string& filter, size_t pos, const Device* device);
+
+        // True if a level of the filter is + or it ends in #
+        static bool hasWildcard(const std::string& filter);
+
+        std::vector<std::shared_ptr<Device>> match(const std::string& topic,
+            std::optional<InternTable::Handle> handle) const;
+        void matchLevel(const Node& node, const std::string& topic, size_t pos,
+            std::string& level, std::vector<std::shared_ptr<Device>>& out) const;
+
+    private:
+        Node root;
+        std::unordered_map<InternTable::Handle, SubscriberList> exact_filters;
+        std::unordered_map<std::string, SubscriberList> named_filters; // Exact filters without a handle
+        size_t subscription_count = 0;
+    };
+
+} // namespace mqtt
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Broker.h"
+#include "Constants.h"
+#include "WireCodec.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mqtt {
+
+    /**
+     * @brief MQTT 5.0 over TCP front end for a Broker
+     *
+     * One thread runs a non-blocking epoll loop over every client socket.
+     * Each connected client is bridged into the broker as a Device without
+     * telemetry: its PUBLISHes go to Broker::publish and its subscriptions
+     * to Broker::subscribe. Deliveries from the delivery workers are encoded
+     * straight into the client's outbound buffer and flushed by the loop,
+     * applying the No Local, Retain As Published and Retain Handling
+     * options of the client's subscriptions.
+     *
+     * QoS 1 and 2 run the full acknowledgement flows in both directions,
+     * tracked per connection by a QoSSession: deliveries respect the
+     * client's Receive Maximum and are retransmitted when unacknowledged
+     * for QOS_RETRY_INTERVAL_MS. Sessions do not outlive their connection
+     * and topic aliases are not accepted.
+     *
+     * Requires Linux; start() fails elsewhere.
+     */
+    class TcpListener {
+    public:
+        /**
+         * @brief Connection and traffic counters
+         */
+        struct Stats {
+            uint64_t connections_accepted = 0;
+            size_t active_connections = 0;   // Connected sockets, including ones still before CONNECT
+            uint64_t packets_received = 0;
+            uint64_t bytes_received = 0;
+            uint64_t bytes_sent = 0;
+            uint64_t protocol_errors = 0;    // Connections closed for violating the protocol
+            uint64_t dropped_deliveries = 0; // Deliveries dropped for a client too far behind
+            uint64_t retransmissions = 0;    // PUBLISH or PUBREL packets sent again after the retry interval
+        };
+
+        explicit TcpListener(std::shared_ptr<Broker> broker);
+
+        // Stops the loop and disconnects all clients
+        ~TcpListener();
+
+        TcpListener(const TcpListener&) = delete;
+        TcpListener& operator=(const TcpListener&) = delete;
+
+        /**
+         * @brief Bind, listen and start the event loop
+         *
+         * Also raises the process's soft open-file limit to its hard limit
+         * so that thousands of clients fit.
+         *
+         * @param address IPv4 address to bind, e.g. "127.0.0.1"
+         * @param port TCP port, 0 for any free port (see getPort)
+         * @return False with a description in error if the socket could not be set up
+         */
+        bool start(const std::string& address, uint16_t port, std::string& error);
+
+        void stop();
+
+        bool isRunning() const;
+
+        // Bound port, valid after start
+        uint16_t getPort() const;
+
+        Stats getStats() const;
+
+    private:
+        struct Connection;
+        struct Shared;
+
+        void eventLoop();
+        void acceptConnections();
+        bool readFrom(Connection& connection);
+        bool processInbound(Connection& connection);
+        bool handlePacket(const std::shared_ptr<Connection>& connection, std::string_view packet);
+        bool handleAck(const std::shared_ptr<Connection>& connection, std::string_view packet);
+        bool handleConnect(const std::shared_ptr<Connection>& connection, std::string_view packet);
+        bool handlePublish(Connection& connection, std::string_view packet);
+        bool handleSubscribe(Connection& connection, std::string_view packet);
+        bool handleUnsubscribe(Connection& connection, std::string_view packet);
+        bool fail(Connection& connection, wire::ReasonCode reason);
+        bool flush(Connection& connection);
+        void flushPending();
+        void sweepConnections();
+        void retransmit(const std::shared_ptr<Connection>& connection, std::chrono::steady_clock::time_point now);
+        void closeConnection(int fd, bool publish_will);
+
+        std::shared_ptr<Broker> broker;
+
+        // State shared with deliveries on the broker's delivery workers,
+        // which may outlive the listener
+        std::shared_ptr<Shared> shared;
+
+        int listen_fd = -1;
+        int epoll_fd = -1;
+        uint16_t port = 0;
+        std::atomic<bool> running{ false };
+        std::thread loop_thread;
+
+        // Owned by the loop thread
+        std::unordered_map<int, std::shared_ptr<Connection>> connections;
+        std::unordered_map<std::string, int> client_ids;
+
+        // Numbers for assigned mqttsim-N ids; freed ones are reused so the
+        // assigned ids stay bounded by the peak connection count
+        uint64_t assigned_client_ids = 0;
+        std::vector<uint64_t> free_assigned_ids;
+    };
+
+} // namespace mqtt
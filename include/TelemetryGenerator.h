@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+namespace mqtt {
+
+    /**
+     * @brief Simulated sensor readings formatted as a JSON telemetry payload
+     *
+     * Draws from a small xorshift generator seeded once per instance and
+     * formats with std::to_chars into an internal buffer, so producing a
+     * payload never allocates. Not thread-safe; give each device (or
+     * worker) its own instance.
+     */
+    class TelemetryGenerator {
+    public:
+        explicit TelemetryGenerator(uint64_t seed);
+
+        /**
+         * @brief Format a new set of readings
+         *
+         * @return View into the internal buffer, valid until the next call
+         */
+        std::string_view next(std::chrono::system_clock::time_point now = std::chrono::system_clock::now());
+
+        // Uniform random values
+        uint64_t nextRandom();
+        double uniform(double min, double max);
+        int uniformInt(int min, int max);
+
+    private:
+        // Largest payload: four readings plus a 20-digit timestamp and keys
+        static constexpr size_t BUFFER_SIZE = 160;
+
+        uint64_t state;
+        char buffer[BUFFER_SIZE];
+    };
+
+} // namespace mqtt
@@ -5,6 +5,7 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <chrono>
 #include <map>
 #include <string>
 
@@ -133,18 +134,38 @@ namespace visualization {
     public:
         NetworkOverview(std::shared_ptr<mqtt::Broker> broker,
             const std::vector<std::shared_ptr<mqtt::Device>>& devices,
-            std::function<void()> add_device_callback);
+            std::function<void()> add_device_callback,
+            std::function<bool()> save_snapshot_callback);
         void render() override;
 
     private:
         void renderBrokerInfo();
         void renderDeviceControls();
         void renderStatistics();
+        void renderLatency();
         void calculateStatistics(size_t& total_pub, size_t& total_sub, float& message_rate);
 
         std::shared_ptr<mqtt::Broker> broker;
         const std::vector<std::shared_ptr<mqtt::Device>>& devices;
         std::function<void()> add_device_callback;
+        std::function<bool()> save_snapshot_callback;
+
+        // Index into mqtt::LatencyStage, end to end by default
+        int latency_stage = 3;
+
+        // Publish rate, sampled from the broker's counters about once a second
+        std::chrono::steady_clock::time_point rate_window_start{};
+        size_t rate_window_publishes = 0;
+        float publish_rate = 0.0f;
+
+        // Metrics lines, collected about every METRICS_PANEL_REFRESH_MS rather than each frame
+        std::chrono::steady_clock::time_point metrics_collected_at{};
+        std::vector<std::string> metric_lines;
+
+        bool metrics_dump_attempted = false;
+        bool metrics_dumped = false;
+        bool snapshot_save_attempted = false;
+        bool snapshot_saved = false;
     };
 
 } // namespace visualization
\ No newline at end of file
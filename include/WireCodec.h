@@ -0,0 +1,329 @@
+#pragma once
+
+#include "Message.h"
+#include "QoS.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace mqtt {
+    namespace wire {
+
+        // Largest value a variable byte integer can carry (four bytes)
+        constexpr uint32_t MAX_VARIABLE_INT = 268435455;
+
+        // Longest encoded variable byte integer
+        constexpr size_t MAX_VARIABLE_INT_SIZE = 4;
+
+        // Longest fixed header: type/flags byte plus remaining length
+        constexpr size_t MAX_FIXED_HEADER_SIZE = 1 + MAX_VARIABLE_INT_SIZE;
+
+        // SUBSCRIBE options byte: maximum QoS in bits 0-1, these flags, then retain handling in bits 4-5
+        constexpr uint8_t SUBSCRIBE_NO_LOCAL = 0x04;
+        constexpr uint8_t SUBSCRIBE_RETAIN_AS_PUBLISHED = 0x08;
+        constexpr unsigned SUBSCRIBE_RETAIN_HANDLING_SHIFT = 4;
+
+        /**
+         * @brief MQTT 5.0 control packet types (high nibble of the first byte)
+         */
+        enum class PacketType : uint8_t {
+            Connect = 1,
+            Connack = 2,
+            Publish = 3,
+            Puback = 4,
+            Pubrec = 5,
+            Pubrel = 6,
+            Pubcomp = 7,
+            Subscribe = 8,
+            Suback = 9,
+            Unsubscribe = 10,
+            Unsuback = 11,
+            Pingreq = 12,
+            Pingresp = 13,
+            Disconnect = 14,
+            Auth = 15
+        };
+
+        /**
+         * @brief Property identifiers
+         */
+        enum class PropertyId : uint8_t {
+            PayloadFormatIndicator = 0x01,
+            MessageExpiryInterval = 0x02,
+            ContentType = 0x03,
+            ResponseTopic = 0x08,
+            CorrelationData = 0x09,
+            SubscriptionIdentifier = 0x0B,
+            SessionExpiryInterval = 0x11,
+            AssignedClientIdentifier = 0x12,
+            ServerKeepAlive = 0x13,
+            AuthenticationMethod = 0x15,
+            AuthenticationData = 0x16,
+            RequestProblemInformation = 0x17,
+            WillDelayInterval = 0x18,
+            RequestResponseInformation = 0x19,
+            ResponseInformation = 0x1A,
+            ServerReference = 0x1C,
+            ReasonString = 0x1F,
+            ReceiveMaximum = 0x21,
+            TopicAliasMaximum = 0x22,
+            TopicAlias = 0x23,
+            MaximumQoS = 0x24,
+            RetainAvailable = 0x25,
+            UserProperty = 0x26,
+            MaximumPacketSize = 0x27,
+            WildcardSubscriptionAvailable = 0x28,
+            SubscriptionIdentifierAvailable = 0x29,
+            SharedSubscriptionAvailable = 0x2A
+        };
+
+        /**
+         * @brief Reason codes the simulator sends or acts on
+         */
+        enum class ReasonCode : uint8_t {
+            Success = 0x00,               // Also Normal Disconnection and Granted QoS 0
+            GrantedQoS1 = 0x01,
+            GrantedQoS2 = 0x02,
+            DisconnectWithWill = 0x04,
+            NoMatchingSubscribers = 0x10,
+            NoSubscriptionExisted = 0x11,
+            UnspecifiedError = 0x80,
+            MalformedPacket = 0x81,
+            ProtocolError = 0x82,
+            ImplementationSpecificError = 0x83,
+            UnsupportedProtocolVersion = 0x84,
+            ClientIdentifierNotValid = 0x85,
+            ServerBusy = 0x89,
+            ServerShuttingDown = 0x8B,
+            KeepAliveTimeout = 0x8D,
+            SessionTakenOver = 0x8E,
+            TopicFilterInvalid = 0x8F,
+            TopicNameInvalid = 0x90,
+            PacketIdentifierInUse = 0x91,
+            PacketIdentifierNotFound = 0x92,
+            ReceiveMaximumExceeded = 0x93,
+            TopicAliasInvalid = 0x94,
+            PacketTooLarge = 0x95,
+            QuotaExceeded = 0x97,
+            PayloadFormatInvalid = 0x99
+        };
+
+        enum class DecodeStatus {
+            Ok,
+            Incomplete, // More bytes are needed; nothing was consumed
+            Malformed   // The input violates the protocol; drop the connection
+        };
+
+        /**
+         * @brief A decoded PUBLISH packet, viewing the input buffer
+         *
+         * All string_views point into the buffer passed to decodePublish and
+         * are only valid while it is. Strings have been checked for
+         * well-formed UTF-8 without U+0000, as the specification requires.
+         */
+        struct PublishView {
+            size_t packet_size = 0; // Bytes consumed from the input, fixed header included
+
+            bool duplicate = false;
+            QoS qos = QoS::AT_MOST_ONCE;
+            bool retained = false;
+            std::string_view topic; // Empty when the sender relies on a topic alias
+            uint16_t packet_id = 0; // Present only for QoS 1 and 2
+            std::string_view payload;
+
+            // MQTT 5.0 properties, zero/empty when absent
+            bool payload_is_utf8 = false;
+            bool has_message_expiry = false;
+            uint32_t message_expiry_interval = 0;
+            uint16_t topic_alias = 0;
+            std::string_view content_type;
+            std::string_view response_topic;
+            std::string_view correlation_data;
+            size_t user_property_count = 0;
+
+            // Raw property section, walked by nextUserProperty
+            std::string_view properties;
+
+            /**
+             * @brief Step through user properties in wire order
+             *
+             * Start with cursor at 0 and call until it returns false.
+             */
+            bool nextUserProperty(size_t& cursor, std::string_view& key, std::string_view& value) const;
+        };
+
+        //-------------------------------------------------------------------------
+        // Variable byte integers
+        //-------------------------------------------------------------------------
+
+        // Bytes needed to encode value, 0 if it exceeds MAX_VARIABLE_INT
+        size_t variableIntSize(uint32_t value);
+
+        /**
+         * @brief Encode a variable byte integer
+         *
+         * @param out Must have room for variableIntSize(value) bytes
+         * @return Bytes written, 0 if value exceeds MAX_VARIABLE_INT
+         */
+        size_t encodeVariableInt(uint32_t value, char* out);
+
+        /**
+         * @brief Decode a variable byte integer from the start of input
+         *
+         * Rejects a fifth continuation byte and non-minimal encodings.
+         */
+        DecodeStatus decodeVariableInt(std::string_view input, uint32_t& value, size_t& length);
+
+        //-------------------------------------------------------------------------
+        // Packets
+        //-------------------------------------------------------------------------
+
+        /**
+         * @brief Read the fixed header of the next packet on a stream
+         *
+         * Lets a reader frame packets before deciding how to decode them.
+         *
+         * @param packet_size Fixed header plus remaining length, on success
+         */
+        DecodeStatus peekPacket(std::string_view input, PacketType& type, uint8_t& flags, size_t& packet_size);
+
+        // Encoded size of a PUBLISH for message, 0 if it cannot be encoded
+        size_t publishSize(const Message& message);
+
+        /**
+         * @brief Serialize message as an MQTT 5.0 PUBLISH packet
+         *
+         * Writes into the caller's buffer and never allocates. Topic, QoS,
+         * retain flag, payload and the message's MQTT 5.0 properties are
+         * encoded; sender, target and trace data are simulator-only.
+         *
+         * @param packet_id Required (non-zero) for QoS 1 and 2, ignored for QoS 0
+         * @return Bytes written, 0 if the buffer is too small or the message
+         *         cannot be encoded (missing packet id, oversized field)
+         */
+        size_t encodePublish(const Message& message, char* out, size_t capacity,
+            uint16_t packet_id = 0, bool duplicate = false);
+
+        /**
+         * @brief Parse the PUBLISH packet at the start of input
+         *
+         * Does not allocate; the result views input. Trailing bytes after
+         * the packet are left for the caller (see PublishView::packet_size).
+         */
+        DecodeStatus decodePublish(std::string_view input, PublishView& publish);
+
+        // Build a Message from a decoded packet, copying its contents
+        Message toMessage(const PublishView& publish);
+
+        //-------------------------------------------------------------------------
+        // Control packets
+        //
+        // Each view describes a packet to encode, or is filled in by the
+        // matching decoder with string_views into its input. Decoders parse
+        // the packet at the start of input and report its size; encoders
+        // return the bytes written, or 0 if the buffer is too small.
+        //-------------------------------------------------------------------------
+
+        struct ConnectView {
+            size_t packet_size = 0;
+            uint8_t protocol_version = 5;          // Decoding stops after this unless it is 5
+            bool clean_start = true;
+            uint16_t keep_alive = 0;               // Seconds, 0 disables keep-alive
+            uint32_t session_expiry_interval = 0;
+            uint16_t receive_maximum = 65535;      // Unacknowledged QoS 1/2 PUBLISHes the client accepts
+            uint32_t maximum_packet_size = 0;      // 0 = no limit
+            std::string_view client_id;            // May be empty; the server assigns one
+
+            bool has_will = false;
+            QoS will_qos = QoS::AT_MOST_ONCE;
+            bool will_retained = false;
+            std::string_view will_topic;
+            std::string_view will_payload;
+
+            std::string_view username;             // Empty = absent
+            std::string_view password;
+        };
+
+        struct ConnackView {
+            size_t packet_size = 0;
+            bool session_present = false;
+            ReasonCode reason = ReasonCode::Success;
+            uint16_t receive_maximum = 65535;      // Unacknowledged QoS 1/2 PUBLISHes the server accepts
+            uint16_t topic_alias_maximum = 0;
+            uint32_t maximum_packet_size = 0;      // 0 = no limit
+            uint16_t server_keep_alive = 0;        // 0 = the client's keep-alive stands
+            std::string_view assigned_client_id;
+        };
+
+        // PUBACK, PUBREC, PUBREL or PUBCOMP
+        struct AckView {
+            size_t packet_size = 0;
+            PacketType type = PacketType::Puback;
+            uint16_t packet_id = 0;
+            ReasonCode reason = ReasonCode::Success;
+        };
+
+        struct SubscribeView {
+            size_t packet_size = 0;
+            uint16_t packet_id = 0;
+            uint32_t subscription_identifier = 0;  // 0 = absent
+            size_t filter_count = 0;
+            std::string_view filters;              // Raw payload, walked by nextFilter
+
+            // Step through filters and their subscription options byte
+            bool nextFilter(size_t& cursor, std::string_view& filter, uint8_t& options) const;
+        };
+
+        struct UnsubscribeView {
+            size_t packet_size = 0;
+            uint16_t packet_id = 0;
+            size_t filter_count = 0;
+            std::string_view filters;
+
+            bool nextFilter(size_t& cursor, std::string_view& filter) const;
+        };
+
+        // SUBACK or UNSUBACK; one reason code byte per requested filter
+        struct SubackView {
+            size_t packet_size = 0;
+            PacketType type = PacketType::Suback;
+            uint16_t packet_id = 0;
+            std::string_view reason_codes;
+        };
+
+        struct DisconnectView {
+            size_t packet_size = 0;
+            ReasonCode reason = ReasonCode::Success;
+        };
+
+        DecodeStatus decodeConnect(std::string_view input, ConnectView& connect);
+        DecodeStatus decodeConnack(std::string_view input, ConnackView& connack);
+        DecodeStatus decodeAck(std::string_view input, AckView& ack);
+        DecodeStatus decodeSubscribe(std::string_view input, SubscribeView& subscribe);
+        DecodeStatus decodeUnsubscribe(std::string_view input, UnsubscribeView& unsubscribe);
+        DecodeStatus decodeSuback(std::string_view input, SubackView& suback);
+        DecodeStatus decodeDisconnect(std::string_view input, DisconnectView& disconnect);
+
+        size_t encodeConnect(const ConnectView& connect, char* out, size_t capacity);
+        size_t encodeConnack(const ConnackView& connack, char* out, size_t capacity);
+        size_t encodeAck(PacketType type, uint16_t packet_id, ReasonCode reason, char* out, size_t capacity);
+        size_t encodeSubscribe(uint16_t packet_id, const std::string_view* filters, size_t count,
+            QoS maximum_qos, char* out, size_t capacity);
+        size_t encodeUnsubscribe(uint16_t packet_id, const std::string_view* filters, size_t count,
+            char* out, size_t capacity);
+        size_t encodeSuback(PacketType type, uint16_t packet_id, const ReasonCode* reasons, size_t count,
+            char* out, size_t capacity);
+        size_t encodeDisconnect(ReasonCode reason, char* out, size_t capacity);
+
+        // PINGREQ or PINGRESP, always two bytes
+        size_t encodePing(PacketType type, char* out, size_t capacity);
+
+        /**
+         * @brief Check topic filter syntax
+         *
+         * "#" must be a whole level and the last one; "+" must be a whole level.
+         */
+        bool validTopicFilter(std::string_view filter);
+
+    } // namespace wire
+} // namespace mqtt
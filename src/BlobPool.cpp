@@ -0,0 +1,71 @@
+#include "BlobPool.h"
+
+namespace mqtt {
+
+    namespace {
+
+        // Heap bytes behind a string beyond its inline buffer
+        size_t heapBytes(const std::string& text) {
+            return text.capacity() > std::string().capacity() ? text.capacity() + 1 : 0;
+        }
+
+    }
+
+    uint32_t BlobPool::acquire(std::string_view bytes) {
+        auto it = index.find(bytes);
+        if (it != index.end()) {
+            slots[it->second].references++;
+            return it->second;
+        }
+
+        uint32_t handle;
+        if (!free_slots.empty()) {
+            handle = free_slots.back();
+            free_slots.pop_back();
+        }
+        else {
+            handle = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+        Slot& slot = slots[handle];
+        slot.bytes.assign(bytes.data(), bytes.size());
+        slot.references = 1;
+        index.emplace(std::string_view(slot.bytes), handle);
+        content_bytes += slot.bytes.size();
+        string_heap_bytes += heapBytes(slot.bytes);
+        return handle;
+    }
+
+    void BlobPool::retain(uint32_t handle) {
+        slots[handle].references++;
+    }
+
+    void BlobPool::release(uint32_t handle) {
+        Slot& slot = slots[handle];
+        if (--slot.references > 0) {
+            return;
+        }
+        index.erase(std::string_view(slot.bytes));
+        content_bytes -= slot.bytes.size();
+        string_heap_bytes -= heapBytes(slot.bytes);
+        std::string().swap(slot.bytes);
+        free_slots.push_back(handle);
+    }
+
+    size_t BlobPool::size() const {
+        return index.size();
+    }
+
+    size_t BlobPool::contentBytes() const {
+        return content_bytes;
+    }
+
+    size_t BlobPool::memoryBytes() const {
+        // Hash nodes hold a view, a handle and the next pointer
+        const size_t index_node = sizeof(void*) + sizeof(std::string_view) + sizeof(uint32_t) + sizeof(size_t);
+        return slots.size() * sizeof(Slot) + string_heap_bytes +
+            free_slots.capacity() * sizeof(uint32_t) +
+            index.bucket_count() * sizeof(void*) + index.size() * index_node;
+    }
+
+} // namespace mqtt
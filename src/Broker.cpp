@@ -1,123 +1,477 @@
 #include "Broker.h"
 #include "Device.h"
 #include <algorithm>
-#include <regex>
 
 namespace mqtt {
 
-    Broker::Broker(const std::string& id)
-        : broker_id(id), running(true) {
-        processing_thread = std::thread(&Broker::processMessages, this);
+    Broker::DispatchShard::DispatchShard(size_t capacity)
+        : message_queue(capacity),
+        dispatcher_idle(false),
+        dispatcher_wakeups(0) {
+    }
+
+    Broker::Broker(const std::string& id, size_t dispatch_threads, size_t delivery_threads)
+        : broker_id(id),
+        publishes_metric(metrics.counter("mqttsim_publishes_total", "Messages accepted by publish()")),
+        deliveries_metric(metrics.counter("mqttsim_deliveries_total", "Messages handed to subscribers")),
+        drops_metric(metrics.counter("mqttsim_dropped_total", "Messages dispatched without a matching subscriber")),
+        subscriber_drops_metric(metrics.counter("mqttsim_subscriber_dropped_total", "Deliveries discarded by full subscriber queues")),
+        subscriber_blocks_metric(metrics.counter("mqttsim_subscriber_blocked_total", "Deliveries that waited for room in a subscriber queue")),
+        subscriber_disconnects_metric(metrics.counter("mqttsim_subscriber_disconnects_total", "Subscribers cut off for overflowing their queue")),
+        match_time_metric(metrics.duration("mqttsim_match_seconds", "Time spent matching topics to subscribers")),
+        lock_wait_metric(metrics.duration("mqttsim_lock_wait_seconds", "Time dispatchers waited for broker locks")),
+        running(true),
+        delivery_workers(std::make_unique<Scheduler>(delivery_threads)),
+        message_history(mqtt::constants::BROKER_MESSAGE_HISTORY_SIZE),
+        latency_tracker(std::make_shared<LatencyTracker>()) {
+        if (dispatch_threads == 0) {
+            dispatch_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        size_t capacity = std::max(mqtt::constants::BROKER_INGRESS_QUEUE_CAPACITY / dispatch_threads,
+            mqtt::constants::BROKER_MIN_SHARD_QUEUE_CAPACITY);
+
+        for (size_t i = 0; i < dispatch_threads; i++) {
+            shards.push_back(std::make_unique<DispatchShard>(capacity));
+        }
+        metrics.gauge("mqttsim_ingress_queue_depth", "Messages waiting for dispatch", [this] {
+            return static_cast<double>(getIngressStats().queue_depth);
+            });
+        metrics.gauge("mqttsim_retained_messages", "Topics holding a retained message", [this] {
+            std::lock_guard<std::mutex> lock(mutex);
+            return static_cast<double>(retained_messages.size());
+            });
+        metrics.gauge("mqttsim_retained_bytes", "Estimated heap use of the retained store", [this] {
+            return static_cast<double>(getRetainedMemoryUsage().total_bytes);
+            });
+        metrics.gauge("mqttsim_log_bytes", "Size of the persistence log on disk", [this] {
+            return static_cast<double>(getLogStats().bytes);
+            });
+        metrics.gauge("mqttsim_retained_unique_payloads", "Distinct payloads among retained messages", [this] {
+            return static_cast<double>(getRetainedMemoryUsage().payloads);
+            });
+        metrics.gauge("mqttsim_interned_topics", "Distinct topics and filters given a handle, process-wide", [] {
+            return static_cast<double>(InternTable::topics().size());
+            });
+        metrics.gauge("mqttsim_interned_bytes", "Estimated heap use of the topic and client id tables", [] {
+            return static_cast<double>(InternTable::topics().memoryUsage() + InternTable::clients().memoryUsage());
+            });
+
+        for (auto& shard : shards) {
+            shard->processing_thread = std::thread(&Broker::processMessages, this, std::ref(*shard));
+        }
     }
 
     Broker::~Broker() {
         running = false;
-        if (processing_thread.joinable()) {
-            processing_thread.join();
+        for (auto& shard : shards) {
+            {
+                std::lock_guard<std::mutex> lock(shard->wake_mutex);
+            }
+            shard->message_condition.notify_all();
+        }
+        for (auto& shard : shards) {
+            if (shard->processing_thread.joinable()) {
+                shard->processing_thread.join();
+            }
+        }
+
+        // Stops early once running is false, discarding what it wrote
+        if (compaction_thread.joinable()) {
+            compaction_thread.join();
         }
+
+        // Nothing queues deliveries any more; wait for handlers still running.
+        // A drain may re-post itself meanwhile, so the workers must stay reachable
+        delivery_workers->stop();
     }
 
-    void Broker::subscribe(const std::string& topic, std::shared_ptr<Device> device) {
-        std::lock_guard<std::mutex> lock(mutex);
-        topic_subscriptions[topic].push_back(device);
-        // Send messages that match
-        for (const auto& retained : retained_messages) {
-            if (topicMatches(topic, retained.first)) {
-                device->receiveMessage(retained.second);
+    void Broker::subscribe(const std::string& topic, std::shared_ptr<Device> device, bool replay_retained) {
+        {
+            std::unique_lock<std::shared_mutex> lock(subscription_mutex);
+            subscriptions.insert(topic, device);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (persistent_log && persisted_subscriptions.emplace(device->getId(), topic).second) {
+                persistent_log->appendSubscribe(device->getId(), topic);
+                afterLogAppend();
             }
         }
+        if (replay_retained) {
+            replayRetained(topic, device);
+        }
+    }
+
+    void Broker::replayRetained(const std::string& topic, const std::shared_ptr<Device>& device) {
+        // Replay matching retained messages a chunk at a time, delivering
+        // each chunk without any broker lock so publishes are not held up
+        std::vector<Message> matching;
+        std::string cursor;
+        size_t found = 0;
+        do {
+            matching.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                found = retained_messages.collect(topic, cursor,
+                    mqtt::constants::BROKER_RETAINED_REPLAY_CHUNK, matching);
+            }
+            for (const auto& retained : matching) {
+                deliverTo(device, retained);
+            }
+        } while (found == mqtt::constants::BROKER_RETAINED_REPLAY_CHUNK);
     }
 
     void Broker::unsubscribe(const std::string& topic, std::shared_ptr<Device> device) {
+        {
+            std::unique_lock<std::shared_mutex> lock(subscription_mutex);
+            subscriptions.remove(topic, device);
+        }
         std::lock_guard<std::mutex> lock(mutex);
-        auto& subscribers = topic_subscriptions[topic];
-        subscribers.erase(
-            std::remove_if(subscribers.begin(), subscribers.end(),
-                [&device](const std::weak_ptr<Device>& wp) {
-                    auto sp = wp.lock();
-                    return !sp || sp.get() == device.get();
-                }),
-            subscribers.end());
+        if (persistent_log && persisted_subscriptions.erase({ device->getId(), topic }) > 0) {
+            persistent_log->appendUnsubscribe(device->getId(), topic);
+            afterLogAppend();
+        }
     }
 
     void Broker::publish(const Message& message) {
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            message_queue.push(message);
-            // Store messages
-            if (message.isRetained()) {
-                retained_messages[message.getTopic()] = message;
-            }
-            // Add to history
-            message_history.push_back(message);
-            if (message_history.size() > MAX_HISTORY_SIZE) {
-                message_history.erase(message_history.begin());
-            }
+        DispatchShard& shard = shardFor(message);
+        Message queued = message;
+        queued.markTrace(TracePoint::Publish);
+        shard.message_queue.push(std::move(queued), [](Message& stored) {
+            stored.markTrace(TracePoint::Enqueue);
+            });
+        publishes_metric.add();
+
+        // Pairs with the fence in processMessages: either the dispatcher sees
+        // the new message before sleeping, or we see that it is asleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (shard.dispatcher_idle.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(shard.wake_mutex);
+            shard.dispatcher_wakeups.fetch_add(1, std::memory_order_relaxed);
+            shard.message_condition.notify_one();
         }
-        // Notify processing thread
-        // message_condition.notify_one(); TODO: notify processing thread of message
     }
 
-    const std::vector<Message>& Broker::getMessageHistory() const {
-        return message_history;
+    std::vector<Message> Broker::getMessageHistory() const {
+        return message_history.snapshot();
+    }
+
+    uint64_t Broker::getMessageHistoryVersion() const {
+        return message_history.version();
+    }
+
+    std::shared_ptr<LatencyTracker> Broker::getLatencyTracker() const {
+        return latency_tracker;
+    }
+
+    const MetricsRegistry& Broker::getMetrics() const {
+        return metrics;
     }
 
     const std::string& Broker::getId() const {
         return broker_id;
     }
 
-    void Broker::processMessages() {
-        while (running) {
-            Message message;    {
+    Broker::IngressStats Broker::getIngressStats() const {
+        IngressStats stats;
+        for (const auto& shard : shards) {
+            auto queue_stats = shard->message_queue.getStats();
+            stats.published += queue_stats.pushes;
+            stats.contended_publishes += queue_stats.contended_pushes;
+            stats.full_waits += queue_stats.full_waits;
+            stats.dispatcher_wakeups += shard->dispatcher_wakeups.load(std::memory_order_relaxed);
+            stats.queue_depth += shard->message_queue.sizeApprox();
+        }
+        return stats;
+    }
+
+    size_t Broker::getDispatchThreadCount() const {
+        return shards.size();
+    }
+
+    RetainedStore::MemoryUsage Broker::getRetainedMemoryUsage() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return retained_messages.memoryUsage();
+    }
+
+    bool Broker::enablePersistence(const std::string& directory, std::string& error) {
+        auto log = std::make_unique<PersistentLog>(directory);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (persistent_log) {
+            error = "Persistence is already enabled in " + persistent_log->getDirectory();
+            return false;
+        }
+        if (!log->open(retained_messages, persisted_subscriptions, error)) {
+            return false;
+        }
+        persistent_log = std::move(log);
+        afterLogAppend();
+        return true;
+    }
+
+    std::vector<std::string> Broker::getPersistedSubscriptions(const std::string& client_id) const {
+        std::vector<std::string> filters;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = persisted_subscriptions.lower_bound({ client_id, std::string() });
+            it != persisted_subscriptions.end() && it->first == client_id; ++it) {
+            filters.push_back(it->second);
+        }
+        return filters;
+    }
+
+    bool Broker::compactLog() {
+        std::unique_lock<std::mutex> lock(mutex);
+        compaction_done.wait(lock, [this] { return !compacting; });
+        if (!persistent_log) {
+            return false;
+        }
+        auto compaction = persistent_log->beginCompaction();
+        if (!compaction) {
+            return false;
+        }
+        compacting = true;
+        lock.unlock();
+        return writeCompaction(std::move(compaction));
+    }
+
+    PersistentLog::Stats Broker::getLogStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return persistent_log ? persistent_log->getStats() : PersistentLog::Stats();
+    }
+
+    void Broker::forEachRetained(const std::function<void(const Message&)>& visit) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        retained_messages.forEach(visit);
+    }
+
+    void Broker::restoreRetained(const Message& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        retained_messages.store(message);
+        if (persistent_log) {
+            persistent_log->appendRetained(message);
+            afterLogAppend();
+        }
+    }
+
+    void Broker::afterLogAppend() {
+        if (compacting || !persistent_log->needsCompaction()) {
+            return;
+        }
+        auto compaction = persistent_log->beginCompaction();
+        if (!compaction) {
+            return;
+        }
+        compacting = true;
+
+        // The previous thread cleared compacting and has nothing left to do
+        if (compaction_thread.joinable()) {
+            compaction_thread.join();
+        }
+        compaction_thread = std::thread(&Broker::writeCompaction, this, std::move(compaction));
+    }
+
+    bool Broker::writeCompaction(std::unique_ptr<PersistentLog::Compaction> compaction) {
+        // Appends since beginCompaction replay after the compacted segment,
+        // so the state may keep changing between chunks
+        std::vector<Message> chunk;
+        std::string cursor;
+        size_t found = 0;
+        do {
+            chunk.clear();
+            {
                 std::lock_guard<std::mutex> lock(mutex);
-                if (!message_queue.empty()) {
-                    message = message_queue.front();
-                    message_queue.pop();
-                }
+                found = retained_messages.collectAll(cursor, mqtt::constants::BROKER_RETAINED_REPLAY_CHUNK, chunk);
+            }
+            for (const auto& retained : chunk) {
+                compaction->addRetained(retained);
             }
-            if (!message.getTopic().empty()) {
+        } while (found == mqtt::constants::BROKER_RETAINED_REPLAY_CHUNK && running);
+
+        std::set<PersistentLog::Subscription> subscriptions;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            subscriptions = persisted_subscriptions;
+        }
+        for (const auto& subscription : subscriptions) {
+            compaction->addSubscription(subscription);
+        }
+        bool committed = running && compaction->commit();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        persistent_log->finishCompaction(*compaction);
+        compacting = false;
+        compaction_done.notify_all();
+        return committed;
+    }
+
+    void Broker::setHistoryCapacity(size_t capacity) {
+        message_history.setCapacity(capacity);
+    }
+
+    Broker::DispatchShard& Broker::shardFor(const Message& message) {
+        if (shards.size() == 1) {
+            return *shards[0];
+        }
+        InternTable::Handle topic = message.getTopicHandle();
+        size_t key = topic != InternTable::EMPTY ? topic : std::hash<std::string>{}(message.getTopic());
+        return *shards[key % shards.size()];
+    }
+
+    void Broker::processMessages(DispatchShard& shard) {
+        Message message;
+        while (running) {
+            // Drain everything published to this shard so far
+            bool drained_any = false;
+            while (running && shard.message_queue.tryPop(message)) {
+                message.markTrace(TracePoint::Dispatch);
                 distributeMessage(message);
+                drained_any = true;
+            }
+            if (drained_any) {
+                continue;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(mqtt::constants::MESSAGE_PROCESSING_INTERVAL_MS));
+
+            // Sleep until a publisher signals new work
+            std::unique_lock<std::mutex> lock(shard.wake_mutex);
+            shard.dispatcher_idle.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            shard.message_condition.wait(lock, [this, &shard] {
+                return !running || !shard.message_queue.empty();
+                });
+            shard.dispatcher_idle.store(false, std::memory_order_relaxed);
         }
     }
 
     void Broker::distributeMessage(const Message& message) {
-        std::lock_guard<std::mutex> lock(mutex);
+        // Store messages; replays to later subscribers are not live deliveries,
+        // so retained copies drop their trace
+        if (message.isRetained()) {
+            Message retained = message;
+            retained.clearTrace();
+            auto wait_start = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            lock_wait_metric.record(std::chrono::steady_clock::now() - wait_start);
+            retained_messages.store(retained);
+            if (persistent_log) {
+                persistent_log->appendRetained(retained);
+                afterLogAppend();
+            }
+        }
+        // Add to history (readers lock one slot at a time, never the whole buffer)
+        message_history.push_back(message);
 
-        for (const auto& subscription : topic_subscriptions) {
-            if (topicMatches(subscription.first, message.getTopic())) {
-                for (auto& weak_device : subscription.second) {
-                    if (auto device = weak_device.lock()) {
-                        Message outgoing_message = message;
-                        outgoing_message.setTargetId(device->getId());
-                        device->receiveMessage(outgoing_message);
-                    }
-                }
+        // Resolve subscribers under a short read lock, deliver outside it
+        std::vector<std::shared_ptr<Device>> subscribers;
+        {
+            auto wait_start = std::chrono::steady_clock::now();
+            std::shared_lock<std::shared_mutex> lock(subscription_mutex);
+            auto match_start = std::chrono::steady_clock::now();
+            lock_wait_metric.record(match_start - wait_start);
+            InternTable::Handle topic = message.getTopicHandle();
+            if (topic != InternTable::EMPTY) {
+                subscribers = subscriptions.match(topic);
+            }
+            else {
+                subscribers = subscriptions.match(message.getTopic());
             }
+            match_time_metric.record(std::chrono::steady_clock::now() - match_start);
+        }
+        if (subscribers.empty()) {
+            drops_metric.add();
+            return;
+        }
+        for (const auto& device : subscribers) {
+            Message outgoing_message = message;
+            outgoing_message.setTargetHandle(device->getHandle());
+            deliverTo(device, outgoing_message);
+        }
+        deliveries_metric.add(subscribers.size());
+    }
+
+    void Broker::deliverTo(const std::shared_ptr<Device>& device, const Message& message) {
+        bool schedule = false;
+        DeliveryQueue::Admission admission = device->receiveMessage(message, schedule);
+        if (schedule) {
+            scheduleDrain(device);
+        }
+        switch (admission) {
+        case DeliveryQueue::Admission::Accepted:
+            break;
+        case DeliveryQueue::Admission::Waited:
+            subscriber_blocks_metric.add();
+            break;
+        case DeliveryQueue::Admission::DroppedOldest:
+        case DeliveryQueue::Admission::DroppedNewest:
+            subscriber_drops_metric.add();
+            break;
+        case DeliveryQueue::Admission::Disconnected:
+            subscriber_drops_metric.add();
+            subscriber_disconnects_metric.add();
+            break;
         }
     }
 
+    void Broker::scheduleDrain(const std::shared_ptr<Device>& device) {
+        delivery_workers->post([this, weak_device = std::weak_ptr<Device>(device)] {
+            if (auto target = weak_device.lock()) {
+                // Re-posted rather than looped, so one busy device cannot hold a worker
+                if (target->drainDeliveries()) {
+                    scheduleDrain(target);
+                }
+            }
+            });
+    }
+
     bool Broker::topicMatches(const std::string& subscription, const std::string& topic) {
         if (subscription == topic) {
             return true;
         }
-        // Single-level wildcard +
-        if (subscription.find('+') != std::string::npos) {
-            std::string sub_regex = subscription;
-            size_t pos = 0;
-            while ((pos = sub_regex.find('+', pos)) != std::string::npos) {
-                sub_regex.replace(pos, 1, "[^/]+");
-                pos += 5;
-            }
-            // regex matching
-            return std::regex_match(topic, std::regex(sub_regex));
+        // Wildcards at the first level never match topics starting with '$'
+        if (!topic.empty() && topic[0] == '$' &&
+            !subscription.empty() && (subscription[0] == '+' || subscription[0] == '#')) {
+            return false;
         }
-        // Multi-level wildcard #
-        if (subscription.back() == '#') {
-            std::string prefix = subscription.substr(0, subscription.length() - 1);
-            return topic.substr(0, prefix.length()) == prefix;
+
+        // Compare level by level
+        size_t sub_pos = 0;
+        size_t topic_pos = 0;
+        while (true) {
+            size_t sub_end = subscription.find('/', sub_pos);
+            if (sub_end == std::string::npos) {
+                sub_end = subscription.size();
+            }
+            bool sub_last = (sub_end == subscription.size());
+
+            // Multi-level wildcard # matches the parent level and everything below
+            if (sub_last && subscription.compare(sub_pos, sub_end - sub_pos, "#") == 0) {
+                return true;
+            }
+            if (topic_pos > topic.size()) {
+                return false;
+            }
+
+            size_t topic_end = topic.find('/', topic_pos);
+            if (topic_end == std::string::npos) {
+                topic_end = topic.size();
+            }
+            bool topic_last = (topic_end == topic.size());
+
+            // Single-level wildcard + matches any one level
+            bool single_level = subscription.compare(sub_pos, sub_end - sub_pos, "+") == 0;
+            if (!single_level && (sub_end - sub_pos != topic_end - topic_pos ||
+                subscription.compare(sub_pos, sub_end - sub_pos, topic, topic_pos, topic_end - topic_pos) != 0)) {
+                return false;
+            }
+
+            if (sub_last) {
+                return topic_last;
+            }
+            if (topic_last) {
+                // "a/#" also matches "a"
+                return subscription.compare(sub_end + 1, std::string::npos, "#") == 0;
+            }
+            sub_pos = sub_end + 1;
+            topic_pos = topic_end + 1;
         }
-        return false;
     }
 } // namespace mqtt
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "DeliveryQueue.h"
+#include <algorithm>
+
+namespace mqtt {
+
+    namespace {
+
+        struct PolicyName {
+            OverflowPolicy policy;
+            const char* name;
+        };
+
+        constexpr PolicyName POLICY_NAMES[] = {
+            { OverflowPolicy::DropOldest, "drop-oldest" },
+            { OverflowPolicy::DropNewest, "drop-newest" },
+            { OverflowPolicy::Block, "block" },
+            { OverflowPolicy::Disconnect, "disconnect" },
+        };
+
+    }
+
+    const char* overflowPolicyName(OverflowPolicy policy) {
+        for (const auto& entry : POLICY_NAMES) {
+            if (entry.policy == policy) {
+                return entry.name;
+            }
+        }
+        return "unknown";
+    }
+
+    bool parseOverflowPolicy(const std::string& name, OverflowPolicy& policy) {
+        for (const auto& entry : POLICY_NAMES) {
+            if (name == entry.name) {
+                policy = entry.policy;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    DeliveryQueue::DeliveryQueue(size_t capacity, OverflowPolicy policy)
+        : capacity(std::max<size_t>(capacity, 1)),
+        policy(policy) {
+    }
+
+    DeliveryQueue::Admission DeliveryQueue::push(const Message& message, bool& schedule) {
+        schedule = false;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stats.disconnected) {
+            stats.dropped++;
+            return Admission::DroppedNewest;
+        }
+
+        Admission admission = Admission::Accepted;
+        if (queue.size() >= capacity) {
+            switch (policy) {
+            case OverflowPolicy::DropNewest:
+                stats.dropped++;
+                return Admission::DroppedNewest;
+
+            case OverflowPolicy::DropOldest:
+                queue.pop_front();
+                stats.dropped++;
+                admission = Admission::DroppedOldest;
+                break;
+
+            case OverflowPolicy::Disconnect:
+                stats.disconnected = true;
+                stats.dropped++;
+                return Admission::Disconnected;
+
+            case OverflowPolicy::Block: {
+                // A handler delivering to its own subscriber would wait for itself
+                if (drainer == std::this_thread::get_id()) {
+                    stats.dropped++;
+                    return Admission::DroppedNewest;
+                }
+                waiters++;
+                bool room = space_condition.wait_for(lock,
+                    std::chrono::milliseconds(mqtt::constants::DEVICE_BLOCK_TIMEOUT_MS),
+                    [this] { return queue.size() < capacity || stats.disconnected; });
+                waiters--;
+                if (!room || stats.disconnected) {
+                    stats.dropped++;
+                    return Admission::DroppedNewest;
+                }
+                stats.blocked++;
+                admission = Admission::Waited;
+                break;
+            }
+            }
+        }
+
+        queue.push_back(message);
+        stats.high_water = std::max(stats.high_water, queue.size());
+        if (!draining) {
+            draining = true;
+            schedule = true;
+        }
+        return admission;
+    }
+
+    std::optional<Message> DeliveryQueue::pop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.empty()) {
+            draining = false;
+            drainer = std::thread::id();
+            if (waiters > 0) {
+                space_condition.notify_all();
+            }
+            return std::nullopt;
+        }
+        drainer = std::this_thread::get_id();
+        std::optional<Message> message(std::move(queue.front()));
+        queue.pop_front();
+        if (waiters > 0) {
+            space_condition.notify_all();
+        }
+        return message;
+    }
+
+    bool DeliveryQueue::endBatch() {
+        std::lock_guard<std::mutex> lock(mutex);
+        drainer = std::thread::id();
+        if (!queue.empty()) {
+            return true;
+        }
+        draining = false;
+        if (waiters > 0) {
+            space_condition.notify_all();
+        }
+        return false;
+    }
+
+    bool DeliveryQueue::waitIdle(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters++;
+        bool idle = space_condition.wait_for(lock, timeout, [this] { return !draining; });
+        waiters--;
+        return idle;
+    }
+
+    void DeliveryQueue::configure(size_t capacity, OverflowPolicy policy) {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->capacity = std::max<size_t>(capacity, 1);
+        this->policy = policy;
+        stats.disconnected = false;
+        space_condition.notify_all();
+    }
+
+    DeliveryQueue::Stats DeliveryQueue::getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats current = stats;
+        current.depth = queue.size();
+        return current;
+    }
+
+    size_t DeliveryQueue::getCapacity() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return capacity;
+    }
+
+    OverflowPolicy DeliveryQueue::getPolicy() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return policy;
+    }
+
+} // namespace mqtt
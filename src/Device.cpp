@@ -2,38 +2,77 @@
 #include "Broker.h"
 #include <algorithm>
 #include <random>
-#include <sstream>
-#include <iomanip>
 
 namespace mqtt {
 
+    namespace {
+
+        // random_device opens the entropy source on every use, too slow to
+        // pay per device when a snapshot brings up 100k of them; draw once
+        // and give each device the next splitmix64 output instead
+        uint64_t randomSeed() {
+            static std::atomic<uint64_t> state{ [] {
+                std::random_device rd;
+                return (static_cast<uint64_t>(rd()) << 32) | rd();
+            }() };
+            uint64_t z = state.fetch_add(0x9E3779B97F4A7C15ull, std::memory_order_relaxed) + 0x9E3779B97F4A7C15ull;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+    }
+
     Device::Device(const std::string& id,
         std::shared_ptr<Broker> broker,
-        std::chrono::milliseconds interval)
+        std::chrono::milliseconds interval,
+        bool transient)
         : device_id(id),
+        transient(transient),
+        handle(transient ? InternTable::clients().find(id).value_or(InternTable::EMPTY) : InternTable::clients().intern(id)),
         broker(broker),
-        running(true),
-        telemetry_interval(interval) {
-        telemetry_thread = std::thread(&Device::generateTelemetry, this);
+        message_handlers(std::make_shared<HandlerList>()),
+        telemetry_interval(interval),
+        telemetry_generator(randomSeed()),
+        message_history(mqtt::constants::DEVICE_MESSAGE_HISTORY_SIZE),
+        latency_tracker(broker ? broker->getLatencyTracker() : nullptr) {
+        std::lock_guard<std::mutex> lock(telemetry_mutex);
+        startTelemetry();
     }
 
     Device::~Device() {
-        running = false;
-        if (telemetry_thread.joinable()) {
-            telemetry_thread.join();
+        Scheduler::Handle timer;
+        {
+            std::lock_guard<std::mutex> lock(telemetry_mutex);
+            telemetry_generation++;
+            timer = std::move(telemetry_timer);
         }
+
+        // Waits for a telemetry run that is already in progress; it takes
+        // telemetry_mutex, so the wait must come after releasing it
+        timer.cancel();
     }
 
-    void Device::subscribe(const std::string& topic) {
+    void Device::subscribe(const std::string& topic, bool replay_retained) {
         if (auto b = broker.lock()) {
-            b->subscribe(topic, shared_from_this());
-            subscribed_topics.push_back(topic);
+            // Gives publishes to a simulated device's exact filters a handle, so they match by integer
+            if (!transient && topic.find_first_of("+#") == std::string::npos) {
+                InternTable::topics().intern(topic);
+            }
+
+            // Recorded first so an overflow during retained replay can undo it
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                subscribed_topics.push_back(topic);
+            }
+            b->subscribe(topic, shared_from_this(), replay_retained);
         }
     }
 
     void Device::unsubscribe(const std::string& topic) {
         if (auto b = broker.lock()) {
             b->unsubscribe(topic, shared_from_this());
+            std::lock_guard<std::mutex> lock(mutex);
             auto it = std::find(subscribed_topics.begin(), subscribed_topics.end(), topic);
             if (it != subscribed_topics.end()) {
                 subscribed_topics.erase(it);
@@ -41,98 +80,215 @@ namespace mqtt {
         }
     }
 
+    void Device::restoreSubscriptions() {
+        if (auto b = broker.lock()) {
+            for (const auto& topic : b->getPersistedSubscriptions(device_id)) {
+                std::vector<std::string> current = getSubscribedTopics();
+                if (std::find(current.begin(), current.end(), topic) == current.end()) {
+                    subscribe(topic);
+                }
+            }
+        }
+    }
+
     void Device::publish(const std::string& topic, const std::string& payload,
         QoS qos, bool retained) {
+        Message message(topic, payload, qos, retained);
+        send(message);
+    }
+
+    void Device::publish(InternTable::Handle topic, std::string_view payload,
+        QoS qos, bool retained) {
+        Message message(std::string(), std::string(), qos, retained);
+        message.setTopicHandle(topic);
+        message.setPayload(payload);
+        send(message);
+    }
+
+    void Device::send(Message& message) {
         if (auto b = broker.lock()) {
-            Message message(topic, payload, qos, retained);
-            message.setSenderId(device_id);
+            if (handle != InternTable::EMPTY) {
+                message.setSenderHandle(handle);
+            }
+            else {
+                message.setSenderId(device_id);
+            }
 
             // Add to history - visualization
-            {
-                std::lock_guard<std::mutex> lock(mutex);
-                message_history.push_back(message);
-                if (message_history.size() > MAX_HISTORY_SIZE) {
-                    message_history.erase(message_history.begin());
-                }
-            }
+            message_history.push_back(message);
 
             b->publish(message);
         }
     }
 
-    void Device::receiveMessage(const Message& message) {
-        std::lock_guard<std::mutex> lock(mutex);
-        received_messages.push(message);
+    DeliveryQueue::Admission Device::receiveMessage(const Message& message, bool& schedule) {
+        DeliveryQueue::Admission admission = delivery_queue.push(message, schedule);
+        if (admission == DeliveryQueue::Admission::Disconnected) {
+            disconnect();
+        }
+        return admission;
+    }
+
+    bool Device::drainDeliveries() {
+        for (size_t i = 0; i < mqtt::constants::DEVICE_DRAIN_BATCH; i++) {
+            auto next = delivery_queue.pop();
+            if (!next) {
+                return false;
+            }
+            handleMessage(*next);
+        }
+        return delivery_queue.endBatch();
+    }
+
+    bool Device::waitForDeliveries(std::chrono::milliseconds timeout) {
+        return delivery_queue.waitIdle(timeout);
+    }
+
+    void Device::handleMessage(Message& message) {
+        // Stamped when handled, so time spent queued counts as latency; handlers see the same stamp
+        if (message.hasTrace()) {
+            message.markTrace(TracePoint::Receive);
+            if (latency_tracker) {
+                latency_tracker->record(message, message.getTrace(TracePoint::Receive));
+            }
+        }
+
+        std::shared_ptr<const HandlerList> handlers;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            handlers = message_handlers;
+        }
 
         // Add to history - visualization
         message_history.push_back(message);
-        if (message_history.size() > MAX_HISTORY_SIZE) {
-            message_history.erase(message_history.begin());
-        }
 
-        // Process message w/ handlers
-        for (const auto& handler : message_handlers) {
+        for (const auto& handler : *handlers) {
             handler(message);
         }
     }
 
+    void Device::disconnect() {
+        std::vector<std::string> topics;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            topics.swap(subscribed_topics);
+        }
+        if (auto b = broker.lock()) {
+            for (const auto& topic : topics) {
+                b->unsubscribe(topic, shared_from_this());
+            }
+        }
+    }
+
     void Device::addMessageHandler(std::function<void(const Message&)> handler) {
-        message_handlers.push_back(handler);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto handlers = std::make_shared<HandlerList>(*message_handlers);
+        handlers->push_back(std::move(handler));
+        message_handlers = std::move(handlers);
     }
 
     const std::string& Device::getId() const {
         return device_id;
     }
 
-    const std::vector<Message>& Device::getMessageHistory() const {
-        return message_history;
+    InternTable::Handle Device::getHandle() const {
+        return handle;
     }
 
-    const std::vector<std::string>& Device::getSubscribedTopics() const {
+    std::vector<Message> Device::getMessageHistory() const {
+        return message_history.snapshot();
+    }
+
+    std::optional<Message> Device::getLastMessage() const {
+        return message_history.latest();
+    }
+
+    std::vector<std::string> Device::getSubscribedTopics() const {
+        std::lock_guard<std::mutex> lock(mutex);
         return subscribed_topics;
     }
 
+    DeliveryQueue::Stats Device::getDeliveryStats() const {
+        return delivery_queue.getStats();
+    }
+
+    std::chrono::milliseconds Device::getTelemetryInterval() const {
+        return telemetry_interval;
+    }
+
+    size_t Device::getHistoryCapacity() const {
+        return message_history.capacity();
+    }
+
+    size_t Device::getDeliveryCapacity() const {
+        return delivery_queue.getCapacity();
+    }
+
+    OverflowPolicy Device::getOverflowPolicy() const {
+        return delivery_queue.getPolicy();
+    }
+
     void Device::setTelemetryInterval(std::chrono::milliseconds interval) {
-        telemetry_interval = interval;
+        // Replace the timer so the new interval applies now, not after the next run
+        Scheduler::Handle retired;
+        {
+            std::lock_guard<std::mutex> lock(telemetry_mutex);
+            telemetry_interval = interval;
+            telemetry_generation++;
+            retired = std::move(telemetry_timer);
+            startTelemetry();
+        }
+        retired.cancel();
     }
 
-    void Device::generateTelemetry() {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> interval_var(mqtt::constants::TELEMETRY_RANDOM_MIN_MS, mqtt::constants::TELEMETRY_RANDOM_MAX_MS);
+    void Device::setHistoryCapacity(size_t capacity) {
+        message_history.setCapacity(capacity);
+    }
 
-        while (running) {
-            // Create and publish telemetry
-            std::string telemetry = generateRandomTelemetry();
-            publish("telemetry/" + device_id, telemetry, QoS::AT_LEAST_ONCE);
+    void Device::setDeliveryQueue(size_t capacity, OverflowPolicy policy) {
+        delivery_queue.configure(capacity, policy);
+    }
 
-            // Insert random variation in telemetry
-            std::this_thread::sleep_for(telemetry_interval +
-                std::chrono::milliseconds(interval_var(gen)));
+    void Device::startTelemetry() {
+        std::chrono::milliseconds delay = nextTelemetryDelay();
+        if (delay.count() < 0) {
+            return;
+        }
+        if (telemetry_topic == InternTable::EMPTY) {
+            telemetry_topic = InternTable::topics().intern(mqtt::constants::TELEMETRY_TOPIC_PREFIX + device_id);
         }
+        telemetry_timer = Scheduler::shared().scheduleRepeating(delay,
+            [this, generation = telemetry_generation] { return generateTelemetry(generation); });
     }
 
-    std::string Device::generateRandomTelemetry() {
-        std::random_device rd;
-        std::mt19937 gen(rd());
+    std::chrono::milliseconds Device::generateTelemetry(uint64_t generation) {
+        // The generator's buffer is only valid under the lock, so the body is filled there
+        Message message(std::string(), std::string(), QoS::AT_LEAST_ONCE);
+        std::chrono::milliseconds delay;
+        {
+            std::lock_guard<std::mutex> lock(telemetry_mutex);
+            if (generation != telemetry_generation) {
+                return std::chrono::milliseconds(-1); // Replaced or stopped meanwhile
+            }
+            message.setTopicHandle(telemetry_topic);
+            message.setPayload(telemetry_generator.next());
+            delay = nextTelemetryDelay();
+        }
 
-        // Generate sensor values
-        std::uniform_real_distribution<> temp(mqtt::constants::TEMPERATURE_MIN, mqtt::constants::TEMPERATURE_MAX);
-        std::uniform_real_distribution<> humidity(mqtt::constants::HUMIDITY_MIN, mqtt::constants::HUMIDITY_MAX);
-        std::uniform_real_distribution<> pressure(mqtt::constants::PRESSURE_MIN, mqtt::constants::PRESSURE_MAX);
-        std::uniform_real_distribution<> battery(mqtt::constants::BATTERY_MIN, mqtt::constants::BATTERY_MAX);
+        // Publish telemetry
+        send(message);
+        return delay;
+    }
 
-        // Create "JSON-ish" output
-        std::stringstream ss;
-        ss << "{"
-            << "\"temperature\":" << std::fixed << std::setprecision(1) << temp(gen) << ","
-            << "\"humidity\":" << std::fixed << std::setprecision(1) << humidity(gen) << ","
-            << "\"pressure\":" << std::fixed << std::setprecision(1) << pressure(gen) << ","
-            << "\"battery\":" << std::fixed << std::setprecision(2) << battery(gen) << ","
-            << "\"timestamp\":\"" << std::chrono::system_clock::now().time_since_epoch().count() << "\""
-            << "}";
+    std::chrono::milliseconds Device::nextTelemetryDelay() {
+        std::chrono::milliseconds interval = telemetry_interval;
+        if (interval.count() <= 0) {
+            return std::chrono::milliseconds(-1);
+        }
 
-        return ss.str();
+        // Insert random variation in telemetry
+        return interval + std::chrono::milliseconds(telemetry_generator.uniformInt(
+            mqtt::constants::TELEMETRY_RANDOM_MIN_MS, mqtt::constants::TELEMETRY_RANDOM_MAX_MS));
     }
 
 } // namespace mqtt
\ No newline at end of file
@@ -0,0 +1,453 @@
+#include "HeadlessRunner.h"
+#include "Snapshot.h"
+#include "TelemetryGenerator.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+
+namespace mqtt {
+
+    namespace {
+
+        bool parseCount(const char* text, uint64_t& value) {
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long parsed = std::strtoull(text, &end, 10);
+            if (errno != 0 || end == text || *end != '\0' || text[0] == '-') {
+                return false;
+            }
+            value = parsed;
+            return true;
+        }
+
+        // host:port, with IPv6 hosts in brackets
+        bool parseHostPort(const std::string& text, std::string& host, uint16_t& port) {
+            size_t colon = text.rfind(':');
+            uint64_t value = 0;
+            if (colon == std::string::npos || colon == 0 || !parseCount(text.c_str() + colon + 1, value) ||
+                value == 0 || value > 65535) {
+                return false;
+            }
+            host = text.substr(0, colon);
+            if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+                host = host.substr(1, host.size() - 2);
+            }
+            port = static_cast<uint16_t>(value);
+            return true;
+        }
+
+        bool parseSeconds(const char* text, std::chrono::milliseconds& value) {
+            char* end = nullptr;
+            errno = 0;
+            double parsed = std::strtod(text, &end);
+            if (errno != 0 || end == text || *end != '\0' || parsed < 0) {
+                return false;
+            }
+            value = std::chrono::milliseconds(static_cast<int64_t>(parsed * 1000.0));
+            return true;
+        }
+
+        int64_t percentile(const std::vector<int64_t>& sorted, double fraction) {
+            if (sorted.empty()) {
+                return 0;
+            }
+            size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+            return sorted[std::min(index, sorted.size() - 1)];
+        }
+
+    }
+
+    //-------------------------------------------------------------------------
+    // Options
+    //-------------------------------------------------------------------------
+
+    bool HeadlessOptions::parse(int argc, const char* const* argv, std::string& error) {
+        std::string headless_only; // First option the graphical simulator would ignore
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--headless") {
+                enabled = true;
+                continue;
+            }
+            if (arg == "--help" || arg == "-h") {
+                show_help = true;
+                continue;
+            }
+
+            // Remaining options all take a value
+            if (i + 1 >= argc) {
+                error = "Missing value for " + arg;
+                return false;
+            }
+            const char* value = argv[++i];
+            uint64_t count = 0;
+            bool valid = true;
+            if (arg == "--duration") {
+                valid = parseSeconds(value, duration);
+            }
+            else if (arg == "--messages") {
+                valid = parseCount(value, message_limit);
+            }
+            else if (arg == "--devices") {
+                valid = parseCount(value, count) && count > 0;
+                device_count = static_cast<size_t>(count);
+            }
+            else if (arg == "--interval") {
+                valid = parseCount(value, count);
+                telemetry_interval = std::chrono::milliseconds(count);
+            }
+            else if (arg == "--publishers") {
+                valid = parseCount(value, count);
+                publisher_threads = static_cast<size_t>(count);
+            }
+            else if (arg == "--dispatch-threads") {
+                valid = parseCount(value, count);
+                dispatch_threads = static_cast<size_t>(count);
+            }
+            else if (arg == "--metrics-file") {
+                metrics_file = value;
+                valid = !metrics_file.empty();
+            }
+            else if (arg == "--metrics-format") {
+                std::string format_name = value;
+                valid = format_name == "prometheus" || format_name == "json";
+                metrics_format = format_name == "json" ? MetricsFormat::Json : MetricsFormat::Prometheus;
+            }
+            else if (arg == "--listen") {
+                valid = parseCount(value, count) && count > 0 && count <= 65535;
+                listen_port = static_cast<uint16_t>(count);
+            }
+            else if (arg == "--listen-address") {
+                listen_address = value;
+                valid = !listen_address.empty();
+            }
+            else if (arg == "--load") {
+                valid = parseHostPort(value, load_host, load_port);
+                enabled = enabled || valid;
+            }
+            else if (arg == "--load-threads") {
+                valid = parseCount(value, count) && count > 0;
+                load_threads = static_cast<size_t>(count);
+            }
+            else if (arg == "--qos") {
+                valid = parseCount(value, count) && count <= 2;
+                load_qos = static_cast<QoS>(count);
+            }
+            else if (arg == "--queue-capacity") {
+                valid = parseCount(value, count) && count > 0;
+                queue_capacity = static_cast<size_t>(count);
+            }
+            else if (arg == "--overflow") {
+                valid = parseOverflowPolicy(value, overflow_policy);
+            }
+            else if (arg == "--data-dir") {
+                data_dir = value;
+                valid = !data_dir.empty();
+            }
+            else if (arg == "--snapshot") {
+                snapshot_file = value;
+                valid = !snapshot_file.empty();
+            }
+            else if (arg == "--save-snapshot") {
+                save_snapshot_file = value;
+                valid = !save_snapshot_file.empty();
+            }
+            else {
+                error = "Unknown option " + arg;
+                return false;
+            }
+            if (!valid) {
+                error = "Invalid value for " + arg + ": " + value;
+                return false;
+            }
+            if (arg != "--snapshot" && headless_only.empty()) {
+                headless_only = arg;
+            }
+        }
+
+        if (!enabled && !headless_only.empty()) {
+            error = headless_only + " requires --headless";
+            return false;
+        }
+
+        if (duration.count() == 0 && message_limit == 0) {
+            duration = std::chrono::seconds(mqtt::constants::HEADLESS_DEFAULT_DURATION_S);
+        }
+        return true;
+    }
+
+    const char* HeadlessOptions::usage() {
+        return
+            "Usage: MQTTSimulator [--headless [options]]\n"
+            "\n"
+            "Without --headless the graphical simulator starts; of the options below it only\n"
+            "takes --snapshot.\n"
+            "\n"
+            "Headless options:\n"
+            "  --duration <seconds>      Stop after this long\n"
+            "  --messages <count>        Stop after this many telemetry deliveries\n"
+            "  --devices <count>         Simulated devices (default 100)\n"
+            "  --interval <ms>           Device telemetry interval, 0 disables (default 1000)\n"
+            "  --publishers <count>      Threads publishing back-to-back for the devices (default 0)\n"
+            "  --dispatch-threads <n>    Broker dispatch threads, 0 = one per core (default 0)\n"
+            "  --metrics-file <path>     Rewrite broker metrics to this file every second\n"
+            "  --metrics-format <fmt>    prometheus or json (default prometheus)\n"
+            "  --listen <port>           Accept MQTT 5.0 clients on this TCP port\n"
+            "  --listen-address <ip>     Address for --listen (default 127.0.0.1)\n"
+            "  --load <host:port>        Drive an external broker over TCP instead (implies --headless)\n"
+            "  --load-threads <count>    epoll threads for --load (default 2)\n"
+            "  --qos <0|1|2>             QoS of --load publishes (default 1)\n"
+            "  --queue-capacity <count>  Deliveries a device may have waiting (default 1024)\n"
+            "  --overflow <policy>       Full queue policy: drop-oldest, drop-newest, block or\n"
+            "                            disconnect (default drop-oldest); block stalls the\n"
+            "                            whole dispatch shard up to 1 s per message\n"
+            "  --data-dir <path>         Keep retained messages and subscriptions in a log here\n"
+            "  --snapshot <path>         Start from the devices and retained messages in this\n"
+            "                            snapshot instead of --devices new ones (also without\n"
+            "                            --headless)\n"
+            "  --save-snapshot <path>    Write a snapshot when the run ends\n"
+            "  --help                    Show this text\n";
+    }
+
+    //-------------------------------------------------------------------------
+    // Runner
+    //-------------------------------------------------------------------------
+
+    HeadlessRunner::HeadlessRunner(const HeadlessOptions& options)
+        : options(options),
+        broker(std::make_shared<Broker>("headless_broker", options.dispatch_threads)),
+        sample_generator(std::random_device{}()) {
+        latency_samples.reserve(mqtt::constants::HEADLESS_LATENCY_SAMPLES);
+        if (!options.data_dir.empty()) {
+            std::string error;
+            if (!broker->enablePersistence(options.data_dir, error)) {
+                throw std::runtime_error(error);
+            }
+        }
+
+        sink = std::make_shared<Device>("headless_sink", broker, std::chrono::milliseconds(0));
+        sink->setHistoryCapacity(0);
+        sink->setDeliveryQueue(options.queue_capacity, options.overflow_policy);
+        sink->addMessageHandler([this](const Message& message) {
+            recordDelivery(message);
+            });
+        sink->subscribe(std::string(mqtt::constants::TELEMETRY_TOPIC_PREFIX) + "#");
+        sink->restoreSubscriptions();
+
+        // Restored devices keep the configuration they were saved with
+        if (!options.snapshot_file.empty()) {
+            auto load_start = std::chrono::steady_clock::now();
+            Snapshot snapshot;
+            std::string error;
+            if (!snapshot.open(options.snapshot_file, error)) {
+                throw std::runtime_error(error);
+            }
+            devices = snapshot.restore(broker);
+            snapshot_load_time = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - load_start);
+        }
+        else {
+            devices.reserve(options.device_count);
+            for (size_t i = 0; i < options.device_count; i++) {
+                auto device = std::make_shared<Device>("device_" + std::to_string(i + 1), broker,
+                    options.telemetry_interval);
+                device->setHistoryCapacity(0);
+                device->setDeliveryQueue(options.queue_capacity, options.overflow_policy);
+                device->restoreSubscriptions();
+                devices.push_back(std::move(device));
+            }
+        }
+    }
+
+    HeadlessRunner::~HeadlessRunner() {
+        // Stop network clients and telemetry before the broker goes away
+        listener.reset();
+        devices.clear();
+        sink.reset();
+
+        // Joins the dispatchers and the delivery workers still running the sink's handler
+        broker.reset();
+    }
+
+    HeadlessReport HeadlessRunner::run() {
+        if (options.listen_port != 0) {
+            listener = std::make_unique<TcpListener>(broker);
+            std::string error;
+            if (!listener->start(options.listen_address, options.listen_port, error)) {
+                throw std::runtime_error(error);
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> publishers;
+        for (size_t i = 0; i < options.publisher_threads; i++) {
+            publishers.emplace_back(&HeadlessRunner::publishLoop, this, i);
+        }
+
+        Scheduler::Handle metrics_timer;
+        if (!options.metrics_file.empty()) {
+            auto interval = std::chrono::milliseconds(mqtt::constants::METRICS_DUMP_INTERVAL_MS);
+            metrics_timer = Scheduler::shared().scheduleRepeating(interval, [this, interval] {
+                dumpMetrics();
+                return interval;
+                });
+        }
+
+        while (!limitReached(start)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        stopping = true;
+        for (auto& publisher : publishers) {
+            publisher.join();
+        }
+
+        // Saved before telemetry is stopped so the devices keep their intervals
+        HeadlessReport report;
+        if (!options.save_snapshot_file.empty()) {
+            std::string error;
+            report.snapshot_saved = Snapshot::write(options.save_snapshot_file, *broker, devices, error);
+        }
+        for (const auto& device : devices) {
+            device->setTelemetryInterval(std::chrono::milliseconds(0));
+        }
+
+        // Let the broker deliver what was already accepted
+        auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (broker->getIngressStats().queue_depth > 0 && std::chrono::steady_clock::now() < drain_deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        sink->waitForDeliveries(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::max(drain_deadline - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero())));
+
+        metrics_timer.cancel();
+        dumpMetrics();
+
+        report.devices = devices.size();
+        report.snapshot_load_time = snapshot_load_time;
+        report.elapsed = std::chrono::steady_clock::now() - start;
+        report.published = broker->getIngressStats().published;
+        report.delivered = delivered.load();
+        report.throughput = report.elapsed.count() > 0 ? report.delivered / report.elapsed.count() : 0;
+        const MetricsRegistry& metrics = broker->getMetrics();
+        report.overflow_dropped = static_cast<uint64_t>(metrics.value("mqttsim_subscriber_dropped_total"));
+        report.overflow_blocked = static_cast<uint64_t>(metrics.value("mqttsim_subscriber_blocked_total"));
+        report.overflow_disconnects = static_cast<uint64_t>(metrics.value("mqttsim_subscriber_disconnects_total"));
+        report.log = broker->getLogStats();
+        if (listener) {
+            report.network = listener->getStats();
+            listener->stop();
+        }
+
+        std::lock_guard<std::mutex> lock(sample_mutex);
+        std::vector<int64_t> sorted = latency_samples;
+        std::sort(sorted.begin(), sorted.end());
+        report.latency_p50_us = percentile(sorted, 0.50);
+        report.latency_p99_us = percentile(sorted, 0.99);
+        report.latency_max_us = latency_max_us;
+        return report;
+    }
+
+    void HeadlessRunner::printReport(const HeadlessOptions& options, const HeadlessReport& report, std::ostream& out) {
+        out << "Headless run: " << report.devices << " devices, "
+            << options.publisher_threads << " publishers, "
+            << options.telemetry_interval.count() << " ms telemetry interval\n"
+            << std::fixed << std::setprecision(2)
+            << "  Elapsed:   " << report.elapsed.count() << " s\n"
+            << "  Published: " << report.published << "\n"
+            << "  Delivered: " << report.delivered << " (" << std::setprecision(0) << report.throughput << " msg/s)\n"
+            << "  Latency:   p50 " << report.latency_p50_us << " us, p99 " << report.latency_p99_us
+            << " us, max " << report.latency_max_us << " us\n"
+            << "  Overflow:  " << report.overflow_dropped << " dropped, " << report.overflow_blocked << " blocked, "
+            << report.overflow_disconnects << " disconnected (" << overflowPolicyName(options.overflow_policy)
+            << ", " << options.queue_capacity << " per device)\n";
+        if (options.listen_port != 0) {
+            out << "  Network:   " << report.network.connections_accepted << " clients on "
+                << options.listen_address << ":" << options.listen_port << ", "
+                << report.network.packets_received << " packets in, "
+                << report.network.protocol_errors << " protocol errors, "
+                << report.network.dropped_deliveries << " deliveries dropped\n";
+        }
+        if (!options.data_dir.empty()) {
+            out << "  Log:       " << report.log.recovered << " records replayed in "
+                << std::setprecision(1) << report.log.recovery_time.count() / 1000.0 << " ms, "
+                << report.log.appended << " appended, " << report.log.compactions << " compactions, "
+                << report.log.bytes << " bytes in " << report.log.segments << " segments\n";
+        }
+        if (!options.snapshot_file.empty()) {
+            out << "  Snapshot:  " << report.devices << " devices restored from " << options.snapshot_file
+                << " in " << std::setprecision(1) << report.snapshot_load_time.count() / 1000.0 << " ms\n";
+        }
+        if (!options.save_snapshot_file.empty()) {
+            out << "  Snapshot:  " << (report.snapshot_saved ? "saved to " : "could not write ")
+                << options.save_snapshot_file << "\n";
+        }
+        out << std::flush;
+    }
+
+    const MetricsRegistry& HeadlessRunner::getMetrics() const {
+        return broker->getMetrics();
+    }
+
+    void HeadlessRunner::dumpMetrics() const {
+        if (!options.metrics_file.empty()) {
+            broker->getMetrics().writeFile(options.metrics_file, options.metrics_format);
+        }
+    }
+
+    void HeadlessRunner::recordDelivery(const Message& message) {
+        uint64_t count = delivered.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        // The broker's end-to-end interval on the monotonic clock, so the report and the tracker agree
+        if (!message.hasTrace()) {
+            return;
+        }
+        int64_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            message.getTrace(TracePoint::Receive) - message.getTrace(TracePoint::Publish)).count();
+
+        // Reservoir sampling keeps a uniform sample of every delivery
+        std::lock_guard<std::mutex> lock(sample_mutex);
+        latency_max_us = std::max(latency_max_us, latency_us);
+        if (latency_samples.size() < mqtt::constants::HEADLESS_LATENCY_SAMPLES) {
+            latency_samples.push_back(latency_us);
+        }
+        else {
+            uint64_t slot = sample_generator() % count;
+            if (slot < latency_samples.size()) {
+                latency_samples[static_cast<size_t>(slot)] = latency_us;
+            }
+        }
+    }
+
+    bool HeadlessRunner::limitReached(std::chrono::steady_clock::time_point start) const {
+        if (options.message_limit > 0 && delivered.load(std::memory_order_relaxed) >= options.message_limit) {
+            return true;
+        }
+        return options.duration.count() > 0 && std::chrono::steady_clock::now() - start >= options.duration;
+    }
+
+    void HeadlessRunner::publishLoop(size_t publisher_index) {
+        // Each publisher drives its own share of the devices
+        std::vector<std::pair<std::shared_ptr<Device>, InternTable::Handle>> owned;
+        for (size_t i = publisher_index; i < devices.size(); i += options.publisher_threads) {
+            owned.emplace_back(devices[i], InternTable::topics().intern(
+                std::string(mqtt::constants::TELEMETRY_TOPIC_PREFIX) + devices[i]->getId()));
+        }
+        if (owned.empty()) {
+            return;
+        }
+
+        TelemetryGenerator generator(publisher_index + 1);
+        size_t next = 0;
+        while (!stopping.load(std::memory_order_relaxed)) {
+            auto& target = owned[next];
+            target.first->publish(target.second, generator.next(), QoS::AT_LEAST_ONCE);
+            next = (next + 1 == owned.size()) ? 0 : next + 1;
+        }
+    }
+
+} // namespace mqtt
@@ -0,0 +1,165 @@
+#include "InternTable.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace mqtt {
+
+    namespace {
+
+        // Index of the highest set bit; value must be non-zero
+        unsigned highestBit(uint64_t value) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, value);
+            return static_cast<unsigned>(index);
+#else
+            return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+        }
+
+        // Capacity std::string keeps inline on common standard libraries
+        constexpr size_t INLINE_STRING_CAPACITY = 15;
+
+        // Hash node, bucket pointer and key of one index entry
+        constexpr size_t INDEX_ENTRY_BYTES = 2 * sizeof(void*) + sizeof(std::string_view) + sizeof(uint32_t);
+
+        std::atomic<uint64_t> next_table_id{ 1 };
+
+        // Per-thread, direct-mapped by string hash, shared by every table
+        struct CacheEntry {
+            uint64_t table_id = 0;
+            uint32_t handle = 0;
+        };
+        thread_local std::array<CacheEntry, mqtt::constants::INTERN_THREAD_CACHE_SIZE> cache;
+
+    }
+
+    InternTable::InternTable()
+        : table_id(next_table_id.fetch_add(1, std::memory_order_relaxed)) {
+        for (auto& chunk : chunks) {
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+
+        // Handle 0 is the empty string, in the first chunk
+        slot(EMPTY);
+    }
+
+    InternTable::~InternTable() {
+        for (auto& chunk : chunks) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    InternTable::Handle InternTable::intern(std::string_view value) {
+        if (value.empty()) {
+            return EMPTY;
+        }
+        size_t hash = std::hash<std::string_view>{}(value);
+        if (auto found = findShared(value, hash)) {
+            return *found;
+        }
+
+        Shard& shard = shards[hash % shards.size()];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.index.find(value);
+        if (it != shard.index.end()) {
+            return it->second;
+        }
+        uint64_t next = next_handle.fetch_add(1, std::memory_order_relaxed);
+        if (next > UINT32_MAX) {
+            throw std::length_error("Intern table is full");
+        }
+        Handle handle = static_cast<Handle>(next);
+
+        // The string is in place before the handle can be found
+        std::string& stored = slot(handle);
+        stored.assign(value.data(), value.size());
+        shard.index.emplace(std::string_view(stored), handle);
+        if (value.size() > INLINE_STRING_CAPACITY) {
+            heap_bytes.fetch_add(value.size() + 1, std::memory_order_relaxed);
+        }
+        cache[hash % cache.size()] = { table_id, handle };
+        return handle;
+    }
+
+    std::optional<InternTable::Handle> InternTable::find(std::string_view value) const {
+        if (value.empty()) {
+            return EMPTY;
+        }
+        return findShared(value, std::hash<std::string_view>{}(value));
+    }
+
+    const std::string& InternTable::lookup(Handle handle) const {
+        uint64_t position = static_cast<uint64_t>(handle) + (uint64_t(1) << FIRST_CHUNK_BITS);
+        unsigned chunk = highestBit(position) - FIRST_CHUNK_BITS;
+        uint64_t offset = position - (uint64_t(1) << (chunk + FIRST_CHUNK_BITS));
+        return chunks[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    size_t InternTable::size() const {
+        return static_cast<size_t>(std::min<uint64_t>(next_handle.load(std::memory_order_relaxed), UINT32_MAX + uint64_t(1)));
+    }
+
+    size_t InternTable::memoryUsage() const {
+        size_t slots = 0;
+        for (size_t chunk = 0; chunk < CHUNK_COUNT; chunk++) {
+            if (chunks[chunk].load(std::memory_order_relaxed)) {
+                slots += size_t(1) << (chunk + FIRST_CHUNK_BITS);
+            }
+        }
+        return slots * sizeof(std::string) + size() * INDEX_ENTRY_BYTES +
+            heap_bytes.load(std::memory_order_relaxed);
+    }
+
+    InternTable& InternTable::topics() {
+        static InternTable* table = new InternTable();
+        return *table;
+    }
+
+    InternTable& InternTable::clients() {
+        static InternTable* table = new InternTable();
+        return *table;
+    }
+
+    std::optional<InternTable::Handle> InternTable::findShared(std::string_view value, size_t hash) const {
+        // Entries are only written by their own thread after the string was in place
+        CacheEntry& entry = cache[hash % cache.size()];
+        if (entry.table_id == table_id && lookup(entry.handle) == value) {
+            return entry.handle;
+        }
+
+        Shard& shard = shards[hash % shards.size()];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.index.find(value);
+        if (it == shard.index.end()) {
+            return std::nullopt;
+        }
+        entry = { table_id, it->second };
+        return it->second;
+    }
+
+    std::string& InternTable::slot(Handle handle) {
+        uint64_t position = static_cast<uint64_t>(handle) + (uint64_t(1) << FIRST_CHUNK_BITS);
+        unsigned chunk = highestBit(position) - FIRST_CHUNK_BITS;
+        uint64_t offset = position - (uint64_t(1) << (chunk + FIRST_CHUNK_BITS));
+
+        // Writers in different shards may reach a new chunk together; one allocation wins
+        std::string* strings = chunks[chunk].load(std::memory_order_acquire);
+        if (!strings) {
+            auto* fresh = new std::string[size_t(1) << (chunk + FIRST_CHUNK_BITS)];
+            if (chunks[chunk].compare_exchange_strong(strings, fresh, std::memory_order_acq_rel)) {
+                strings = fresh;
+            }
+            else {
+                delete[] fresh;
+            }
+        }
+        return strings[offset];
+    }
+
+} // namespace mqtt
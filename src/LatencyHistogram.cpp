@@ -0,0 +1,106 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace mqtt {
+
+    namespace {
+
+        constexpr size_t HALF_SUB_BUCKET_COUNT = LatencyHistogram::SUB_BUCKET_COUNT / 2;
+
+        // Index of the highest set bit; value must be non-zero
+        unsigned highestBit(uint64_t value) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, value);
+            return static_cast<unsigned>(index);
+#else
+            return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+        }
+
+    }
+
+    void LatencyHistogram::record(uint64_t value_ns) {
+        buckets[bucketIndex(value_ns)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t current = max_value.load(std::memory_order_relaxed);
+        while (value_ns > current &&
+            !max_value.compare_exchange_weak(current, value_ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t LatencyHistogram::count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    uint64_t LatencyHistogram::max() const {
+        return max_value.load(std::memory_order_relaxed);
+    }
+
+    uint64_t LatencyHistogram::percentile(double fraction) const {
+        // Work from one pass over the buckets so concurrent records cannot
+        // push the target rank past the counts we saw
+        std::array<uint64_t, BUCKET_COUNT> counts;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; i++) {
+            counts[i] = buckets[i].load(std::memory_order_relaxed);
+            seen += counts[i];
+        }
+        if (seen == 0) {
+            return 0;
+        }
+
+        fraction = std::min(std::max(fraction, 0.0), 1.0);
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * seen + 0.5));
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; i++) {
+            cumulative += counts[i];
+            if (cumulative >= rank) {
+                uint64_t midpoint = bucketLowerBound(i) + (bucketUpperBound(i) - bucketLowerBound(i)) / 2;
+                return std::min(midpoint, max());
+            }
+        }
+        return max();
+    }
+
+    void LatencyHistogram::reset() {
+        for (auto& bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        total.store(0, std::memory_order_relaxed);
+        max_value.store(0, std::memory_order_relaxed);
+    }
+
+    size_t LatencyHistogram::bucketIndex(uint64_t value_ns) {
+        if (value_ns < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value_ns);
+        }
+        // Keep the top five significant bits: value >> shift is in [16, 32)
+        unsigned shift = highestBit(value_ns) - 4;
+        size_t index = SUB_BUCKET_COUNT + (shift - 1) * HALF_SUB_BUCKET_COUNT +
+            static_cast<size_t>((value_ns >> shift) - HALF_SUB_BUCKET_COUNT);
+        return std::min(index, BUCKET_COUNT - 1);
+    }
+
+    uint64_t LatencyHistogram::bucketLowerBound(size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        size_t shift = (index - SUB_BUCKET_COUNT) / HALF_SUB_BUCKET_COUNT + 1;
+        uint64_t sub_bucket = (index - SUB_BUCKET_COUNT) % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+        return sub_bucket << shift;
+    }
+
+    uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        size_t shift = (index - SUB_BUCKET_COUNT) / HALF_SUB_BUCKET_COUNT + 1;
+        return bucketLowerBound(index) + (uint64_t(1) << shift) - 1;
+    }
+
+} // namespace mqtt
@@ -0,0 +1,191 @@
+#include "LatencyTracker.h"
+#include <algorithm>
+#include <mutex>
+
+namespace mqtt {
+
+    namespace {
+
+        double toMicroseconds(uint64_t nanoseconds) {
+            return static_cast<double>(nanoseconds) / 1000.0;
+        }
+
+        // Nanoseconds between two trace stamps, -1 if either was never set
+        int64_t between(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+            if (start.time_since_epoch().count() == 0 || end.time_since_epoch().count() == 0) {
+                return -1;
+            }
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        }
+
+    }
+
+    const LatencySummary& LatencyTracker::Row::stage(LatencyStage latency_stage) const {
+        return stages[static_cast<size_t>(latency_stage)];
+    }
+
+    LatencyTracker::LatencyTracker(size_t max_topics)
+        : max_topics(max_topics) {
+    }
+
+    void LatencyTracker::record(const Message& message, std::chrono::steady_clock::time_point received) {
+        if (!message.hasTrace()) {
+            return;
+        }
+
+        auto published = message.getTrace(TracePoint::Publish);
+        auto enqueued = message.getTrace(TracePoint::Enqueue);
+        auto dispatched = message.getTrace(TracePoint::Dispatch);
+        std::array<int64_t, LATENCY_STAGE_COUNT> durations = {
+            between(published, enqueued),
+            between(enqueued, dispatched),
+            between(dispatched, received),
+            between(published, received),
+        };
+
+        total.record(durations);
+        size_t qos = static_cast<size_t>(message.getQoS());
+        if (qos < qos_levels.size()) {
+            qos_levels[qos].record(durations);
+        }
+        topicHistograms(message).record(durations);
+    }
+
+    LatencyTracker::Row LatencyTracker::overall() const {
+        return total.summarize("All messages");
+    }
+
+    std::vector<LatencyTracker::Row> LatencyTracker::byQoS() const {
+        std::vector<Row> rows;
+        for (size_t i = 0; i < qos_levels.size(); i++) {
+            rows.push_back(qos_levels[i].summarize("QoS " + std::to_string(i)));
+        }
+        return rows;
+    }
+
+    std::vector<LatencyTracker::Row> LatencyTracker::byTopic(size_t limit) const {
+        std::vector<Row> rows;
+        {
+            std::shared_lock<std::shared_mutex> lock(topic_mutex);
+            rows.reserve(interned_topics.size() + named_topics.size() + 1);
+            for (const auto& topic : interned_topics) {
+                Row row = topic.second->summarize(InternTable::topics().lookup(topic.first));
+                if (row.stage(LatencyStage::EndToEnd).count > 0) {
+                    rows.push_back(std::move(row));
+                }
+            }
+            for (const auto& topic : named_topics) {
+                Row row = topic.second->summarize(topic.first);
+                if (row.stage(LatencyStage::EndToEnd).count > 0) {
+                    rows.push_back(std::move(row));
+                }
+            }
+        }
+        Row other = other_topics.summarize("(other)");
+        if (other.stage(LatencyStage::EndToEnd).count > 0) {
+            rows.push_back(std::move(other));
+        }
+
+        std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+            return a.stage(LatencyStage::EndToEnd).count > b.stage(LatencyStage::EndToEnd).count;
+            });
+        if (rows.size() > limit) {
+            rows.resize(limit);
+        }
+        return rows;
+    }
+
+    void LatencyTracker::reset() {
+        total.reset();
+        for (auto& level : qos_levels) {
+            level.reset();
+        }
+        other_topics.reset();
+
+        // Entries stay: record() may be writing to one after dropping the lock
+        std::shared_lock<std::shared_mutex> lock(topic_mutex);
+        for (auto& topic : interned_topics) {
+            topic.second->reset();
+        }
+        for (auto& topic : named_topics) {
+            topic.second->reset();
+        }
+    }
+
+    const char* LatencyTracker::stageName(LatencyStage stage) {
+        switch (stage) {
+        case LatencyStage::EnqueueWait:
+            return "Enqueue wait";
+        case LatencyStage::Queueing:
+            return "Queueing";
+        case LatencyStage::Delivery:
+            return "Delivery";
+        case LatencyStage::EndToEnd:
+            return "End to end";
+        }
+        return "Unknown";
+    }
+
+    void LatencyTracker::StageHistograms::record(const std::array<int64_t, LATENCY_STAGE_COUNT>& durations_ns) {
+        for (size_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+            if (durations_ns[i] >= 0) {
+                stages[i].record(static_cast<uint64_t>(durations_ns[i]));
+            }
+        }
+    }
+
+    LatencyTracker::Row LatencyTracker::StageHistograms::summarize(const std::string& label) const {
+        Row row;
+        row.label = label;
+        for (size_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+            LatencySummary& summary = row.stages[i];
+            summary.count = stages[i].count();
+            summary.p50_us = toMicroseconds(stages[i].percentile(0.50));
+            summary.p99_us = toMicroseconds(stages[i].percentile(0.99));
+            summary.p999_us = toMicroseconds(stages[i].percentile(0.999));
+            summary.max_us = toMicroseconds(stages[i].max());
+        }
+        return row;
+    }
+
+    void LatencyTracker::StageHistograms::reset() {
+        for (auto& stage : stages) {
+            stage.reset();
+        }
+    }
+
+    LatencyTracker::StageHistograms& LatencyTracker::topicHistograms(const Message& message) {
+        InternTable::Handle topic = message.getTopicHandle();
+        if (topic != InternTable::EMPTY) {
+            return findOrAdd(interned_topics, topic);
+        }
+        return findOrAdd(named_topics, message.getTopic());
+    }
+
+    template <typename Map>
+    LatencyTracker::StageHistograms& LatencyTracker::findOrAdd(Map& rows, const typename Map::key_type& key) {
+        {
+            std::shared_lock<std::shared_mutex> lock(topic_mutex);
+            auto it = rows.find(key);
+            if (it != rows.end()) {
+                return *it->second;
+            }
+            if (interned_topics.size() + named_topics.size() >= max_topics) {
+                return other_topics;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(topic_mutex);
+        auto it = rows.find(key);
+        if (it != rows.end()) {
+            return *it->second;
+        }
+        if (interned_topics.size() + named_topics.size() >= max_topics) {
+            return other_topics;
+        }
+        auto& histograms = rows[key];
+        histograms = std::make_unique<StageHistograms>();
+        return *histograms;
+    }
+
+} // namespace mqtt
@@ -0,0 +1,591 @@
+#include "LoadGenerator.h"
+#include "TelemetryGenerator.h"
+#include "WireCodec.h"
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace mqtt {
+
+#ifdef __linux__
+
+    /**
+     * @brief One epoll loop and the virtual devices it owns
+     */
+    class LoadGenerator::Worker {
+    public:
+        Worker(size_t index, const HeadlessOptions& options, Counters& counters,
+            const std::atomic<bool>& stopping, const sockaddr_storage& address, socklen_t address_length)
+            : options(options),
+            counters(counters),
+            stopping(stopping),
+            address(address),
+            address_length(address_length),
+            generator(index + 1) {
+        }
+
+        ~Worker() {
+            for (auto& device : devices) {
+                closeDevice(device);
+            }
+            if (epoll_fd >= 0) {
+                ::close(epoll_fd);
+            }
+        }
+
+        // Device numbers this worker drives, all before start()
+        void addDevice(size_t number) {
+            VirtualDevice device;
+            device.client_id = mqtt::constants::LOADGEN_CLIENT_ID_PREFIX + std::to_string(number);
+            device.topic = std::string(mqtt::constants::TELEMETRY_TOPIC_PREFIX) + device.client_id;
+            devices.push_back(std::move(device));
+        }
+
+        void start() {
+            thread = std::thread(&Worker::loop, this);
+        }
+
+        void join() {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+
+    private:
+        enum class State {
+            Idle,
+            Connecting,      // TCP handshake in progress
+            AwaitingConnack,
+            Connected,
+            Closed
+        };
+
+        struct InFlight {
+            uint16_t packet_id;
+            bool released;   // QoS 2: PUBREC received, PUBREL sent
+            std::chrono::steady_clock::time_point sent;
+        };
+
+        struct VirtualDevice {
+            int fd = -1;
+            State state = State::Idle;
+            std::string client_id;
+            std::string topic;
+            uint16_t next_packet_id = 1;
+            size_t window = 0;                  // In-flight limit from CONNACK
+            std::vector<InFlight> in_flight;
+            std::string inbound;
+            std::string outbound;
+            size_t outbound_offset = 0;
+            bool write_armed = false;
+            std::chrono::steady_clock::time_point connect_started;
+            std::chrono::steady_clock::time_point last_send;
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+        // Next scheduled publish: time and device index, earliest on top
+        using Due = std::pair<Clock::time_point, uint32_t>;
+
+        void loop() {
+            epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_fd < 0) {
+                counters.connect_failures.fetch_add(devices.size(), std::memory_order_relaxed);
+                return;
+            }
+
+            // Spread the first publishes over one interval
+            auto now = Clock::now();
+            auto interval = options.telemetry_interval;
+            for (size_t i = 0; i < devices.size(); i++) {
+                connectDevice(devices[i], now);
+                if (interval.count() > 0) {
+                    schedule.push({ now + interval * i / devices.size(), static_cast<uint32_t>(i) });
+                }
+            }
+
+            epoll_event events[mqtt::constants::LISTENER_MAX_EVENTS];
+            auto next_sweep = now;
+            while (!stopping.load(std::memory_order_relaxed)) {
+                int timeout = 100;
+                if (!schedule.empty()) {
+                    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(schedule.top().first - Clock::now());
+                    timeout = static_cast<int>(std::clamp<int64_t>(wait.count(), 0, timeout));
+                }
+                int count = epoll_wait(epoll_fd, events, mqtt::constants::LISTENER_MAX_EVENTS, timeout);
+                for (int i = 0; i < count; i++) {
+                    VirtualDevice& device = devices[events[i].data.u32];
+                    if (device.fd < 0) {
+                        continue; // Closed earlier in this batch
+                    }
+                    if (device.state == State::Connecting) {
+                        finishConnect(device);
+                        continue;
+                    }
+                    bool keep = (events[i].events & EPOLLERR) == 0;
+                    if (keep && (events[i].events & (EPOLLIN | EPOLLHUP)) != 0) {
+                        keep = readFrom(device);
+                    }
+                    if (keep && (events[i].events & EPOLLOUT) != 0) {
+                        fill(device);
+                        keep = flush(device);
+                    }
+                    if (!keep) {
+                        drop(device);
+                    }
+                }
+
+                now = Clock::now();
+                while (!schedule.empty() && schedule.top().first <= now) {
+                    Due due = schedule.top();
+                    schedule.pop();
+                    VirtualDevice& device = devices[due.second];
+                    if (device.state == State::Connected && device.in_flight.size() < device.window) {
+                        publish(device);
+                        if (!flush(device)) {
+                            drop(device);
+                        }
+                    }
+                    // A worker that fell behind skips ticks rather than bursting
+                    auto next = due.first + interval;
+                    schedule.push({ next < now ? now + interval : next, due.second });
+                }
+                if (now >= next_sweep) {
+                    sweep(now);
+                    next_sweep = now + std::chrono::milliseconds(mqtt::constants::LISTENER_SWEEP_INTERVAL_MS);
+                }
+            }
+
+            // Disconnect cleanly so the broker does not log errors
+            char disconnect[8];
+            size_t size = wire::encodeDisconnect(wire::ReasonCode::Success, disconnect, sizeof(disconnect));
+            for (auto& device : devices) {
+                if (device.state == State::Connected) {
+                    device.outbound.append(disconnect, size);
+                    flush(device);
+                }
+                closeDevice(device);
+            }
+        }
+
+        void connectDevice(VirtualDevice& device, Clock::time_point now) {
+            device.connect_started = now;
+            device.fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (device.fd < 0) {
+                drop(device);
+                return;
+            }
+            int enable = 1;
+            setsockopt(device.fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            if (::connect(device.fd, reinterpret_cast<const sockaddr*>(&address), address_length) != 0 &&
+                errno != EINPROGRESS) {
+                drop(device);
+                return;
+            }
+
+            // Writable once the handshake completes
+            epoll_event event{};
+            event.events = EPOLLOUT;
+            event.data.u32 = static_cast<uint32_t>(&device - devices.data());
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, device.fd, &event) != 0) {
+                drop(device);
+                return;
+            }
+            device.state = State::Connecting;
+            device.write_armed = true;
+        }
+
+        void finishConnect(VirtualDevice& device) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(device.fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+                drop(device);
+                return;
+            }
+
+            wire::ConnectView connect;
+            connect.client_id = device.client_id;
+            connect.keep_alive = mqtt::constants::LOADGEN_KEEP_ALIVE_S;
+            size_t size = 32 + device.client_id.size();
+            device.outbound.resize(size);
+            device.outbound.resize(wire::encodeConnect(connect, device.outbound.data(), size));
+            device.state = State::AwaitingConnack;
+            if (!flush(device)) {
+                drop(device);
+            }
+        }
+
+        bool readFrom(VirtualDevice& device) {
+            const size_t chunk = mqtt::constants::LISTENER_READ_CHUNK;
+            bool closed = false;
+            while (true) {
+                size_t used = device.inbound.size();
+                device.inbound.resize(used + chunk);
+                ssize_t received = ::recv(device.fd, device.inbound.data() + used, chunk, 0);
+                if (received > 0) {
+                    device.inbound.resize(used + static_cast<size_t>(received));
+                    if (static_cast<size_t>(received) < chunk) {
+                        break;
+                    }
+                    continue;
+                }
+                device.inbound.resize(used);
+                if (received == 0) {
+                    closed = true;
+                    break;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                return false;
+            }
+
+            size_t offset = 0;
+            bool keep = true;
+            while (keep && offset < device.inbound.size()) {
+                std::string_view input(device.inbound.data() + offset, device.inbound.size() - offset);
+                wire::PacketType type = wire::PacketType::Connect;
+                uint8_t flags = 0;
+                size_t packet_size = 0;
+                wire::DecodeStatus status = wire::peekPacket(input, type, flags, packet_size);
+                if (status == wire::DecodeStatus::Malformed) {
+                    return false;
+                }
+                if (status == wire::DecodeStatus::Incomplete || input.size() < packet_size) {
+                    break;
+                }
+                keep = handlePacket(device, type, input.substr(0, packet_size));
+                offset += packet_size;
+            }
+            device.inbound.erase(0, offset);
+            return keep && !closed && flush(device);
+        }
+
+        bool handlePacket(VirtualDevice& device, wire::PacketType type, std::string_view packet) {
+            switch (type) {
+            case wire::PacketType::Connack: {
+                wire::ConnackView connack;
+                if (device.state != State::AwaitingConnack ||
+                    wire::decodeConnack(packet, connack) != wire::DecodeStatus::Ok ||
+                    connack.reason != wire::ReasonCode::Success) {
+                    return false;
+                }
+                device.state = State::Connected;
+                device.window = std::min<size_t>(connack.receive_maximum, mqtt::constants::LOADGEN_MAX_IN_FLIGHT);
+                device.in_flight.reserve(device.window);
+                counters.connected.fetch_add(1, std::memory_order_relaxed);
+                fill(device);
+                return true;
+            }
+            case wire::PacketType::Puback:
+            case wire::PacketType::Pubrec:
+            case wire::PacketType::Pubcomp: {
+                wire::AckView ack;
+                if (wire::decodeAck(packet, ack) != wire::DecodeStatus::Ok) {
+                    return false;
+                }
+                auto it = std::find_if(device.in_flight.begin(), device.in_flight.end(),
+                    [&ack](const InFlight& entry) { return entry.packet_id == ack.packet_id; });
+                if (it == device.in_flight.end()) {
+                    return true;
+                }
+
+                // Every publish has the run's QoS: PUBACK answers QoS 1, PUBREC then PUBCOMP QoS 2
+                wire::PacketType expected = wire::PacketType::Puback;
+                if (options.load_qos == QoS::EXACTLY_ONCE) {
+                    expected = it->released ? wire::PacketType::Pubcomp : wire::PacketType::Pubrec;
+                }
+                if (type != expected) {
+                    return false;
+                }
+                bool refused = static_cast<uint8_t>(ack.reason) >= 0x80;
+
+                // PUBREC with an error reason ends the exchange like a PUBCOMP
+                if (type == wire::PacketType::Pubrec && !refused) {
+                    it->released = true;
+                    char pubrel[8];
+                    device.outbound.append(pubrel, wire::encodeAck(wire::PacketType::Pubrel, ack.packet_id,
+                        wire::ReasonCode::Success, pubrel, sizeof(pubrel)));
+                    return true;
+                }
+                if (refused) {
+                    counters.refused.fetch_add(1, std::memory_order_relaxed);
+                }
+                else {
+                    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - it->sent);
+                    counters.ack_latency.record(static_cast<uint64_t>(latency.count()));
+                    counters.acknowledged.fetch_add(1, std::memory_order_relaxed);
+                }
+                *it = device.in_flight.back();
+                device.in_flight.pop_back();
+                fill(device);
+                return true;
+            }
+            case wire::PacketType::Disconnect:
+                return false;
+            default:
+                // PINGRESP, and PUBLISHes we never subscribed to
+                return true;
+            }
+        }
+
+        // Closed-loop publishing when the interval is 0
+        void fill(VirtualDevice& device) {
+            if (options.telemetry_interval.count() > 0 || device.state != State::Connected) {
+                return;
+            }
+            bool acknowledged = options.load_qos != QoS::AT_MOST_ONCE;
+            while ((!acknowledged || device.in_flight.size() < device.window) &&
+                device.outbound.size() - device.outbound_offset < mqtt::constants::LOADGEN_MAX_OUTBOUND_BYTES) {
+                publish(device);
+            }
+        }
+
+        void publish(VirtualDevice& device) {
+            message.setTopic(device.topic);
+            message.setPayload(generator.next());
+            message.setQoS(options.load_qos);
+
+            uint16_t packet_id = 0;
+            if (options.load_qos != QoS::AT_MOST_ONCE) {
+                packet_id = nextPacketId(device);
+            }
+            size_t size = wire::publishSize(message);
+            size_t offset = device.outbound.size();
+            device.outbound.resize(offset + size);
+            wire::encodePublish(message, device.outbound.data() + offset, size, packet_id);
+            counters.published.fetch_add(1, std::memory_order_relaxed);
+            if (packet_id == 0) {
+                counters.acknowledged.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                device.in_flight.push_back({ packet_id, false, Clock::now() });
+            }
+        }
+
+        uint16_t nextPacketId(VirtualDevice& device) {
+            while (true) {
+                uint16_t id = device.next_packet_id++;
+                if (device.next_packet_id == 0) {
+                    device.next_packet_id = 1;
+                }
+                bool in_use = std::any_of(device.in_flight.begin(), device.in_flight.end(),
+                    [id](const InFlight& entry) { return entry.packet_id == id; });
+                if (!in_use) {
+                    return id;
+                }
+            }
+        }
+
+        bool flush(VirtualDevice& device) {
+            while (device.outbound_offset < device.outbound.size()) {
+                ssize_t sent = ::send(device.fd, device.outbound.data() + device.outbound_offset,
+                    device.outbound.size() - device.outbound_offset, MSG_NOSIGNAL);
+                if (sent > 0) {
+                    device.outbound_offset += static_cast<size_t>(sent);
+                    device.last_send = Clock::now();
+                    continue;
+                }
+                if (sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                return false;
+            }
+            if (device.outbound_offset == device.outbound.size()) {
+                device.outbound.clear();
+                device.outbound_offset = 0;
+            }
+
+            // QoS 0 closed loop keeps writing whenever the socket has room
+            bool closed_loop = options.telemetry_interval.count() == 0 && options.load_qos == QoS::AT_MOST_ONCE &&
+                device.state == State::Connected;
+            bool want_write = !device.outbound.empty() || closed_loop;
+            if (want_write != device.write_armed) {
+                epoll_event event{};
+                event.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+                event.data.u32 = static_cast<uint32_t>(&device - devices.data());
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, device.fd, &event);
+                device.write_armed = want_write;
+            }
+            return true;
+        }
+
+        void sweep(Clock::time_point now) {
+            auto connect_timeout = std::chrono::milliseconds(mqtt::constants::LOADGEN_CONNECT_TIMEOUT_MS);
+            auto ping_after = std::chrono::seconds(mqtt::constants::LOADGEN_KEEP_ALIVE_S) / 2;
+            for (auto& device : devices) {
+                if ((device.state == State::Connecting || device.state == State::AwaitingConnack) &&
+                    now - device.connect_started > connect_timeout) {
+                    drop(device);
+                }
+                else if (device.state == State::Connected && now - device.last_send > ping_after) {
+                    char ping[2];
+                    device.outbound.append(ping, wire::encodePing(wire::PacketType::Pingreq, ping, sizeof(ping)));
+                    if (!flush(device)) {
+                        drop(device);
+                    }
+                }
+            }
+        }
+
+        // Counted as a failed connect before CONNACK, a disconnect after
+        void drop(VirtualDevice& device) {
+            if (device.state == State::Connected) {
+                counters.disconnects.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                counters.connect_failures.fetch_add(1, std::memory_order_relaxed);
+            }
+            closeDevice(device);
+        }
+
+        void closeDevice(VirtualDevice& device) {
+            if (device.fd >= 0) {
+                if (epoll_fd >= 0) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, device.fd, nullptr);
+                }
+                ::close(device.fd);
+                device.fd = -1;
+            }
+            device.state = State::Closed;
+            device.in_flight.clear();
+            device.inbound.clear();
+            device.outbound.clear();
+            device.outbound_offset = 0;
+            device.write_armed = false;
+        }
+
+    private:
+        const HeadlessOptions& options;
+        Counters& counters;
+        const std::atomic<bool>& stopping;
+        sockaddr_storage address;
+        socklen_t address_length;
+
+        int epoll_fd = -1;
+        std::thread thread;
+        std::vector<VirtualDevice> devices;
+        std::priority_queue<Due, std::vector<Due>, std::greater<Due>> schedule;
+
+        // Scratch space reused for every publish
+        TelemetryGenerator generator;
+        Message message;
+    };
+
+#endif
+
+    LoadGenerator::LoadGenerator(const HeadlessOptions& options)
+        : options(options) {
+    }
+
+    LoadGenerator::~LoadGenerator() = default;
+
+    LoadReport LoadGenerator::run() {
+#ifdef __linux__
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* resolved = nullptr;
+        std::string port = std::to_string(options.load_port);
+        int status = getaddrinfo(options.load_host.c_str(), port.c_str(), &hints, &resolved);
+        if (status != 0 || resolved == nullptr) {
+            throw std::runtime_error("Cannot resolve " + options.load_host + ": " + gai_strerror(status));
+        }
+        sockaddr_storage address{};
+        socklen_t address_length = static_cast<socklen_t>(resolved->ai_addrlen);
+        std::memcpy(&address, resolved->ai_addr, resolved->ai_addrlen);
+        freeaddrinfo(resolved);
+
+        // VirtualDevice n goes to worker n % threads
+        size_t thread_count = std::clamp<size_t>(options.load_threads, 1, std::max<size_t>(options.device_count, 1));
+        std::vector<std::unique_ptr<Worker>> workers;
+        for (size_t i = 0; i < thread_count; i++) {
+            workers.push_back(std::make_unique<Worker>(i, options, counters, stopping, address, address_length));
+        }
+        for (size_t n = 0; n < options.device_count; n++) {
+            workers[n % thread_count]->addDevice(n + 1);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& worker : workers) {
+            worker->start();
+        }
+        while (!limitReached(start)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        stopping = true;
+        for (auto& worker : workers) {
+            worker->join();
+        }
+
+        LoadReport report;
+        report.elapsed = std::chrono::steady_clock::now() - start;
+        report.connected = counters.connected.load();
+        report.connect_failures = counters.connect_failures.load();
+        report.disconnects = counters.disconnects.load();
+        report.published = counters.published.load();
+        report.acknowledged = counters.acknowledged.load();
+        report.refused = counters.refused.load();
+        report.publish_rate = report.elapsed.count() > 0 ? report.published / report.elapsed.count() : 0;
+        report.ack_latency_p50_us = static_cast<int64_t>(counters.ack_latency.percentile(0.50) / 1000);
+        report.ack_latency_p99_us = static_cast<int64_t>(counters.ack_latency.percentile(0.99) / 1000);
+        report.ack_latency_max_us = static_cast<int64_t>(counters.ack_latency.max() / 1000);
+        return report;
+#else
+        throw std::runtime_error("The load generator requires Linux (epoll)");
+#endif
+    }
+
+    void LoadGenerator::printReport(const HeadlessOptions& options, const LoadReport& report, std::ostream& out) {
+        out << "Load run against " << options.load_host << ":" << options.load_port << ": "
+            << options.device_count << " devices on " << options.load_threads << " threads, QoS "
+            << static_cast<int>(options.load_qos) << ", "
+            << options.telemetry_interval.count() << " ms interval\n"
+            << std::fixed << std::setprecision(2)
+            << "  Elapsed:      " << report.elapsed.count() << " s\n"
+            << "  Connected:    " << report.connected << " (" << report.connect_failures << " failed, "
+            << report.disconnects << " dropped)\n"
+            << "  Published:    " << report.published << " (" << std::setprecision(0) << report.publish_rate << " msg/s)\n"
+            << "  Acknowledged: " << report.acknowledged << " (" << report.refused << " refused)\n"
+            << "  Ack latency:  p50 " << report.ack_latency_p50_us << " us, p99 " << report.ack_latency_p99_us
+            << " us, max " << report.ack_latency_max_us << " us" << std::endl;
+    }
+
+    bool LoadGenerator::limitReached(std::chrono::steady_clock::time_point start) const {
+        // Refused publishes still finished their exchange
+        uint64_t completed = counters.acknowledged.load(std::memory_order_relaxed) +
+            counters.refused.load(std::memory_order_relaxed);
+        if (options.message_limit > 0 && completed >= options.message_limit) {
+            return true;
+        }
+        // Nothing left to drive
+        uint64_t finished = counters.connect_failures.load(std::memory_order_relaxed) +
+            counters.disconnects.load(std::memory_order_relaxed);
+        if (finished >= options.device_count) {
+            return true;
+        }
+        return options.duration.count() > 0 && std::chrono::steady_clock::now() - start >= options.duration;
+    }
+
+} // namespace mqtt
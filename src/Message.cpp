@@ -2,33 +2,107 @@
 
 namespace mqtt {
 
+    namespace {
+
+        // Length-prefixed fields: sender, expiry, content type, response topic,
+        // correlation data, then a count followed by user property pairs
+
+        void appendVarint(std::string& out, size_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        void appendField(std::string& out, std::string_view field) {
+            appendVarint(out, field.size());
+            out.append(field.data(), field.size());
+        }
+
+        bool readVarint(std::string_view blob, size_t& pos, size_t& value) {
+            value = 0;
+            for (int shift = 0; pos < blob.size() && shift < 64; shift += 7) {
+                uint8_t byte = static_cast<uint8_t>(blob[pos++]);
+                value |= static_cast<size_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool readField(std::string_view blob, size_t& pos, std::string_view& field) {
+            size_t length = 0;
+            if (!readVarint(blob, pos, length) || length > blob.size() - pos) {
+                return false;
+            }
+            field = blob.substr(pos, length);
+            pos += length;
+            return true;
+        }
+
+    }
+
     Message::Message(const std::string& topic,
         const std::string& payload,
         QoS qos,
         bool retained)
-        : topic(topic),
-        payload(payload),
+        : body(std::make_shared<Body>()),
         qos(qos),
-        retained(retained),
-        timestamp(std::chrono::system_clock::now()),
-        message_expiry_interval(0),
-        topic_alias(0) {
+        retained(retained) {
+        assignTopic(*body, topic);
+        body->payload = payload;
+        body->timestamp = std::chrono::system_clock::now();
+    }
+
+    Message::Body& Message::mutableBody() {
+        // Copy on write: never modify a body another message still shares
+        if (body.use_count() != 1) {
+            body = std::make_shared<Body>(*body);
+        }
+        return *body;
+    }
+
+    void Message::assignTopic(Body& content, const std::string& topic) {
+        if (auto handle = InternTable::topics().find(topic)) {
+            content.topic = *handle;
+            content.topic_name.clear();
+        }
+        else {
+            content.topic = InternTable::EMPTY;
+            content.topic_name = topic;
+        }
+    }
+
+    void Message::assignSender(Body& content, std::string_view sender) {
+        if (auto handle = InternTable::clients().find(sender)) {
+            content.sender = *handle;
+            content.sender_name.clear();
+        }
+        else {
+            content.sender = InternTable::EMPTY;
+            content.sender_name.assign(sender);
+        }
     }
 
     const std::string& Message::getTopic() const {
-        return topic;
+        if (body->topic == InternTable::EMPTY) {
+            return body->topic_name;
+        }
+        return InternTable::topics().lookup(body->topic);
     }
 
     void Message::setTopic(const std::string& topic) {
-        this->topic = topic;
+        assignTopic(mutableBody(), topic);
     }
 
     const std::string& Message::getPayload() const {
-        return payload;
+        return body->payload;
     }
 
-    void Message::setPayload(const std::string& payload) {
-        this->payload = payload;
+    void Message::setPayload(std::string_view payload) {
+        mutableBody().payload.assign(payload);
     }
 
     QoS Message::getQoS() const {
@@ -48,71 +122,173 @@ namespace mqtt {
     }
 
     const std::string& Message::getSenderId() const {
-        return sender_id;
+        if (body->sender == InternTable::EMPTY) {
+            return body->sender_name;
+        }
+        return InternTable::clients().lookup(body->sender);
     }
 
     void Message::setSenderId(const std::string& sender_id) {
-        this->sender_id = sender_id;
+        assignSender(mutableBody(), sender_id);
     }
 
     const std::string& Message::getTargetId() const {
-        return target_id;
+        return InternTable::clients().lookup(target);
     }
 
     void Message::setTargetId(const std::string& target_id) {
-        this->target_id = target_id;
+        target = InternTable::clients().intern(target_id);
+    }
+
+    InternTable::Handle Message::getTopicHandle() const {
+        return body->topic;
+    }
+
+    void Message::setTopicHandle(InternTable::Handle topic) {
+        if (body->topic != topic || !body->topic_name.empty()) {
+            Body& content = mutableBody();
+            content.topic = topic;
+            content.topic_name.clear();
+        }
+    }
+
+    InternTable::Handle Message::getSenderHandle() const {
+        return body->sender;
+    }
+
+    void Message::setSenderHandle(InternTable::Handle sender) {
+        if (body->sender != sender || !body->sender_name.empty()) {
+            Body& content = mutableBody();
+            content.sender = sender;
+            content.sender_name.clear();
+        }
+    }
+
+    InternTable::Handle Message::getTargetHandle() const {
+        return target;
+    }
+
+    void Message::setTargetHandle(InternTable::Handle target) {
+        this->target = target;
     }
 
     std::chrono::system_clock::time_point Message::getTimestamp() const {
-        return timestamp;
+        return body->timestamp;
+    }
+
+    void Message::setTimestamp(std::chrono::system_clock::time_point timestamp) {
+        mutableBody().timestamp = timestamp;
+    }
+
+    void Message::markTrace(TracePoint point, std::chrono::steady_clock::time_point when) {
+        trace[static_cast<size_t>(point)] = when;
+    }
+
+    std::chrono::steady_clock::time_point Message::getTrace(TracePoint point) const {
+        return trace[static_cast<size_t>(point)];
+    }
+
+    bool Message::hasTrace() const {
+        return trace[static_cast<size_t>(TracePoint::Publish)].time_since_epoch().count() != 0;
+    }
+
+    void Message::clearTrace() {
+        trace.fill(std::chrono::steady_clock::time_point());
     }
 
     void Message::addUserProperty(const std::string& key, const std::string& value) {
-        user_properties[key] = value;
+        mutableBody().user_properties[key] = value;
     }
 
     const std::map<std::string, std::string>& Message::getUserProperties() const {
-        return user_properties;
+        return body->user_properties;
     }
 
     void Message::setMessageExpiryInterval(uint32_t interval) {
-        message_expiry_interval = interval;
+        mutableBody().message_expiry_interval = interval;
     }
 
     uint32_t Message::getMessageExpiryInterval() const {
-        return message_expiry_interval;
+        return body->message_expiry_interval;
     }
 
     void Message::setTopicAlias(uint16_t alias) {
-        topic_alias = alias;
+        mutableBody().topic_alias = alias;
     }
 
     uint16_t Message::getTopicAlias() const {
-        return topic_alias;
+        return body->topic_alias;
     }
 
     void Message::setContentType(const std::string& content_type) {
-        this->content_type = content_type;
+        mutableBody().content_type = content_type;
     }
 
     const std::string& Message::getContentType() const {
-        return content_type;
+        return body->content_type;
     }
 
     void Message::setResponseTopic(const std::string& response_topic) {
-        this->response_topic = response_topic;
+        mutableBody().response_topic = response_topic;
     }
 
     const std::string& Message::getResponseTopic() const {
-        return response_topic;
+        return body->response_topic;
     }
 
     void Message::setCorrelationData(const std::vector<uint8_t>& correlation_data) {
-        this->correlation_data = correlation_data;
+        mutableBody().correlation_data = correlation_data;
     }
 
     const std::vector<uint8_t>& Message::getCorrelationData() const {
-        return correlation_data;
+        return body->correlation_data;
+    }
+
+    bool Message::hasProperties() const {
+        return body->sender != InternTable::EMPTY || !body->sender_name.empty() ||
+            body->message_expiry_interval != 0 || !body->content_type.empty() ||
+            !body->response_topic.empty() || !body->correlation_data.empty() || !body->user_properties.empty();
+    }
+
+    void Message::appendProperties(std::string& out) const {
+        appendField(out, getSenderId());
+        appendVarint(out, body->message_expiry_interval);
+        appendField(out, body->content_type);
+        appendField(out, body->response_topic);
+        appendField(out, std::string_view(reinterpret_cast<const char*>(body->correlation_data.data()),
+            body->correlation_data.size()));
+        appendVarint(out, body->user_properties.size());
+        for (const auto& property : body->user_properties) {
+            appendField(out, property.first);
+            appendField(out, property.second);
+        }
+    }
+
+    bool Message::readProperties(std::string_view blob) {
+        Body& content = mutableBody();
+        size_t pos = 0;
+        size_t expiry = 0;
+        size_t count = 0;
+        std::string_view sender, content_type, response_topic, correlation;
+        if (!readField(blob, pos, sender) || !readVarint(blob, pos, expiry) || expiry > UINT32_MAX ||
+            !readField(blob, pos, content_type) || !readField(blob, pos, response_topic) ||
+            !readField(blob, pos, correlation) || !readVarint(blob, pos, count)) {
+            return false;
+        }
+        assignSender(content, sender);
+        content.message_expiry_interval = static_cast<uint32_t>(expiry);
+        content.content_type.assign(content_type);
+        content.response_topic.assign(response_topic);
+        content.correlation_data.assign(correlation.begin(), correlation.end());
+        content.user_properties.clear();
+        for (size_t i = 0; i < count; i++) {
+            std::string_view key, value;
+            if (!readField(blob, pos, key) || !readField(blob, pos, value)) {
+                return false;
+            }
+            content.user_properties.emplace(key, value);
+        }
+        return pos == blob.size();
     }
 
-} // namespace mqtt
\ No newline at end of file
+} // namespace mqtt
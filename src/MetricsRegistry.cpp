@@ -0,0 +1,193 @@
+#include "MetricsRegistry.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace mqtt {
+
+    namespace {
+
+        const char* prometheusType(MetricsRegistry::Type type) {
+            switch (type) {
+            case MetricsRegistry::Type::Counter:
+                return "counter";
+            case MetricsRegistry::Type::Gauge:
+                return "gauge";
+            case MetricsRegistry::Type::Duration:
+                return "summary";
+            }
+            return "untyped";
+        }
+
+        std::string escapeJson(const std::string& text) {
+            std::string escaped;
+            escaped.reserve(text.size());
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    escaped += '\\';
+                }
+                escaped += c;
+            }
+            return escaped;
+        }
+
+    }
+
+    //-------------------------------------------------------------------------
+    // Counters
+    //-------------------------------------------------------------------------
+
+    uint64_t ShardedCounter::value() const {
+        uint64_t total = 0;
+        for (const auto& shard : shards) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    size_t ShardedCounter::shardIndex() {
+        static std::atomic<size_t> next_shard{ 0 };
+        thread_local size_t index = next_shard.fetch_add(1, std::memory_order_relaxed) %
+            mqtt::constants::METRICS_COUNTER_SHARDS;
+        return index;
+    }
+
+    //-------------------------------------------------------------------------
+    // Registry
+    //-------------------------------------------------------------------------
+
+    ShardedCounter& MetricsRegistry::counter(const std::string& name, const std::string& help) {
+        auto entry = std::make_unique<Entry>();
+        entry->name = name;
+        entry->help = help;
+        entry->type = Type::Counter;
+        entry->counter = std::make_unique<ShardedCounter>();
+        ShardedCounter& registered = *entry->counter;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.push_back(std::move(entry));
+        return registered;
+    }
+
+    DurationCounter& MetricsRegistry::duration(const std::string& name, const std::string& help) {
+        auto entry = std::make_unique<Entry>();
+        entry->name = name;
+        entry->help = help;
+        entry->type = Type::Duration;
+        entry->duration = std::make_unique<DurationCounter>();
+        DurationCounter& registered = *entry->duration;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.push_back(std::move(entry));
+        return registered;
+    }
+
+    void MetricsRegistry::gauge(const std::string& name, const std::string& help, std::function<double()> read) {
+        auto entry = std::make_unique<Entry>();
+        entry->name = name;
+        entry->help = help;
+        entry->type = Type::Gauge;
+        entry->read = std::move(read);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.push_back(std::move(entry));
+    }
+
+    std::vector<MetricsRegistry::Sample> MetricsRegistry::collect() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Sample> samples;
+        samples.reserve(entries.size());
+        for (const auto& entry : entries) {
+            samples.push_back(sample(*entry));
+        }
+        return samples;
+    }
+
+    double MetricsRegistry::value(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : entries) {
+            if (entry->name == name) {
+                return sample(*entry).value;
+            }
+        }
+        return 0;
+    }
+
+    std::string MetricsRegistry::format(MetricsFormat output_format) const {
+        auto samples = collect();
+        std::ostringstream out;
+        out << std::setprecision(15);
+
+        if (output_format == MetricsFormat::Prometheus) {
+            for (const auto& metric : samples) {
+                out << "# HELP " << metric.name << ' ' << metric.help << '\n'
+                    << "# TYPE " << metric.name << ' ' << prometheusType(metric.type) << '\n';
+                if (metric.type == Type::Duration) {
+                    out << metric.name << "_sum " << metric.value << '\n'
+                        << metric.name << "_count " << metric.count << '\n';
+                }
+                else {
+                    out << metric.name << ' ' << metric.value << '\n';
+                }
+            }
+            return out.str();
+        }
+
+        out << "{\n  \"metrics\": [";
+        for (size_t i = 0; i < samples.size(); i++) {
+            const auto& metric = samples[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    {\"name\": \"" << escapeJson(metric.name)
+                << "\", \"type\": \"" << prometheusType(metric.type)
+                << "\", \"help\": \"" << escapeJson(metric.help)
+                << "\", \"value\": " << metric.value;
+            if (metric.type == Type::Duration) {
+                out << ", \"count\": " << metric.count;
+            }
+            out << '}';
+        }
+        out << "\n  ]\n}\n";
+        return out.str();
+    }
+
+    bool MetricsRegistry::writeFile(const std::string& path, MetricsFormat output_format) const {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            if (!file) {
+                return false;
+            }
+            file << format(output_format);
+            if (!file.flush()) {
+                return false;
+            }
+        }
+#ifdef _WIN32
+        // std::rename does not replace an existing file on Windows
+        std::remove(path.c_str());
+#endif
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    MetricsRegistry::Sample MetricsRegistry::sample(const Entry& entry) const {
+        Sample result;
+        result.name = entry.name;
+        result.help = entry.help;
+        result.type = entry.type;
+        switch (entry.type) {
+        case Type::Counter:
+            result.value = static_cast<double>(entry.counter->value());
+            break;
+        case Type::Gauge:
+            result.value = entry.read ? entry.read() : 0;
+            break;
+        case Type::Duration:
+            result.value = static_cast<double>(entry.duration->totalNanoseconds()) / 1e9;
+            result.count = entry.duration->count();
+            break;
+        }
+        return result;
+    }
+
+} // namespace mqtt
@@ -1,6 +1,7 @@
 #include "NetworkSimulator.h"
 #include "Broker.h"
 #include "Device.h"
+#include "Snapshot.h"
 #include "Visualization.h"
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
@@ -31,19 +32,42 @@ std::shared_ptr<mqtt::Device> NetworkSimulator::addDevice(
 
     // Create device
     auto device = std::make_shared<mqtt::Device>(device_id, broker, telemetry_interval);
-    devices.push_back(device);
+    attachDevice(device);
 
     // Subscribe to command topics
     device->subscribe("command/" + device_id);
     device->subscribe("command/all");
 
+    return device;
+}
+
+void NetworkSimulator::attachDevice(const std::shared_ptr<mqtt::Device>& device) {
+    devices.push_back(device);
+
     // Message handler to display received commands
-    device->addMessageHandler([device_id](const mqtt::Message& msg) {
+    device->addMessageHandler([device_id = device->getId()](const mqtt::Message& msg) {
         std::cout << "Device " << device_id << " received command: "
             << msg.getTopic() << " -> " << msg.getPayload() << std::endl;
         });
+}
 
-    return device;
+bool NetworkSimulator::saveSnapshot(const std::string& path, std::string& error) const {
+    return mqtt::Snapshot::write(path, *broker, devices, error);
+}
+
+bool NetworkSimulator::loadSnapshot(const std::string& path, std::string& error) {
+    mqtt::Snapshot snapshot;
+    if (!snapshot.open(path, error)) {
+        return false;
+    }
+
+    // Devices already subscribed; only their handlers are missing
+    auto restored = snapshot.restore(broker);
+    devices.reserve(devices.size() + restored.size());
+    for (const auto& device : restored) {
+        attachDevice(device);
+    }
+    return true;
 }
 
 void NetworkSimulator::setupInitialDevices() {
@@ -136,9 +160,15 @@ void NetworkSimulator::setupUIComponents() {
         addDevice(id);
         };
 
+    // Snapshot callback for the overview's button
+    auto save_snapshot_callback = [this]() {
+        std::string error;
+        return saveSnapshot(mqtt::constants::SNAPSHOT_DEFAULT_FILE, error);
+        };
+
     // Create UI components
     ui_components.push_back(std::make_unique<visualization::NetworkOverview>(
-        broker, devices, add_device_callback));
+        broker, devices, add_device_callback, save_snapshot_callback));
     ui_components.push_back(std::make_unique<visualization::MessageFlow>(broker, devices));
     ui_components.push_back(std::make_unique<visualization::DeviceDetails>(devices));
     ui_components.push_back(std::make_unique<visualization::CommandCenter>(broker, devices));
@@ -0,0 +1,660 @@
+#include "PersistentLog.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mqtt {
+
+    namespace {
+
+        // Segment files start with a magic number and a format version
+        constexpr char SEGMENT_MAGIC[4] = { 'M', 'Q', 'S', 'L' };
+        constexpr uint32_t SEGMENT_VERSION = 1;
+        constexpr size_t SEGMENT_HEADER_SIZE = 8;
+
+        // Records: length and CRC-32 of the rest, then a type byte and its fields
+        constexpr size_t RECORD_HEADER_SIZE = 8;
+
+        // Compaction writes the new segment in pieces this large
+        constexpr size_t COMPACT_WRITE_CHUNK = 1024 * 1024;
+
+        constexpr char SEGMENT_EXTENSION[] = ".log";
+        constexpr char TEMPORARY_EXTENSION[] = ".tmp";
+
+        constexpr std::array<uint32_t, 256> CRC_TABLE = [] {
+            std::array<uint32_t, 256> table{};
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+                }
+                table[i] = crc;
+            }
+            return table;
+        }();
+
+        // CRC-32 as used by zlib and Ethernet
+        uint32_t crc32(std::string_view data) {
+            uint32_t crc = 0xFFFFFFFFu;
+            for (char byte : data) {
+                crc = CRC_TABLE[(crc ^ static_cast<uint8_t>(byte)) & 0xFF] ^ (crc >> 8);
+            }
+            return crc ^ 0xFFFFFFFFu;
+        }
+
+        // Fixed-width fields are little-endian whatever the host
+        void putU32(std::string& out, uint32_t value) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                out.push_back(static_cast<char>((value >> shift) & 0xFF));
+            }
+        }
+
+        void putU64(std::string& out, uint64_t value) {
+            for (int shift = 0; shift < 64; shift += 8) {
+                out.push_back(static_cast<char>((value >> shift) & 0xFF));
+            }
+        }
+
+        void putString(std::string& out, std::string_view text) {
+            putU32(out, static_cast<uint32_t>(text.size()));
+            out.append(text.data(), text.size());
+        }
+
+        uint64_t loadLittleEndian(const char* bytes, int width) {
+            uint64_t value = 0;
+            for (int i = width - 1; i >= 0; i--) {
+                value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+            }
+            return value;
+        }
+
+        /**
+         * @brief Bounds-checked reads from one record
+         */
+        struct RecordReader {
+            std::string_view data;
+            size_t pos = 0;
+
+            bool u8(uint8_t& value) {
+                if (data.size() - pos < 1) {
+                    return false;
+                }
+                value = static_cast<uint8_t>(data[pos++]);
+                return true;
+            }
+
+            bool u32(uint32_t& value) {
+                if (data.size() - pos < 4) {
+                    return false;
+                }
+                value = static_cast<uint32_t>(loadLittleEndian(data.data() + pos, 4));
+                pos += 4;
+                return true;
+            }
+
+            bool u64(uint64_t& value) {
+                if (data.size() - pos < 8) {
+                    return false;
+                }
+                value = loadLittleEndian(data.data() + pos, 8);
+                pos += 8;
+                return true;
+            }
+
+            bool text(std::string_view& value) {
+                uint32_t length = 0;
+                if (!u32(length) || data.size() - pos < length) {
+                    return false;
+                }
+                value = data.substr(pos, length);
+                pos += length;
+                return true;
+            }
+
+            bool done() const {
+                return pos == data.size();
+            }
+        };
+
+    }
+
+    PersistentLog::PersistentLog(const std::string& directory, size_t segment_bytes)
+        : directory(directory),
+        segment_bytes(segment_bytes) {
+    }
+
+    bool PersistentLog::appendRetained(const Message& message) {
+        record.clear();
+        encodeRetained(record, message);
+        return writeRecord();
+    }
+
+    bool PersistentLog::appendSubscribe(const std::string& client_id, const std::string& filter) {
+        record.clear();
+        encodeSubscription(record, RecordType::Subscribe, client_id, filter);
+        return writeRecord();
+    }
+
+    bool PersistentLog::appendUnsubscribe(const std::string& client_id, const std::string& filter) {
+        record.clear();
+        encodeSubscription(record, RecordType::Unsubscribe, client_id, filter);
+        return writeRecord();
+    }
+
+    bool PersistentLog::needsCompaction() const {
+        return total_bytes >= mqtt::constants::LOG_COMPACT_MIN_BYTES &&
+            total_bytes >= mqtt::constants::LOG_COMPACT_RATIO * std::max<uint64_t>(live_bytes, SEGMENT_HEADER_SIZE);
+    }
+
+    PersistentLog::Stats PersistentLog::getStats() const {
+        Stats current = stats;
+        current.segments = segments.size();
+        current.bytes = total_bytes;
+        return current;
+    }
+
+    const std::string& PersistentLog::getDirectory() const {
+        return directory;
+    }
+
+    std::string PersistentLog::segmentPath(uint64_t sequence) const {
+        // Zero-padded so names sort in sequence order
+        char name[32];
+        std::snprintf(name, sizeof(name), "%020llu%s", static_cast<unsigned long long>(sequence), SEGMENT_EXTENSION);
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    void PersistentLog::beginRecord(std::string& buffer, RecordType type) {
+        buffer.append(RECORD_HEADER_SIZE, '\0');
+        buffer.push_back(static_cast<char>(type));
+    }
+
+    void PersistentLog::endRecord(std::string& buffer, size_t start) {
+        std::string_view body(buffer.data() + start + RECORD_HEADER_SIZE, buffer.size() - start - RECORD_HEADER_SIZE);
+        std::string header;
+        putU32(header, static_cast<uint32_t>(body.size()));
+        putU32(header, crc32(body));
+        buffer.replace(start, RECORD_HEADER_SIZE, header);
+    }
+
+    void PersistentLog::encodeRetained(std::string& buffer, const Message& message) {
+        size_t start = buffer.size();
+        if (message.getPayload().empty()) {
+            beginRecord(buffer, RecordType::Clear);
+            putString(buffer, message.getTopic());
+        }
+        else {
+            beginRecord(buffer, RecordType::Retain);
+            putString(buffer, message.getTopic());
+            putString(buffer, message.getPayload());
+            buffer.push_back(static_cast<char>(message.getQoS()));
+            putU64(buffer, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                message.getTimestamp().time_since_epoch()).count()));
+            std::string properties;
+            if (message.hasProperties()) {
+                message.appendProperties(properties);
+            }
+            putString(buffer, properties);
+        }
+        endRecord(buffer, start);
+    }
+
+    void PersistentLog::encodeSubscription(std::string& buffer, RecordType type, const std::string& client_id,
+        const std::string& filter) {
+        size_t start = buffer.size();
+        beginRecord(buffer, type);
+        putString(buffer, client_id);
+        putString(buffer, filter);
+        endRecord(buffer, start);
+    }
+
+    bool PersistentLog::applyRecord(std::string_view data, RetainedStore& retained,
+        std::set<Subscription>& subscriptions) {
+        RecordReader reader{ data };
+        uint8_t type = 0;
+        if (!reader.u8(type)) {
+            return false;
+        }
+        switch (static_cast<RecordType>(type)) {
+        case RecordType::Retain: {
+            std::string_view topic, payload, properties;
+            uint8_t qos = 0;
+            uint64_t timestamp_us = 0;
+            if (!reader.text(topic) || !reader.text(payload) || !reader.u8(qos) || qos > 2 ||
+                !reader.u64(timestamp_us) || !reader.text(properties) || !reader.done()) {
+                return false;
+            }
+            Message message{ std::string(topic), std::string(payload), static_cast<QoS>(qos), true };
+            message.setTimestamp(std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::microseconds(static_cast<int64_t>(timestamp_us)))));
+            if (!properties.empty() && !message.readProperties(properties)) {
+                return false;
+            }
+            retained.store(message);
+            return true;
+        }
+        case RecordType::Clear: {
+            std::string_view topic;
+            if (!reader.text(topic) || !reader.done()) {
+                return false;
+            }
+            retained.erase(std::string(topic));
+            return true;
+        }
+        case RecordType::Subscribe:
+        case RecordType::Unsubscribe: {
+            std::string_view client_id, filter;
+            if (!reader.text(client_id) || !reader.text(filter) || !reader.done()) {
+                return false;
+            }
+            Subscription subscription(client_id, filter);
+            if (static_cast<RecordType>(type) == RecordType::Subscribe) {
+                subscriptions.insert(std::move(subscription));
+            }
+            else {
+                subscriptions.erase(subscription);
+            }
+            return true;
+        }
+        }
+        return false;
+    }
+
+    bool PersistentLog::compact(const RetainedStore& retained, const std::set<Subscription>& subscriptions) {
+        auto compaction = beginCompaction();
+        if (!compaction) {
+            return false;
+        }
+        retained.forEach([&](const Message& message) {
+            compaction->addRetained(message);
+            });
+        for (const auto& subscription : subscriptions) {
+            compaction->addSubscription(subscription);
+        }
+        compaction->commit();
+        finishCompaction(*compaction);
+        return compaction->committed;
+    }
+
+    void PersistentLog::Compaction::addRetained(const Message& message) {
+        encodeRetained(buffer, message);
+        if (buffer.size() >= COMPACT_WRITE_CHUNK) {
+            flush();
+        }
+    }
+
+    void PersistentLog::Compaction::addSubscription(const Subscription& subscription) {
+        encodeSubscription(buffer, RecordType::Subscribe, subscription.first, subscription.second);
+        if (buffer.size() >= COMPACT_WRITE_CHUNK) {
+            flush();
+        }
+    }
+
+#ifdef __linux__
+
+    namespace {
+
+        bool writeAll(int fd, const char* data, size_t size) {
+            while (size > 0) {
+                ssize_t written = ::write(fd, data, size);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        std::string segmentHeader() {
+            std::string header(SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+            putU32(header, SEGMENT_VERSION);
+            return header;
+        }
+
+        // Makes a rename or unlink in the directory durable
+        void syncDirectory(const std::string& directory) {
+            int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd >= 0) {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+
+        bool failed(std::string& error, const std::string& what) {
+            error = what + ": " + std::strerror(errno);
+            return false;
+        }
+
+    }
+
+    PersistentLog::~PersistentLog() {
+        if (fd >= 0) {
+            ::fsync(fd);
+        }
+        closeSegment();
+    }
+
+    bool PersistentLog::open(RetainedStore& retained, std::set<Subscription>& subscriptions, std::string& error) {
+        auto start = std::chrono::steady_clock::now();
+        std::error_code status;
+        std::filesystem::create_directories(directory, status);
+        if (status) {
+            error = "Cannot create " + directory + ": " + status.message();
+            return false;
+        }
+
+        // Leftovers of an interrupted compaction are incomplete; the segments they would have replaced are not
+        std::vector<uint64_t> found;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, status)) {
+            std::string name = entry.path().filename().string();
+            if (entry.path().extension() == TEMPORARY_EXTENSION) {
+                std::filesystem::remove(entry.path(), status);
+                continue;
+            }
+            char* end = nullptr;
+            unsigned long long sequence = std::strtoull(name.c_str(), &end, 10);
+            if (end != name.c_str() && std::strcmp(end, SEGMENT_EXTENSION) == 0 && sequence > 0) {
+                found.push_back(sequence);
+            }
+        }
+        if (status) {
+            error = "Cannot list " + directory + ": " + status.message();
+            return false;
+        }
+        std::sort(found.begin(), found.end());
+
+        segments.clear();
+        total_bytes = 0;
+        for (uint64_t sequence : found) {
+            if (!replaySegment(sequence, retained, subscriptions, error)) {
+                return false;
+            }
+            segments.push_back(sequence);
+        }
+        if (!openForAppend(segments.empty() ? 1 : segments.back(), error)) {
+            return false;
+        }
+
+        // Scale the log by the share of replayed records still live to judge how much compaction would save
+        uint64_t live_entries = retained.size() + subscriptions.size();
+        live_bytes = stats.recovered == 0 ? total_bytes :
+            total_bytes * std::min<uint64_t>(live_entries, stats.recovered) / stats.recovered;
+        stats.recovery_time = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+        return true;
+    }
+
+    bool PersistentLog::replaySegment(uint64_t sequence, RetainedStore& retained,
+        std::set<Subscription>& subscriptions, std::string& error) {
+        std::string path = segmentPath(sequence);
+        int segment_fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (segment_fd < 0) {
+            return failed(error, "Cannot open " + path);
+        }
+        struct stat info {};
+        if (::fstat(segment_fd, &info) != 0) {
+            ::close(segment_fd);
+            return failed(error, "Cannot stat " + path);
+        }
+
+        size_t size = static_cast<size_t>(info.st_size);
+        size_t valid = 0;
+        if (size >= SEGMENT_HEADER_SIZE) {
+            void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, segment_fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(segment_fd);
+                return failed(error, "Cannot map " + path);
+            }
+            ::madvise(mapped, size, MADV_SEQUENTIAL);
+            std::string_view data(static_cast<const char*>(mapped), size);
+
+            if (data.compare(0, SEGMENT_HEADER_SIZE, segmentHeader()) == 0) {
+                valid = SEGMENT_HEADER_SIZE;
+                while (size - valid >= RECORD_HEADER_SIZE) {
+                    uint32_t length = static_cast<uint32_t>(loadLittleEndian(data.data() + valid, 4));
+                    uint32_t checksum = static_cast<uint32_t>(loadLittleEndian(data.data() + valid + 4, 4));
+                    if (length == 0 || length > size - valid - RECORD_HEADER_SIZE) {
+                        break;
+                    }
+                    std::string_view body = data.substr(valid + RECORD_HEADER_SIZE, length);
+                    if (crc32(body) != checksum || !applyRecord(body, retained, subscriptions)) {
+                        break;
+                    }
+                    valid += RECORD_HEADER_SIZE + length;
+                    stats.recovered++;
+                }
+            }
+            ::munmap(mapped, size);
+        }
+
+        // Appends resume after the last good record; a segment without a valid header restarts empty
+        if (valid < size) {
+            stats.torn_bytes += size - valid;
+            if (::ftruncate(segment_fd, static_cast<off_t>(valid)) != 0) {
+                ::close(segment_fd);
+                return failed(error, "Cannot truncate " + path);
+            }
+        }
+        ::close(segment_fd);
+        total_bytes += valid;
+        return true;
+    }
+
+    bool PersistentLog::openForAppend(uint64_t sequence, std::string& error) {
+        std::string path = segmentPath(sequence);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return failed(error, "Cannot open " + path);
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            failed(error, "Cannot stat " + path);
+            closeSegment();
+            return false;
+        }
+        segment_size = static_cast<uint64_t>(info.st_size);
+        if (segment_size < SEGMENT_HEADER_SIZE) {
+            std::string header = segmentHeader();
+            if (::ftruncate(fd, 0) != 0 || !writeAll(fd, header.data(), header.size())) {
+                failed(error, "Cannot write " + path);
+                closeSegment();
+                return false;
+            }
+            total_bytes += header.size() - segment_size;
+            segment_size = header.size();
+        }
+        if (segments.empty() || segments.back() != sequence) {
+            segments.push_back(sequence);
+        }
+        return true;
+    }
+
+    void PersistentLog::closeSegment() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool PersistentLog::writeRecord() {
+        if (fd < 0) {
+            stats.write_errors++;
+            return false;
+        }
+        if (segment_size + record.size() > segment_bytes && segment_size > SEGMENT_HEADER_SIZE) {
+            std::string error;
+            closeSegment();
+            if (!openForAppend(segments.back() + 1, error)) {
+                stats.write_errors++;
+                return false;
+            }
+        }
+        if (!writeAll(fd, record.data(), record.size())) {
+            // Cut a partial write off so later records stay readable
+            if (::ftruncate(fd, static_cast<off_t>(segment_size)) != 0) {
+                closeSegment();
+            }
+            stats.write_errors++;
+            return false;
+        }
+        segment_size += record.size();
+        total_bytes += record.size();
+        stats.appended++;
+        return true;
+    }
+
+    std::unique_ptr<PersistentLog::Compaction> PersistentLog::beginCompaction() {
+        if (fd < 0) {
+            return nullptr;
+        }
+        std::unique_ptr<Compaction> compaction(new Compaction());
+        compaction->directory = directory;
+        compaction->sequence = segments.back() + 1;
+        compaction->path = segmentPath(compaction->sequence);
+        compaction->temporary = compaction->path + TEMPORARY_EXTENSION;
+        compaction->fd = ::open(compaction->temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (compaction->fd < 0) {
+            return nullptr;
+        }
+        for (uint64_t old : segments) {
+            compaction->replaced.push_back(segmentPath(old));
+        }
+        compaction->replaced_bytes = total_bytes;
+        compaction->buffer = segmentHeader();
+
+        // Appends skip the compacted segment's number so they replay after it
+        std::string error;
+        closeSegment();
+        if (!openForAppend(compaction->sequence + 1, error)) {
+            stats.write_errors++;
+            return nullptr;
+        }
+        return compaction;
+    }
+
+    PersistentLog::Compaction::~Compaction() {
+        if (fd >= 0) {
+            ::close(fd);
+            ::unlink(temporary.c_str());
+        }
+    }
+
+    void PersistentLog::Compaction::flush() {
+        ok = ok && writeAll(fd, buffer.data(), buffer.size());
+        written += buffer.size();
+        buffer.clear();
+    }
+
+    bool PersistentLog::Compaction::commit() {
+        flush();
+        ok = ok && ::fsync(fd) == 0;
+        ::close(fd);
+        fd = -1;
+        if (!ok || ::rename(temporary.c_str(), path.c_str()) != 0) {
+            ::unlink(temporary.c_str());
+            return false;
+        }
+        syncDirectory(directory);
+
+        // Oldest first, so a crash part way leaves a suffix of the history that the new segment completes
+        for (const auto& old : replaced) {
+            ::unlink(old.c_str());
+        }
+        syncDirectory(directory);
+        committed = true;
+        return true;
+    }
+
+    void PersistentLog::finishCompaction(const Compaction& compaction) {
+        if (!compaction.committed) {
+            return;
+        }
+        segments.erase(std::remove_if(segments.begin(), segments.end(), [&](uint64_t sequence) {
+            return sequence < compaction.sequence;
+            }), segments.end());
+        segments.insert(segments.begin(), compaction.sequence);
+        total_bytes = total_bytes - compaction.replaced_bytes + compaction.written;
+        live_bytes = compaction.written;
+        stats.compactions++;
+
+        // Nothing was appended meanwhile, so appends can carry on in the compacted segment
+        if (segments.size() == 2 && segment_size <= SEGMENT_HEADER_SIZE) {
+            closeSegment();
+            ::unlink(segmentPath(segments.back()).c_str());
+            segments.pop_back();
+            total_bytes -= segment_size;
+            std::string error;
+            openForAppend(compaction.sequence, error);
+        }
+    }
+
+    void PersistentLog::sync() {
+        if (fd >= 0) {
+            ::fsync(fd);
+        }
+    }
+
+#else
+
+    PersistentLog::~PersistentLog() = default;
+
+    bool PersistentLog::open(RetainedStore&, std::set<Subscription>&, std::string& error) {
+        error = "Persistence requires Linux";
+        return false;
+    }
+
+    bool PersistentLog::replaySegment(uint64_t, RetainedStore&, std::set<Subscription>&, std::string&) {
+        return false;
+    }
+
+    bool PersistentLog::openForAppend(uint64_t, std::string&) {
+        return false;
+    }
+
+    void PersistentLog::closeSegment() {
+    }
+
+    bool PersistentLog::writeRecord() {
+        stats.write_errors++;
+        return false;
+    }
+
+    std::unique_ptr<PersistentLog::Compaction> PersistentLog::beginCompaction() {
+        return nullptr;
+    }
+
+    PersistentLog::Compaction::~Compaction() = default;
+
+    void PersistentLog::Compaction::flush() {
+        buffer.clear();
+        ok = false;
+    }
+
+    bool PersistentLog::Compaction::commit() {
+        return false;
+    }
+
+    void PersistentLog::finishCompaction(const Compaction&) {
+    }
+
+    void PersistentLog::sync() {
+    }
+
+#endif
+
+} // namespace mqtt
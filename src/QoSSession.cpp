@@ -0,0 +1,157 @@
+#include "QoSSession.h"
+#include "Constants.h"
+#include <algorithm>
+
+namespace mqtt {
+
+    QoSSession::QoSSession() {
+        reset(1, 0);
+    }
+
+    void QoSSession::reset(uint16_t send_window, uint16_t receive_window) {
+        send_window = std::max<uint16_t>(send_window, 1);
+        slots.assign(send_window, Slot());
+        generations.assign(send_window, 0);
+        free_slots.resize(send_window);
+        // Lowest slot on top so ids start at 1
+        for (uint16_t i = 0; i < send_window; i++) {
+            free_slots[i] = static_cast<uint16_t>(send_window - 1 - i);
+        }
+        pending.clear();
+        unreleased.clear();
+        unreleased.reserve(receive_window);
+        this->receive_window = receive_window;
+        retries = 0;
+    }
+
+    bool QoSSession::canSend() const {
+        return !free_slots.empty() && pending.empty();
+    }
+
+    uint16_t QoSSession::send(const Message& message, Clock::time_point now) {
+        if (!canSend()) {
+            return 0;
+        }
+        return occupy(message, now);
+    }
+
+    bool QoSSession::enqueue(const Message& message) {
+        if (pending.size() >= mqtt::constants::QOS_MAX_PENDING) {
+            return false;
+        }
+        pending.push_back(message);
+        return true;
+    }
+
+    uint16_t QoSSession::sendQueued(Clock::time_point now, const Message*& message) {
+        if (pending.empty() || free_slots.empty()) {
+            return 0;
+        }
+        uint16_t packet_id = occupy(pending.front(), now);
+        pending.pop_front();
+        message = &slots[(packet_id - 1u) % slots.size()].message;
+        return packet_id;
+    }
+
+    uint16_t QoSSession::occupy(const Message& message, Clock::time_point now) {
+        uint16_t index = free_slots.back();
+        free_slots.pop_back();
+
+        // The id encodes the slot: slot + 1 + window * generation
+        const size_t window = slots.size();
+        uint16_t& generation = generations[index];
+        Slot& slot = slots[index];
+        slot.message = message;
+        slot.sent = now;
+        slot.packet_id = static_cast<uint16_t>(index + 1 + window * generation);
+        generation = static_cast<uint16_t>((generation + 1) % (65535 / window));
+        slot.state = message.getQoS() == QoS::EXACTLY_ONCE ? SlotState::AwaitingPubrec : SlotState::AwaitingPuback;
+        return slot.packet_id;
+    }
+
+    QoSSession::Slot* QoSSession::find(uint16_t packet_id, SlotState state) {
+        if (packet_id == 0) {
+            return nullptr;
+        }
+        Slot& slot = slots[(packet_id - 1u) % slots.size()];
+        return slot.packet_id == packet_id && slot.state == state ? &slot : nullptr;
+    }
+
+    void QoSSession::releaseSlot(Slot& slot) {
+        slot.state = SlotState::Free;
+        slot.message = Message(); // Drops the shared body now rather than on reuse
+        free_slots.push_back(static_cast<uint16_t>(&slot - slots.data()));
+    }
+
+    bool QoSSession::acknowledge(uint16_t packet_id) {
+        Slot* slot = find(packet_id, SlotState::AwaitingPuback);
+        if (slot == nullptr) {
+            return false;
+        }
+        releaseSlot(*slot);
+        return true;
+    }
+
+    bool QoSSession::received(uint16_t packet_id, Clock::time_point now) {
+        Slot* slot = find(packet_id, SlotState::AwaitingPubrec);
+        if (slot == nullptr) {
+            // A repeated PUBREC gets the PUBREL again
+            return find(packet_id, SlotState::AwaitingPubcomp) != nullptr;
+        }
+        slot->state = SlotState::AwaitingPubcomp;
+        slot->sent = now;
+        return true;
+    }
+
+    bool QoSSession::complete(uint16_t packet_id) {
+        Slot* slot = find(packet_id, SlotState::AwaitingPubcomp);
+        if (slot == nullptr) {
+            return false;
+        }
+        releaseSlot(*slot);
+        return true;
+    }
+
+    bool QoSSession::refused(uint16_t packet_id) {
+        Slot* slot = find(packet_id, SlotState::AwaitingPubrec);
+        if (slot == nullptr) {
+            return false;
+        }
+        releaseSlot(*slot);
+        return true;
+    }
+
+    size_t QoSSession::inFlight() const {
+        return slots.size() - free_slots.size();
+    }
+
+    size_t QoSSession::queued() const {
+        return pending.size();
+    }
+
+    uint64_t QoSSession::getRetries() const {
+        return retries;
+    }
+
+    QoSSession::ReceiveResult QoSSession::beginReceive(uint16_t packet_id) {
+        if (std::find(unreleased.begin(), unreleased.end(), packet_id) != unreleased.end()) {
+            return ReceiveResult::Duplicate;
+        }
+        if (unreleased.size() >= receive_window) {
+            return ReceiveResult::Exceeded;
+        }
+        unreleased.push_back(packet_id);
+        return ReceiveResult::New;
+    }
+
+    bool QoSSession::release(uint16_t packet_id) {
+        auto it = std::find(unreleased.begin(), unreleased.end(), packet_id);
+        if (it == unreleased.end()) {
+            return false;
+        }
+        *it = unreleased.back();
+        unreleased.pop_back();
+        return true;
+    }
+
+} // namespace mqtt
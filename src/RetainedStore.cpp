@@ -0,0 +1,369 @@
+#include "RetainedStore.h"
+#include <algorithm>
+
+namespace mqtt {
+
+    RetainedStore::RetainedStore()
+        : nodes(1) {
+    }
+
+    RetainedStore::~RetainedStore() = default;
+
+    void RetainedStore::store(const Message& message) {
+        if (message.getPayload().empty()) {
+            erase(message.getTopic());
+            return;
+        }
+
+        uint32_t node = 0;
+        for (std::string_view level : splitLevels(message.getTopic())) {
+            uint32_t child = findChild(node, level);
+            node = child != NONE ? child : addChild(node, level);
+        }
+
+        // Acquire before releasing so an unchanged value never leaves its pool
+        uint32_t payload = payloads.acquire(message.getPayload());
+        uint32_t blob = NONE;
+        if (message.hasProperties()) {
+            std::string encoded;
+            message.appendProperties(encoded);
+            blob = properties.acquire(encoded);
+        }
+        Node& target = nodes[node];
+        if (target.payload == NONE) {
+            message_count++;
+        }
+        clearMessage(target);
+        target.payload = payload;
+        target.properties = blob;
+        target.qos = message.getQoS();
+        target.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            message.getTimestamp().time_since_epoch()).count();
+    }
+
+    bool RetainedStore::erase(const std::string& topic) {
+        size_t before = message_count;
+        eraseFrom(0, splitLevels(topic), 0);
+        return message_count != before;
+    }
+
+    std::optional<Message> RetainedStore::find(const std::string& topic) const {
+        uint32_t node = 0;
+        for (std::string_view level : splitLevels(topic)) {
+            node = findChild(node, level);
+            if (node == NONE) {
+                return std::nullopt;
+            }
+        }
+        if (nodes[node].payload == NONE) {
+            return std::nullopt;
+        }
+        return toMessage(node, topic, false);
+    }
+
+    size_t RetainedStore::collect(const std::string& filter, std::string& cursor, size_t limit,
+        std::vector<Message>& out) const {
+        if (limit == 0) {
+            return 0;
+        }
+        std::vector<std::string_view> filter_levels = splitLevels(filter);
+        std::vector<std::string_view> cursor_levels;
+        if (!cursor.empty()) {
+            cursor_levels = splitLevels(cursor);
+        }
+
+        Walk walk{ filter_levels, cursor_levels, limit, out, std::string(), 0 };
+        walk.cache = true;
+        walkFilter(walk, 0, 0, !cursor.empty());
+        if (walk.added > 0) {
+            cursor = out.back().getTopic();
+        }
+        return walk.added;
+    }
+
+    size_t RetainedStore::collectAll(std::string& cursor, size_t limit, std::vector<Message>& out) const {
+        if (limit == 0) {
+            return 0;
+        }
+        std::vector<std::string_view> no_filter;
+        std::vector<std::string_view> cursor_levels;
+        if (!cursor.empty()) {
+            cursor_levels = splitLevels(cursor);
+        }
+
+        Walk walk{ no_filter, cursor_levels, limit, out, std::string(), 0 };
+        walkSubtree(walk, 0, 0, !cursor.empty(), false);
+        if (walk.added > 0) {
+            cursor = out.back().getTopic();
+        }
+        return walk.added;
+    }
+
+    void RetainedStore::forEach(const std::function<void(const Message&)>& visit) const {
+        std::string topic;
+        for (uint32_t child : nodes[0].children) {
+            topic.assign(levelName(child));
+            visitSubtree(child, topic, visit);
+        }
+    }
+
+    size_t RetainedStore::size() const {
+        return message_count;
+    }
+
+    bool RetainedStore::empty() const {
+        return message_count == 0;
+    }
+
+    RetainedStore::MemoryUsage RetainedStore::memoryUsage() const {
+        MemoryUsage usage;
+        usage.topics = message_count;
+        usage.nodes = nodes.size() - free_nodes.size();
+        usage.levels = levels.size();
+        usage.payloads = payloads.size();
+        usage.payload_bytes = payloads.contentBytes();
+        usage.properties = properties.size();
+        usage.cache_bytes = replay_cache.capacity() * sizeof(CachedReplay);
+        for (const auto& entry : replay_cache) {
+            if (entry.node != NONE) {
+                usage.cached++;
+                usage.cache_bytes += entry.message.getPayload().size() + entry.message.getTopic().size();
+            }
+        }
+        usage.node_bytes = nodes.capacity() * sizeof(Node) + free_nodes.capacity() * sizeof(uint32_t) +
+            children_bytes;
+        usage.pool_bytes = levels.memoryBytes() + payloads.memoryBytes() + properties.memoryBytes();
+        usage.total_bytes = usage.node_bytes + usage.pool_bytes + usage.cache_bytes;
+        return usage;
+    }
+
+    std::vector<std::string_view> RetainedStore::splitLevels(std::string_view topic) {
+        std::vector<std::string_view> split;
+        size_t pos = 0;
+        while (true) {
+            size_t end = topic.find('/', pos);
+            if (end == std::string_view::npos) {
+                split.push_back(topic.substr(pos));
+                return split;
+            }
+            split.push_back(topic.substr(pos, end - pos));
+            pos = end + 1;
+        }
+    }
+
+    std::string_view RetainedStore::levelName(uint32_t node) const {
+        return levels.get(nodes[node].level);
+    }
+
+    std::vector<uint32_t>::const_iterator RetainedStore::lowerBound(const Node& node, std::string_view level) const {
+        return std::lower_bound(node.children.begin(), node.children.end(), level,
+            [this](uint32_t child, std::string_view name) { return levelName(child) < name; });
+    }
+
+    uint32_t RetainedStore::findChild(uint32_t node, std::string_view level) const {
+        const Node& parent = nodes[node];
+        auto it = lowerBound(parent, level);
+        return it != parent.children.end() && levelName(*it) == level ? *it : NONE;
+    }
+
+    uint32_t RetainedStore::addChild(uint32_t node, std::string_view level) {
+        uint32_t child;
+        if (!free_nodes.empty()) {
+            child = free_nodes.back();
+            free_nodes.pop_back();
+        }
+        else {
+            child = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[child].level = levels.acquire(level);
+
+        // Taken after emplace_back, which may have moved the array
+        Node& parent = nodes[node];
+        size_t before = parent.children.capacity();
+        auto position = parent.children.begin() + (lowerBound(parent, level) - parent.children.cbegin());
+        parent.children.insert(position, child);
+        children_bytes += (parent.children.capacity() - before) * sizeof(uint32_t);
+        return child;
+    }
+
+    void RetainedStore::clearMessage(Node& node) {
+        if (node.replay != NONE) {
+            replay_cache[node.replay] = CachedReplay();
+            node.replay = NONE;
+        }
+        if (node.payload != NONE) {
+            payloads.release(node.payload);
+            node.payload = NONE;
+        }
+        if (node.properties != NONE) {
+            properties.release(node.properties);
+            node.properties = NONE;
+        }
+    }
+
+    bool RetainedStore::eraseFrom(uint32_t node, const std::vector<std::string_view>& path, size_t depth) {
+        if (depth == path.size()) {
+            if (nodes[node].payload != NONE) {
+                clearMessage(nodes[node]);
+                message_count--;
+            }
+        }
+        else {
+            uint32_t child = findChild(node, path[depth]);
+            if (child != NONE && eraseFrom(child, path, depth + 1)) {
+                // Prune the child: it holds nothing and has no children left
+                Node& parent = nodes[node];
+                parent.children.erase(std::find(parent.children.begin(), parent.children.end(), child));
+                Node& removed = nodes[child];
+                levels.release(removed.level);
+                children_bytes -= removed.children.capacity() * sizeof(uint32_t);
+                removed = Node();
+                free_nodes.push_back(child);
+            }
+        }
+        const Node& current = nodes[node];
+        return node != 0 && current.payload == NONE && current.children.empty();
+    }
+
+    Message RetainedStore::toMessage(uint32_t index, const std::string& topic, bool cache) const {
+        const Node& node = nodes[index];
+        if (node.replay != NONE) {
+            return replay_cache[node.replay].message;
+        }
+
+        Message message(topic, std::string(payloads.get(node.payload)), node.qos, true);
+        if (node.properties != NONE) {
+            message.readProperties(properties.get(node.properties));
+        }
+        message.setTimestamp(std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::microseconds(node.timestamp_us))));
+        if (!cache) {
+            return message;
+        }
+
+        // Evict whatever the slot held; a full ring wraps around to the oldest
+        uint32_t slot = static_cast<uint32_t>(replay_next);
+        replay_next = (replay_next + 1) % mqtt::constants::RETAINED_REPLAY_CACHE_SIZE;
+        if (slot == replay_cache.size()) {
+            replay_cache.emplace_back();
+        }
+        CachedReplay& entry = replay_cache[slot];
+        if (entry.node != NONE) {
+            nodes[entry.node].replay = NONE;
+        }
+        entry.node = index;
+        entry.message = message;
+        nodes[index].replay = slot;
+        return message;
+    }
+
+    //-------------------------------------------------------------------------
+    // Filter walk
+    //
+    // Matches are visited in pre-order: a topic's own message, then its
+    // child levels in sorted order. on_cursor means the current node lies
+    // on the path of the cursor topic, so it and every sibling branch
+    // sorting before the cursor were returned by an earlier chunk.
+    //-------------------------------------------------------------------------
+
+    bool RetainedStore::walkFilter(Walk& walk, uint32_t node, size_t depth, bool on_cursor) const {
+        if (depth == walk.filter.size()) {
+            return emit(walk, node, on_cursor);
+        }
+
+        std::string_view level = walk.filter[depth];
+        if (level == "#" && depth + 1 == walk.filter.size()) {
+            // "a/#" also matches "a"; wildcards at the first level skip "$" topics
+            return walkSubtree(walk, node, depth, on_cursor, depth == 0);
+        }
+        if (level == "+") {
+            const Node& current = nodes[node];
+            auto it = current.children.begin();
+            if (on_cursor && depth < walk.cursor.size()) {
+                it = lowerBound(current, walk.cursor[depth]);
+            }
+            for (; it != current.children.end(); ++it) {
+                std::string_view name = levelName(*it);
+                if (depth == 0 && !name.empty() && name[0] == '$') {
+                    continue;
+                }
+                if (!walkChild(walk, *it, depth, on_cursor, false)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        if (on_cursor && depth < walk.cursor.size() && level < walk.cursor[depth]) {
+            return true;
+        }
+        uint32_t child = findChild(node, level);
+        return child == NONE || walkChild(walk, child, depth, on_cursor, false);
+    }
+
+    bool RetainedStore::walkSubtree(Walk& walk, uint32_t node, size_t depth, bool on_cursor,
+        bool skip_system) const {
+        if (!emit(walk, node, on_cursor)) {
+            return false;
+        }
+        const Node& current = nodes[node];
+        auto it = current.children.begin();
+        if (on_cursor && depth < walk.cursor.size()) {
+            it = lowerBound(current, walk.cursor[depth]);
+        }
+        for (; it != current.children.end(); ++it) {
+            std::string_view name = levelName(*it);
+            if (skip_system && !name.empty() && name[0] == '$') {
+                continue;
+            }
+            if (!walkChild(walk, *it, depth, on_cursor, true)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool RetainedStore::walkChild(Walk& walk, uint32_t child, size_t depth, bool on_cursor, bool subtree) const {
+        std::string_view name = levelName(child);
+        bool child_on_cursor = on_cursor && depth < walk.cursor.size() && name == walk.cursor[depth];
+
+        size_t parent_length = walk.topic.size();
+        if (depth > 0) {
+            walk.topic.push_back('/');
+        }
+        walk.topic.append(name.data(), name.size());
+        bool more = subtree
+            ? walkSubtree(walk, child, depth + 1, child_on_cursor, false)
+            : walkFilter(walk, child, depth + 1, child_on_cursor);
+        walk.topic.resize(parent_length);
+        return more;
+    }
+
+    bool RetainedStore::emit(Walk& walk, uint32_t node, bool on_cursor) const {
+        // A node on the cursor path is the cursor topic or one of its parents,
+        // both of which sort before anything not yet returned
+        if (on_cursor || nodes[node].payload == NONE) {
+            return true;
+        }
+        walk.out.push_back(toMessage(node, walk.topic, walk.cache));
+        walk.added++;
+        return walk.added < walk.limit;
+    }
+
+    void RetainedStore::visitSubtree(uint32_t node, std::string& topic,
+        const std::function<void(const Message&)>& visit) const {
+        if (nodes[node].payload != NONE) {
+            visit(toMessage(node, topic, false));
+        }
+        size_t length = topic.size();
+        for (uint32_t child : nodes[node].children) {
+            topic.push_back('/');
+            topic.append(levelName(child));
+            visitSubtree(child, topic, visit);
+            topic.resize(length);
+        }
+    }
+
+} // namespace mqtt
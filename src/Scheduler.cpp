@@ -0,0 +1,298 @@
+#include "Scheduler.h"
+#include <algorithm>
+
+namespace mqtt {
+
+    struct Scheduler::Timer {
+        explicit Timer(RepeatingTask task)
+            : task(std::move(task)) {
+        }
+
+        RepeatingTask task;
+        uint64_t deadline = 0; // Guarded by the scheduler's wheel_mutex
+
+        // Guards the run state below
+        std::mutex mutex;
+        std::condition_variable idle;
+        bool cancelled = false;
+        bool finished = false;
+        bool running = false;
+        std::thread::id runner;
+    };
+
+    Scheduler::Handle::Handle(std::shared_ptr<Timer> timer)
+        : timer(std::move(timer)) {
+    }
+
+    void Scheduler::Handle::cancel() {
+        if (!timer) {
+            return;
+        }
+        RepeatingTask released;
+        {
+            std::unique_lock<std::mutex> lock(timer->mutex);
+            timer->cancelled = true;
+
+            // A callback cancelling its own timer must not wait for itself
+            if (timer->runner != std::this_thread::get_id()) {
+                timer->idle.wait(lock, [this] { return !timer->running; });
+            }
+            if (!timer->running) {
+                released = std::move(timer->task);
+            }
+        }
+    }
+
+    bool Scheduler::Handle::active() const {
+        if (!timer) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(timer->mutex);
+        return !timer->cancelled && !timer->finished;
+    }
+
+    Scheduler::Scheduler(size_t worker_threads, std::chrono::milliseconds tick)
+        : tick_length(std::max(tick, std::chrono::milliseconds(1))),
+        start_time(std::chrono::steady_clock::now()),
+        running(true) {
+        if (worker_threads == 0) {
+            worker_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        ticker_thread = std::thread(&Scheduler::runTicker, this);
+        for (size_t i = 0; i < worker_threads; i++) {
+            this->worker_threads.emplace_back(&Scheduler::runWorker, this);
+        }
+    }
+
+    Scheduler::~Scheduler() {
+        stop();
+    }
+
+    void Scheduler::stop() {
+        running = false;
+        {
+            std::lock_guard<std::mutex> lock(wheel_mutex);
+        }
+        wheel_condition.notify_all();
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+        }
+        ready_condition.notify_all();
+
+        if (ticker_thread.joinable()) {
+            ticker_thread.join();
+        }
+        for (auto& worker : worker_threads) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    Scheduler::Handle Scheduler::schedule(std::chrono::milliseconds delay, std::function<void()> task) {
+        return scheduleRepeating(delay, [task = std::move(task)] {
+            task();
+            return std::chrono::milliseconds(-1);
+            });
+    }
+
+    Scheduler::Handle Scheduler::scheduleRepeating(std::chrono::milliseconds delay, RepeatingTask task) {
+        auto timer = std::make_shared<Timer>(std::move(task));
+        arm(timer, delay);
+        return Handle(timer);
+    }
+
+    Scheduler::Handle Scheduler::post(std::function<void()> task) {
+        auto timer = std::make_shared<Timer>([task = std::move(task)] {
+            task();
+            return std::chrono::milliseconds(-1);
+            });
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            ready_timers.push_back(timer);
+        }
+        ready_condition.notify_one();
+        return Handle(timer);
+    }
+
+    Scheduler::Stats Scheduler::getStats() const {
+        Stats stats;
+        stats.scheduled = scheduled_count.load(std::memory_order_relaxed);
+        stats.fired = fired_count.load(std::memory_order_relaxed);
+        stats.late_ticks = late_tick_count.load(std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(wheel_mutex);
+            stats.pending = pending_timers;
+        }
+        return stats;
+    }
+
+    size_t Scheduler::getWorkerCount() const {
+        return worker_threads.size();
+    }
+
+    Scheduler& Scheduler::shared() {
+        static Scheduler scheduler;
+        return scheduler;
+    }
+
+    void Scheduler::arm(const std::shared_ptr<Timer>& timer, std::chrono::milliseconds delay) {
+        // Round up so a timer never fires early; the outermost wheel bounds the delay
+        constexpr uint64_t max_ticks = (uint64_t(1) << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+        uint64_t ticks = delay.count() <= 0 ? 1 :
+            (static_cast<uint64_t>(delay.count()) + tick_length.count() - 1) / tick_length.count();
+        ticks = std::min(std::max<uint64_t>(ticks, 1), max_ticks - 1);
+
+        bool was_empty;
+        {
+            std::lock_guard<std::mutex> lock(wheel_mutex);
+            uint64_t now = elapsedTicks();
+            was_empty = (pending_timers == 0);
+            if (was_empty) {
+                // Nothing to cascade, so an idle wheel can jump straight to now
+                current_tick = std::max(current_tick, now);
+            }
+            // The current tick is already partly over, so count from the next one
+            timer->deadline = std::max(current_tick, now) + ticks + 1;
+            insert(timer);
+            pending_timers++;
+        }
+        scheduled_count.fetch_add(1, std::memory_order_relaxed);
+        if (was_empty) {
+            wheel_condition.notify_one();
+        }
+    }
+
+    void Scheduler::insert(const std::shared_ptr<Timer>& timer) {
+        uint64_t delta = timer->deadline - current_tick;
+        for (size_t level = 0; level < WHEEL_LEVELS; level++) {
+            if (level + 1 == WHEEL_LEVELS || delta < (uint64_t(1) << (WHEEL_BITS * (level + 1)))) {
+                size_t slot = (timer->deadline >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1);
+                wheels[level][slot].push_back(timer);
+                return;
+            }
+        }
+    }
+
+    void Scheduler::cascade(size_t level) {
+        size_t slot = (current_tick >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1);
+        if (slot == 0 && level + 1 < WHEEL_LEVELS) {
+            cascade(level + 1);
+        }
+
+        // Re-file this slot's timers into the inner wheels
+        Slot timers;
+        timers.swap(wheels[level][slot]);
+        for (const auto& timer : timers) {
+            insert(timer);
+        }
+    }
+
+    void Scheduler::advanceTo(uint64_t target, std::vector<std::shared_ptr<Timer>>& due) {
+        while (current_tick < target && pending_timers > 0) {
+            current_tick++;
+            if ((current_tick & (WHEEL_SIZE - 1)) == 0) {
+                cascade(1);
+            }
+            Slot& slot = wheels[0][current_tick & (WHEEL_SIZE - 1)];
+            pending_timers -= slot.size();
+            for (auto& timer : slot) {
+                due.push_back(std::move(timer));
+            }
+            slot.clear();
+        }
+        current_tick = std::max(current_tick, target);
+    }
+
+    uint64_t Scheduler::elapsedTicks() const {
+        return static_cast<uint64_t>((std::chrono::steady_clock::now() - start_time) / tick_length);
+    }
+
+    void Scheduler::runTicker() {
+        std::vector<std::shared_ptr<Timer>> due;
+        std::unique_lock<std::mutex> lock(wheel_mutex);
+        while (running) {
+            if (pending_timers == 0) {
+                wheel_condition.wait(lock, [this] { return !running || pending_timers > 0; });
+                continue;
+            }
+
+            // Sleep until the next tick boundary
+            wheel_condition.wait_until(lock, start_time + tick_length * (current_tick + 1));
+            uint64_t target = elapsedTicks();
+            if (target > current_tick + 1) {
+                late_tick_count.fetch_add(target - current_tick - 1, std::memory_order_relaxed);
+            }
+            advanceTo(target, due);
+            if (due.empty()) {
+                continue;
+            }
+
+            // Hand due timers to the workers without holding the wheel
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> ready_lock(ready_mutex);
+                for (auto& timer : due) {
+                    ready_timers.push_back(std::move(timer));
+                }
+            }
+            if (due.size() == 1) {
+                ready_condition.notify_one();
+            }
+            else {
+                ready_condition.notify_all();
+            }
+            due.clear();
+            lock.lock();
+        }
+    }
+
+    void Scheduler::runWorker() {
+        while (true) {
+            std::shared_ptr<Timer> timer;
+            {
+                std::unique_lock<std::mutex> lock(ready_mutex);
+                ready_condition.wait(lock, [this] { return !running || !ready_timers.empty(); });
+                if (!running) {
+                    return;
+                }
+                timer = std::move(ready_timers.front());
+                ready_timers.pop_front();
+            }
+            runTimer(timer);
+        }
+    }
+
+    void Scheduler::runTimer(const std::shared_ptr<Timer>& timer) {
+        {
+            std::lock_guard<std::mutex> lock(timer->mutex);
+            if (timer->cancelled) {
+                return;
+            }
+            timer->running = true;
+            timer->runner = std::this_thread::get_id();
+        }
+
+        std::chrono::milliseconds next_delay = timer->task();
+        fired_count.fetch_add(1, std::memory_order_relaxed);
+
+        RepeatingTask released;
+        bool repeat;
+        {
+            std::lock_guard<std::mutex> lock(timer->mutex);
+            timer->running = false;
+            timer->runner = std::thread::id();
+            repeat = !timer->cancelled && next_delay.count() >= 0;
+            if (!repeat) {
+                timer->finished = true;
+                released = std::move(timer->task);
+            }
+        }
+        timer->idle.notify_all();
+
+        if (repeat) {
+            arm(timer, next_delay);
+        }
+    }
+
+} // namespace mqtt
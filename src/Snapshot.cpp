@@ -0,0 +1,300 @@
+#include "Snapshot.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mqtt {
+
+    namespace {
+
+        constexpr char MAGIC[8] = { 'M', 'Q', 'S', 'N', 'A', 'P', '0', '1' };
+
+        bool failed(std::string& error, const std::string& message) {
+            error = message;
+            return false;
+        }
+
+        template <typename Record>
+        void appendRecords(std::string& out, const std::vector<Record>& records) {
+            out.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        }
+
+    }
+
+    Snapshot::~Snapshot() {
+        close();
+    }
+
+    //-------------------------------------------------------------------------
+    // Writing
+    //-------------------------------------------------------------------------
+
+    bool Snapshot::write(const std::string& path, const Broker& broker,
+        const std::vector<std::shared_ptr<Device>>& devices, std::string& error) {
+        std::vector<DeviceRecord> device_records;
+        std::vector<StringRef> subscription_refs;
+        std::vector<RetainedRecord> retained_records;
+        std::string strings;
+        auto addString = [&strings](std::string_view value) {
+            StringRef ref{ strings.size(), value.size() };
+            strings.append(value);
+            return ref;
+        };
+
+        device_records.reserve(devices.size());
+        for (const auto& device : devices) {
+            DeviceRecord record{};
+            record.id = addString(device->getId());
+            record.telemetry_interval_ms = device->getTelemetryInterval().count();
+            record.queue_capacity = device->getDeliveryCapacity();
+            record.history_capacity = device->getHistoryCapacity();
+            record.overflow_policy = static_cast<uint32_t>(device->getOverflowPolicy());
+            record.first_subscription = subscription_refs.size();
+            for (const auto& topic : device->getSubscribedTopics()) {
+                subscription_refs.push_back(addString(topic));
+            }
+            record.subscription_count = subscription_refs.size() - record.first_subscription;
+            device_records.push_back(record);
+        }
+
+        std::string properties;
+        broker.forEachRetained([&](const Message& message) {
+            RetainedRecord record{};
+            record.topic = addString(message.getTopic());
+            record.payload = addString(message.getPayload());
+            properties.clear();
+            if (message.hasProperties()) {
+                message.appendProperties(properties);
+            }
+            record.properties = addString(properties);
+            record.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                message.getTimestamp().time_since_epoch()).count();
+            record.qos = static_cast<uint32_t>(message.getQoS());
+            retained_records.push_back(record);
+            });
+
+        // Every table size is a multiple of 8, so each one starts aligned
+        Header file_header{};
+        std::memcpy(file_header.magic, MAGIC, sizeof(MAGIC));
+        file_header.version = VERSION;
+        file_header.byte_order = BYTE_ORDER_MARK;
+        file_header.created_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        file_header.device_count = device_records.size();
+        file_header.device_offset = sizeof(Header);
+        file_header.subscription_count = subscription_refs.size();
+        file_header.subscription_offset = file_header.device_offset + device_records.size() * sizeof(DeviceRecord);
+        file_header.retained_count = retained_records.size();
+        file_header.retained_offset = file_header.subscription_offset + subscription_refs.size() * sizeof(StringRef);
+        file_header.strings_offset = file_header.retained_offset + retained_records.size() * sizeof(RetainedRecord);
+        file_header.strings_size = strings.size();
+
+        std::string out;
+        out.reserve(file_header.strings_offset + strings.size());
+        out.append(reinterpret_cast<const char*>(&file_header), sizeof(Header));
+        appendRecords(out, device_records);
+        appendRecords(out, subscription_refs);
+        appendRecords(out, retained_records);
+        out.append(strings);
+
+        std::string temporary = path + ".tmp";
+        std::error_code ignored;
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file || !file.write(out.data(), static_cast<std::streamsize>(out.size())).flush()) {
+                std::filesystem::remove(temporary, ignored);
+                return failed(error, "Cannot write " + temporary);
+            }
+        }
+        std::error_code rename_error;
+        std::filesystem::rename(temporary, path, rename_error);
+        if (rename_error) {
+            std::filesystem::remove(temporary, ignored);
+            return failed(error, "Cannot replace " + path + ": " + rename_error.message());
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------
+    // Loading
+    //-------------------------------------------------------------------------
+
+    bool Snapshot::open(const std::string& path, std::string& error) {
+        close();
+
+#ifdef __linux__
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return failed(error, "Cannot open " + path);
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            return failed(error, "Cannot stat " + path);
+        }
+        size = static_cast<size_t>(info.st_size);
+        if (size >= sizeof(Header)) {
+            void* region = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (region == MAP_FAILED) {
+                ::close(fd);
+                size = 0;
+                return failed(error, "Cannot map " + path);
+            }
+            ::madvise(region, size, MADV_WILLNEED);
+            data = static_cast<const char*>(region);
+            mapped = true;
+        }
+        ::close(fd);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            return failed(error, "Cannot open " + path);
+        }
+        size = static_cast<size_t>(file.tellg());
+        buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(size))) {
+            close();
+            return failed(error, "Cannot read " + path);
+        }
+        data = reinterpret_cast<const char*>(buffer.data());
+#endif
+
+        if (!data || size < sizeof(Header) || std::memcmp(header().magic, MAGIC, sizeof(MAGIC)) != 0) {
+            close();
+            return failed(error, path + " is not a snapshot");
+        }
+        if (header().version != VERSION || header().byte_order != BYTE_ORDER_MARK) {
+            close();
+            return failed(error, path + " was written by an incompatible version or host");
+        }
+
+        // Bounds only; records are used as they lie in the file
+        const Header& file_header = header();
+        bool valid = checkTable(file_header.device_offset, file_header.device_count, sizeof(DeviceRecord)) &&
+            checkTable(file_header.subscription_offset, file_header.subscription_count, sizeof(StringRef)) &&
+            checkTable(file_header.retained_offset, file_header.retained_count, sizeof(RetainedRecord)) &&
+            file_header.strings_offset <= size && file_header.strings_size <= size - file_header.strings_offset;
+        for (uint64_t i = 0; valid && i < file_header.device_count; i++) {
+            const DeviceRecord& record = devices()[i];
+            valid = checkString(record.id) &&
+                record.overflow_policy <= static_cast<uint32_t>(OverflowPolicy::Disconnect) &&
+                record.first_subscription <= file_header.subscription_count &&
+                record.subscription_count <= file_header.subscription_count - record.first_subscription;
+        }
+        for (uint64_t i = 0; valid && i < file_header.subscription_count; i++) {
+            valid = checkString(subscriptions()[i]);
+        }
+        for (uint64_t i = 0; valid && i < file_header.retained_count; i++) {
+            const RetainedRecord& record = retained()[i];
+            valid = checkString(record.topic) && checkString(record.payload) && checkString(record.properties) &&
+                record.qos <= static_cast<uint32_t>(QoS::EXACTLY_ONCE);
+        }
+        if (!valid) {
+            close();
+            return failed(error, path + " is truncated or corrupt");
+        }
+        return true;
+    }
+
+    std::vector<std::shared_ptr<Device>> Snapshot::restore(const std::shared_ptr<Broker>& broker) const {
+        std::vector<std::shared_ptr<Device>> restored;
+        if (!data) {
+            return restored;
+        }
+
+        restored.reserve(header().device_count);
+        for (uint64_t i = 0; i < header().device_count; i++) {
+            const DeviceRecord& record = devices()[i];
+            auto device = std::make_shared<Device>(std::string(view(record.id)), broker,
+                std::chrono::milliseconds(record.telemetry_interval_ms));
+            if (record.history_capacity != mqtt::constants::DEVICE_MESSAGE_HISTORY_SIZE) {
+                device->setHistoryCapacity(static_cast<size_t>(record.history_capacity));
+            }
+            device->setDeliveryQueue(static_cast<size_t>(record.queue_capacity),
+                static_cast<OverflowPolicy>(record.overflow_policy));
+            for (uint64_t s = 0; s < record.subscription_count; s++) {
+                device->subscribe(std::string(view(subscriptions()[record.first_subscription + s])));
+            }
+            restored.push_back(std::move(device));
+        }
+
+        for (uint64_t i = 0; i < header().retained_count; i++) {
+            const RetainedRecord& record = retained()[i];
+            Message message(std::string(view(record.topic)), std::string(view(record.payload)),
+                static_cast<QoS>(record.qos), true);
+            message.setTimestamp(std::chrono::system_clock::time_point(
+                std::chrono::microseconds(record.timestamp_us)));
+            if (record.properties.size > 0) {
+                message.readProperties(view(record.properties));
+            }
+            broker->restoreRetained(message);
+        }
+        return restored;
+    }
+
+    size_t Snapshot::getDeviceCount() const {
+        return data ? static_cast<size_t>(header().device_count) : 0;
+    }
+
+    size_t Snapshot::getRetainedCount() const {
+        return data ? static_cast<size_t>(header().retained_count) : 0;
+    }
+
+    std::chrono::system_clock::time_point Snapshot::getCreated() const {
+        return data ? std::chrono::system_clock::time_point(std::chrono::microseconds(header().created_us))
+            : std::chrono::system_clock::time_point();
+    }
+
+    //-------------------------------------------------------------------------
+    // Layout helpers
+    //-------------------------------------------------------------------------
+
+    std::string_view Snapshot::view(const StringRef& ref) const {
+        return std::string_view(data + header().strings_offset + ref.offset, static_cast<size_t>(ref.size));
+    }
+
+    bool Snapshot::checkTable(uint64_t offset, uint64_t count, size_t record_size) const {
+        return offset % alignof(uint64_t) == 0 && offset <= size && count <= (size - offset) / record_size;
+    }
+
+    bool Snapshot::checkString(const StringRef& ref) const {
+        return ref.offset <= header().strings_size && ref.size <= header().strings_size - ref.offset;
+    }
+
+    void Snapshot::close() {
+#ifdef __linux__
+        if (mapped) {
+            ::munmap(const_cast<char*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+        mapped = false;
+        buffer.clear();
+    }
+
+    const Snapshot::Header& Snapshot::header() const {
+        return *reinterpret_cast<const Header*>(data);
+    }
+
+    const Snapshot::DeviceRecord* Snapshot::devices() const {
+        return reinterpret_cast<const DeviceRecord*>(data + header().device_offset);
+    }
+
+    const Snapshot::StringRef* Snapshot::subscriptions() const {
+        return reinterpret_cast<const StringRef*>(data + header().subscription_offset);
+    }
+
+    const Snapshot::RetainedRecord* Snapshot::retained() const {
+        return reinterpret_cast<const RetainedRecord*>(data + header().retained_offset);
+    }
+
+} // namespace mqtt
@@ -0,0 +1,309 @@
+#include "SubscriptionTrie.h"
+#include "Device.h"
+#include "Constants.h"
+#include "InternTable.h"
+#include <algorithm>
+
+namespace mqtt {
+
+    SubscriptionTrie::SubscriptionTrie() = default;
+
+    SubscriptionTrie::~SubscriptionTrie() = default;
+
+    void SubscriptionTrie::insert(const std::string& filter, const std::shared_ptr<Device>& device) {
+        if (!hasWildcard(filter)) {
+            // A filter listed by name stays there once interned, so a device is never in both maps
+            auto named = named_filters.find(filter);
+            if (named == named_filters.end()) {
+                if (auto handle = InternTable::topics().find(filter)) {
+                    subscription_count += addSubscriber(exact_filters[*handle], device);
+                    return;
+                }
+                named = named_filters.emplace(filter, SubscriberList()).first;
+            }
+            subscription_count += addSubscriber(named->second, device);
+            return;
+        }
+
+        Node* node = &root;
+        size_t pos = 0;
+        while (true) {
+            size_t end = filter.find('/', pos);
+            bool last = (end == std::string::npos);
+            if (last) {
+                end = filter.size();
+            }
+            std::string level = filter.substr(pos, end - pos);
+
+            // Multi-level wildcard is only valid as the final level
+            if (last && level == "#") {
+                subscription_count += addSubscriber(node->multi_level_subscribers, device);
+                return;
+            }
+
+            if (level == "+") {
+                if (!node->single_level) {
+                    node->single_level = std::make_unique<Node>();
+                }
+                node = node->single_level.get();
+            }
+            else {
+                auto& child = node->children[level];
+                if (!child) {
+                    child = std::make_unique<Node>();
+                }
+                node = child.get();
+            }
+
+            if (last) {
+                break;
+            }
+            pos = end + 1;
+        }
+
+        subscription_count += addSubscriber(node->subscribers, device);
+    }
+
+    void SubscriptionTrie::remove(const std::string& filter, const std::shared_ptr<Device>& device) {
+        if (hasWildcard(filter)) {
+            removeFrom(root, filter, 0, device.get());
+            return;
+        }
+
+        auto named = named_filters.find(filter);
+        if (named != named_filters.end()) {
+            subscription_count -= removeSubscriber(named->second, device.get());
+            if (named->second.empty()) {
+                named_filters.erase(named);
+            }
+            return;
+        }
+        auto handle = InternTable::topics().find(filter);
+        auto it = handle ? exact_filters.find(*handle) : exact_filters.end();
+        if (it != exact_filters.end()) {
+            subscription_count -= removeSubscriber(it->second, device.get());
+            if (it->second.empty()) {
+                exact_filters.erase(it);
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<Device>> SubscriptionTrie::match(const std::string& topic) const {
+        // A topic never interned cannot equal a filter keyed on its handle
+        auto handle = exact_filters.empty() ? std::nullopt : InternTable::topics().find(topic);
+        return match(topic, handle);
+    }
+
+    std::vector<std::shared_ptr<Device>> SubscriptionTrie::match(InternTable::Handle topic) const {
+        return match(InternTable::topics().lookup(topic), topic);
+    }
+
+    std::vector<std::shared_ptr<Device>> SubscriptionTrie::match(const std::string& topic,
+        std::optional<InternTable::Handle> handle) const {
+        std::vector<std::shared_ptr<Device>> matches;
+        if (handle) {
+            auto it = exact_filters.find(*handle);
+            if (it != exact_filters.end()) {
+                collect(it->second, matches);
+            }
+        }
+        if (!named_filters.empty()) {
+            auto it = named_filters.find(topic);
+            if (it != named_filters.end()) {
+                collect(it->second, matches);
+            }
+        }
+        if (!root.isEmpty()) {
+            std::string level;
+            matchLevel(root, topic, 0, level, matches);
+        }
+
+        // A device with several matching filters receives the message once
+        if (matches.size() > 1) {
+            std::sort(matches.begin(), matches.end());
+            matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+        }
+        return matches;
+    }
+
+    size_t SubscriptionTrie::size() const {
+        return subscription_count;
+    }
+
+    bool SubscriptionTrie::empty() const {
+        return subscription_count == 0;
+    }
+
+    bool SubscriptionTrie::hasWildcard(const std::string& filter) {
+        size_t pos = 0;
+        while (true) {
+            size_t end = filter.find('/', pos);
+            bool last = (end == std::string::npos);
+            if (last) {
+                end = filter.size();
+            }
+            if (filter.compare(pos, end - pos, "+") == 0 || (last && filter.compare(pos, end - pos, "#") == 0)) {
+                return true;
+            }
+            if (last) {
+                return false;
+            }
+            pos = end + 1;
+        }
+    }
+
+    bool SubscriptionTrie::Node::isEmpty() const {
+        return children.empty() && !single_level &&
+            subscribers.empty() && multi_level_subscribers.empty();
+    }
+
+    bool SubscriptionTrie::SubscriberList::empty() const {
+        return entries.empty();
+    }
+
+    std::ptrdiff_t SubscriptionTrie::addSubscriber(SubscriberList& list, const std::shared_ptr<Device>& device) {
+        size_t position = findSubscriber(list, device.get());
+        if (position != list.entries.size()) {
+            // Either already subscribed, or a destroyed device's address reused by this one
+            Subscriber& existing = list.entries[position];
+            if (existing.device.expired()) {
+                existing.device = device;
+            }
+            return 0;
+        }
+
+        std::ptrdiff_t swept = 0;
+        if (list.entries.size() >= list.sweep_at) {
+            swept = static_cast<std::ptrdiff_t>(sweepExpired(list));
+            list.sweep_at = std::max(mqtt::constants::SUBSCRIBER_SCAN_LIMIT, list.entries.size() * 2);
+        }
+        if (!list.positions.empty() || list.entries.size() >= mqtt::constants::SUBSCRIBER_SCAN_LIMIT) {
+            if (list.positions.empty()) {
+                for (size_t i = 0; i < list.entries.size(); i++) {
+                    list.positions.emplace(list.entries[i].address, i);
+                }
+            }
+            list.positions.emplace(device.get(), list.entries.size());
+        }
+        list.entries.push_back({ device, device.get() });
+        return 1 - swept;
+    }
+
+    size_t SubscriptionTrie::removeSubscriber(SubscriberList& list, const Device* device) {
+        size_t position = findSubscriber(list, device);
+        if (position == list.entries.size()) {
+            return 0;
+        }
+
+        // Fill the gap with the last entry
+        if (position + 1 != list.entries.size()) {
+            list.entries[position] = std::move(list.entries.back());
+            if (!list.positions.empty()) {
+                list.positions[list.entries[position].address] = position;
+            }
+        }
+        list.entries.pop_back();
+        list.positions.erase(device);
+        return 1;
+    }
+
+    size_t SubscriptionTrie::findSubscriber(const SubscriberList& list, const Device* device) {
+        if (!list.positions.empty()) {
+            auto found = list.positions.find(device);
+            return found != list.positions.end() ? found->second : list.entries.size();
+        }
+        auto found = std::find_if(list.entries.begin(), list.entries.end(),
+            [device](const Subscriber& entry) { return entry.address == device; });
+        return static_cast<size_t>(found - list.entries.begin());
+    }
+
+    size_t SubscriptionTrie::sweepExpired(SubscriberList& list) {
+        size_t before = list.entries.size();
+        list.entries.erase(
+            std::remove_if(list.entries.begin(), list.entries.end(),
+                [](const Subscriber& entry) { return entry.device.expired(); }),
+            list.entries.end());
+        if (!list.positions.empty() && list.entries.size() != before) {
+            list.positions.clear();
+            for (size_t i = 0; i < list.entries.size(); i++) {
+                list.positions.emplace(list.entries[i].address, i);
+            }
+        }
+        return before - list.entries.size();
+    }
+
+    void SubscriptionTrie::collect(const SubscriberList& list,
+        std::vector<std::shared_ptr<Device>>& out) {
+        for (const auto& entry : list.entries) {
+            if (auto device = entry.device.lock()) {
+                out.push_back(std::move(device));
+            }
+        }
+    }
+
+    bool SubscriptionTrie::removeFrom(Node& node, const std::string& filter, size_t pos, const Device* device) {
+        if (pos > filter.size()) {
+            subscription_count -= removeSubscriber(node.subscribers, device);
+            return node.isEmpty();
+        }
+
+        size_t end = filter.find('/', pos);
+        bool last = (end == std::string::npos);
+        if (last) {
+            end = filter.size();
+        }
+
+        if (last && filter.compare(pos, end - pos, "#") == 0) {
+            subscription_count -= removeSubscriber(node.multi_level_subscribers, device);
+            return node.isEmpty();
+        }
+
+        if (filter.compare(pos, end - pos, "+") == 0) {
+            if (node.single_level && removeFrom(*node.single_level, filter, end + 1, device)) {
+                node.single_level.reset();
+            }
+        }
+        else {
+            auto it = node.children.find(filter.substr(pos, end - pos));
+            if (it != node.children.end() && removeFrom(*it->second, filter, end + 1, device)) {
+                node.children.erase(it);
+            }
+        }
+        return node.isEmpty();
+    }
+
+    void SubscriptionTrie::matchLevel(const Node& node, const std::string& topic, size_t pos,
+        std::string& level, std::vector<std::shared_ptr<Device>>& out) const {
+        // All levels consumed: exact filters end here, and "a/#" also matches "a"
+        if (pos > topic.size()) {
+            collect(node.subscribers, out);
+            collect(node.multi_level_subscribers, out);
+            return;
+        }
+
+        // Wildcards at the first level never match topics starting with '$'
+        bool system_topic = (pos == 0 && !topic.empty() && topic[0] == '$');
+
+        if (!system_topic) {
+            collect(node.multi_level_subscribers, out);
+        }
+
+        size_t end = topic.find('/', pos);
+        if (end == std::string::npos) {
+            end = topic.size();
+        }
+
+        if (!node.children.empty()) {
+            level.assign(topic, pos, end - pos);
+            auto it = node.children.find(level);
+            if (it != node.children.end()) {
+                matchLevel(*it->second, topic, end + 1, level, out);
+            }
+        }
+
+        if (node.single_level && !system_topic) {
+            matchLevel(*node.single_level, topic, end + 1, level, out);
+        }
+    }
+
+} // namespace mqtt
@@ -0,0 +1,968 @@
+#include "TcpListener.h"
+#include "Device.h"
+#include "QoSSession.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace mqtt {
+
+    /**
+     * @brief One client socket
+     *
+     * Everything but the outbound buffer belongs to the loop thread.
+     */
+    struct TcpListener::Connection {
+        // A subscribed filter and the options its SUBSCRIBE gave it
+        struct Grant {
+            std::string filter;
+            QoS maximum = QoS::AT_MOST_ONCE;
+            bool no_local = false;            // Skip messages this client published
+            bool retain_as_published = false; // Keep RETAIN on live deliveries
+        };
+
+        int fd = -1;
+        std::string client_id;
+        uint64_t assigned_id = 0;       // N of an assigned mqttsim-N id, 0 if the client chose its own
+        std::shared_ptr<Device> device;
+        bool connected = false;         // CONNECT accepted
+        uint16_t keep_alive = 0;        // Seconds
+        size_t maximum_packet_size = 0; // Client's limit on what we send, 0 = none
+        std::optional<Message> will;
+        bool will_suppressed = false;   // Normal DISCONNECT received
+        std::chrono::steady_clock::time_point accepted_at;
+        std::chrono::steady_clock::time_point last_receive;
+
+        std::string inbound;
+        std::string sending;            // Bytes taken from outbound, partly written
+        size_t sending_offset = 0;
+        bool write_armed = false;       // Waiting for EPOLLOUT
+
+        // Filled by any thread, drained by the loop
+        std::mutex outbound_mutex;
+        std::string outbound;
+        bool flush_queued = false;
+        bool closed = false;
+        QoSSession session;
+        std::vector<Grant> granted;
+    };
+
+    /**
+     * @brief Wakeup and counters used by deliveries from delivery workers
+     */
+    struct TcpListener::Shared {
+        int wake_fd = -1;
+        std::atomic<std::thread::id> loop_thread;
+        std::mutex pending_mutex;
+        std::vector<std::shared_ptr<Connection>> pending_flush;
+
+        std::atomic<uint64_t> connections_accepted{ 0 };
+        std::atomic<size_t> active_connections{ 0 };
+        std::atomic<uint64_t> packets_received{ 0 };
+        std::atomic<uint64_t> bytes_received{ 0 };
+        std::atomic<uint64_t> bytes_sent{ 0 };
+        std::atomic<uint64_t> protocol_errors{ 0 };
+        std::atomic<uint64_t> dropped_deliveries{ 0 };
+        std::atomic<uint64_t> retransmissions{ 0 };
+
+        ~Shared();
+
+        // Append bytes for a connection and have the loop flush them
+        void queue(const std::shared_ptr<Connection>& connection, const char* data, size_t size);
+
+        // Encode a delivery for a connection at the QoS its subscription granted
+        void deliver(const std::shared_ptr<Connection>& connection, const Message& message);
+
+        // Move queued QoS 1/2 deliveries into freed window slots; outbound_mutex held
+        void sendQueued(Connection& connection);
+
+        // Call with the connection's outbound_mutex held
+        void scheduleFlush(const std::shared_ptr<Connection>& connection);
+    };
+
+    TcpListener::TcpListener(std::shared_ptr<Broker> broker)
+        : broker(std::move(broker)),
+        shared(std::make_shared<Shared>()) {
+    }
+
+    TcpListener::~TcpListener() {
+        stop();
+    }
+
+    bool TcpListener::isRunning() const {
+        return running.load();
+    }
+
+    uint16_t TcpListener::getPort() const {
+        return port;
+    }
+
+    TcpListener::Stats TcpListener::getStats() const {
+        Stats stats;
+        stats.connections_accepted = shared->connections_accepted.load(std::memory_order_relaxed);
+        stats.active_connections = shared->active_connections.load(std::memory_order_relaxed);
+        stats.packets_received = shared->packets_received.load(std::memory_order_relaxed);
+        stats.bytes_received = shared->bytes_received.load(std::memory_order_relaxed);
+        stats.bytes_sent = shared->bytes_sent.load(std::memory_order_relaxed);
+        stats.protocol_errors = shared->protocol_errors.load(std::memory_order_relaxed);
+        stats.dropped_deliveries = shared->dropped_deliveries.load(std::memory_order_relaxed);
+        stats.retransmissions = shared->retransmissions.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void TcpListener::Shared::queue(const std::shared_ptr<Connection>& connection, const char* data, size_t size) {
+        std::lock_guard<std::mutex> lock(connection->outbound_mutex);
+        if (connection->closed) {
+            return;
+        }
+        connection->outbound.append(data, size);
+        scheduleFlush(connection);
+    }
+
+    namespace {
+
+        void appendPublish(std::string& out, const Message& message, uint16_t packet_id, bool duplicate) {
+            size_t size = wire::publishSize(message);
+            size_t offset = out.size();
+            out.resize(offset + size);
+            wire::encodePublish(message, out.data() + offset, size, packet_id, duplicate);
+        }
+
+        void appendAck(std::string& out, wire::PacketType type, uint16_t packet_id, wire::ReasonCode reason) {
+            char ack[8];
+            out.append(ack, wire::encodeAck(type, packet_id, reason, ack, sizeof(ack)));
+        }
+
+    }
+
+    void TcpListener::Shared::deliver(const std::shared_ptr<Connection>& connection, const Message& message) {
+        std::lock_guard<std::mutex> lock(connection->outbound_mutex);
+        if (connection->closed) {
+            return;
+        }
+
+        // Delivered at the publish QoS, capped by the best matching subscription.
+        // Retained replays carry no trace and keep RETAIN; live deliveries only
+        // keep it for a Retain As Published subscription
+        bool live = message.hasTrace();
+        bool matched = false;
+        bool retain = !live;
+        QoS granted = QoS::AT_MOST_ONCE;
+        for (const auto& grant : connection->granted) {
+            if (!Broker::topicMatches(grant.filter, message.getTopic()) ||
+                (grant.no_local && message.getSenderId() == connection->client_id)) {
+                continue;
+            }
+            matched = true;
+            granted = std::max(granted, grant.maximum);
+            retain = retain || grant.retain_as_published;
+        }
+        if (!matched) {
+            return;
+        }
+        // Shares the body; only the envelope changes
+        Message outgoing = message;
+        outgoing.setQoS(std::min(granted, message.getQoS()));
+        outgoing.setRetained(retain && message.isRetained());
+
+        size_t size = wire::publishSize(outgoing);
+        if (size == 0 || (connection->maximum_packet_size != 0 && size > connection->maximum_packet_size)) {
+            dropped_deliveries.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (outgoing.getQoS() == QoS::AT_MOST_ONCE) {
+            if (connection->outbound.size() + size > mqtt::constants::LISTENER_MAX_OUTBOUND_BYTES) {
+                dropped_deliveries.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            appendPublish(connection->outbound, outgoing, 0, false);
+        }
+        else if (connection->session.canSend()) {
+            uint16_t packet_id = connection->session.send(outgoing, std::chrono::steady_clock::now());
+            appendPublish(connection->outbound, outgoing, packet_id, false);
+        }
+        else {
+            // The window bounds what is outstanding; the rest waits its turn
+            if (!connection->session.enqueue(outgoing)) {
+                dropped_deliveries.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+        scheduleFlush(connection);
+    }
+
+    void TcpListener::Shared::sendQueued(Connection& connection) {
+        auto now = std::chrono::steady_clock::now();
+        const Message* message = nullptr;
+        while (uint16_t packet_id = connection.session.sendQueued(now, message)) {
+            appendPublish(connection.outbound, *message, packet_id, false);
+        }
+    }
+
+#ifdef __linux__
+
+    namespace {
+
+        void setEvents(int epoll_fd, int fd, uint32_t events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+        }
+
+        // Sockets per process are capped by the soft limit, often 1024
+        void raiseDescriptorLimit() {
+            rlimit limit{};
+            if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+                limit.rlim_cur = limit.rlim_max;
+                setrlimit(RLIMIT_NOFILE, &limit);
+            }
+        }
+
+    }
+
+    TcpListener::Shared::~Shared() {
+        if (wake_fd >= 0) {
+            ::close(wake_fd);
+        }
+    }
+
+    void TcpListener::Shared::scheduleFlush(const std::shared_ptr<Connection>& connection) {
+        if (connection->flush_queued) {
+            return;
+        }
+        connection->flush_queued = true;
+        bool wake = false;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            wake = pending_flush.empty();
+            pending_flush.push_back(connection);
+        }
+        // The loop flushes before it waits again, so it needs no wakeup
+        if (wake && std::this_thread::get_id() != loop_thread.load()) {
+            uint64_t one = 1;
+            ssize_t written = ::write(wake_fd, &one, sizeof(one));
+            (void)written;
+        }
+    }
+
+    bool TcpListener::start(const std::string& address, uint16_t requested_port, std::string& error) {
+        if (running) {
+            error = "Listener is already running";
+            return false;
+        }
+        raiseDescriptorLimit();
+
+        auto failed = [this, &error](const std::string& what) {
+            error = what + ": " + std::strerror(errno);
+            if (listen_fd >= 0) {
+                ::close(listen_fd);
+                listen_fd = -1;
+            }
+            if (epoll_fd >= 0) {
+                ::close(epoll_fd);
+                epoll_fd = -1;
+            }
+            return false;
+        };
+
+        sockaddr_in bind_address{};
+        bind_address.sin_family = AF_INET;
+        bind_address.sin_port = htons(requested_port);
+        if (inet_pton(AF_INET, address.c_str(), &bind_address.sin_addr) != 1) {
+            error = "Invalid IPv4 address " + address;
+            return false;
+        }
+
+        if (shared->wake_fd < 0) {
+            shared->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (shared->wake_fd < 0) {
+                return failed("eventfd");
+            }
+        }
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) {
+            return failed("socket");
+        }
+        int enable = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&bind_address), sizeof(bind_address)) != 0) {
+            return failed("Cannot bind " + address + ":" + std::to_string(requested_port));
+        }
+        if (listen(listen_fd, mqtt::constants::LISTENER_BACKLOG) != 0) {
+            return failed("listen");
+        }
+        socklen_t length = sizeof(bind_address);
+        getsockname(listen_fd, reinterpret_cast<sockaddr*>(&bind_address), &length);
+        port = ntohs(bind_address.sin_port);
+
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) {
+            return failed("epoll_create1");
+        }
+        for (int fd : { listen_fd, shared->wake_fd }) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                return failed("epoll_ctl");
+            }
+        }
+
+        running = true;
+        loop_thread = std::thread(&TcpListener::eventLoop, this);
+        return true;
+    }
+
+    void TcpListener::stop() {
+        if (!running.exchange(false)) {
+            return;
+        }
+        uint64_t one = 1;
+        ssize_t written = ::write(shared->wake_fd, &one, sizeof(one));
+        (void)written;
+        if (loop_thread.joinable()) {
+            loop_thread.join();
+        }
+        ::close(listen_fd);
+        ::close(epoll_fd);
+        listen_fd = -1;
+        epoll_fd = -1;
+    }
+
+    void TcpListener::eventLoop() {
+        shared->loop_thread = std::this_thread::get_id();
+        epoll_event events[mqtt::constants::LISTENER_MAX_EVENTS];
+        auto next_sweep = std::chrono::steady_clock::now();
+
+        while (running.load(std::memory_order_relaxed)) {
+            int count = epoll_wait(epoll_fd, events, mqtt::constants::LISTENER_MAX_EVENTS,
+                mqtt::constants::LISTENER_SWEEP_INTERVAL_MS);
+            for (int i = 0; i < count; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd) {
+                    acceptConnections();
+                    continue;
+                }
+                if (fd == shared->wake_fd) {
+                    uint64_t value = 0;
+                    ssize_t got = ::read(shared->wake_fd, &value, sizeof(value));
+                    (void)got;
+                    continue;
+                }
+
+                auto it = connections.find(fd);
+                if (it == connections.end()) {
+                    continue;
+                }
+                std::shared_ptr<Connection> connection = it->second;
+                bool keep = (events[i].events & EPOLLERR) == 0;
+                if (keep && (events[i].events & (EPOLLIN | EPOLLHUP)) != 0) {
+                    keep = readFrom(*connection);
+                }
+                if (keep && (events[i].events & EPOLLOUT) != 0) {
+                    keep = flush(*connection);
+                }
+                if (!keep) {
+                    closeConnection(fd, !connection->will_suppressed);
+                }
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next_sweep) {
+                sweepConnections();
+                next_sweep = now + std::chrono::milliseconds(mqtt::constants::LISTENER_SWEEP_INTERVAL_MS);
+            }
+            flushPending();
+        }
+
+        // Shutting down: tell clients why, without publishing their wills
+        char disconnect[8];
+        size_t size = wire::encodeDisconnect(wire::ReasonCode::ServerShuttingDown, disconnect, sizeof(disconnect));
+        std::vector<int> open_fds;
+        for (const auto& [fd, connection] : connections) {
+            if (connection->connected) {
+                shared->queue(connection, disconnect, size);
+            }
+            open_fds.push_back(fd);
+        }
+        for (int fd : open_fds) {
+            closeConnection(fd, false);
+        }
+        std::lock_guard<std::mutex> lock(shared->pending_mutex);
+        shared->pending_flush.clear();
+    }
+
+    void TcpListener::acceptConnections() {
+        while (true) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // EAGAIN once the queue is empty; on EMFILE and the like the
+                // connection stays queued until a descriptor frees up
+                return;
+            }
+            int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+                continue;
+            }
+
+            auto connection = std::make_shared<Connection>();
+            connection->fd = fd;
+            connection->accepted_at = std::chrono::steady_clock::now();
+            connection->last_receive = connection->accepted_at;
+            connections[fd] = std::move(connection);
+            shared->connections_accepted.fetch_add(1, std::memory_order_relaxed);
+            shared->active_connections.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool TcpListener::readFrom(Connection& connection) {
+        const size_t chunk = mqtt::constants::LISTENER_READ_CHUNK;
+        bool closed = false;
+        while (true) {
+            size_t used = connection.inbound.size();
+            connection.inbound.resize(used + chunk);
+            ssize_t received = ::recv(connection.fd, connection.inbound.data() + used, chunk, 0);
+            if (received > 0) {
+                connection.inbound.resize(used + static_cast<size_t>(received));
+                shared->bytes_received.fetch_add(static_cast<uint64_t>(received), std::memory_order_relaxed);
+                if (static_cast<size_t>(received) < chunk) {
+                    break;
+                }
+                continue;
+            }
+            connection.inbound.resize(used);
+            if (received == 0) {
+                // Still handle whatever arrived before the close
+                closed = true;
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        connection.last_receive = std::chrono::steady_clock::now();
+        return processInbound(connection) && !closed;
+    }
+
+    bool TcpListener::processInbound(Connection& connection) {
+        std::shared_ptr<Connection> owner = connections.at(connection.fd);
+        size_t offset = 0;
+        bool keep = true;
+        while (keep && offset < connection.inbound.size()) {
+            std::string_view input(connection.inbound.data() + offset, connection.inbound.size() - offset);
+            wire::PacketType type = wire::PacketType::Connect;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            wire::DecodeStatus status = wire::peekPacket(input, type, flags, packet_size);
+            if (status == wire::DecodeStatus::Malformed) {
+                keep = fail(connection, wire::ReasonCode::MalformedPacket);
+                break;
+            }
+            if (status == wire::DecodeStatus::Incomplete) {
+                break;
+            }
+            if (packet_size > mqtt::constants::LISTENER_MAX_PACKET_SIZE) {
+                keep = fail(connection, wire::ReasonCode::PacketTooLarge);
+                break;
+            }
+            if (input.size() < packet_size) {
+                break;
+            }
+            shared->packets_received.fetch_add(1, std::memory_order_relaxed);
+            keep = handlePacket(owner, input.substr(0, packet_size));
+            offset += packet_size;
+        }
+        connection.inbound.erase(0, offset);
+        return keep;
+    }
+
+    bool TcpListener::handlePacket(const std::shared_ptr<Connection>& connection, std::string_view packet) {
+        auto type = static_cast<wire::PacketType>(static_cast<uint8_t>(packet[0]) >> 4);
+        if (!connection->connected) {
+            if (type != wire::PacketType::Connect) {
+                return fail(*connection, wire::ReasonCode::ProtocolError);
+            }
+            return handleConnect(connection, packet);
+        }
+
+        switch (type) {
+        case wire::PacketType::Publish:
+            return handlePublish(*connection, packet);
+        case wire::PacketType::Subscribe:
+            return handleSubscribe(*connection, packet);
+        case wire::PacketType::Unsubscribe:
+            return handleUnsubscribe(*connection, packet);
+        case wire::PacketType::Pingreq: {
+            char response[2];
+            shared->queue(connection, response, wire::encodePing(wire::PacketType::Pingresp, response, sizeof(response)));
+            return true;
+        }
+        case wire::PacketType::Puback:
+        case wire::PacketType::Pubrec:
+        case wire::PacketType::Pubrel:
+        case wire::PacketType::Pubcomp:
+            return handleAck(connection, packet);
+        case wire::PacketType::Disconnect: {
+            wire::DisconnectView disconnect;
+            if (wire::decodeDisconnect(packet, disconnect) == wire::DecodeStatus::Ok) {
+                connection->will_suppressed = disconnect.reason != wire::ReasonCode::DisconnectWithWill;
+            }
+            return false;
+        }
+        default:
+            return fail(*connection, wire::ReasonCode::ProtocolError);
+        }
+    }
+
+    bool TcpListener::handleConnect(const std::shared_ptr<Connection>& connection, std::string_view packet) {
+        wire::ConnectView connect;
+        if (wire::decodeConnect(packet, connect) != wire::DecodeStatus::Ok) {
+            return fail(*connection, wire::ReasonCode::MalformedPacket);
+        }
+        if (connect.protocol_version != 5) {
+            // MQTT 3.1.1 CONNACK: return code 1, unacceptable protocol version
+            const char refusal[] = { 0x20, 0x02, 0x00, 0x01 };
+            shared->queue(connection, refusal, sizeof(refusal));
+            shared->protocol_errors.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        wire::ConnackView connack;
+        connack.maximum_packet_size = static_cast<uint32_t>(mqtt::constants::LISTENER_MAX_PACKET_SIZE);
+        connack.receive_maximum = mqtt::constants::QOS_RECEIVE_MAXIMUM;
+        connection->client_id = std::string(connect.client_id);
+        if (connection->client_id.empty()) {
+            if (free_assigned_ids.empty()) {
+                connection->assigned_id = ++assigned_client_ids;
+            }
+            else {
+                connection->assigned_id = free_assigned_ids.back();
+                free_assigned_ids.pop_back();
+            }
+            connection->client_id = "mqttsim-" + std::to_string(connection->assigned_id);
+            connack.assigned_client_id = connection->client_id;
+        }
+
+        // A second connection with the same client id takes over the session
+        auto existing = client_ids.find(connection->client_id);
+        if (existing != client_ids.end()) {
+            auto previous = connections.find(existing->second);
+            if (previous != connections.end()) {
+                char disconnect[8];
+                shared->queue(previous->second, disconnect, wire::encodeDisconnect(
+                    wire::ReasonCode::SessionTakenOver, disconnect, sizeof(disconnect)));
+                closeConnection(existing->second, true);
+            }
+        }
+        client_ids[connection->client_id] = connection->fd;
+
+        connection->keep_alive = connect.keep_alive;
+        connection->maximum_packet_size = connect.maximum_packet_size;
+        connection->session.reset(std::min(connect.receive_maximum, mqtt::constants::QOS_MAX_SEND_WINDOW),
+            mqtt::constants::QOS_RECEIVE_MAXIMUM);
+        if (connect.has_will) {
+            Message will(std::string(connect.will_topic), std::string(connect.will_payload),
+                connect.will_qos, connect.will_retained);
+            will.setSenderId(connection->client_id);
+            connection->will = std::move(will);
+        }
+
+        // Bridge into the broker as a transient device without telemetry or history
+        connection->device = std::make_shared<Device>(connection->client_id, broker,
+            std::chrono::milliseconds(0), true);
+        connection->device->setHistoryCapacity(0);
+        std::weak_ptr<Connection> weak_connection = connection;
+        connection->device->addMessageHandler([shared = shared, weak_connection](const Message& message) {
+            if (auto target = weak_connection.lock()) {
+                shared->deliver(target, message);
+            }
+            });
+        connection->connected = true;
+
+        std::string encoded(5 + 32 + connack.assigned_client_id.size(), '\0');
+        encoded.resize(wire::encodeConnack(connack, encoded.data(), encoded.size()));
+        shared->queue(connection, encoded.data(), encoded.size());
+        return true;
+    }
+
+    bool TcpListener::handleAck(const std::shared_ptr<Connection>& connection, std::string_view packet) {
+        wire::AckView ack;
+        if (wire::decodeAck(packet, ack) != wire::DecodeStatus::Ok) {
+            return fail(*connection, wire::ReasonCode::MalformedPacket);
+        }
+
+        std::lock_guard<std::mutex> lock(connection->outbound_mutex);
+        QoSSession& session = connection->session;
+        bool error = static_cast<uint8_t>(ack.reason) >= 0x80;
+        switch (ack.type) {
+        case wire::PacketType::Puback:
+            // Unknown ids are ignored; the client may be answering a retransmission
+            if (session.acknowledge(ack.packet_id)) {
+                shared->sendQueued(*connection);
+            }
+            break;
+        case wire::PacketType::Pubrec:
+            if (error) {
+                if (session.refused(ack.packet_id)) {
+                    shared->sendQueued(*connection);
+                }
+            }
+            else {
+                bool known = session.received(ack.packet_id, std::chrono::steady_clock::now());
+                appendAck(connection->outbound, wire::PacketType::Pubrel, ack.packet_id,
+                    known ? wire::ReasonCode::Success : wire::ReasonCode::PacketIdentifierNotFound);
+            }
+            break;
+        case wire::PacketType::Pubcomp:
+            if (session.complete(ack.packet_id)) {
+                shared->sendQueued(*connection);
+            }
+            break;
+        default:
+            // PUBREL: second half of an incoming QoS 2 exchange
+            appendAck(connection->outbound, wire::PacketType::Pubcomp, ack.packet_id,
+                session.release(ack.packet_id) ? wire::ReasonCode::Success : wire::ReasonCode::PacketIdentifierNotFound);
+            break;
+        }
+        shared->scheduleFlush(connection);
+        return true;
+    }
+
+    bool TcpListener::handlePublish(Connection& connection, std::string_view packet) {
+        wire::PublishView publish;
+        if (wire::decodePublish(packet, publish) != wire::DecodeStatus::Ok) {
+            return fail(connection, wire::ReasonCode::MalformedPacket);
+        }
+        // CONNACK advertised no topic aliases
+        if (publish.topic_alias != 0) {
+            return fail(connection, wire::ReasonCode::TopicAliasInvalid);
+        }
+
+        // A retransmitted QoS 2 PUBLISH is acknowledged but not delivered again
+        QoSSession::ReceiveResult result = QoSSession::ReceiveResult::New;
+        if (publish.qos == QoS::EXACTLY_ONCE) {
+            std::lock_guard<std::mutex> lock(connection.outbound_mutex);
+            result = connection.session.beginReceive(publish.packet_id);
+        }
+        if (result == QoSSession::ReceiveResult::Exceeded) {
+            return fail(connection, wire::ReasonCode::ReceiveMaximumExceeded);
+        }
+        bool deliver = result == QoSSession::ReceiveResult::New;
+
+        if (deliver) {
+            Message message = wire::toMessage(publish);
+            message.setSenderId(connection.client_id);
+            broker->publish(message);
+        }
+
+        if (publish.qos != QoS::AT_MOST_ONCE) {
+            auto type = publish.qos == QoS::AT_LEAST_ONCE ? wire::PacketType::Puback : wire::PacketType::Pubrec;
+            char response[8];
+            shared->queue(connections.at(connection.fd), response,
+                wire::encodeAck(type, publish.packet_id, wire::ReasonCode::Success, response, sizeof(response)));
+        }
+        return true;
+    }
+
+    bool TcpListener::handleSubscribe(Connection& connection, std::string_view packet) {
+        wire::SubscribeView subscribe;
+        if (wire::decodeSubscribe(packet, subscribe) != wire::DecodeStatus::Ok) {
+            return fail(connection, wire::ReasonCode::MalformedPacket);
+        }
+
+        // Acknowledge first so SUBACK precedes any retained messages
+        std::vector<wire::ReasonCode> reasons;
+        reasons.reserve(subscribe.filter_count);
+        std::vector<std::pair<std::string, bool>> added; // New filters and whether to replay retained
+        std::vector<std::string> replayed;               // Existing filters that replay retained again
+        size_t cursor = 0;
+        std::string_view filter;
+        uint8_t options = 0;
+        {
+            // Granted QoS codes equal the QoS itself; granted mirrors the device's
+            // subscriptions, so a filter listed twice is only added once
+            std::lock_guard<std::mutex> lock(connection.outbound_mutex);
+            while (subscribe.nextFilter(cursor, filter, options)) {
+                if (!wire::validTopicFilter(filter)) {
+                    reasons.push_back(wire::ReasonCode::TopicFilterInvalid);
+                    continue;
+                }
+                Connection::Grant grant;
+                grant.filter.assign(filter);
+                grant.maximum = static_cast<QoS>(options & 0x03);
+                grant.no_local = (options & wire::SUBSCRIBE_NO_LOCAL) != 0;
+                grant.retain_as_published = (options & wire::SUBSCRIBE_RETAIN_AS_PUBLISHED) != 0;
+
+                // Retain handling: 0 always replays, 1 only for a new subscription, 2 never
+                unsigned retain_handling = options >> wire::SUBSCRIBE_RETAIN_HANDLING_SHIFT;
+                reasons.push_back(static_cast<wire::ReasonCode>(grant.maximum));
+                auto it = std::find_if(connection.granted.begin(), connection.granted.end(),
+                    [filter](const auto& entry) { return entry.filter == filter; });
+                if (it != connection.granted.end()) {
+                    if (retain_handling == 0) {
+                        replayed.push_back(grant.filter);
+                    }
+                    *it = std::move(grant);
+                }
+                else {
+                    added.emplace_back(grant.filter, retain_handling != 2);
+                    connection.granted.push_back(std::move(grant));
+                }
+            }
+        }
+        std::string encoded(wire::MAX_FIXED_HEADER_SIZE + 3 + reasons.size(), '\0');
+        encoded.resize(wire::encodeSuback(wire::PacketType::Suback, subscribe.packet_id,
+            reasons.data(), reasons.size(), encoded.data(), encoded.size()));
+        shared->queue(connections.at(connection.fd), encoded.data(), encoded.size());
+
+        for (const auto& [topic, replay] : added) {
+            connection.device->subscribe(topic, replay);
+        }
+        for (const auto& topic : replayed) {
+            broker->replayRetained(topic, connection.device);
+        }
+        return true;
+    }
+
+    bool TcpListener::handleUnsubscribe(Connection& connection, std::string_view packet) {
+        wire::UnsubscribeView unsubscribe;
+        if (wire::decodeUnsubscribe(packet, unsubscribe) != wire::DecodeStatus::Ok) {
+            return fail(connection, wire::ReasonCode::MalformedPacket);
+        }
+
+        std::vector<wire::ReasonCode> reasons;
+        reasons.reserve(unsubscribe.filter_count);
+        size_t cursor = 0;
+        std::string_view filter;
+        while (unsubscribe.nextFilter(cursor, filter)) {
+            bool existed = false;
+            {
+                std::lock_guard<std::mutex> lock(connection.outbound_mutex);
+                auto it = std::find_if(connection.granted.begin(), connection.granted.end(),
+                    [filter](const auto& entry) { return entry.filter == filter; });
+                if (it != connection.granted.end()) {
+                    connection.granted.erase(it);
+                    existed = true;
+                }
+            }
+            if (existed) {
+                connection.device->unsubscribe(std::string(filter));
+                reasons.push_back(wire::ReasonCode::Success);
+            }
+            else {
+                reasons.push_back(wire::ReasonCode::NoSubscriptionExisted);
+            }
+        }
+        std::string encoded(wire::MAX_FIXED_HEADER_SIZE + 3 + reasons.size(), '\0');
+        encoded.resize(wire::encodeSuback(wire::PacketType::Unsuback, unsubscribe.packet_id,
+            reasons.data(), reasons.size(), encoded.data(), encoded.size()));
+        shared->queue(connections.at(connection.fd), encoded.data(), encoded.size());
+        return true;
+    }
+
+    bool TcpListener::fail(Connection& connection, wire::ReasonCode reason) {
+        // Before CONNACK the reason goes in a CONNACK, afterwards in a DISCONNECT
+        char response[16];
+        size_t size = 0;
+        if (connection.connected) {
+            size = wire::encodeDisconnect(reason, response, sizeof(response));
+        }
+        else {
+            wire::ConnackView connack;
+            connack.reason = reason;
+            size = wire::encodeConnack(connack, response, sizeof(response));
+        }
+        shared->queue(connections.at(connection.fd), response, size);
+        shared->protocol_errors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool TcpListener::flush(Connection& connection) {
+        while (true) {
+            if (connection.sending_offset == connection.sending.size()) {
+                connection.sending.clear();
+                connection.sending_offset = 0;
+                std::lock_guard<std::mutex> lock(connection.outbound_mutex);
+                if (connection.outbound.empty()) {
+                    break;
+                }
+                // Swap rather than copy; both buffers keep their capacity
+                connection.sending.swap(connection.outbound);
+            }
+
+            ssize_t sent = ::send(connection.fd, connection.sending.data() + connection.sending_offset,
+                connection.sending.size() - connection.sending_offset, MSG_NOSIGNAL);
+            if (sent > 0) {
+                connection.sending_offset += static_cast<size_t>(sent);
+                shared->bytes_sent.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            return false;
+        }
+
+        bool want_write = connection.sending_offset < connection.sending.size();
+        if (want_write != connection.write_armed) {
+            setEvents(epoll_fd, connection.fd, want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+            connection.write_armed = want_write;
+        }
+        return true;
+    }
+
+    void TcpListener::flushPending() {
+        std::vector<std::shared_ptr<Connection>> batch;
+        {
+            std::lock_guard<std::mutex> lock(shared->pending_mutex);
+            batch.swap(shared->pending_flush);
+        }
+        for (const auto& connection : batch) {
+            {
+                std::lock_guard<std::mutex> lock(connection->outbound_mutex);
+                connection->flush_queued = false;
+            }
+            // An armed socket picks up the new bytes on its next EPOLLOUT
+            if (connection->fd >= 0 && !connection->write_armed && !flush(*connection)) {
+                closeConnection(connection->fd, !connection->will_suppressed);
+            }
+        }
+    }
+
+    void TcpListener::sweepConnections() {
+        auto now = std::chrono::steady_clock::now();
+        std::vector<int> expired;
+        for (const auto& [fd, connection] : connections) {
+            if (!connection->connected) {
+                if (now - connection->accepted_at > std::chrono::milliseconds(mqtt::constants::LISTENER_CONNECT_TIMEOUT_MS)) {
+                    expired.push_back(fd);
+                }
+            }
+            // Clients get one and a half keep-alive periods
+            else if (connection->keep_alive != 0 &&
+                now - connection->last_receive > std::chrono::milliseconds(connection->keep_alive * 1500)) {
+                char disconnect[8];
+                shared->queue(connection, disconnect, wire::encodeDisconnect(
+                    wire::ReasonCode::KeepAliveTimeout, disconnect, sizeof(disconnect)));
+                expired.push_back(fd);
+            }
+            else {
+                retransmit(connection, now);
+            }
+        }
+        for (int fd : expired) {
+            closeConnection(fd, true);
+        }
+    }
+
+    void TcpListener::retransmit(const std::shared_ptr<Connection>& connection, std::chrono::steady_clock::time_point now) {
+        std::lock_guard<std::mutex> lock(connection->outbound_mutex);
+        std::string& out = connection->outbound;
+        size_t resent = connection->session.forEachExpired(now,
+            std::chrono::milliseconds(mqtt::constants::QOS_RETRY_INTERVAL_MS),
+            [&out](uint16_t packet_id, const Message& message, bool awaiting_pubcomp) {
+                if (awaiting_pubcomp) {
+                    appendAck(out, wire::PacketType::Pubrel, packet_id, wire::ReasonCode::Success);
+                }
+                else {
+                    appendPublish(out, message, packet_id, true);
+                }
+            });
+        if (resent > 0) {
+            shared->retransmissions.fetch_add(resent, std::memory_order_relaxed);
+            shared->scheduleFlush(connection);
+        }
+    }
+
+    void TcpListener::closeConnection(int fd, bool publish_will) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            return;
+        }
+        std::shared_ptr<Connection> connection = it->second;
+        connections.erase(it);
+
+        // Best effort to get a final CONNACK or DISCONNECT out
+        if (!connection->write_armed) {
+            flush(*connection);
+        }
+        {
+            std::lock_guard<std::mutex> lock(connection->outbound_mutex);
+            connection->closed = true;
+            connection->outbound.clear();
+        }
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connection->fd = -1;
+        shared->active_connections.fetch_sub(1, std::memory_order_relaxed);
+
+        auto owner = client_ids.find(connection->client_id);
+        if (owner != client_ids.end() && owner->second == fd) {
+            client_ids.erase(owner);
+        }
+        if (connection->assigned_id != 0) {
+            free_assigned_ids.push_back(connection->assigned_id);
+            connection->assigned_id = 0;
+        }
+        if (connection->device) {
+            std::vector<std::string> topics = connection->device->getSubscribedTopics();
+            for (const auto& topic : topics) {
+                connection->device->unsubscribe(topic);
+            }
+            connection->device.reset();
+        }
+        if (publish_will && connection->will) {
+            broker->publish(*connection->will);
+        }
+    }
+
+#else
+
+    TcpListener::Shared::~Shared() = default;
+
+    void TcpListener::Shared::scheduleFlush(const std::shared_ptr<Connection>&) {
+    }
+
+    bool TcpListener::start(const std::string&, uint16_t, std::string& error) {
+        error = "The TCP listener requires Linux (epoll)";
+        return false;
+    }
+
+    void TcpListener::stop() {
+    }
+
+#endif
+
+} // namespace mqtt
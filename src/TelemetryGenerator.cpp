@@ -0,0 +1,67 @@
+#include "TelemetryGenerator.h"
+#include "Constants.h"
+#include <charconv>
+#include <cstring>
+
+namespace mqtt {
+
+    namespace {
+
+        // Copies a literal and returns the new write position
+        template <size_t N>
+        char* append(char* out, const char(&text)[N]) {
+            std::memcpy(out, text, N - 1);
+            return out + N - 1;
+        }
+
+        char* appendFixed(char* out, char* end, double value, int precision) {
+            return std::to_chars(out, end, value, std::chars_format::fixed, precision).ptr;
+        }
+
+    }
+
+    TelemetryGenerator::TelemetryGenerator(uint64_t seed)
+        // Zero is the one state xorshift cannot leave
+        : state(seed != 0 ? seed : 0x9E3779B97F4A7C15ull) {
+    }
+
+    std::string_view TelemetryGenerator::next(std::chrono::system_clock::time_point now) {
+        char* out = buffer;
+        char* end = buffer + BUFFER_SIZE;
+
+        // Same layout as the original stringstream output
+        out = append(out, "{\"temperature\":");
+        out = appendFixed(out, end, uniform(mqtt::constants::TEMPERATURE_MIN, mqtt::constants::TEMPERATURE_MAX), 1);
+        out = append(out, ",\"humidity\":");
+        out = appendFixed(out, end, uniform(mqtt::constants::HUMIDITY_MIN, mqtt::constants::HUMIDITY_MAX), 1);
+        out = append(out, ",\"pressure\":");
+        out = appendFixed(out, end, uniform(mqtt::constants::PRESSURE_MIN, mqtt::constants::PRESSURE_MAX), 1);
+        out = append(out, ",\"battery\":");
+        out = appendFixed(out, end, uniform(mqtt::constants::BATTERY_MIN, mqtt::constants::BATTERY_MAX), 2);
+        out = append(out, ",\"timestamp\":\"");
+        out = std::to_chars(out, end, static_cast<long long>(now.time_since_epoch().count())).ptr;
+        out = append(out, "\"}");
+
+        return std::string_view(buffer, static_cast<size_t>(out - buffer));
+    }
+
+    uint64_t TelemetryGenerator::nextRandom() {
+        // xorshift64*
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+
+    double TelemetryGenerator::uniform(double min, double max) {
+        // Top 53 bits give a double in [0, 1)
+        double unit = static_cast<double>(nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+        return min + (max - min) * unit;
+    }
+
+    int TelemetryGenerator::uniformInt(int min, int max) {
+        uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(max) - min) + 1;
+        return static_cast<int>(min + static_cast<int64_t>(nextRandom() % range));
+    }
+
+} // namespace mqtt
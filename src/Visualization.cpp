@@ -2,12 +2,14 @@
 #include "Broker.h"
 #include "Device.h"
 #include "Message.h"
+#include "LatencyTracker.h"
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
 #include <GLFW/glfw3.h>
 #include <cmath>
 #include <algorithm>
 #include <ctime>
+#include <cstdio>
 #include <unordered_set>
 #include <unordered_map>
 
@@ -43,8 +45,8 @@ namespace visualization {
             drawDevice(draw_list, device_id, device_positions[device_id]);
         }
 
-        // Get messages, display
-        const auto& all_messages = broker->getMessageHistory();
+        // Get messages (one snapshot per frame), display
+        const auto all_messages = broker->getMessageHistory();
         size_t msg_count = all_messages.size();
         size_t start_idx = (msg_count > style::MAX_VISIBLE_MESSAGES) ?
             (msg_count - style::MAX_VISIBLE_MESSAGES) : 0;
@@ -292,7 +294,7 @@ namespace visualization {
     }
 
     void DeviceDetails::renderMessageHistory(const std::shared_ptr<mqtt::Device>& device) {
-        const auto& messages = device->getMessageHistory();
+        const auto messages = device->getMessageHistory();
 
         // Filter controls
         static bool show_incoming = true;
@@ -425,7 +427,7 @@ namespace visualization {
                 for (const auto& device : devices) {
                     std::string suggestion = mqtt::constants::COMMAND_TOPIC_PREFIX + device->getId();
                     if (ImGui::MenuItem(suggestion.c_str())) {
-                        strcpy_s(command_topic, suggestion.c_str());
+                        std::snprintf(command_topic, sizeof(command_topic), "%s", suggestion.c_str());
                     }
                 }
                 ImGui::EndMenu();
@@ -434,13 +436,13 @@ namespace visualization {
             // Command patterns
             if (ImGui::BeginMenu("Common Patterns")) {
                 if (ImGui::MenuItem("All Devices")) {
-                    strcpy_s(command_topic, mqtt::constants::ALL_DEVICES_TOPIC);
+                    std::snprintf(command_topic, sizeof(command_topic), "%s", mqtt::constants::ALL_DEVICES_TOPIC);
                 }
                 if (ImGui::MenuItem("Group Commands")) {
-                    strcpy_s(command_topic, "command/group/+");
+                    std::snprintf(command_topic, sizeof(command_topic), "%s", "command/group/+");
                 }
                 if (ImGui::MenuItem("Wildcard Example")) {
-                    strcpy_s(command_topic, "sensors/#");
+                    std::snprintf(command_topic, sizeof(command_topic), "%s", "sensors/#");
                 }
                 ImGui::EndMenu();
             }
@@ -483,10 +485,12 @@ namespace visualization {
     // NetworkOverview implementation
     NetworkOverview::NetworkOverview(std::shared_ptr<mqtt::Broker> broker,
         const std::vector<std::shared_ptr<mqtt::Device>>& devices,
-        std::function<void()> add_device_callback)
+        std::function<void()> add_device_callback,
+        std::function<bool()> save_snapshot_callback)
         : broker(broker),
         devices(devices),
-        add_device_callback(add_device_callback) {
+        add_device_callback(add_device_callback),
+        save_snapshot_callback(save_snapshot_callback) {
     }
 
     void NetworkOverview::render() {
@@ -500,11 +504,16 @@ namespace visualization {
 
         // Statistics section
         renderStatistics();
+
+        ImGui::Separator();
+
+        // Delivery latency section
+        renderLatency();
     }
 
     void NetworkOverview::renderBrokerInfo() {
         // Broker status & information
-        bool is_active = broker->getMessageHistory().size() > 0;
+        bool is_active = broker->getMessageHistoryVersion() > 0;
 
         ImGui::Text("Broker: ");
         ImGui::SameLine();
@@ -514,6 +523,72 @@ namespace visualization {
         );
 
         ImGui::Text("Broker ID: %s", broker->getId().c_str());
+
+        // Publish path contention
+        auto ingress = broker->getIngressStats();
+        ImGui::Text("Ingress: %llu published, %zu queued",
+            static_cast<unsigned long long>(ingress.published), ingress.queue_depth);
+        ImGui::Text("Contention: %llu lost slot claims, %llu full waits, %llu wakeups",
+            static_cast<unsigned long long>(ingress.contended_publishes),
+            static_cast<unsigned long long>(ingress.full_waits),
+            static_cast<unsigned long long>(ingress.dispatcher_wakeups));
+
+        // Hot-path metrics; collecting evaluates every gauge, so not on every frame
+        auto now = std::chrono::steady_clock::now();
+        if (now - metrics_collected_at >= std::chrono::milliseconds(mqtt::constants::METRICS_PANEL_REFRESH_MS)) {
+            metrics_collected_at = now;
+            metric_lines.clear();
+            char line[256];
+            for (const auto& sample : broker->getMetrics().collect()) {
+                if (sample.type == mqtt::MetricsRegistry::Type::Duration) {
+                    double average_us = sample.count > 0 ? sample.value * 1e6 / sample.count : 0.0;
+                    std::snprintf(line, sizeof(line), "%s: %.2f us avg over %llu", sample.name.c_str(), average_us,
+                        static_cast<unsigned long long>(sample.count));
+                }
+                else {
+                    std::snprintf(line, sizeof(line), "%s: %.0f", sample.name.c_str(), sample.value);
+                }
+                metric_lines.emplace_back(line);
+            }
+        }
+        for (const auto& metric_line : metric_lines) {
+            ImGui::TextUnformatted(metric_line.c_str());
+        }
+        if (ImGui::Button("Dump Metrics")) {
+            metrics_dumped = broker->getMetrics().writeFile(mqtt::constants::METRICS_DEFAULT_FILE,
+                mqtt::MetricsFormat::Prometheus);
+            metrics_dump_attempted = true;
+        }
+        if (metrics_dump_attempted) {
+            ImGui::SameLine();
+            if (metrics_dumped) {
+                ImGui::Text("Wrote %s", mqtt::constants::METRICS_DEFAULT_FILE);
+            }
+            else {
+                ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Could not write %s", mqtt::constants::METRICS_DEFAULT_FILE);
+            }
+        }
+        if (save_snapshot_callback && ImGui::Button("Save Snapshot")) {
+            snapshot_saved = save_snapshot_callback();
+            snapshot_save_attempted = true;
+        }
+        if (snapshot_save_attempted) {
+            ImGui::SameLine();
+            if (snapshot_saved) {
+                ImGui::Text("Wrote %s", mqtt::constants::SNAPSHOT_DEFAULT_FILE);
+            }
+            else {
+                ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Could not write %s", mqtt::constants::SNAPSHOT_DEFAULT_FILE);
+            }
+        }
+
+        // History capacity
+        static int history_capacity = static_cast<int>(mqtt::constants::BROKER_MESSAGE_HISTORY_SIZE);
+        ImGui::SetNextItemWidth(150);
+        if (ImGui::InputInt("History Size", &history_capacity, 10, 100)) {
+            history_capacity = std::max(history_capacity, 1);
+            broker->setHistoryCapacity(static_cast<size_t>(history_capacity));
+        }
     }
 
     void NetworkOverview::renderDeviceControls() {
@@ -564,11 +639,12 @@ namespace visualization {
 
                 // Device status (based on history)
                 ImGui::TableSetColumnIndex(2);
-                if (device->getMessageHistory().empty()) {
+                auto last_message = device->getLastMessage();
+                if (!last_message) {
                     ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.0f, 1.0f), "Inactive");
                 }
                 else {
-                    auto last_msg_time = device->getMessageHistory().back().getTimestamp();
+                    auto last_msg_time = last_message->getTimestamp();
                     auto now = std::chrono::system_clock::now();
                     auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - last_msg_time).count();
 
@@ -638,9 +714,10 @@ namespace visualization {
         ImGui::Indent();
 
         std::unordered_map<std::string, int> topic_counts;
+        const auto messages = broker->getMessageHistory();
 
         // Count messages/topic
-        for (const auto& msg : broker->getMessageHistory()) {
+        for (const auto& msg : messages) {
             topic_counts[msg.getTopic()]++;
         }
 
@@ -653,7 +730,7 @@ namespace visualization {
         int max_topics = std::min(5, static_cast<int>(sorted_topics.size()));
         for (int i = 0; i < max_topics; i++) {
             const auto& topic_data = sorted_topics[i];
-            float percentage = 100.0f * topic_data.second / broker->getMessageHistory().size();
+            float percentage = 100.0f * topic_data.second / messages.size();
 
             ImGui::Text("%s: %d msgs (%.1f%%)", topic_data.first.c_str(), topic_data.second, percentage);
 
@@ -665,33 +742,96 @@ namespace visualization {
         ImGui::Unindent();
     }
 
-    void NetworkOverview::calculateStatistics(size_t& total_pub, size_t& total_sub, float& message_rate) {
-        total_pub = 0;
-        total_sub = 0;
-        message_rate = 0.0f;
+    void NetworkOverview::renderLatency() {
+        auto tracker = broker->getLatencyTracker();
 
-        const auto& messages = broker->getMessageHistory();
+        ImGui::Text("Delivery Latency:");
+        ImGui::Indent();
 
-        // Count message types
-        for (const auto& msg : messages) {
-            if (msg.getTargetId().empty()) {
-                total_pub++;
-            }
-            else {
-                total_sub++;
+        // Stage selector
+        const char* stage_names[mqtt::LATENCY_STAGE_COUNT];
+        for (size_t i = 0; i < mqtt::LATENCY_STAGE_COUNT; i++) {
+            stage_names[i] = mqtt::LatencyTracker::stageName(static_cast<mqtt::LatencyStage>(i));
+        }
+        ImGui::SetNextItemWidth(150);
+        ImGui::Combo("Stage", &latency_stage, stage_names, IM_ARRAYSIZE(stage_names));
+        ImGui::SameLine();
+        if (ImGui::Button("Reset##Latency")) {
+            tracker->reset();
+        }
+
+        auto stage = static_cast<mqtt::LatencyStage>(latency_stage);
+        auto overall = tracker->overall();
+        if (overall.stage(stage).count == 0) {
+            ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "No deliveries recorded yet");
+            ImGui::Unindent();
+            return;
+        }
+
+        // Overall, per QoS and busiest topics
+        std::vector<mqtt::LatencyTracker::Row> rows;
+        rows.push_back(std::move(overall));
+        for (auto& row : tracker->byQoS()) {
+            rows.push_back(std::move(row));
+        }
+        for (auto& row : tracker->byTopic(mqtt::constants::LATENCY_PANEL_TOPIC_ROWS)) {
+            rows.push_back(std::move(row));
+        }
+
+        if (ImGui::BeginTable("LatencyTable", 6,
+            ImGuiTableFlags_Borders |
+            ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableSetupColumn("p50 (us)");
+            ImGui::TableSetupColumn("p99 (us)");
+            ImGui::TableSetupColumn("p99.9 (us)");
+            ImGui::TableSetupColumn("Max (us)");
+            ImGui::TableHeadersRow();
+
+            for (size_t i = 0; i < rows.size(); i++) {
+                const auto& summary = rows[i].stage(stage);
+                if (summary.count == 0 && i > 0) {
+                    continue;
+                }
+                ImGui::TableNextRow();
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", rows[i].label.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%llu", static_cast<unsigned long long>(summary.count));
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.1f", summary.p50_us);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.1f", summary.p99_us);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%.1f", summary.p999_us);
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%.1f", summary.max_us);
             }
+
+            ImGui::EndTable();
         }
 
-        // Calculate message rate
-        if (!messages.empty() && messages.size() > 1) {
-            auto oldest = messages.front().getTimestamp();
-            auto newest = messages.back().getTimestamp();
+        ImGui::Unindent();
+    }
 
-            auto duration = std::chrono::duration_cast<std::chrono::seconds>(newest - oldest).count();
-            if (duration > 0) {
-                message_rate = messages.size() / static_cast<float>(duration);
+    void NetworkOverview::calculateStatistics(size_t& total_pub, size_t& total_sub, float& message_rate) {
+        const auto& metrics = broker->getMetrics();
+        total_pub = static_cast<size_t>(metrics.value("mqttsim_publishes_total"));
+        total_sub = static_cast<size_t>(metrics.value("mqttsim_deliveries_total"));
+
+        // Rate over the last full sampling window
+        auto now = std::chrono::steady_clock::now();
+        auto window = std::chrono::duration<float>(now - rate_window_start).count();
+        if (window >= 1.0f) {
+            if (rate_window_publishes <= total_pub && rate_window_start.time_since_epoch().count() != 0) {
+                publish_rate = (total_pub - rate_window_publishes) / window;
             }
+            rate_window_start = now;
+            rate_window_publishes = total_pub;
         }
+        message_rate = publish_rate;
     }
 
 } // namespace visualization
\ No newline at end of file
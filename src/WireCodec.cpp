@@ -0,0 +1,1335 @@
+#include "WireCodec.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace mqtt {
+    namespace wire {
+
+        namespace {
+
+            constexpr size_t MAX_STRING_SIZE = 65535;
+
+            /**
+             * @brief Well-formed UTF-8 without U+0000 or surrogates
+             */
+            bool validUtf8(std::string_view text) {
+                size_t i = 0;
+                while (i < text.size()) {
+                    auto lead = static_cast<uint8_t>(text[i]);
+                    if (lead == 0) {
+                        return false;
+                    }
+                    if (lead < 0x80) {
+                        i++;
+                        continue;
+                    }
+
+                    size_t extra = 0;
+                    uint32_t code_point = 0;
+                    uint32_t minimum = 0;
+                    if ((lead & 0xE0) == 0xC0) {
+                        extra = 1;
+                        code_point = lead & 0x1F;
+                        minimum = 0x80;
+                    }
+                    else if ((lead & 0xF0) == 0xE0) {
+                        extra = 2;
+                        code_point = lead & 0x0F;
+                        minimum = 0x800;
+                    }
+                    else if ((lead & 0xF8) == 0xF0) {
+                        extra = 3;
+                        code_point = lead & 0x07;
+                        minimum = 0x10000;
+                    }
+                    else {
+                        return false;
+                    }
+                    if (i + extra >= text.size()) {
+                        return false;
+                    }
+                    for (size_t k = 1; k <= extra; k++) {
+                        auto next = static_cast<uint8_t>(text[i + k]);
+                        if ((next & 0xC0) != 0x80) {
+                            return false;
+                        }
+                        code_point = (code_point << 6) | (next & 0x3F);
+                    }
+                    if (code_point < minimum || code_point > 0x10FFFF ||
+                        (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+                        return false;
+                    }
+                    i += extra + 1;
+                }
+                return true;
+            }
+
+            /**
+             * @brief Unchecked big-endian writer; callers size the buffer first
+             */
+            struct Writer {
+                char* position;
+
+                void put8(uint8_t value) {
+                    *position++ = static_cast<char>(value);
+                }
+
+                void put16(uint16_t value) {
+                    put8(static_cast<uint8_t>(value >> 8));
+                    put8(static_cast<uint8_t>(value));
+                }
+
+                void put32(uint32_t value) {
+                    put16(static_cast<uint16_t>(value >> 16));
+                    put16(static_cast<uint16_t>(value));
+                }
+
+                void putVariableInt(uint32_t value) {
+                    position += encodeVariableInt(value, position);
+                }
+
+                void putBytes(const void* data, size_t size) {
+                    if (size > 0) {
+                        std::memcpy(position, data, size);
+                        position += size;
+                    }
+                }
+
+                // Two-byte length prefix, as for UTF-8 strings and binary data
+                void putString(const void* data, size_t size) {
+                    put16(static_cast<uint16_t>(size));
+                    putBytes(data, size);
+                }
+
+                void putString(const std::string& text) {
+                    putString(text.data(), text.size());
+                }
+            };
+
+            /**
+             * @brief Bounds-checked big-endian reader over one packet
+             */
+            struct Reader {
+                const char* position;
+                const char* end;
+
+                size_t remaining() const {
+                    return static_cast<size_t>(end - position);
+                }
+
+                bool get8(uint8_t& value) {
+                    if (remaining() < 1) {
+                        return false;
+                    }
+                    value = static_cast<uint8_t>(*position++);
+                    return true;
+                }
+
+                bool get16(uint16_t& value) {
+                    uint8_t high = 0;
+                    uint8_t low = 0;
+                    if (!get8(high) || !get8(low)) {
+                        return false;
+                    }
+                    value = static_cast<uint16_t>((high << 8) | low);
+                    return true;
+                }
+
+                bool get32(uint32_t& value) {
+                    uint16_t high = 0;
+                    uint16_t low = 0;
+                    if (!get16(high) || !get16(low)) {
+                        return false;
+                    }
+                    value = (static_cast<uint32_t>(high) << 16) | low;
+                    return true;
+                }
+
+                bool getVariableInt(uint32_t& value) {
+                    size_t length = 0;
+                    if (decodeVariableInt(std::string_view(position, remaining()), value, length) != DecodeStatus::Ok) {
+                        return false;
+                    }
+                    position += length;
+                    return true;
+                }
+
+                // Two-byte length prefixed binary data
+                bool getBinary(std::string_view& data) {
+                    uint16_t size = 0;
+                    if (!get16(size) || remaining() < size) {
+                        return false;
+                    }
+                    data = std::string_view(position, size);
+                    position += size;
+                    return true;
+                }
+
+                bool getString(std::string_view& text) {
+                    return getBinary(text) && validUtf8(text);
+                }
+            };
+
+            enum class PropertyType {
+                Byte,
+                TwoByte,
+                FourByte,
+                VariableInt,
+                String,
+                Binary,
+                StringPair,
+                Unknown
+            };
+
+            PropertyType propertyType(PropertyId id) {
+                switch (id) {
+                case PropertyId::PayloadFormatIndicator:
+                case PropertyId::RequestProblemInformation:
+                case PropertyId::RequestResponseInformation:
+                case PropertyId::MaximumQoS:
+                case PropertyId::RetainAvailable:
+                case PropertyId::WildcardSubscriptionAvailable:
+                case PropertyId::SubscriptionIdentifierAvailable:
+                case PropertyId::SharedSubscriptionAvailable:
+                    return PropertyType::Byte;
+                case PropertyId::ServerKeepAlive:
+                case PropertyId::ReceiveMaximum:
+                case PropertyId::TopicAliasMaximum:
+                case PropertyId::TopicAlias:
+                    return PropertyType::TwoByte;
+                case PropertyId::MessageExpiryInterval:
+                case PropertyId::SessionExpiryInterval:
+                case PropertyId::WillDelayInterval:
+                case PropertyId::MaximumPacketSize:
+                    return PropertyType::FourByte;
+                case PropertyId::SubscriptionIdentifier:
+                    return PropertyType::VariableInt;
+                case PropertyId::ContentType:
+                case PropertyId::ResponseTopic:
+                case PropertyId::AssignedClientIdentifier:
+                case PropertyId::AuthenticationMethod:
+                case PropertyId::ResponseInformation:
+                case PropertyId::ServerReference:
+                case PropertyId::ReasonString:
+                    return PropertyType::String;
+                case PropertyId::CorrelationData:
+                case PropertyId::AuthenticationData:
+                    return PropertyType::Binary;
+                case PropertyId::UserProperty:
+                    return PropertyType::StringPair;
+                }
+                return PropertyType::Unknown;
+            }
+
+            /**
+             * @brief One property as read off the wire
+             *
+             * Integers of any width land in number, strings and binary data
+             * in text, and the second string of a pair in value.
+             */
+            struct Property {
+                PropertyId id = PropertyId::PayloadFormatIndicator;
+                uint32_t number = 0;
+                std::string_view text;
+                std::string_view value;
+            };
+
+            bool readProperty(Reader& reader, Property& property) {
+                uint32_t id_value = 0;
+                if (!reader.getVariableInt(id_value) || id_value > 0xFF) {
+                    return false;
+                }
+                property.id = static_cast<PropertyId>(id_value);
+
+                uint8_t byte_value = 0;
+                uint16_t short_value = 0;
+                switch (propertyType(property.id)) {
+                case PropertyType::Byte:
+                    if (!reader.get8(byte_value)) {
+                        return false;
+                    }
+                    property.number = byte_value;
+                    return true;
+                case PropertyType::TwoByte:
+                    if (!reader.get16(short_value)) {
+                        return false;
+                    }
+                    property.number = short_value;
+                    return true;
+                case PropertyType::FourByte:
+                    return reader.get32(property.number);
+                case PropertyType::VariableInt:
+                    return reader.getVariableInt(property.number);
+                case PropertyType::String:
+                    return reader.getString(property.text);
+                case PropertyType::Binary:
+                    return reader.getBinary(property.text);
+                case PropertyType::StringPair:
+                    return reader.getString(property.text) && reader.getString(property.value);
+                case PropertyType::Unknown:
+                    break;
+                }
+                return false;
+            }
+
+            /**
+             * @brief Read a property section, handing each property to visit
+             *
+             * Rejects unknown properties and repeats of any property other
+             * than User Property and Subscription Identifier. visit returns
+             * false to reject a property.
+             *
+             * @param raw Receives the section's bytes, for later walks
+             */
+            template <typename Visit>
+            bool readProperties(Reader& reader, Visit&& visit, std::string_view* raw = nullptr) {
+                uint32_t size = 0;
+                if (!reader.getVariableInt(size) || reader.remaining() < size) {
+                    return false;
+                }
+                Reader section{ reader.position, reader.position + size };
+                if (raw != nullptr) {
+                    *raw = std::string_view(reader.position, size);
+                }
+                reader.position += size;
+
+                uint64_t seen = 0;
+                Property property;
+                while (section.remaining() > 0) {
+                    if (!readProperty(section, property)) {
+                        return false;
+                    }
+                    if (property.id != PropertyId::UserProperty && property.id != PropertyId::SubscriptionIdentifier) {
+                        uint64_t bit = uint64_t(1) << static_cast<uint8_t>(property.id);
+                        if ((seen & bit) != 0) {
+                            return false;
+                        }
+                        seen |= bit;
+                    }
+                    if (!visit(property)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            /**
+             * @brief Check the fixed header and bound a reader to the packet body
+             */
+            DecodeStatus openPacket(std::string_view input, PacketType& type, uint8_t& flags,
+                size_t& packet_size, Reader& body) {
+                DecodeStatus status = peekPacket(input, type, flags, packet_size);
+                if (status != DecodeStatus::Ok) {
+                    return status;
+                }
+                if (input.size() < packet_size) {
+                    return DecodeStatus::Incomplete;
+                }
+                uint32_t remaining = 0;
+                size_t length_size = 0;
+                decodeVariableInt(input.substr(1), remaining, length_size);
+                body = Reader{ input.data() + 1 + length_size, input.data() + packet_size };
+                return DecodeStatus::Ok;
+            }
+
+            // Fixed header for a packet whose body is remaining bytes long
+            size_t packetSize(size_t remaining) {
+                return remaining <= MAX_VARIABLE_INT ?
+                    1 + variableIntSize(static_cast<uint32_t>(remaining)) + remaining : 0;
+            }
+
+            Writer startPacket(char* out, PacketType type, uint8_t flags, size_t remaining) {
+                Writer writer{ out };
+                writer.put8(static_cast<uint8_t>((static_cast<uint8_t>(type) << 4) | flags));
+                writer.putVariableInt(static_cast<uint32_t>(remaining));
+                return writer;
+            }
+
+            // Size of a two-byte length prefixed string property
+            size_t stringPropertySize(std::string_view text) {
+                return text.empty() ? 0 : 1 + 2 + text.size();
+            }
+
+            void putStringProperty(Writer& writer, PropertyId id, std::string_view text) {
+                if (!text.empty()) {
+                    writer.put8(static_cast<uint8_t>(id));
+                    writer.putString(text.data(), text.size());
+                }
+            }
+
+            size_t propertiesSize(const Message& message) {
+                size_t size = 0;
+                if (message.getMessageExpiryInterval() != 0) {
+                    size += 1 + 4;
+                }
+                if (!message.getContentType().empty()) {
+                    size += 1 + 2 + message.getContentType().size();
+                }
+                if (!message.getResponseTopic().empty()) {
+                    size += 1 + 2 + message.getResponseTopic().size();
+                }
+                if (!message.getCorrelationData().empty()) {
+                    size += 1 + 2 + message.getCorrelationData().size();
+                }
+                if (message.getTopicAlias() != 0) {
+                    size += 1 + 2;
+                }
+                for (const auto& [key, value] : message.getUserProperties()) {
+                    size += 1 + 2 + key.size() + 2 + value.size();
+                }
+                return size;
+            }
+
+            bool encodable(const Message& message) {
+                if (message.getTopic().size() > MAX_STRING_SIZE ||
+                    message.getContentType().size() > MAX_STRING_SIZE ||
+                    message.getResponseTopic().size() > MAX_STRING_SIZE ||
+                    message.getCorrelationData().size() > MAX_STRING_SIZE) {
+                    return false;
+                }
+                for (const auto& [key, value] : message.getUserProperties()) {
+                    if (key.size() > MAX_STRING_SIZE || value.size() > MAX_STRING_SIZE) {
+                        return false;
+                    }
+                }
+                // A PUBLISH needs a topic name or a topic alias to resolve it
+                return !message.getTopic().empty() || message.getTopicAlias() != 0;
+            }
+
+            // Variable header and payload size, 0 if the message cannot be encoded
+            size_t remainingLength(const Message& message, size_t& properties_size) {
+                if (!encodable(message)) {
+                    return 0;
+                }
+                properties_size = propertiesSize(message);
+                if (properties_size > MAX_VARIABLE_INT) {
+                    return 0;
+                }
+                size_t remaining = 2 + message.getTopic().size() +
+                    (message.getQoS() != QoS::AT_MOST_ONCE ? 2 : 0) +
+                    variableIntSize(static_cast<uint32_t>(properties_size)) + properties_size +
+                    message.getPayload().size();
+                return remaining <= MAX_VARIABLE_INT ? remaining : 0;
+            }
+
+        }
+
+        //-------------------------------------------------------------------------
+        // Variable byte integers
+        //-------------------------------------------------------------------------
+
+        size_t variableIntSize(uint32_t value) {
+            if (value < 128) {
+                return 1;
+            }
+            if (value < 16384) {
+                return 2;
+            }
+            if (value < 2097152) {
+                return 3;
+            }
+            return value <= MAX_VARIABLE_INT ? 4 : 0;
+        }
+
+        size_t encodeVariableInt(uint32_t value, char* out) {
+            if (value > MAX_VARIABLE_INT) {
+                return 0;
+            }
+            size_t length = 0;
+            do {
+                auto encoded = static_cast<uint8_t>(value % 128);
+                value /= 128;
+                if (value > 0) {
+                    encoded |= 0x80;
+                }
+                out[length++] = static_cast<char>(encoded);
+            } while (value > 0);
+            return length;
+        }
+
+        DecodeStatus decodeVariableInt(std::string_view input, uint32_t& value, size_t& length) {
+            uint32_t result = 0;
+            uint32_t multiplier = 1;
+            for (size_t i = 0; i < MAX_VARIABLE_INT_SIZE; i++) {
+                if (i >= input.size()) {
+                    return DecodeStatus::Incomplete;
+                }
+                auto encoded = static_cast<uint8_t>(input[i]);
+                result += (encoded & 0x7F) * multiplier;
+                if ((encoded & 0x80) == 0) {
+                    // A trailing zero byte means a shorter encoding existed
+                    if (i > 0 && encoded == 0) {
+                        return DecodeStatus::Malformed;
+                    }
+                    value = result;
+                    length = i + 1;
+                    return DecodeStatus::Ok;
+                }
+                multiplier *= 128;
+            }
+            return DecodeStatus::Malformed;
+        }
+
+        //-------------------------------------------------------------------------
+        // Packets
+        //-------------------------------------------------------------------------
+
+        DecodeStatus peekPacket(std::string_view input, PacketType& type, uint8_t& flags, size_t& packet_size) {
+            if (input.empty()) {
+                return DecodeStatus::Incomplete;
+            }
+            auto first = static_cast<uint8_t>(input[0]);
+            uint8_t type_value = first >> 4;
+            flags = first & 0x0F;
+            if (type_value == 0) {
+                return DecodeStatus::Malformed;
+            }
+            type = static_cast<PacketType>(type_value);
+
+            // Reserved flag bits are fixed for everything but PUBLISH
+            if (type != PacketType::Publish) {
+                bool needs_bit1 = type == PacketType::Pubrel || type == PacketType::Subscribe ||
+                    type == PacketType::Unsubscribe;
+                if (flags != (needs_bit1 ? 0x02 : 0x00)) {
+                    return DecodeStatus::Malformed;
+                }
+            }
+
+            uint32_t remaining = 0;
+            size_t length = 0;
+            DecodeStatus status = decodeVariableInt(input.substr(1), remaining, length);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            packet_size = 1 + length + remaining;
+            return DecodeStatus::Ok;
+        }
+
+        size_t publishSize(const Message& message) {
+            size_t properties_size = 0;
+            size_t remaining = remainingLength(message, properties_size);
+            if (remaining == 0) {
+                return 0;
+            }
+            return 1 + variableIntSize(static_cast<uint32_t>(remaining)) + remaining;
+        }
+
+        size_t encodePublish(const Message& message, char* out, size_t capacity,
+            uint16_t packet_id, bool duplicate) {
+            bool acknowledged = message.getQoS() != QoS::AT_MOST_ONCE;
+            if (acknowledged && packet_id == 0) {
+                return 0;
+            }
+            size_t properties_size = 0;
+            size_t remaining = remainingLength(message, properties_size);
+            if (remaining == 0) {
+                return 0;
+            }
+            size_t total = 1 + variableIntSize(static_cast<uint32_t>(remaining)) + remaining;
+            if (total > capacity) {
+                return 0;
+            }
+
+            Writer writer{ out };
+
+            // Fixed header
+            uint8_t flags = static_cast<uint8_t>(static_cast<uint8_t>(message.getQoS()) << 1);
+            if (duplicate && acknowledged) {
+                flags |= 0x08;
+            }
+            if (message.isRetained()) {
+                flags |= 0x01;
+            }
+            writer.put8(static_cast<uint8_t>((static_cast<uint8_t>(PacketType::Publish) << 4) | flags));
+            writer.putVariableInt(static_cast<uint32_t>(remaining));
+
+            // Variable header
+            writer.putString(message.getTopic());
+            if (acknowledged) {
+                writer.put16(packet_id);
+            }
+            writer.putVariableInt(static_cast<uint32_t>(properties_size));
+            if (message.getMessageExpiryInterval() != 0) {
+                writer.put8(static_cast<uint8_t>(PropertyId::MessageExpiryInterval));
+                writer.put32(message.getMessageExpiryInterval());
+            }
+            if (!message.getContentType().empty()) {
+                writer.put8(static_cast<uint8_t>(PropertyId::ContentType));
+                writer.putString(message.getContentType());
+            }
+            if (!message.getResponseTopic().empty()) {
+                writer.put8(static_cast<uint8_t>(PropertyId::ResponseTopic));
+                writer.putString(message.getResponseTopic());
+            }
+            if (!message.getCorrelationData().empty()) {
+                const auto& correlation = message.getCorrelationData();
+                writer.put8(static_cast<uint8_t>(PropertyId::CorrelationData));
+                writer.putString(correlation.data(), correlation.size());
+            }
+            if (message.getTopicAlias() != 0) {
+                writer.put8(static_cast<uint8_t>(PropertyId::TopicAlias));
+                writer.put16(message.getTopicAlias());
+            }
+            for (const auto& [key, value] : message.getUserProperties()) {
+                writer.put8(static_cast<uint8_t>(PropertyId::UserProperty));
+                writer.putString(key);
+                writer.putString(value);
+            }
+
+            // Payload, unprefixed to the end of the packet
+            writer.putBytes(message.getPayload().data(), message.getPayload().size());
+            return total;
+        }
+
+        DecodeStatus decodePublish(std::string_view input, PublishView& publish) {
+            PacketType type = PacketType::Publish;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            Reader reader{ nullptr, nullptr };
+            DecodeStatus status = openPacket(input, type, flags, packet_size, reader);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            if (type != PacketType::Publish) {
+                return DecodeStatus::Malformed;
+            }
+
+            PublishView result;
+            result.packet_size = packet_size;
+            result.duplicate = (flags & 0x08) != 0;
+            result.retained = (flags & 0x01) != 0;
+            uint8_t qos = (flags >> 1) & 0x03;
+            if (qos > 2 || (qos == 0 && result.duplicate)) {
+                return DecodeStatus::Malformed;
+            }
+            result.qos = static_cast<QoS>(qos);
+
+            // Variable header
+            if (!reader.getString(result.topic) ||
+                result.topic.find_first_of("+#") != std::string_view::npos) {
+                return DecodeStatus::Malformed;
+            }
+            if (result.qos != QoS::AT_MOST_ONCE) {
+                if (!reader.get16(result.packet_id) || result.packet_id == 0) {
+                    return DecodeStatus::Malformed;
+                }
+            }
+
+            bool valid = readProperties(reader, [&result](const Property& property) {
+                switch (property.id) {
+                case PropertyId::PayloadFormatIndicator:
+                    result.payload_is_utf8 = property.number == 1;
+                    return property.number <= 1;
+                case PropertyId::MessageExpiryInterval:
+                    result.message_expiry_interval = property.number;
+                    result.has_message_expiry = true;
+                    return true;
+                case PropertyId::ContentType:
+                    result.content_type = property.text;
+                    return true;
+                case PropertyId::ResponseTopic:
+                    result.response_topic = property.text;
+                    return property.text.find_first_of("+#") == std::string_view::npos;
+                case PropertyId::CorrelationData:
+                    result.correlation_data = property.text;
+                    return true;
+                case PropertyId::SubscriptionIdentifier:
+                    // Only meaningful from server to client; validated, not surfaced
+                    return property.number != 0;
+                case PropertyId::TopicAlias:
+                    result.topic_alias = static_cast<uint16_t>(property.number);
+                    return property.number != 0;
+                case PropertyId::UserProperty:
+                    result.user_property_count++;
+                    return true;
+                default:
+                    return false;
+                }
+                }, &result.properties);
+            if (!valid || (result.topic.empty() && result.topic_alias == 0)) {
+                return DecodeStatus::Malformed;
+            }
+
+            result.payload = std::string_view(reader.position, reader.remaining());
+            publish = result;
+            return DecodeStatus::Ok;
+        }
+
+        bool PublishView::nextUserProperty(size_t& cursor, std::string_view& key, std::string_view& value) const {
+            // The section was validated by decodePublish, so reads cannot fail
+            Reader reader{ properties.data() + cursor, properties.data() + properties.size() };
+            Property property;
+            while (reader.remaining() > 0 && readProperty(reader, property)) {
+                if (property.id == PropertyId::UserProperty) {
+                    key = property.text;
+                    value = property.value;
+                    cursor = static_cast<size_t>(reader.position - properties.data());
+                    return true;
+                }
+            }
+            cursor = properties.size();
+            return false;
+        }
+
+        Message toMessage(const PublishView& publish) {
+            Message message(std::string(publish.topic), std::string(publish.payload), publish.qos, publish.retained);
+            if (publish.has_message_expiry) {
+                message.setMessageExpiryInterval(publish.message_expiry_interval);
+            }
+            if (publish.topic_alias != 0) {
+                message.setTopicAlias(publish.topic_alias);
+            }
+            if (!publish.content_type.empty()) {
+                message.setContentType(std::string(publish.content_type));
+            }
+            if (!publish.response_topic.empty()) {
+                message.setResponseTopic(std::string(publish.response_topic));
+            }
+            if (!publish.correlation_data.empty()) {
+                message.setCorrelationData(std::vector<uint8_t>(publish.correlation_data.begin(), publish.correlation_data.end()));
+            }
+            size_t cursor = 0;
+            std::string_view key;
+            std::string_view value;
+            while (publish.nextUserProperty(cursor, key, value)) {
+                message.addUserProperty(std::string(key), std::string(value));
+            }
+            return message;
+        }
+
+        //-------------------------------------------------------------------------
+        // Control packets
+        //-------------------------------------------------------------------------
+
+        DecodeStatus decodeConnect(std::string_view input, ConnectView& connect) {
+            PacketType type = PacketType::Connect;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            Reader reader{ nullptr, nullptr };
+            DecodeStatus status = openPacket(input, type, flags, packet_size, reader);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            if (type != PacketType::Connect) {
+                return DecodeStatus::Malformed;
+            }
+
+            ConnectView result;
+            result.packet_size = packet_size;
+            std::string_view protocol_name;
+            if (!reader.getString(protocol_name) || protocol_name != "MQTT" || !reader.get8(result.protocol_version)) {
+                return DecodeStatus::Malformed;
+            }
+            if (result.protocol_version != 5) {
+                // The rest of the layout differs; let the caller refuse the version
+                connect = result;
+                return DecodeStatus::Ok;
+            }
+
+            uint8_t connect_flags = 0;
+            if (!reader.get8(connect_flags) || (connect_flags & 0x01) != 0 || !reader.get16(result.keep_alive)) {
+                return DecodeStatus::Malformed;
+            }
+            result.clean_start = (connect_flags & 0x02) != 0;
+            result.has_will = (connect_flags & 0x04) != 0;
+            uint8_t will_qos = (connect_flags >> 3) & 0x03;
+            result.will_retained = (connect_flags & 0x20) != 0;
+            bool has_password = (connect_flags & 0x40) != 0;
+            bool has_username = (connect_flags & 0x80) != 0;
+            if (will_qos > 2 || (!result.has_will && (will_qos != 0 || result.will_retained))) {
+                return DecodeStatus::Malformed;
+            }
+            result.will_qos = static_cast<QoS>(will_qos);
+
+            bool valid = readProperties(reader, [&result](const Property& property) {
+                switch (property.id) {
+                case PropertyId::SessionExpiryInterval:
+                    result.session_expiry_interval = property.number;
+                    return true;
+                case PropertyId::ReceiveMaximum:
+                    result.receive_maximum = static_cast<uint16_t>(property.number);
+                    return property.number != 0;
+                case PropertyId::MaximumPacketSize:
+                    result.maximum_packet_size = property.number;
+                    return property.number != 0;
+                case PropertyId::RequestResponseInformation:
+                case PropertyId::RequestProblemInformation:
+                    return property.number <= 1;
+                case PropertyId::TopicAliasMaximum:
+                case PropertyId::UserProperty:
+                case PropertyId::AuthenticationMethod:
+                case PropertyId::AuthenticationData:
+                    return true;
+                default:
+                    return false;
+                }
+                });
+            if (!valid || !reader.getString(result.client_id)) {
+                return DecodeStatus::Malformed;
+            }
+
+            if (result.has_will) {
+                valid = readProperties(reader, [](const Property& property) {
+                    switch (property.id) {
+                    case PropertyId::PayloadFormatIndicator:
+                        return property.number <= 1;
+                    case PropertyId::WillDelayInterval:
+                    case PropertyId::MessageExpiryInterval:
+                    case PropertyId::ContentType:
+                    case PropertyId::ResponseTopic:
+                    case PropertyId::CorrelationData:
+                    case PropertyId::UserProperty:
+                        return true;
+                    default:
+                        return false;
+                    }
+                    });
+                if (!valid || !reader.getString(result.will_topic) || result.will_topic.empty() ||
+                    result.will_topic.find_first_of("+#") != std::string_view::npos ||
+                    !reader.getBinary(result.will_payload)) {
+                    return DecodeStatus::Malformed;
+                }
+            }
+            if (has_username && !reader.getString(result.username)) {
+                return DecodeStatus::Malformed;
+            }
+            if (has_password && !reader.getBinary(result.password)) {
+                return DecodeStatus::Malformed;
+            }
+            if (reader.remaining() != 0) {
+                return DecodeStatus::Malformed;
+            }
+            connect = result;
+            return DecodeStatus::Ok;
+        }
+
+        DecodeStatus decodeConnack(std::string_view input, ConnackView& connack) {
+            PacketType type = PacketType::Connack;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            Reader reader{ nullptr, nullptr };
+            DecodeStatus status = openPacket(input, type, flags, packet_size, reader);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            if (type != PacketType::Connack) {
+                return DecodeStatus::Malformed;
+            }
+
+            ConnackView result;
+            result.packet_size = packet_size;
+            uint8_t acknowledge_flags = 0;
+            uint8_t reason = 0;
+            if (!reader.get8(acknowledge_flags) || (acknowledge_flags & 0xFE) != 0 || !reader.get8(reason)) {
+                return DecodeStatus::Malformed;
+            }
+            result.session_present = (acknowledge_flags & 0x01) != 0;
+            result.reason = static_cast<ReasonCode>(reason);
+
+            bool valid = readProperties(reader, [&result](const Property& property) {
+                switch (property.id) {
+                case PropertyId::ReceiveMaximum:
+                    result.receive_maximum = static_cast<uint16_t>(property.number);
+                    return property.number != 0;
+                case PropertyId::TopicAliasMaximum:
+                    result.topic_alias_maximum = static_cast<uint16_t>(property.number);
+                    return true;
+                case PropertyId::MaximumPacketSize:
+                    result.maximum_packet_size = property.number;
+                    return property.number != 0;
+                case PropertyId::ServerKeepAlive:
+                    result.server_keep_alive = static_cast<uint16_t>(property.number);
+                    return true;
+                case PropertyId::AssignedClientIdentifier:
+                    result.assigned_client_id = property.text;
+                    return true;
+                case PropertyId::MaximumQoS:
+                case PropertyId::RetainAvailable:
+                case PropertyId::WildcardSubscriptionAvailable:
+                case PropertyId::SubscriptionIdentifierAvailable:
+                case PropertyId::SharedSubscriptionAvailable:
+                    return property.number <= 1;
+                case PropertyId::SessionExpiryInterval:
+                case PropertyId::ReasonString:
+                case PropertyId::UserProperty:
+                case PropertyId::ResponseInformation:
+                case PropertyId::ServerReference:
+                case PropertyId::AuthenticationMethod:
+                case PropertyId::AuthenticationData:
+                    return true;
+                default:
+                    return false;
+                }
+                });
+            if (!valid || reader.remaining() != 0) {
+                return DecodeStatus::Malformed;
+            }
+            connack = result;
+            return DecodeStatus::Ok;
+        }
+
+        DecodeStatus decodeAck(std::string_view input, AckView& ack) {
+            PacketType type = PacketType::Puback;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            Reader reader{ nullptr, nullptr };
+            DecodeStatus status = openPacket(input, type, flags, packet_size, reader);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            if (type != PacketType::Puback && type != PacketType::Pubrec &&
+                type != PacketType::Pubrel && type != PacketType::Pubcomp) {
+                return DecodeStatus::Malformed;
+            }
+
+            AckView result;
+            result.packet_size = packet_size;
+            result.type = type;
+            if (!reader.get16(result.packet_id) || result.packet_id == 0) {
+                return DecodeStatus::Malformed;
+            }
+            // Reason code and properties are omitted on success
+            uint8_t reason = 0;
+            if (reader.remaining() > 0 && !reader.get8(reason)) {
+                return DecodeStatus::Malformed;
+            }
+            result.reason = static_cast<ReasonCode>(reason);
+            if (reader.remaining() > 0) {
+                bool valid = readProperties(reader, [](const Property& property) {
+                    return property.id == PropertyId::ReasonString || property.id == PropertyId::UserProperty;
+                    });
+                if (!valid || reader.remaining() != 0) {
+                    return DecodeStatus::Malformed;
+                }
+            }
+            ack = result;
+            return DecodeStatus::Ok;
+        }
+
+        DecodeStatus decodeSubscribe(std::string_view input, SubscribeView& subscribe) {
+            PacketType type = PacketType::Subscribe;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            Reader reader{ nullptr, nullptr };
+            DecodeStatus status = openPacket(input, type, flags, packet_size, reader);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            if (type != PacketType::Subscribe) {
+                return DecodeStatus::Malformed;
+            }
+
+            SubscribeView result;
+            result.packet_size = packet_size;
+            if (!reader.get16(result.packet_id) || result.packet_id == 0) {
+                return DecodeStatus::Malformed;
+            }
+            bool valid = readProperties(reader, [&result](const Property& property) {
+                switch (property.id) {
+                case PropertyId::SubscriptionIdentifier:
+                    // Unlike in PUBLISH, at most one
+                    if (result.subscription_identifier != 0) {
+                        return false;
+                    }
+                    result.subscription_identifier = property.number;
+                    return property.number != 0;
+                case PropertyId::UserProperty:
+                    return true;
+                default:
+                    return false;
+                }
+                });
+            if (!valid) {
+                return DecodeStatus::Malformed;
+            }
+
+            result.filters = std::string_view(reader.position, reader.remaining());
+            while (reader.remaining() > 0) {
+                std::string_view filter;
+                uint8_t options = 0;
+                if (!reader.getString(filter) || !reader.get8(options)) {
+                    return DecodeStatus::Malformed;
+                }
+                // Reserved bits, QoS 3 and retain handling 3 are all invalid
+                if ((options & 0xC0) != 0 || (options & 0x03) == 0x03 || (options & 0x30) == 0x30) {
+                    return DecodeStatus::Malformed;
+                }
+                result.filter_count++;
+            }
+            if (result.filter_count == 0) {
+                return DecodeStatus::Malformed;
+            }
+            subscribe = result;
+            return DecodeStatus::Ok;
+        }
+
+        bool SubscribeView::nextFilter(size_t& cursor, std::string_view& filter, uint8_t& options) const {
+            Reader reader{ filters.data() + cursor, filters.data() + filters.size() };
+            if (reader.remaining() == 0 || !reader.getBinary(filter) || !reader.get8(options)) {
+                cursor = filters.size();
+                return false;
+            }
+            cursor = static_cast<size_t>(reader.position - filters.data());
+            return true;
+        }
+
+        DecodeStatus decodeUnsubscribe(std::string_view input, UnsubscribeView& unsubscribe) {
+            PacketType type = PacketType::Unsubscribe;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            Reader reader{ nullptr, nullptr };
+            DecodeStatus status = openPacket(input, type, flags, packet_size, reader);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            if (type != PacketType::Unsubscribe) {
+                return DecodeStatus::Malformed;
+            }
+
+            UnsubscribeView result;
+            result.packet_size = packet_size;
+            if (!reader.get16(result.packet_id) || result.packet_id == 0) {
+                return DecodeStatus::Malformed;
+            }
+            bool valid = readProperties(reader, [](const Property& property) {
+                return property.id == PropertyId::UserProperty;
+                });
+            if (!valid) {
+                return DecodeStatus::Malformed;
+            }
+
+            result.filters = std::string_view(reader.position, reader.remaining());
+            while (reader.remaining() > 0) {
+                std::string_view filter;
+                if (!reader.getString(filter)) {
+                    return DecodeStatus::Malformed;
+                }
+                result.filter_count++;
+            }
+            if (result.filter_count == 0) {
+                return DecodeStatus::Malformed;
+            }
+            unsubscribe = result;
+            return DecodeStatus::Ok;
+        }
+
+        bool UnsubscribeView::nextFilter(size_t& cursor, std::string_view& filter) const {
+            Reader reader{ filters.data() + cursor, filters.data() + filters.size() };
+            if (reader.remaining() == 0 || !reader.getBinary(filter)) {
+                cursor = filters.size();
+                return false;
+            }
+            cursor = static_cast<size_t>(reader.position - filters.data());
+            return true;
+        }
+
+        DecodeStatus decodeSuback(std::string_view input, SubackView& suback) {
+            PacketType type = PacketType::Suback;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            Reader reader{ nullptr, nullptr };
+            DecodeStatus status = openPacket(input, type, flags, packet_size, reader);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            if (type != PacketType::Suback && type != PacketType::Unsuback) {
+                return DecodeStatus::Malformed;
+            }
+
+            SubackView result;
+            result.packet_size = packet_size;
+            result.type = type;
+            if (!reader.get16(result.packet_id) || result.packet_id == 0) {
+                return DecodeStatus::Malformed;
+            }
+            bool valid = readProperties(reader, [](const Property& property) {
+                return property.id == PropertyId::ReasonString || property.id == PropertyId::UserProperty;
+                });
+            if (!valid || reader.remaining() == 0) {
+                return DecodeStatus::Malformed;
+            }
+            result.reason_codes = std::string_view(reader.position, reader.remaining());
+            suback = result;
+            return DecodeStatus::Ok;
+        }
+
+        DecodeStatus decodeDisconnect(std::string_view input, DisconnectView& disconnect) {
+            PacketType type = PacketType::Disconnect;
+            uint8_t flags = 0;
+            size_t packet_size = 0;
+            Reader reader{ nullptr, nullptr };
+            DecodeStatus status = openPacket(input, type, flags, packet_size, reader);
+            if (status != DecodeStatus::Ok) {
+                return status;
+            }
+            if (type != PacketType::Disconnect) {
+                return DecodeStatus::Malformed;
+            }
+
+            DisconnectView result;
+            result.packet_size = packet_size;
+            uint8_t reason = 0;
+            if (reader.remaining() > 0 && !reader.get8(reason)) {
+                return DecodeStatus::Malformed;
+            }
+            result.reason = static_cast<ReasonCode>(reason);
+            if (reader.remaining() > 0) {
+                bool valid = readProperties(reader, [](const Property& property) {
+                    return property.id == PropertyId::SessionExpiryInterval || property.id == PropertyId::ReasonString ||
+                        property.id == PropertyId::UserProperty || property.id == PropertyId::ServerReference;
+                    });
+                if (!valid || reader.remaining() != 0) {
+                    return DecodeStatus::Malformed;
+                }
+            }
+            disconnect = result;
+            return DecodeStatus::Ok;
+        }
+
+        size_t encodeConnect(const ConnectView& connect, char* out, size_t capacity) {
+            if (connect.client_id.size() > MAX_STRING_SIZE || connect.will_topic.size() > MAX_STRING_SIZE ||
+                connect.will_payload.size() > MAX_STRING_SIZE || connect.username.size() > MAX_STRING_SIZE ||
+                connect.password.size() > MAX_STRING_SIZE) {
+                return 0;
+            }
+            size_t properties_size = (connect.session_expiry_interval != 0 ? 5 : 0) +
+                (connect.receive_maximum != 65535 ? 3 : 0) +
+                (connect.maximum_packet_size != 0 ? 5 : 0);
+            size_t remaining = 6 + 1 + 1 + 2 + variableIntSize(static_cast<uint32_t>(properties_size)) +
+                properties_size + 2 + connect.client_id.size();
+            if (connect.has_will) {
+                remaining += 1 + 2 + connect.will_topic.size() + 2 + connect.will_payload.size();
+            }
+            if (!connect.username.empty()) {
+                remaining += 2 + connect.username.size();
+            }
+            if (!connect.password.empty()) {
+                remaining += 2 + connect.password.size();
+            }
+            size_t total = packetSize(remaining);
+            if (total == 0 || total > capacity) {
+                return 0;
+            }
+
+            uint8_t connect_flags = connect.clean_start ? 0x02 : 0x00;
+            if (connect.has_will) {
+                connect_flags |= 0x04 | static_cast<uint8_t>(static_cast<uint8_t>(connect.will_qos) << 3);
+                if (connect.will_retained) {
+                    connect_flags |= 0x20;
+                }
+            }
+            if (!connect.password.empty()) {
+                connect_flags |= 0x40;
+            }
+            if (!connect.username.empty()) {
+                connect_flags |= 0x80;
+            }
+
+            Writer writer = startPacket(out, PacketType::Connect, 0, remaining);
+            writer.putString("MQTT", 4);
+            writer.put8(5);
+            writer.put8(connect_flags);
+            writer.put16(connect.keep_alive);
+            writer.putVariableInt(static_cast<uint32_t>(properties_size));
+            if (connect.session_expiry_interval != 0) {
+                writer.put8(static_cast<uint8_t>(PropertyId::SessionExpiryInterval));
+                writer.put32(connect.session_expiry_interval);
+            }
+            if (connect.receive_maximum != 65535) {
+                writer.put8(static_cast<uint8_t>(PropertyId::ReceiveMaximum));
+                writer.put16(connect.receive_maximum);
+            }
+            if (connect.maximum_packet_size != 0) {
+                writer.put8(static_cast<uint8_t>(PropertyId::MaximumPacketSize));
+                writer.put32(connect.maximum_packet_size);
+            }
+            writer.putString(connect.client_id.data(), connect.client_id.size());
+            if (connect.has_will) {
+                writer.putVariableInt(0);
+                writer.putString(connect.will_topic.data(), connect.will_topic.size());
+                writer.putString(connect.will_payload.data(), connect.will_payload.size());
+            }
+            if (!connect.username.empty()) {
+                writer.putString(connect.username.data(), connect.username.size());
+            }
+            if (!connect.password.empty()) {
+                writer.putString(connect.password.data(), connect.password.size());
+            }
+            return total;
+        }
+
+        size_t encodeConnack(const ConnackView& connack, char* out, size_t capacity) {
+            if (connack.assigned_client_id.size() > MAX_STRING_SIZE) {
+                return 0;
+            }
+            size_t properties_size = (connack.receive_maximum != 65535 ? 3 : 0) +
+                (connack.topic_alias_maximum != 0 ? 3 : 0) +
+                (connack.maximum_packet_size != 0 ? 5 : 0) +
+                (connack.server_keep_alive != 0 ? 3 : 0) +
+                stringPropertySize(connack.assigned_client_id);
+            size_t remaining = 2 + variableIntSize(static_cast<uint32_t>(properties_size)) + properties_size;
+            size_t total = packetSize(remaining);
+            if (total > capacity) {
+                return 0;
+            }
+
+            Writer writer = startPacket(out, PacketType::Connack, 0, remaining);
+            writer.put8(connack.session_present ? 0x01 : 0x00);
+            writer.put8(static_cast<uint8_t>(connack.reason));
+            writer.putVariableInt(static_cast<uint32_t>(properties_size));
+            if (connack.receive_maximum != 65535) {
+                writer.put8(static_cast<uint8_t>(PropertyId::ReceiveMaximum));
+                writer.put16(connack.receive_maximum);
+            }
+            if (connack.topic_alias_maximum != 0) {
+                writer.put8(static_cast<uint8_t>(PropertyId::TopicAliasMaximum));
+                writer.put16(connack.topic_alias_maximum);
+            }
+            if (connack.maximum_packet_size != 0) {
+                writer.put8(static_cast<uint8_t>(PropertyId::MaximumPacketSize));
+                writer.put32(connack.maximum_packet_size);
+            }
+            if (connack.server_keep_alive != 0) {
+                writer.put8(static_cast<uint8_t>(PropertyId::ServerKeepAlive));
+                writer.put16(connack.server_keep_alive);
+            }
+            putStringProperty(writer, PropertyId::AssignedClientIdentifier, connack.assigned_client_id);
+            return total;
+        }
+
+        size_t encodeAck(PacketType type, uint16_t packet_id, ReasonCode reason, char* out, size_t capacity) {
+            if ((type != PacketType::Puback && type != PacketType::Pubrec &&
+                type != PacketType::Pubrel && type != PacketType::Pubcomp) || packet_id == 0) {
+                return 0;
+            }
+            // Success needs only the packet identifier; otherwise add the
+            // reason code and leave out the empty property section
+            size_t remaining = reason == ReasonCode::Success ? 2 : 3;
+            size_t total = packetSize(remaining);
+            if (total > capacity) {
+                return 0;
+            }
+            Writer writer = startPacket(out, type, type == PacketType::Pubrel ? 0x02 : 0x00, remaining);
+            writer.put16(packet_id);
+            if (reason != ReasonCode::Success) {
+                writer.put8(static_cast<uint8_t>(reason));
+            }
+            return total;
+        }
+
+        size_t encodeSubscribe(uint16_t packet_id, const std::string_view* filters, size_t count,
+            QoS maximum_qos, char* out, size_t capacity) {
+            if (packet_id == 0 || count == 0) {
+                return 0;
+            }
+            size_t remaining = 2 + 1;
+            for (size_t i = 0; i < count; i++) {
+                if (filters[i].size() > MAX_STRING_SIZE) {
+                    return 0;
+                }
+                remaining += 2 + filters[i].size() + 1;
+            }
+            size_t total = packetSize(remaining);
+            if (total == 0 || total > capacity) {
+                return 0;
+            }
+            Writer writer = startPacket(out, PacketType::Subscribe, 0x02, remaining);
+            writer.put16(packet_id);
+            writer.putVariableInt(0);
+            for (size_t i = 0; i < count; i++) {
+                writer.putString(filters[i].data(), filters[i].size());
+                writer.put8(static_cast<uint8_t>(maximum_qos));
+            }
+            return total;
+        }
+
+        size_t encodeUnsubscribe(uint16_t packet_id, const std::string_view* filters, size_t count,
+            char* out, size_t capacity) {
+            if (packet_id == 0 || count == 0) {
+                return 0;
+            }
+            size_t remaining = 2 + 1;
+            for (size_t i = 0; i < count; i++) {
+                if (filters[i].size() > MAX_STRING_SIZE) {
+                    return 0;
+                }
+                remaining += 2 + filters[i].size();
+            }
+            size_t total = packetSize(remaining);
+            if (total == 0 || total > capacity) {
+                return 0;
+            }
+            Writer writer = startPacket(out, PacketType::Unsubscribe, 0x02, remaining);
+            writer.put16(packet_id);
+            writer.putVariableInt(0);
+            for (size_t i = 0; i < count; i++) {
+                writer.putString(filters[i].data(), filters[i].size());
+            }
+            return total;
+        }
+
+        size_t encodeSuback(PacketType type, uint16_t packet_id, const ReasonCode* reasons, size_t count,
+            char* out, size_t capacity) {
+            if ((type != PacketType::Suback && type != PacketType::Unsuback) || packet_id == 0 || count == 0) {
+                return 0;
+            }
+            size_t remaining = 2 + 1 + count;
+            size_t total = packetSize(remaining);
+            if (total == 0 || total > capacity) {
+                return 0;
+            }
+            Writer writer = startPacket(out, type, 0, remaining);
+            writer.put16(packet_id);
+            writer.putVariableInt(0);
+            for (size_t i = 0; i < count; i++) {
+                writer.put8(static_cast<uint8_t>(reasons[i]));
+            }
+            return total;
+        }
+
+        size_t encodeDisconnect(ReasonCode reason, char* out, size_t capacity) {
+            size_t remaining = reason == ReasonCode::Success ? 0 : 1;
+            size_t total = packetSize(remaining);
+            if (total > capacity) {
+                return 0;
+            }
+            Writer writer = startPacket(out, PacketType::Disconnect, 0, remaining);
+            if (reason != ReasonCode::Success) {
+                writer.put8(static_cast<uint8_t>(reason));
+            }
+            return total;
+        }
+
+        size_t encodePing(PacketType type, char* out, size_t capacity) {
+            if ((type != PacketType::Pingreq && type != PacketType::Pingresp) || capacity < 2) {
+                return 0;
+            }
+            startPacket(out, type, 0, 0);
+            return 2;
+        }
+
+        bool validTopicFilter(std::string_view filter) {
+            if (filter.empty()) {
+                return false;
+            }
+            size_t level_start = 0;
+            while (true) {
+                size_t level_end = filter.find('/', level_start);
+                bool last = level_end == std::string_view::npos;
+                std::string_view level = filter.substr(level_start, last ? std::string_view::npos : level_end - level_start);
+                if (level.find('#') != std::string_view::npos && (level != "#" || !last)) {
+                    return false;
+                }
+                if (level.find('+') != std::string_view::npos && level != "+") {
+                    return false;
+                }
+                if (last) {
+                    return true;
+                }
+                level_start = level_end + 1;
+            }
+        }
+
+    } // namespace wire
+} // namespace mqtt
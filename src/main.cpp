@@ -1,4 +1,8 @@
+#include "HeadlessRunner.h"
+#include "LoadGenerator.h"
+#ifndef MQTTSIM_NO_GUI
 #include "NetworkSimulator.h"
+#endif
 #include <iostream>
 #include <stdexcept>
 #include "Constants.h"
@@ -6,27 +10,70 @@
 /**
  * @brief Application entry point
  *
+ * Starts the graphical simulator, or a GLFW/ImGui-free load run when
+ * started with --headless.
+ *
  * @return int Exit code
  */
 int main(int argc, char** argv) {
     try {
+        mqtt::HeadlessOptions options;
+        std::string error;
+        if (!options.parse(argc, argv, error)) {
+            std::cerr << "Error: " << error << "\n\n" << mqtt::HeadlessOptions::usage();
+            return 2;
+        }
+        if (options.show_help) {
+            std::cout << mqtt::HeadlessOptions::usage();
+            return 0;
+        }
+
+        if (!options.load_host.empty()) {
+            mqtt::LoadGenerator generator(options);
+            mqtt::LoadReport report = generator.run();
+            mqtt::LoadGenerator::printReport(options, report, std::cout);
+            return report.acknowledged > 0 ? 0 : 1;
+        }
+
+        if (options.enabled) {
+            mqtt::HeadlessRunner runner(options);
+            mqtt::HeadlessReport report = runner.run();
+            mqtt::HeadlessRunner::printReport(options, report, std::cout);
+
+            // Nothing delivered means the broker is broken
+            return report.delivered > 0 ? 0 : 1;
+        }
+
+#ifdef MQTTSIM_NO_GUI
+        std::cerr << "Built without GUI support; run with --headless\n\n" << mqtt::HeadlessOptions::usage();
+        return 2;
+#else
         // Create network simulator
         NetworkSimulator simulator;
 
-        // Add initial devices
-        simulator.addDevice(mqtt::constants::DEFAULT_TEMP_SENSOR_ID, std::chrono::milliseconds(mqtt::constants::TEMP_SENSOR_INTERVAL_MS));
-        simulator.addDevice(mqtt::constants::DEFAULT_HUMIDITY_SENSOR_ID, std::chrono::milliseconds(mqtt::constants::HUMIDITY_SENSOR_INTERVAL_MS));
-        simulator.addDevice(mqtt::constants::DEFAULT_VALVE_ACTUATOR_ID, std::chrono::milliseconds(mqtt::constants::VALVE_ACTUATOR_INTERVAL_MS));
-        simulator.addDevice(mqtt::constants::DEFAULT_GATEWAY_ID, std::chrono::milliseconds(mqtt::constants::GATEWAY_INTERVAL_MS));
+        // Start from a snapshot, or add the initial devices
+        if (!options.snapshot_file.empty()) {
+            if (!simulator.loadSnapshot(options.snapshot_file, error)) {
+                std::cerr << "Error: " << error << std::endl;
+                return 1;
+            }
+        }
+        else {
+            simulator.addDevice(mqtt::constants::DEFAULT_TEMP_SENSOR_ID, std::chrono::milliseconds(mqtt::constants::TEMP_SENSOR_INTERVAL_MS));
+            simulator.addDevice(mqtt::constants::DEFAULT_HUMIDITY_SENSOR_ID, std::chrono::milliseconds(mqtt::constants::HUMIDITY_SENSOR_INTERVAL_MS));
+            simulator.addDevice(mqtt::constants::DEFAULT_VALVE_ACTUATOR_ID, std::chrono::milliseconds(mqtt::constants::VALVE_ACTUATOR_INTERVAL_MS));
+            simulator.addDevice(mqtt::constants::DEFAULT_GATEWAY_ID, std::chrono::milliseconds(mqtt::constants::GATEWAY_INTERVAL_MS));
+        }
 
         // Initialize and run the simulator
         simulator.initialize();
         simulator.run();
 
         return 0;
+#endif
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
-}
\ No newline at end of file
+}